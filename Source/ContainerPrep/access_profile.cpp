@@ -0,0 +1,287 @@
+#include "access_profile.h"
+
+#include <fstream>
+#include <system_error>
+
+using namespace Files;
+
+static const wchar_t* DefaultSafetyPaths[] =
+{
+	L"\\Windows\\system32\\ntdll.dll",
+	L"\\Windows\\system32\\kernel32.dll",
+	L"\\Windows\\system32\\KernelBase.dll",
+	L"\\Windows\\system32\\smss.exe",
+	L"\\Windows\\system32\\csrss.exe",
+	L"\\Windows\\system32\\wininit.exe",
+	L"\\Windows\\system32\\services.exe",
+	L"\\Windows\\system32\\lsass.exe",
+	L"\\Windows\\system32\\CExecSvc.exe",
+	L"\\Windows\\system32\\config",
+};
+
+/**
+ * Splits a CSV line, handling quoted fields.
+ */
+static std::vector<std::string> splitCsv(const std::string& line)
+{
+	std::vector<std::string> fields(1);
+	bool quoted = false;
+
+	for (size_t i = 0; i < line.size(); ++i)
+	{
+		const char ch = line[i];
+		if (quoted)
+		{
+			if (ch == '"')
+			{
+				if (i + 1 < line.size() && line[i + 1] == '"') {
+					fields.back() += '"';
+					++i;
+				}
+				else {
+					quoted = false;
+				}
+			}
+			else {
+				fields.back() += ch;
+			}
+		}
+		else if (ch == '"') {
+			quoted = true;
+		}
+		else if (ch == ',') {
+			fields.emplace_back();
+		}
+		else {
+			fields.back() += ch;
+		}
+	}
+
+	return fields;
+}
+
+/**
+ * Converts a path seen inside the container (C:\Windows\..., \\?\C:\Windows\...) to file group form.
+ */
+static std::filesystem::path normalizeContainerPath(std::string_view path)
+{
+	if (!path.compare(0, 4, "\\\\?\\") || !path.compare(0, 4, "\\??\\")) {
+		path.remove_prefix(4);
+	}
+
+	if (path.size() >= 2 && path[1] == ':') {
+		path.remove_prefix(2);
+	}
+
+	std::string result;
+	result.reserve(path.size() + 1);
+	if (path.empty() || (path[0] != '\\' && path[0] != '/')) {
+		result += '\\';
+	}
+
+	for (const char ch : path) {
+		result += ch == '/' ? '\\' : ch;
+	}
+
+	return fromUtf8(result);
+}
+
+Files::AccessProfile::AccessProfile(std::istream& traceStream)
+{
+	std::string line;
+	size_t pathColumn = 0;
+	bool csv = false;
+	bool firstLine = true;
+
+	while (std::getline(traceStream, line))
+	{
+		if (!line.empty() && line.back() == '\r') {
+			line.pop_back();
+		}
+
+		if (firstLine)
+		{
+			firstLine = false;
+
+			// skip the UTF-8 BOM
+			if (!line.compare(0, 3, "\xEF\xBB\xBF")) {
+				line.erase(0, 3);
+			}
+
+			if (line.find(',') != std::string::npos)
+			{
+				const std::vector<std::string> header = splitCsv(line);
+				for (size_t i = 0; i < header.size(); ++i)
+				{
+					if (header[i] == "Path")
+					{
+						pathColumn = i;
+						csv = true;
+						break;
+					}
+				}
+
+				if (csv) {
+					continue;
+				}
+			}
+		}
+
+		if (line.empty() || line[0] == '#') {
+			continue;
+		}
+
+		if (csv)
+		{
+			const std::vector<std::string> fields = splitCsv(line);
+			if (pathColumn < fields.size() && !fields[pathColumn].empty()) {
+				addFile(normalizeContainerPath(fields[pathColumn]));
+			}
+		}
+		else {
+			addFile(normalizeContainerPath(line));
+		}
+	}
+}
+
+AccessProfile Files::AccessProfile::load(const std::filesystem::path& traceFile)
+{
+	std::ifstream stream(traceFile, std::ios::in | std::ios::binary);
+	if (stream.fail()) {
+		throw std::system_error(std::make_error_code(std::errc::no_such_file_or_directory), "could not open the access trace");
+	}
+
+	return AccessProfile(stream);
+}
+
+AccessProfile::key_t Files::AccessProfile::makeKey(const std::filesystem::path& path)
+{
+	key_t key = path.native();
+	for (auto& ch : key)
+	{
+		if (ch == '/') {
+			ch = '\\';
+		}
+		else if (ch >= 'A' && ch <= 'Z') {
+			ch += 'a' - 'A';
+		}
+	}
+
+	if (key.empty() || key[0] != '\\') {
+		key.insert(key.begin(), '\\');
+	}
+
+	while (key.size() > 1 && key.back() == '\\') {
+		key.pop_back();
+	}
+
+	return key;
+}
+
+void Files::AccessProfile::addFile(const std::filesystem::path& path)
+{
+	key_t key = makeKey(path);
+	if (files.insert(key).second)
+	{
+		accessOrder.push_back(path);
+		addParentDirectories(key);
+	}
+}
+
+void Files::AccessProfile::addParentDirectories(const key_t& key)
+{
+	for (size_t separator = key.rfind('\\'); separator != key_t::npos && separator > 0; separator = key.rfind('\\', separator - 1))
+	{
+		if (!directories.insert(key.substr(0, separator)).second)
+		{
+			// the remaining ancestors are already there
+			break;
+		}
+	}
+}
+
+void Files::AccessProfile::addSafetyPath(const std::filesystem::path& path)
+{
+	key_t key = makeKey(path);
+
+	// the path may be a file or a directory, keep both
+	files.insert(key);
+	safetyDirectories.insert(key);
+	addParentDirectories(key);
+}
+
+void Files::AccessProfile::addSafetyPaths(std::istream& stream)
+{
+	std::string line;
+	while (std::getline(stream, line))
+	{
+		if (!line.empty() && line.back() == '\r') {
+			line.pop_back();
+		}
+
+		if (!line.empty() && line[0] != '#') {
+			addSafetyPath(normalizeContainerPath(line));
+		}
+	}
+}
+
+void Files::AccessProfile::addDefaultSafetyPaths()
+{
+	for (const wchar_t* path : DefaultSafetyPaths) {
+		addSafetyPath(path);
+	}
+}
+
+bool Files::AccessProfile::isUnderSafetyDirectory(const key_t& key) const
+{
+	for (size_t separator = key.size(); separator != key_t::npos && separator > 0; separator = key.rfind('\\', separator - 1))
+	{
+		if (safetyDirectories.count(key.substr(0, separator))) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool Files::AccessProfile::containsFile(const std::filesystem::path& path) const
+{
+	const key_t key = makeKey(path);
+	return files.count(key) || isUnderSafetyDirectory(key);
+}
+
+bool Files::AccessProfile::containsDirectory(const std::filesystem::path& path) const
+{
+	const key_t key = makeKey(path);
+	return key.size() == 1 || directories.count(key) || isUnderSafetyDirectory(key);
+}
+
+const std::vector<std::filesystem::path>& Files::AccessProfile::getAccessOrder() const
+{
+	return accessOrder;
+}
+
+std::vector<LinkEntry> Files::pruneLinks(const std::vector<LinkEntry>& links, const AccessProfile& profile, PruneReport& report)
+{
+	std::vector<LinkEntry> keptLinks;
+	std::unordered_set<std::filesystem::path::string_type> sources;
+	std::unordered_set<std::filesystem::path::string_type> keptSources;
+
+	for (const LinkEntry& link : links)
+	{
+		sources.insert(link.source.native());
+
+		if (profile.containsFile(link.target))
+		{
+			keptSources.insert(link.source.native());
+			keptLinks.push_back(link);
+		}
+	}
+
+	report.totalLinks = links.size();
+	report.keptLinks = keptLinks.size();
+	report.totalFiles = sources.size();
+	report.keptFiles = keptSources.size();
+
+	return keptLinks;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "link_manifest.h"
+
+#include <filesystem>
+#include <istream>
+#include <unordered_set>
+#include <vector>
+
+namespace Files
+{
+	/**
+	 * Set of files accessed during a recorded container run.
+	 *
+	 * The trace is a text file with one container path per line (C:\Windows\system32\ntdll.dll),
+	 * or a CSV file whose header has a "Path" column, such as a Process Monitor export.
+	 * Lines starting with # are ignored, and paths are kept in first access order.
+	 */
+	class AccessProfile
+	{
+	public:
+		using key_t = std::filesystem::path::string_type;
+
+	public:
+		AccessProfile(std::istream& traceStream);
+
+		static AccessProfile load(const std::filesystem::path& traceFile);
+
+		/**
+		 * Adds a file or a directory that is always kept, even if it was never accessed.
+		 */
+		void addSafetyPath(const std::filesystem::path& path);
+
+		/**
+		 * Adds the paths listed in a file, one per line.
+		 */
+		void addSafetyPaths(std::istream& stream);
+
+		/**
+		 * Adds the files needed to boot the container whether or not they show up in the trace.
+		 */
+		void addDefaultSafetyPaths();
+
+		/**
+		 * Whether the file (in file group form) must be kept.
+		 */
+		bool containsFile(const std::filesystem::path& path) const;
+
+		/**
+		 * Whether the directory (in file group form) may contain files to keep.
+		 */
+		bool containsDirectory(const std::filesystem::path& path) const;
+
+		/**
+		 * Accessed files in file group form, in order of first access.
+		 */
+		const std::vector<std::filesystem::path>& getAccessOrder() const;
+
+		/**
+		 * Case-insensitive lookup key of a path in file group form.
+		 */
+		static key_t makeKey(const std::filesystem::path& path);
+
+	private:
+		void addFile(const std::filesystem::path& path);
+		void addParentDirectories(const key_t& key);
+		bool isUnderSafetyDirectory(const key_t& key) const;
+
+	private:
+		std::vector<std::filesystem::path> accessOrder;
+		std::unordered_set<key_t> files;
+		std::unordered_set<key_t> directories;
+		std::unordered_set<key_t> safetyDirectories;
+	};
+
+	struct PruneReport
+	{
+		size_t totalLinks;
+		size_t keptLinks;
+		size_t totalFiles;
+		size_t keptFiles;
+	};
+
+	/**
+	 * Keeps the manifest links that the profile contains.
+	 */
+	std::vector<LinkEntry> pruneLinks(const std::vector<LinkEntry>& links, const AccessProfile& profile, PruneReport& report);
+}
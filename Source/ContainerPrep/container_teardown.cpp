@@ -0,0 +1,260 @@
+#include "container_teardown.h"
+#include "tree_walker.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <iterator>
+#include <thread>
+#include <unordered_set>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace Files;
+
+/**
+ * Deletes a file, a directory or a reparse point.
+ */
+static std::error_code deleteEntry(const std::filesystem::path& path, bool directory)
+{
+#ifdef _WIN32
+	HANDLE hFile = CreateFileW(
+		path.c_str(),
+		DELETE,
+		FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		NULL,
+		OPEN_EXISTING,
+		FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OPEN_REPARSE_POINT,
+		NULL
+	);
+
+	if (hFile == INVALID_HANDLE_VALUE) {
+		return std::error_code(GetLastError(), std::system_category());
+	}
+
+	// the name goes away as soon as the handle is closed, even if the host has the file open;
+	// read-only links are deleted as is, clearing the attribute would change the host file
+	FILE_DISPOSITION_INFO_EX dispositionInfo;
+	dispositionInfo.Flags = FILE_DISPOSITION_FLAG_DELETE | FILE_DISPOSITION_FLAG_POSIX_SEMANTICS | FILE_DISPOSITION_FLAG_IGNORE_READONLY_ATTRIBUTE;
+
+	DWORD lastError = ERROR_SUCCESS;
+	if (!SetFileInformationByHandle(hFile, FileDispositionInfoEx, &dispositionInfo, sizeof(dispositionInfo))) {
+		lastError = GetLastError();
+	}
+
+	CloseHandle(hFile);
+
+	if (lastError == ERROR_INVALID_PARAMETER || lastError == ERROR_NOT_SUPPORTED)
+	{
+		// the file system doesn't support extended disposition flags
+		lastError = ERROR_SUCCESS;
+		if (!(directory ? RemoveDirectoryW(path.c_str()) : DeleteFileW(path.c_str()))) {
+			lastError = GetLastError();
+		}
+	}
+
+	return std::error_code(lastError, std::system_category());
+#else
+	if ((directory ? rmdir(path.c_str()) : unlink(path.c_str())) < 0)
+	{
+		// a symbolic link to a directory is not a directory here
+		if (!directory || errno != ENOTDIR || unlink(path.c_str()) < 0) {
+			return std::error_code(errno, std::generic_category());
+		}
+	}
+
+	return std::error_code();
+#endif
+}
+
+Files::ContainerTeardown::ContainerTeardown(ThreadPool& inPool, const TeardownOptions& inOptions)
+	: pool(inPool)
+	, options(inOptions)
+	, startTime(std::chrono::steady_clock::now())
+	, deletedCount(0)
+	, fileCount(0)
+	, directoryCount(0)
+	, failedCount(0)
+{
+	if (!options.maxConcurrency || options.maxConcurrency > pool.getNumThreads() + 1) {
+		options.maxConcurrency = pool.getNumThreads() + 1;
+	}
+}
+
+void Files::ContainerTeardown::destroy(const std::filesystem::path& containerPath)
+{
+	const std::filesystem::path filesDir = containerPath / L"Files";
+	const std::filesystem::path manifestPath = containerPath / L"links.manifest";
+
+	std::error_code ec;
+	if (std::filesystem::exists(manifestPath, ec)) {
+		removeLinks(LinkManifest::load(manifestPath), filesDir);
+	}
+	else {
+		removeTree(filesDir);
+	}
+
+	removeTree(containerPath / L"Hives");
+
+	// the manifest is deleted with the rest once the links are gone,
+	// so that an interrupted teardown can start again from it
+	removeTree(containerPath);
+}
+
+void Files::ContainerTeardown::removeTree(const std::filesystem::path& directory)
+{
+	std::vector<TreeEntry> entries;
+	std::vector<std::vector<std::filesystem::path>> levels;
+	walkTree(pool, directory, entries, levels);
+
+	std::vector<std::pair<size_t, std::filesystem::path>> directories;
+	for (size_t depth = 0; depth < levels.size(); ++depth)
+	{
+		for (std::filesystem::path& path : levels[depth]) {
+			directories.emplace_back(depth, std::move(path));
+		}
+	}
+
+	removeEntries(entries, fileCount);
+	removeDirectories(directories);
+}
+
+void Files::ContainerTeardown::removeLinks(const LinkManifest& manifest, const std::filesystem::path& filesDir)
+{
+	std::vector<TreeEntry> directoryLinks;
+	std::vector<TreeEntry> entries;
+	std::vector<std::pair<size_t, std::filesystem::path>> directories;
+	std::unordered_set<std::filesystem::path::string_type> knownDirectories;
+	std::unordered_set<std::filesystem::path::string_type> directoryLinkPaths;
+
+	const size_t rootDepth = std::distance(filesDir.begin(), filesDir.end());
+
+	for (const LinkEntry& link : manifest.getEntries())
+	{
+		if (link.directory) {
+			directoryLinkPaths.insert(getLinkPath(filesDir, link.target).native());
+		}
+	}
+
+	// only the last component of a path is not followed, an entry below a directory link would delete the host file
+	const auto isBelowDirectoryLink = [&](const std::filesystem::path& path)
+		{
+			for (std::filesystem::path directory = path.parent_path(); directory.native().size() > filesDir.native().size(); directory = directory.parent_path())
+			{
+				if (directoryLinkPaths.count(directory.native())) {
+					return true;
+				}
+			}
+
+			return false;
+		};
+
+	for (const LinkEntry& link : manifest.getEntries())
+	{
+		TreeEntry entry{ getLinkPath(filesDir, link.target), link.directory };
+		if (isBelowDirectoryLink(entry.path)) {
+			continue;
+		}
+
+		for (std::filesystem::path directory = entry.path.parent_path();
+			directory.native().size() > filesDir.native().size() && knownDirectories.insert(directory.native()).second;
+			directory = directory.parent_path())
+		{
+			const size_t depth = std::distance(directory.begin(), directory.end()) - rootDepth;
+			directories.emplace_back(depth, directory);
+		}
+
+		(link.directory ? directoryLinks : entries).push_back(std::move(entry));
+	}
+
+	// the directory links go first, nothing below them is reached once they are deleted
+	removeEntries(directoryLinks, fileCount);
+	removeEntries(entries, fileCount);
+	removeDirectories(directories);
+
+	// entries created outside of the manifest are left, enumerate what remains
+	removeTree(filesDir);
+}
+
+TeardownReport Files::ContainerTeardown::getReport() const
+{
+	TeardownReport report;
+	report.files = fileCount;
+	report.directories = directoryCount;
+	report.failed = failedCount;
+
+	return report;
+}
+
+void Files::ContainerTeardown::removeEntries(const std::vector<TreeEntry>& entries, std::atomic<size_t>& counter)
+{
+	if (entries.empty()) {
+		return;
+	}
+
+	// a fixed number of workers take the entries in turn, bounding the deletions in flight
+	std::atomic<size_t> nextEntry = 0;
+	const size_t workerCount = std::min(options.maxConcurrency, entries.size());
+
+	pool.parallelFor(workerCount, [&](size_t)
+		{
+			for (size_t index = nextEntry++; index < entries.size(); index = nextEntry++)
+			{
+				removeEntry(entries[index], counter);
+				throttle();
+			}
+		});
+}
+
+void Files::ContainerTeardown::removeDirectories(std::vector<std::pair<size_t, std::filesystem::path>>& directories)
+{
+	// deepest first, directories of the same level don't depend on each other
+	std::sort(directories.begin(), directories.end(), [](const auto& left, const auto& right)
+		{
+			return left.first > right.first;
+		});
+
+	std::vector<TreeEntry> level;
+	for (size_t i = 0; i < directories.size();)
+	{
+		const size_t depth = directories[i].first;
+
+		level.clear();
+		for (; i < directories.size() && directories[i].first == depth; ++i) {
+			level.push_back({ std::move(directories[i].second), true });
+		}
+
+		removeEntries(level, directoryCount);
+	}
+}
+
+void Files::ContainerTeardown::removeEntry(const TreeEntry& entry, std::atomic<size_t>& counter)
+{
+	const std::error_code ec = deleteEntry(entry.path, entry.directory);
+	if (!ec) {
+		++counter;
+	}
+	else if (ec != std::errc::no_such_file_or_directory && ec != std::errc::directory_not_empty)
+	{
+		// a directory that is not empty holds an entry that failed or was not listed
+		++failedCount;
+	}
+}
+
+void Files::ContainerTeardown::throttle()
+{
+	if (!options.maxRate) {
+		return;
+	}
+
+	// sleep until the deletions done so far fit in the rate
+	const size_t count = ++deletedCount;
+	const auto due = startTime + std::chrono::microseconds(count * 1000000 / options.maxRate);
+	const auto now = std::chrono::steady_clock::now();
+	if (due > now) {
+		std::this_thread::sleep_for(due - now);
+	}
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "link_manifest.h"
+#include "thread_pool.h"
+#include "tree_walker.h"
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <vector>
+
+namespace Files
+{
+	struct TeardownOptions
+	{
+		/** Maximum number of deletions in flight, 0 for one per pool thread. */
+		size_t maxConcurrency;
+
+		/** Maximum number of deletions per second, 0 for no limit. */
+		size_t maxRate;
+	};
+
+	struct TeardownReport
+	{
+		size_t files;
+		size_t directories;
+		size_t failed;
+	};
+
+	/**
+	 * Deletes container trees in parallel, deepest entries first.
+	 *
+	 * Files are deleted with POSIX semantics without changing their attributes,
+	 * as they are hard links shared with the host. Reparse points are deleted, not followed.
+	 */
+	class ContainerTeardown
+	{
+	public:
+		ContainerTeardown(ThreadPool& inPool, const TeardownOptions& inOptions);
+
+		/**
+		 * Deletes the files, hives, disk and manifest of a container, then its directory.
+		 * The files are deleted from the link manifest when there is one.
+		 */
+		void destroy(const std::filesystem::path& containerPath);
+
+		/**
+		 * Deletes a directory and everything below it.
+		 */
+		void removeTree(const std::filesystem::path& directory);
+
+		/**
+		 * Deletes the links of the manifest and their directories, then the files directory.
+		 * Directory links are deleted first, the entries listed below them are not deleted through them.
+		 * Entries not listed in the manifest are enumerated and deleted as well.
+		 */
+		void removeLinks(const LinkManifest& manifest, const std::filesystem::path& filesDir);
+
+		TeardownReport getReport() const;
+
+	private:
+		void removeEntries(const std::vector<TreeEntry>& entries, std::atomic<size_t>& counter);
+		void removeDirectories(std::vector<std::pair<size_t, std::filesystem::path>>& directories);
+		void removeEntry(const TreeEntry& entry, std::atomic<size_t>& counter);
+		void throttle();
+
+	private:
+		ThreadPool& pool;
+		TeardownOptions options;
+		std::chrono::steady_clock::time_point startTime;
+		std::atomic<size_t> deletedCount;
+		std::atomic<size_t> fileCount;
+		std::atomic<size_t> directoryCount;
+		std::atomic<size_t> failedCount;
+	};
+}
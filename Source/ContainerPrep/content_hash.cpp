@@ -0,0 +1,168 @@
+#include "content_hash.h"
+
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <system_error>
+
+using namespace Files;
+
+static const size_t ReadChunkSize = 1024 * 1024;
+
+static const uint32_t RoundConstants[64] =
+{
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static uint32_t rotateRight(uint32_t value, int count)
+{
+	return (value >> count) | (value << (32 - count));
+}
+
+Files::Sha256::Sha256()
+	: state{ 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 }
+	, buffer{}
+	, bufferSize(0)
+	, totalSize(0)
+{
+}
+
+void Files::Sha256::processBlock(const uint8_t* block)
+{
+	uint32_t w[64];
+	for (int i = 0; i < 16; ++i) {
+		w[i] = (uint32_t(block[i * 4]) << 24) | (uint32_t(block[i * 4 + 1]) << 16) | (uint32_t(block[i * 4 + 2]) << 8) | block[i * 4 + 3];
+	}
+
+	for (int i = 16; i < 64; ++i)
+	{
+		const uint32_t s0 = rotateRight(w[i - 15], 7) ^ rotateRight(w[i - 15], 18) ^ (w[i - 15] >> 3);
+		const uint32_t s1 = rotateRight(w[i - 2], 17) ^ rotateRight(w[i - 2], 19) ^ (w[i - 2] >> 10);
+		w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+	}
+
+	uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+	uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+	for (int i = 0; i < 64; ++i)
+	{
+		const uint32_t s1 = rotateRight(e, 6) ^ rotateRight(e, 11) ^ rotateRight(e, 25);
+		const uint32_t ch = (e & f) ^ (~e & g);
+		const uint32_t t1 = h + s1 + ch + RoundConstants[i] + w[i];
+		const uint32_t s0 = rotateRight(a, 2) ^ rotateRight(a, 13) ^ rotateRight(a, 22);
+		const uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+		const uint32_t t2 = s0 + maj;
+
+		h = g;
+		g = f;
+		f = e;
+		e = d + t1;
+		d = c;
+		c = b;
+		b = a;
+		a = t1 + t2;
+	}
+
+	state[0] += a;
+	state[1] += b;
+	state[2] += c;
+	state[3] += d;
+	state[4] += e;
+	state[5] += f;
+	state[6] += g;
+	state[7] += h;
+}
+
+void Files::Sha256::update(std::span<const uint8_t> data)
+{
+	totalSize += data.size();
+
+	size_t offset = 0;
+	if (bufferSize)
+	{
+		const size_t count = std::min(data.size(), sizeof(buffer) - bufferSize);
+		std::memcpy(buffer + bufferSize, data.data(), count);
+		bufferSize += count;
+		offset = count;
+
+		if (bufferSize < sizeof(buffer)) {
+			return;
+		}
+
+		processBlock(buffer);
+		bufferSize = 0;
+	}
+
+	for (; offset + sizeof(buffer) <= data.size(); offset += sizeof(buffer)) {
+		processBlock(data.data() + offset);
+	}
+
+	bufferSize = data.size() - offset;
+	std::memcpy(buffer, data.data() + offset, bufferSize);
+}
+
+ContentHash Files::Sha256::finish()
+{
+	const uint64_t bitSize = totalSize * 8;
+
+	// padding: a one bit, zeros, then the size in bits
+	uint8_t padding[72] = { 0x80 };
+	const size_t paddingSize = (bufferSize < 56 ? 56 : 120) - bufferSize;
+	for (int i = 0; i < 8; ++i) {
+		padding[paddingSize + i] = static_cast<uint8_t>(bitSize >> (56 - i * 8));
+	}
+
+	update(std::span<const uint8_t>(padding, paddingSize + 8));
+
+	ContentHash hash;
+	for (int i = 0; i < 8; ++i)
+	{
+		hash[i * 4] = static_cast<uint8_t>(state[i] >> 24);
+		hash[i * 4 + 1] = static_cast<uint8_t>(state[i] >> 16);
+		hash[i * 4 + 2] = static_cast<uint8_t>(state[i] >> 8);
+		hash[i * 4 + 3] = static_cast<uint8_t>(state[i]);
+	}
+
+	return hash;
+}
+
+ContentHash Files::hashFile(const std::filesystem::path& path)
+{
+	std::ifstream stream(path, std::ios::in | std::ios::binary);
+	if (stream.fail()) {
+		throw std::system_error(std::make_error_code(std::errc::no_such_file_or_directory), "could not open the file to hash");
+	}
+
+	Sha256 sha;
+	std::unique_ptr<uint8_t[]> chunk(new uint8_t[ReadChunkSize]);
+
+	while (stream)
+	{
+		stream.read(reinterpret_cast<char*>(chunk.get()), ReadChunkSize);
+		sha.update(std::span<const uint8_t>(chunk.get(), static_cast<size_t>(stream.gcount())));
+	}
+
+	return sha.finish();
+}
+
+std::string Files::toHex(const ContentHash& hash)
+{
+	static const char digits[] = "0123456789abcdef";
+
+	std::string result;
+	result.reserve(hash.size() * 2);
+	for (const uint8_t byte : hash)
+	{
+		result += digits[byte >> 4];
+		result += digits[byte & 0xf];
+	}
+
+	return result;
+}
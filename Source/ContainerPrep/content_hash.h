@@ -0,0 +1,40 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string>
+
+namespace Files
+{
+	using ContentHash = std::array<uint8_t, 32>;
+
+	/**
+	 * SHA-256 of a stream of data.
+	 */
+	class Sha256
+	{
+	public:
+		Sha256();
+
+		void update(std::span<const uint8_t> data);
+		ContentHash finish();
+
+	private:
+		void processBlock(const uint8_t* block);
+
+	private:
+		uint32_t state[8];
+		uint8_t buffer[64];
+		size_t bufferSize;
+		uint64_t totalSize;
+	};
+
+	/**
+	 * Hashes the content of a file, reading it in chunks.
+	 */
+	ContentHash hashFile(const std::filesystem::path& path);
+
+	std::string toHex(const ContentHash& hash);
+}
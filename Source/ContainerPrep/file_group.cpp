@@ -0,0 +1,51 @@
+#include "file_group.h"
+
+#include <pugixml.hpp>
+
+using namespace Files;
+
+void Files::writeFileGroup(std::ostream& stream, const std::wstring_view& groupName, const std::vector<std::filesystem::path>& hostFiles)
+{
+	pugi::xml_document doc;
+	pugi::xml_node groupNode = doc.append_child("FileGroup");
+	groupNode.append_attribute("Name") = toUtf8(groupName).c_str();
+
+	for (const std::filesystem::path& hostFile : hostFiles)
+	{
+		pugi::xml_node fileNode = groupNode.append_child("HostFile");
+		fileNode.append_attribute("Path") = toUtf8(toFileGroupPath(hostFile)).c_str();
+	}
+
+	doc.save(stream, "    ");
+}
+
+void Files::writeFileGroup(std::ostream& stream, const std::wstring_view& groupName, const std::vector<LinkEntry>& links)
+{
+	pugi::xml_document doc;
+	pugi::xml_node groupNode = doc.append_child("FileGroup");
+	groupNode.append_attribute("Name") = toUtf8(groupName).c_str();
+
+	for (const LinkEntry& link : links)
+	{
+		const std::filesystem::path sourcePath = toFileGroupPath(link.source);
+
+		pugi::xml_node fileNode = groupNode.append_child(link.directory ? "HostDirectory" : "HostFile");
+		fileNode.append_attribute("Path") = toUtf8(sourcePath).c_str();
+		if (sourcePath != link.target) {
+			fileNode.append_attribute("Target") = toUtf8(link.target).c_str();
+		}
+
+		if (link.directory) {
+			fileNode.append_attribute("Link") = "Directory";
+		}
+	}
+
+	doc.save(stream, "    ");
+}
+
+void Files::visitHostFiles(Config::IFileVisitor& visitor, const std::vector<std::filesystem::path>& hostFiles)
+{
+	for (const std::filesystem::path& hostFile : hostFiles) {
+		visitor.visit(Config::HostFile(toFileGroupPath(hostFile)));
+	}
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "files_configuration.h"
+#include "link_manifest.h"
+
+#include <filesystem>
+#include <ostream>
+#include <string_view>
+#include <vector>
+
+namespace Files
+{
+	/**
+	 * Writes the files as a file group of HostFile entries.
+	 */
+	void writeFileGroup(std::ostream& stream, const std::wstring_view& groupName, const std::vector<std::filesystem::path>& hostFiles);
+
+	/**
+	 * Writes links as a file group of HostFile entries, and HostDirectory entries for directory links.
+	 */
+	void writeFileGroup(std::ostream& stream, const std::wstring_view& groupName, const std::vector<LinkEntry>& links);
+
+	/**
+	 * Feeds the files as HostFile entries to a file visitor.
+	 */
+	void visitHostFiles(Config::IFileVisitor& visitor, const std::vector<std::filesystem::path>& hostFiles);
+}
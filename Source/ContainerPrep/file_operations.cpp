@@ -0,0 +1,83 @@
+#include "file_operations.h"
+
+#include <algorithm>
+
+using namespace Files;
+
+/**
+ * Operations per pool task, a task per operation costs more than the call itself.
+ */
+static const size_t OperationsPerTask = 64;
+
+static void executeOperation(FileOperation& operation)
+{
+	std::error_code ec;
+
+	switch (operation.type)
+	{
+	case FileOperationType::CreateDirectory:
+		if (!std::filesystem::create_directory(operation.path, ec) && !ec) {
+			ec = std::make_error_code(std::errc::file_exists);
+		}
+		break;
+	case FileOperationType::CreateHardLink:
+		std::filesystem::create_hard_link(operation.target, operation.path, ec);
+		break;
+	case FileOperationType::CreateDirectoryLink:
+		std::filesystem::create_directory_symlink(operation.target, operation.path, ec);
+		break;
+	case FileOperationType::Stat:
+		operation.linkCount = std::filesystem::hard_link_count(operation.path, ec);
+		if (!ec) {
+			operation.size = std::filesystem::file_size(operation.path, ec);
+		}
+		break;
+	}
+
+	operation.result = ec;
+}
+
+Files::ThreadPoolFileOperations::ThreadPoolFileOperations(ThreadPool& inPool)
+	: pool(inPool)
+{
+}
+
+void Files::ThreadPoolFileOperations::execute(std::span<FileOperation> operations)
+{
+	const size_t taskCount = (operations.size() + OperationsPerTask - 1) / OperationsPerTask;
+
+	pool.parallelFor(taskCount, [&](size_t task)
+		{
+			const size_t begin = task * OperationsPerTask;
+			const size_t end = std::min(begin + OperationsPerTask, operations.size());
+
+			for (size_t i = begin; i < end; ++i) {
+				executeOperation(operations[i]);
+			}
+		});
+}
+
+void Files::DryRunFileOperations::execute(std::span<FileOperation> operations)
+{
+	for (FileOperation& operation : operations)
+	{
+		operation.result.clear();
+
+		// a run that couldn't link a directory linked its files instead, the dry run must fall back the same way
+		std::error_code ec;
+		if (operation.type == FileOperationType::CreateDirectoryLink && std::filesystem::exists(std::filesystem::symlink_status(operation.path, ec))) {
+			operation.result = std::make_error_code(std::errc::file_exists);
+		}
+	}
+}
+
+IFileOperationsPtr Files::createFileOperations(ThreadPool& pool)
+{
+#ifdef __linux__
+	if (IFileOperationsPtr operations = createUringFileOperations()) {
+		return operations;
+	}
+#endif
+
+	return IFileOperationsPtr(new ThreadPoolFileOperations(pool));
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "thread_pool.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <system_error>
+
+namespace Files
+{
+	enum class FileOperationType : unsigned char
+	{
+		/** Creates the directory, its parent must exist. */
+		CreateDirectory,
+
+		/** Creates a hard link at the path to the target file. */
+		CreateHardLink,
+
+		/** Creates a symbolic link at the path to the target directory. */
+		CreateDirectoryLink,
+
+		/** Queries the link count and size of the file. */
+		Stat
+	};
+
+	struct FileOperation
+	{
+		FileOperationType type;
+		std::filesystem::path path;
+
+		/** Existing file for CreateHardLink, existing directory for CreateDirectoryLink. */
+		std::filesystem::path target;
+
+		/** Set when the operation completes, file_exists if the path already exists. */
+		std::error_code result;
+
+		/** Stat results. */
+		uintmax_t linkCount;
+		uintmax_t size;
+	};
+
+	/**
+	 * Runs batches of filesystem operations, the operations of a batch can be in flight at the same time.
+	 */
+	class IFileOperations
+	{
+	public:
+		virtual ~IFileOperations() = default;
+
+		/**
+		 * Runs operations that don't depend on each other, and stores the result of each.
+		 */
+		virtual void execute(std::span<FileOperation> operations) = 0;
+	};
+	using IFileOperationsPtr = std::shared_ptr<IFileOperations>;
+
+	/**
+	 * Runs each operation as a blocking call on the thread pool.
+	 */
+	class ThreadPoolFileOperations : public IFileOperations
+	{
+	public:
+		ThreadPoolFileOperations(ThreadPool& inPool);
+
+		void execute(std::span<FileOperation> operations) override;
+
+	private:
+		ThreadPool& pool;
+	};
+
+	/**
+	 * Completes the operations without touching the filesystem, to resolve what would be done.
+	 * A directory link fails with file_exists where the path already exists, as it does when a run is resumed.
+	 */
+	class DryRunFileOperations : public IFileOperations
+	{
+	public:
+		void execute(std::span<FileOperation> operations) override;
+	};
+
+#ifdef __linux__
+	/**
+	 * Returns a backend submitting the operations through io_uring (mkdirat, linkat, symlinkat, statx),
+	 * or nullptr if the kernel doesn't support them. conprep only runs on Windows, so this is used by
+	 * the library and its tests for now.
+	 */
+	IFileOperationsPtr createUringFileOperations(unsigned int queueDepth = 256);
+#endif
+
+	/**
+	 * Returns the fastest backend available on this system.
+	 */
+	IFileOperationsPtr createFileOperations(ThreadPool& pool);
+}
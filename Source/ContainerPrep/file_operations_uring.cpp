@@ -0,0 +1,310 @@
+#ifdef __linux__
+
+#include "file_operations.h"
+
+#include <linux/io_uring.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using namespace Files;
+
+static int ioUringSetup(unsigned int entries, io_uring_params* params)
+{
+	return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+static int ioUringEnter(int fd, unsigned int toSubmit, unsigned int minComplete, unsigned int flags)
+{
+	return static_cast<int>(syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0));
+}
+
+static int ioUringRegister(int fd, unsigned int opcode, void* arg, unsigned int argCount)
+{
+	return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, argCount));
+}
+
+/**
+ * Submission and completion rings mapped from the kernel, without liburing.
+ */
+class UringFileOperations : public IFileOperations
+{
+public:
+	UringFileOperations(int inRingFd, const io_uring_params& params);
+	~UringFileOperations();
+
+	UringFileOperations(const UringFileOperations&) = delete;
+	UringFileOperations& operator=(const UringFileOperations&) = delete;
+
+	bool map();
+	void execute(std::span<FileOperation> operations) override;
+
+private:
+	void prepare(io_uring_sqe& sqe, FileOperation& operation, size_t index);
+	size_t reap(std::span<FileOperation> operations);
+
+private:
+	int ringFd;
+	io_uring_params params;
+
+	void* sqRing;
+	size_t sqRingSize;
+	void* cqRing;
+	size_t cqRingSize;
+	io_uring_sqe* sqes;
+	size_t sqesSize;
+
+	std::atomic<unsigned int>* sqHead;
+	std::atomic<unsigned int>* sqTail;
+	unsigned int sqMask;
+	unsigned int* sqArray;
+
+	std::atomic<unsigned int>* cqHead;
+	std::atomic<unsigned int>* cqTail;
+	unsigned int cqMask;
+	io_uring_cqe* cqes;
+
+	/** statx results, one per operation of the batch. */
+	std::vector<struct statx> statxBuffers;
+};
+
+UringFileOperations::UringFileOperations(int inRingFd, const io_uring_params& inParams)
+	: ringFd(inRingFd)
+	, params(inParams)
+	, sqRing(MAP_FAILED)
+	, sqRingSize(0)
+	, cqRing(MAP_FAILED)
+	, cqRingSize(0)
+	, sqes(static_cast<io_uring_sqe*>(MAP_FAILED))
+	, sqesSize(0)
+{
+}
+
+UringFileOperations::~UringFileOperations()
+{
+	if (sqes != MAP_FAILED) {
+		munmap(sqes, sqesSize);
+	}
+
+	if (cqRing != MAP_FAILED && cqRing != sqRing) {
+		munmap(cqRing, cqRingSize);
+	}
+
+	if (sqRing != MAP_FAILED) {
+		munmap(sqRing, sqRingSize);
+	}
+
+	close(ringFd);
+}
+
+bool UringFileOperations::map()
+{
+	sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+	cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+	if (params.features & IORING_FEAT_SINGLE_MMAP)
+	{
+		// both rings share the same mapping
+		sqRingSize = std::max(sqRingSize, cqRingSize);
+		cqRingSize = sqRingSize;
+	}
+
+	sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+	if (sqRing == MAP_FAILED) {
+		return false;
+	}
+
+	if (params.features & IORING_FEAT_SINGLE_MMAP) {
+		cqRing = sqRing;
+	}
+	else
+	{
+		cqRing = mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+		if (cqRing == MAP_FAILED) {
+			return false;
+		}
+	}
+
+	sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+	sqes = static_cast<io_uring_sqe*>(mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES));
+	if (sqes == MAP_FAILED) {
+		return false;
+	}
+
+	uint8_t* sq = static_cast<uint8_t*>(sqRing);
+	sqHead = reinterpret_cast<std::atomic<unsigned int>*>(sq + params.sq_off.head);
+	sqTail = reinterpret_cast<std::atomic<unsigned int>*>(sq + params.sq_off.tail);
+	sqMask = *reinterpret_cast<unsigned int*>(sq + params.sq_off.ring_mask);
+	sqArray = reinterpret_cast<unsigned int*>(sq + params.sq_off.array);
+
+	uint8_t* cq = static_cast<uint8_t*>(cqRing);
+	cqHead = reinterpret_cast<std::atomic<unsigned int>*>(cq + params.cq_off.head);
+	cqTail = reinterpret_cast<std::atomic<unsigned int>*>(cq + params.cq_off.tail);
+	cqMask = *reinterpret_cast<unsigned int*>(cq + params.cq_off.ring_mask);
+	cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+	return true;
+}
+
+void UringFileOperations::prepare(io_uring_sqe& sqe, FileOperation& operation, size_t index)
+{
+	std::memset(&sqe, 0, sizeof(sqe));
+	sqe.user_data = index;
+
+	switch (operation.type)
+	{
+	case FileOperationType::CreateDirectory:
+		sqe.opcode = IORING_OP_MKDIRAT;
+		sqe.fd = AT_FDCWD;
+		sqe.addr = reinterpret_cast<uintptr_t>(operation.path.c_str());
+		sqe.len = 0755;
+		break;
+	case FileOperationType::CreateHardLink:
+		sqe.opcode = IORING_OP_LINKAT;
+		sqe.fd = AT_FDCWD;
+		sqe.addr = reinterpret_cast<uintptr_t>(operation.target.c_str());
+		sqe.len = AT_FDCWD;
+		sqe.addr2 = reinterpret_cast<uintptr_t>(operation.path.c_str());
+		sqe.hardlink_flags = 0;
+		break;
+	case FileOperationType::CreateDirectoryLink:
+		sqe.opcode = IORING_OP_SYMLINKAT;
+		sqe.fd = AT_FDCWD;
+		sqe.addr = reinterpret_cast<uintptr_t>(operation.target.c_str());
+		sqe.addr2 = reinterpret_cast<uintptr_t>(operation.path.c_str());
+		break;
+	case FileOperationType::Stat:
+		sqe.opcode = IORING_OP_STATX;
+		sqe.fd = AT_FDCWD;
+		sqe.addr = reinterpret_cast<uintptr_t>(operation.path.c_str());
+		sqe.len = STATX_NLINK | STATX_SIZE;
+		sqe.off = reinterpret_cast<uintptr_t>(&statxBuffers[index]);
+		sqe.statx_flags = 0;
+		break;
+	}
+}
+
+size_t UringFileOperations::reap(std::span<FileOperation> operations)
+{
+	size_t completed = 0;
+
+	unsigned int head = cqHead->load(std::memory_order_relaxed);
+	const unsigned int tail = cqTail->load(std::memory_order_acquire);
+
+	for (; head != tail; ++head, ++completed)
+	{
+		const io_uring_cqe& cqe = cqes[head & cqMask];
+		FileOperation& operation = operations[cqe.user_data];
+
+		if (cqe.res < 0) {
+			operation.result = std::error_code(-cqe.res, std::generic_category());
+		}
+		else
+		{
+			operation.result.clear();
+
+			if (operation.type == FileOperationType::Stat)
+			{
+				const struct statx& buffer = statxBuffers[cqe.user_data];
+				operation.linkCount = buffer.stx_nlink;
+				operation.size = buffer.stx_size;
+			}
+		}
+	}
+
+	cqHead->store(head, std::memory_order_release);
+	return completed;
+}
+
+void UringFileOperations::execute(std::span<FileOperation> operations)
+{
+	const size_t capacity = params.sq_entries;
+	size_t submitted = 0;
+	size_t completed = 0;
+
+	for (const FileOperation& operation : operations)
+	{
+		if (operation.type == FileOperationType::Stat)
+		{
+			statxBuffers.resize(operations.size());
+			break;
+		}
+	}
+
+	while (completed < operations.size())
+	{
+		// keep the ring full, the completion queue is twice as large so it can't overflow
+		unsigned int tail = sqTail->load(std::memory_order_relaxed);
+
+		while (submitted < operations.size() && submitted - completed < capacity)
+		{
+			const unsigned int slot = tail & sqMask;
+			prepare(sqes[slot], operations[submitted], submitted);
+			sqArray[slot] = slot;
+
+			++tail;
+			++submitted;
+		}
+
+		sqTail->store(tail, std::memory_order_release);
+
+		// entries the kernel didn't consume on the previous call are submitted again
+		const unsigned int toSubmit = tail - sqHead->load(std::memory_order_acquire);
+
+		int result;
+		do
+		{
+			result = ioUringEnter(ringFd, toSubmit, 1, IORING_ENTER_GETEVENTS);
+		} while (result < 0 && errno == EINTR);
+
+		if (result < 0) {
+			throw std::system_error(std::error_code(errno, std::generic_category()), "could not submit the file operations");
+		}
+
+		completed += reap(operations);
+	}
+}
+
+IFileOperationsPtr Files::createUringFileOperations(unsigned int queueDepth)
+{
+	io_uring_params params;
+	std::memset(&params, 0, sizeof(params));
+
+	const int ringFd = ioUringSetup(queueDepth, &params);
+	if (ringFd < 0) {
+		return nullptr;
+	}
+
+	std::shared_ptr<UringFileOperations> operations(new UringFileOperations(ringFd, params));
+	if (!operations->map()) {
+		return nullptr;
+	}
+
+	// mkdirat, linkat and symlinkat require Linux 5.15
+	const size_t probeSize = sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op);
+	std::vector<uint8_t> probeBuffer(probeSize);
+	io_uring_probe* probe = reinterpret_cast<io_uring_probe*>(probeBuffer.data());
+
+	if (ioUringRegister(ringFd, IORING_REGISTER_PROBE, probe, 256) < 0) {
+		return nullptr;
+	}
+
+	for (const unsigned int opcode : { IORING_OP_MKDIRAT, IORING_OP_SYMLINKAT, IORING_OP_LINKAT, IORING_OP_STATX })
+	{
+		if (opcode > probe->last_op || !(probe->ops[opcode].flags & IO_URING_OP_SUPPORTED)) {
+			return nullptr;
+		}
+	}
+
+	return operations;
+}
+
+#endif
@@ -73,7 +73,7 @@ void Config::FileGroupParser::parse(const IFileVisitorPtr& fileVisitor, const ID
 				targetAttr = std::wstring(targetAttrA, targetAttrA + std::strlen(targetAttrA));
 			}
 
-			HostDirectory hostDir(sourceAttr, targetAttr);
+			HostDirectory hostDir(sourceAttr, targetAttr, !std::strcmp(subNode->attribute("Link").value(), "Directory"));
 			std::vector<Component> components;
 
 			size_t numComponents = 0;
@@ -180,9 +180,10 @@ const std::filesystem::path& Files::Config::Directory::getPath() const
 	return path;
 }
 
-Files::Config::HostDirectory::HostDirectory(const std::filesystem::path& inSourcePath, const std::filesystem::path& inTargetPath)
+Files::Config::HostDirectory::HostDirectory(const std::filesystem::path& inSourcePath, const std::filesystem::path& inTargetPath, bool inDirectoryLink)
 	: sourcePath(inSourcePath)
 	, targetPath(inTargetPath)
+	, bDirectoryLink(inDirectoryLink)
 {
 
 }
@@ -207,6 +208,11 @@ const std::filesystem::path& Files::Config::HostDirectory::getTargetPath() const
 	}
 }
 
+bool Files::Config::HostDirectory::isDirectoryLink() const
+{
+	return bDirectoryLink;
+}
+
 Files::Config::HostFile::HostFile(const std::filesystem::path& inSourceFile, const std::filesystem::path& inTargetFile /*= {}*/)
 	: sourceFile(inSourceFile)
 	, targetFile(inTargetFile)
@@ -36,14 +36,20 @@ namespace Files
 		class HostDirectory
 		{
 		public:
-			HostDirectory(const std::filesystem::path& inSourcePath, const std::filesystem::path& inTargetPath = {});
+			HostDirectory(const std::filesystem::path& inSourcePath, const std::filesystem::path& inTargetPath = {}, bool inDirectoryLink = false);
 
 			const std::filesystem::path& getSourcePath() const;
 			const std::filesystem::path& getTargetPath() const;
 
+			/**
+			 * Whether the whole tree may be linked as a single directory (Link="Directory").
+			 */
+			bool isDirectoryLink() const;
+
 		private:
 			std::filesystem::path sourcePath;
 			std::filesystem::path targetPath;
+			bool bDirectoryLink;
 		};
 
 		class HostSxsFile
@@ -12,25 +12,146 @@ const std::filesystem::path sxsDir = systemRoot / L"WinSxS";
 
 using namespace Files;
 
-static void linkTo(
-	const std::filesystem::path& target,
-	const std::filesystem::path& linkPath
-)
+/**
+ * Rules completed before the links are created are recorded with the next batch,
+ * unless that many links are pending.
+ */
+static const size_t CheckpointLinkCount = 1024;
+
+/**
+ * Names a host directory through its volume, the drive letters in the container are not the host ones.
+ */
+static std::filesystem::path getVolumePath(const std::filesystem::path& path)
 {
+	wchar_t volumePath[MAX_PATH];
+	wchar_t volumeName[MAX_PATH];
+	if (!GetVolumePathNameW(path.c_str(), volumePath, MAX_PATH) || !GetVolumeNameForVolumeMountPointW(volumePath, volumeName, MAX_PATH)) {
+		return path;
+	}
+
+	return std::filesystem::path(volumeName) / path.lexically_relative(volumePath);
+}
+
+static std::string makeRuleName(const std::filesystem::path& source, const std::filesystem::path& target)
+{
+	return toUtf8(source) + '>' + toUtf8(target);
+}
+
+FilesVisitor::FilesVisitor(const std::filesystem::path& inWorkingDir, const IFileOperationsPtr& fileOperations, LinkManifestWriter* inManifest, const AccessProfile* inProfile, PrepJournal* inJournal, const CancellationToken* inCancellation)
+	: workingDir(inWorkingDir)
+	, linkBatch(fileOperations, inWorkingDir)
+	, manifest(inManifest)
+	, profile(inProfile)
+	, journal(inJournal)
+	, cancellation(inCancellation)
+{
+}
+
+void FilesVisitor::link(const std::filesystem::path& source, const std::filesystem::path& target)
+{
+	// a file below a directory link is already in the container, or would be linked in the host directory
+	if (!linkBatch.add(source, getLinkPath(workingDir, target))) {
+		return;
+	}
+
+	if (manifest) {
+		manifest->add(source, target);
+	}
+}
+
+bool FilesVisitor::linkDirectory(const std::filesystem::path& source, const std::filesystem::path& target)
+{
+	// a profile keeps only some of the files, and the container must not be linked into itself
 	std::error_code ec;
-	const uintmax_t count = std::filesystem::hard_link_count(linkPath, ec);
-	if (count == static_cast<uintmax_t>(-1) || !count)
-	{
-		const std::filesystem::path directory = linkPath.parent_path();
+	if (profile || !workingDir.native().find(source.native()) || !std::filesystem::is_directory(source, ec)) {
+		return false;
+	}
+
+	// requires this privilege to create symbolic links
+	Privilege privilege(SE_CREATE_SYMBOLIC_LINK_NAME);
 
-		std::filesystem::create_directories(directory);
-		std::filesystem::create_hard_link(target, linkPath, ec);
+	const std::filesystem::path linkPath = getLinkPath(workingDir, target);
+
+	// a directory that other rules linked files in is walked
+	if (linkBatch.linkDirectory(getVolumePath(source), linkPath)) {
+		return false;
 	}
+
+	if (manifest) {
+		manifest->addDirectory(source, target);
+	}
+
+	return true;
 }
 
-FilesVisitor::FilesVisitor(const std::filesystem::path& inWorkingDir)
-	: workingDir(inWorkingDir)
+void FilesVisitor::flush()
+{
+	// requires this privilege to create hard links
+	Privilege privilege(SE_RESTORE_NAME);
+
+	linkBatch.flush();
+	checkpoint();
+}
+
+size_t FilesVisitor::getFailedCount() const
+{
+	return linkBatch.getFailedCount();
+}
+
+bool FilesVisitor::isRuleDone(const char* kind, const std::string& name) const
 {
+	return journal && journal->contains(kind, name);
+}
+
+void FilesVisitor::endRule(const char* kind, std::string&& name)
+{
+	// the pending links of the rule are not recorded, a resumed run links them again
+	if (cancellation) {
+		cancellation->check();
+	}
+
+	if (!journal) {
+		return;
+	}
+
+	pendingRules.emplace_back(kind, std::move(name));
+
+	if (linkBatch.getPendingCount() >= CheckpointLinkCount) {
+		linkBatch.flush();
+	}
+
+	if (!linkBatch.getPendingCount()) {
+		checkpoint();
+	}
+}
+
+void FilesVisitor::checkpoint()
+{
+	if (!journal || pendingRules.empty()) {
+		return;
+	}
+
+	// the links of the rules are created, the manifest must have them before the rules are committed
+	if (manifest) {
+		manifest->flush();
+	}
+
+	for (const auto& [kind, name] : pendingRules) {
+		journal->append(kind, name);
+	}
+
+	journal->commit();
+	pendingRules.clear();
+}
+
+bool FilesVisitor::isFileAllowed(const std::filesystem::path& target) const
+{
+	return !profile || profile->containsFile(target);
+}
+
+bool FilesVisitor::isDirectoryAllowed(const std::filesystem::path& target) const
+{
+	return !profile || profile->containsDirectory(target);
 }
 
 void FilesVisitor::visit(const Config::HostFile& file)
@@ -38,10 +159,19 @@ void FilesVisitor::visit(const Config::HostFile& file)
 	// requires this privilege to create hard links
 	Privilege privilege(SE_RESTORE_NAME);
 
+	if (!isFileAllowed(file.getTargetFile())) {
+		return;
+	}
+
+	std::string ruleName = makeRuleName(file.getSourceFile(), file.getTargetFile());
+	if (isRuleDone("file", ruleName)) {
+		return;
+	}
+
 	const std::filesystem::path sourcePath = systemDrive / file.getSourceFile();
-	const std::filesystem::path targetPath = workingDir / (file.getTargetFile().native().c_str() + 1);
 
-	linkTo(sourcePath, targetPath);
+	link(sourcePath, file.getTargetFile());
+	endRule("file", std::move(ruleName));
 }
 
 void FilesVisitor::visit(const Config::HostSxs& sxs, const std::span<const Config::HostSxsFile>& files)
@@ -49,6 +179,11 @@ void FilesVisitor::visit(const Config::HostSxs& sxs, const std::span<const Confi
 	// requires this privilege to create hard links
 	Privilege privilege(SE_RESTORE_NAME);
 
+	std::string ruleName = toUtf8(sxs.getNamePart());
+	if (isRuleDone("sxs", ruleName)) {
+		return;
+	}
+
 	const std::filesystem::path sxsDirName = sxsDir / sxs.getNamePart();
 
 	for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(sxsDir, std::filesystem::directory_options::skip_permission_denied))
@@ -85,30 +220,61 @@ void FilesVisitor::visit(const Config::HostSxs& sxs, const std::span<const Confi
 
 				for (const Config::HostSxsFile& sxsFile : files)
 				{
-					if (sxsFile.getSourcePath() == fileRelPath)
-					{
-						const std::filesystem::path linkPath = workingDir / (sxsFile.getTargetPath().native().c_str() + 1);
-
-						linkTo(filePath, linkPath);
+					if (sxsFile.getSourcePath() == fileRelPath && isFileAllowed(sxsFile.getTargetPath())) {
+						link(filePath, sxsFile.getTargetPath());
 					}
 				}
 			}
 		}
 	}
+
+	endRule("sxs", std::move(ruleName));
 }
 
-void FilesVisitor::visit(const Config::HostDirectory& directory, const std::span<Config::Component>& components)
+void FilesVisitor::linkTree(const std::string& ruleName, const std::filesystem::path& sourcePath, const std::filesystem::path& targetPath, const std::function<bool(const std::filesystem::path& filePath)>& filter)
 {
-	// requires this privilege to create hard links
-	Privilege privilege(SE_RESTORE_NAME);
-
-	const std::filesystem::path sourcePath = systemDrive / directory.getSourcePath();
-	const std::filesystem::path targetPath = workingDir / (directory.getTargetPath().native().c_str() + 1);
+	// top level subdirectories are recorded as they are completed
+	std::string subdirectoryName;
 
-	for (const std::filesystem::directory_entry& entry : std::filesystem::recursive_directory_iterator(sourcePath, std::filesystem::directory_options::skip_permission_denied))
+	for (std::filesystem::recursive_directory_iterator it(sourcePath, std::filesystem::directory_options::skip_permission_denied), end; it != end; ++it)
 	{
+		const std::filesystem::directory_entry& entry = *it;
+		const std::filesystem::path& entryPath = entry.path();
+		if (!it.depth() && !subdirectoryName.empty())
+		{
+			// back to the top level, the previous subdirectory is complete
+			endRule("subdirectory", std::move(subdirectoryName));
+			subdirectoryName.clear();
+		}
+
+		if (!entryPath.native().find(workingDir)) {
+			it.disable_recursion_pending();
+			continue;
+		}
+
+		const std::filesystem::path relTarget = targetPath / entryPath.lexically_relative(sourcePath);
+
 		try
 		{
+			if (entry.is_directory())
+			{
+				if (!isDirectoryAllowed(relTarget)) {
+					// nothing to link below, don't walk it
+					it.disable_recursion_pending();
+				}
+				else if (!it.depth())
+				{
+					subdirectoryName = ruleName + '>' + toUtf8(entryPath.filename());
+					if (isRuleDone("subdirectory", subdirectoryName))
+					{
+						it.disable_recursion_pending();
+						subdirectoryName.clear();
+					}
+				}
+
+				continue;
+			}
+
 			if (!entry.is_regular_file()) {
 				continue;
 			}
@@ -119,38 +285,51 @@ void FilesVisitor::visit(const Config::HostDirectory& directory, const std::span
 			continue;
 		}
 
-		const std::filesystem::path& entryPath = entry.path();
-		if (!entryPath.native().find(workingDir)) {
+		if (!isFileAllowed(relTarget) || (filter && !filter(entryPath))) {
 			continue;
 		}
 
-		std::wstring sxs;
-		for (hard_link_iterator iterator(entryPath); iterator; ++iterator)
+		// create a new hard link if it doesn't exist
+		link(entryPath, relTarget);
+	}
+	if (!subdirectoryName.empty()) {
+		endRule("subdirectory", std::move(subdirectoryName));
+	}
+}
+
+void FilesVisitor::visit(const Config::HostDirectory& directory, const std::span<Config::Component>& components)
+{
+	// requires this privilege to create hard links
+	Privilege privilege(SE_RESTORE_NAME);
+
+	const std::string ruleName = makeRuleName(directory.getSourcePath(), directory.getTargetPath());
+	if (isRuleDone("components", ruleName)) {
+		return;
+	}
+
+	// only the files that are themselves linked to one of the SXS components
+	linkTree(ruleName, systemDrive / directory.getSourcePath(), directory.getTargetPath(), [&components](const std::filesystem::path& filePath)
 		{
-			std::wstring tmp = iterator->native();
-			if (!tmp.find(L"\\Windows\\WinSxS"))
+			for (hard_link_iterator iterator(filePath); iterator; ++iterator)
 			{
+				const std::wstring& linkPath = iterator->native();
+				if (linkPath.find(L"\\Windows\\WinSxS")) {
+					continue;
+				}
+
 				for (const Config::Component& component : components)
 				{
-					if (!tmp.find(L"\\Windows\\WinSxS\\" + component.getComponentName()))
-					{
+					if (!linkPath.find(L"\\Windows\\WinSxS\\" + component.getComponentName())) {
 						// found an SXS component
-						sxs = systemDrive / tmp;
-						break;
+						return true;
 					}
 				}
 			}
-		}
 
-		if (!sxs.empty())
-		{
-			const std::filesystem::path relPath = std::filesystem::relative(entryPath, sourcePath);
-			const std::filesystem::path linkPath = targetPath / relPath;
+			return false;
+		});
 
-			// create a new hard link if it doesn't exist
-			linkTo(entryPath, linkPath);
-		}
-	}
+	endRule("components", std::string(ruleName));
 }
 
 void FilesVisitor::visit(const Config::HostDirectory& directory)
@@ -158,33 +337,20 @@ void FilesVisitor::visit(const Config::HostDirectory& directory)
 	// requires this privilege to create hard links
 	Privilege privilege(SE_RESTORE_NAME);
 
+	const std::string ruleName = makeRuleName(directory.getSourcePath(), directory.getTargetPath());
+	if (isRuleDone("directory", ruleName)) {
+		return;
+	}
+
 	const std::filesystem::path sourcePath = systemDrive / directory.getSourcePath();
-	const std::filesystem::path targetPath = workingDir / (directory.getTargetPath().native().c_str() + 1);
+	const std::filesystem::path& targetPath = directory.getTargetPath();
 
-	for (const std::filesystem::directory_entry& entry : std::filesystem::recursive_directory_iterator(sourcePath, std::filesystem::directory_options::skip_permission_denied))
+	if (directory.isDirectoryLink() && linkDirectory(sourcePath, targetPath))
 	{
-		try
-		{
-			if (!entry.is_regular_file()) {
-				continue;
-			}
-		}
-		catch (const std::filesystem::filesystem_error&)
-		{
-			// Skip files that cannot be accessed
-			continue;
-		}
-
-		const std::filesystem::path& entryPath = entry.path();
-		if (!entryPath.native().find(workingDir)) {
-			continue;
-		}
-
-		const std::filesystem::path relPath = std::filesystem::relative(entryPath, sourcePath);
-		const std::filesystem::path linkPath = targetPath / relPath;
-
-		// create a new hard link if it doesn't exist
-		linkTo(entryPath, linkPath);
+		endRule("directory", std::string(ruleName));
+		return;
 	}
-}
 
+	linkTree(ruleName, sourcePath, targetPath, nullptr);
+	endRule("directory", std::string(ruleName));
+}
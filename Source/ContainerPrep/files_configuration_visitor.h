@@ -1,21 +1,73 @@
 #pragma once
 
 #include "files_configuration.h"
+#include "access_profile.h"
+#include "file_operations.h"
+#include "link_batch.h"
+#include "link_manifest.h"
+#include "prep_journal.h"
+#include "task_group.h"
+
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
 
 namespace Files
 {
 	class FilesVisitor : public Config::IFileVisitor, public Config::IDirectoryVisitor
 	{
 	public:
-		FilesVisitor(const std::filesystem::path& inWorkingDir);
+		/**
+		 * Links are created in batches through the file operations, and recorded in the manifest if specified.
+		 * If a profile is specified, only the files it contains are linked and other directories are not walked.
+		 * Directories marked for directory links are linked as a whole when no profile is specified.
+		 * If a journal is specified, completed rules are recorded once their links are created, and skipped when resuming.
+		 * If a cancellation token is specified, it is checked as each rule and top level subdirectory completes.
+		 */
+		FilesVisitor(const std::filesystem::path& inWorkingDir, const IFileOperationsPtr& fileOperations, LinkManifestWriter* inManifest = nullptr, const AccessProfile* inProfile = nullptr, PrepJournal* inJournal = nullptr, const CancellationToken* inCancellation = nullptr);
 
 		void visit(const Config::HostFile& file) override;
 		void visit(const Config::HostSxs& sxs, const std::span<const Config::HostSxsFile>& files) override;
 		void visit(const Config::HostDirectory& directory) override;
 		void visit(const Config::HostDirectory& directory, const std::span<Config::Component>& components) override;
 
+		/**
+		 * Creates the pending links and records the completed rules.
+		 */
+		void flush();
+
+		/**
+		 * Number of directories and links that could not be created.
+		 */
+		size_t getFailedCount() const;
+
+	private:
+		void link(const std::filesystem::path& source, const std::filesystem::path& target);
+
+		/**
+		 * Links the whole directory with a single symbolic link. Returns false if the tree must be linked file by file.
+		 */
+		bool linkDirectory(const std::filesystem::path& source, const std::filesystem::path& target);
+		/**
+		 * Links the files of a host directory allowed by the profile and accepted by the filter, if specified.
+		 * Top level subdirectories are recorded in the journal as they are completed, and skipped when resuming.
+		 */
+		void linkTree(const std::string& ruleName, const std::filesystem::path& sourcePath, const std::filesystem::path& targetPath, const std::function<bool(const std::filesystem::path& filePath)>& filter);
+		bool isFileAllowed(const std::filesystem::path& target) const;
+		bool isDirectoryAllowed(const std::filesystem::path& target) const;
+		bool isRuleDone(const char* kind, const std::string& name) const;
+		void endRule(const char* kind, std::string&& name);
+		void checkpoint();
+
 	private:
 		std::filesystem::path workingDir;
+		LinkBatch linkBatch;
+		LinkManifestWriter* manifest;
+		const AccessProfile* profile;
+		PrepJournal* journal;
+		const CancellationToken* cancellation;
+		std::vector<std::pair<const char*, std::string>> pendingRules;
 	};
 	using FilesVisitorPtr = std::shared_ptr<FilesVisitor>;
 }
@@ -0,0 +1,277 @@
+#include "import_closure.h"
+#include "link_manifest.h"
+#include "mapped_file.h"
+#include "thread_pool.h"
+
+#include <cstdint>
+#include <set>
+#include <type_traits>
+#include <unordered_set>
+
+using namespace Files;
+
+struct ModuleDependencies
+{
+	std::string moduleName;
+	std::vector<std::string> dependencies;
+	bool b32Bit = false;
+};
+
+/**
+ * Module of the closure whose dependencies are yet to be found.
+ */
+struct PendingModule
+{
+	std::filesystem::path path;
+
+	/** Search path of the dependencies, unknown for root binaries until their image is parsed. */
+	size_t searchPath;
+};
+
+constexpr size_t RootSearchPath = SIZE_MAX;
+
+/**
+ * Lower-case ASCII version of a file name, empty if the name contains other characters.
+ */
+static std::string toModuleName(const std::filesystem::path& fileName)
+{
+	std::string name;
+	name.reserve(fileName.native().size());
+
+	using unsigned_char_t = std::make_unsigned_t<std::filesystem::path::value_type>;
+
+	for (const std::filesystem::path::value_type ch : fileName.native())
+	{
+		if (!ch || static_cast<unsigned_char_t>(ch) >= 0x80) {
+			return {};
+		}
+
+		name.push_back(static_cast<char>(ch));
+	}
+
+	return Pe::toLower(name);
+}
+
+static bool isBinaryFile(const std::filesystem::path& path)
+{
+	const std::string extension = toModuleName(path.extension());
+	return extension == ".exe" || extension == ".dll" || extension == ".sys" || extension == ".drv" || extension == ".cpl" || extension == ".ocx";
+}
+
+static std::string getModuleKey(const std::filesystem::path& path)
+{
+	std::string key = toModuleName(path.filename());
+	if (key.empty()) {
+		key = path.filename().string();
+	}
+
+	return key;
+}
+
+Files::ImportClosure::ImportClosure(ThreadPool& inPool, const std::vector<std::filesystem::path>& inSearchDirectories, const std::vector<std::filesystem::path>& inWow64SearchDirectories)
+	: pool(inPool)
+	, searchDirectories(inSearchDirectories)
+	, wow64SearchDirectories(inWow64SearchDirectories)
+{
+	for (const std::filesystem::path& directory : searchDirectories)
+	{
+		const ModuleIndex& moduleIndex = getModuleIndex(directory);
+
+		const auto apiSetIt = moduleIndex.find("apisetschema.dll");
+		if (apiSetIt == moduleIndex.end()) {
+			continue;
+		}
+
+		const MappedFile file(apiSetIt->second);
+		const Pe::Image image(file.getData());
+
+		const std::span<const unsigned char> schemaData = image.findSection(".apiset");
+		if (!schemaData.empty()) {
+			apiSetSchema = Pe::ApiSetSchema(schemaData);
+		}
+
+		break;
+	}
+}
+
+const Files::ImportClosure::ModuleIndex& Files::ImportClosure::getModuleIndex(const std::filesystem::path& directory)
+{
+	const auto [indexIt, bInserted] = moduleIndexes.try_emplace(directory.native());
+	if (!bInserted) {
+		return indexIt->second;
+	}
+
+	ModuleIndex& moduleIndex = indexIt->second;
+
+	std::error_code ec;
+	for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(directory, std::filesystem::directory_options::skip_permission_denied, ec))
+	{
+		if (!entry.is_regular_file(ec)) {
+			continue;
+		}
+
+		std::string name = toModuleName(entry.path().filename());
+		if (!name.empty()) {
+			moduleIndex.emplace(std::move(name), entry.path());
+		}
+	}
+
+	return moduleIndex;
+}
+
+size_t Files::ImportClosure::getSearchPath(const std::filesystem::path& applicationDirectory, bool b32Bit)
+{
+	const auto [idIt, bInserted] = searchPathIds.try_emplace({ applicationDirectory, b32Bit }, searchPaths.size());
+	if (!bInserted) {
+		return idIt->second;
+	}
+
+	// the application directory comes first, then the system directories of the bitness of the process
+	std::vector<const ModuleIndex*>& searchPath = searchPaths.emplace_back();
+	searchPath.push_back(&getModuleIndex(applicationDirectory));
+
+	for (const std::filesystem::path& directory : b32Bit && !wow64SearchDirectories.empty() ? wow64SearchDirectories : searchDirectories) {
+		searchPath.push_back(&getModuleIndex(directory));
+	}
+
+	return idIt->second;
+}
+
+std::filesystem::path Files::ImportClosure::findModule(const std::string& moduleName, const std::string& importingModule, size_t searchPath) const
+{
+	std::string name = moduleName;
+	if (Pe::ApiSetSchema::isApiSetName(name))
+	{
+		name = apiSetSchema.resolve(name, importingModule);
+		if (name.empty()) {
+			return {};
+		}
+	}
+
+	// the first directory that contains a module wins, as with the loader search order
+	for (const ModuleIndex* moduleIndex : searchPaths[searchPath])
+	{
+		const auto it = moduleIndex->find(name);
+		if (it != moduleIndex->end()) {
+			return it->second;
+		}
+	}
+
+	return {};
+}
+
+std::vector<std::filesystem::path> Files::ImportClosure::compute(const std::vector<std::filesystem::path>& roots)
+{
+	std::vector<std::filesystem::path> closure;
+	std::unordered_set<std::filesystem::path::string_type> closureFiles;
+	std::set<std::pair<size_t, std::string>> visited;
+	std::unordered_set<std::string> unresolved;
+	std::vector<PendingModule> wave;
+
+	const auto addFile = [&](const std::filesystem::path& path)
+	{
+		if (!closureFiles.insert(path.native()).second) {
+			return false;
+		}
+
+		closure.push_back(path);
+		return true;
+	};
+
+	const auto addModule = [&](const std::filesystem::path& path, size_t searchPath)
+	{
+		// modules are identified by name in a search path, just like the loader does in a process
+		if (visited.emplace(searchPath, getModuleKey(path)).second)
+		{
+			addFile(path);
+			wave.push_back({ path, searchPath });
+		}
+	};
+
+	const auto addRoot = [&](const std::filesystem::path& path)
+	{
+		if (addFile(path)) {
+			wave.push_back({ path, RootSearchPath });
+		}
+	};
+
+	for (const std::filesystem::path& root : roots)
+	{
+		std::error_code ec;
+		if (std::filesystem::is_directory(root, ec))
+		{
+			for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(root, std::filesystem::directory_options::skip_permission_denied, ec))
+			{
+				if (entry.is_regular_file(ec) && isBinaryFile(entry.path())) {
+					addRoot(entry.path());
+				}
+			}
+		}
+		else {
+			addRoot(root);
+		}
+	}
+
+	// breadth-first, every level of the dependency graph is parsed in parallel
+	while (!wave.empty())
+	{
+		const std::vector<PendingModule> currentWave = std::move(wave);
+		wave.clear();
+
+		std::vector<ModuleDependencies> results(currentWave.size());
+		pool.parallelFor(currentWave.size(), [&currentWave, &results](size_t index)
+			{
+				ModuleDependencies& result = results[index];
+				result.moduleName = toModuleName(currentWave[index].path.filename());
+
+				try
+				{
+					const MappedFile file(currentWave[index].path);
+					const Pe::Image image(file.getData());
+
+					result.dependencies = image.getImports();
+					result.dependencies.insert(result.dependencies.end(), image.getDelayImports().begin(), image.getDelayImports().end());
+					result.b32Bit = image.is32Bit();
+				}
+				catch (const std::exception&)
+				{
+					// not a PE image or not readable, it is still part of the closure but has no dependencies
+				}
+			});
+
+		// root binaries search their dependencies from their own directory, before any of them is resolved
+		std::vector<size_t> waveSearchPaths(currentWave.size());
+		for (size_t index = 0; index < currentWave.size(); ++index)
+		{
+			waveSearchPaths[index] = currentWave[index].searchPath;
+			if (waveSearchPaths[index] == RootSearchPath)
+			{
+				waveSearchPaths[index] = getSearchPath(currentWave[index].path.parent_path(), results[index].b32Bit);
+				visited.emplace(waveSearchPaths[index], getModuleKey(currentWave[index].path));
+			}
+		}
+
+		for (size_t index = 0; index < currentWave.size(); ++index)
+		{
+			for (const std::string& dependency : results[index].dependencies)
+			{
+				const std::filesystem::path modulePath = findModule(dependency, results[index].moduleName, waveSearchPaths[index]);
+				if (modulePath.empty())
+				{
+					unresolved.insert(dependency);
+					continue;
+				}
+
+				addModule(modulePath, waveSearchPaths[index]);
+			}
+		}
+	}
+
+	unresolvedModules.assign(unresolved.begin(), unresolved.end());
+	return closure;
+}
+
+const std::vector<std::string>& Files::ImportClosure::getUnresolvedModules() const
+{
+	return unresolvedModules;
+}
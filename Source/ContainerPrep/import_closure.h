@@ -0,0 +1,62 @@
+#pragma once
+
+#include "pe_image.h"
+
+#include <filesystem>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class ThreadPool;
+
+namespace Files
+{
+	/**
+	 * Computes the set of DLLs that must be present to load a set of root binaries,
+	 * following imports, delay imports and API set redirections.
+	 */
+	class ImportClosure
+	{
+	public:
+		/**
+		 * Modules are searched in the directory of the root binary that loads them, then in the specified directories, in order.
+		 * The modules of 32-bit root binaries are searched in the WOW64 directories instead, if any are specified.
+		 * The API set schema is loaded from apisetschema.dll if it is found in one of the search directories.
+		 */
+		ImportClosure(ThreadPool& inPool, const std::vector<std::filesystem::path>& inSearchDirectories, const std::vector<std::filesystem::path>& inWow64SearchDirectories = {});
+
+		/**
+		 * Computes the closure of the root binaries, roots included. A directory root stands for all binaries it contains.
+		 */
+		std::vector<std::filesystem::path> compute(const std::vector<std::filesystem::path>& roots);
+
+		/**
+		 * Module names that couldn't be resolved during the last computation.
+		 */
+		const std::vector<std::string>& getUnresolvedModules() const;
+
+	private:
+		using ModuleIndex = std::unordered_map<std::string, std::filesystem::path>;
+
+		const ModuleIndex& getModuleIndex(const std::filesystem::path& directory);
+
+		/**
+		 * Returns the search path of the root binaries of a directory and bitness, the modules they load share it.
+		 */
+		size_t getSearchPath(const std::filesystem::path& applicationDirectory, bool b32Bit);
+		std::filesystem::path findModule(const std::string& moduleName, const std::string& importingModule, size_t searchPath) const;
+
+	private:
+		ThreadPool& pool;
+		std::vector<std::filesystem::path> searchDirectories;
+		std::vector<std::filesystem::path> wow64SearchDirectories;
+		Pe::ApiSetSchema apiSetSchema;
+
+		/** Modules of each indexed directory, by lower-case name. */
+		std::unordered_map<std::filesystem::path::string_type, ModuleIndex> moduleIndexes;
+		std::vector<std::vector<const ModuleIndex*>> searchPaths;
+		std::map<std::pair<std::filesystem::path, bool>, size_t> searchPathIds;
+		std::vector<std::string> unresolvedModules;
+	};
+}
@@ -0,0 +1,484 @@
+#include "layer_bundle.h"
+#include "access_profile.h"
+#include "link_batch.h"
+
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+#include <unordered_set>
+
+using namespace Files;
+
+static const char BundleMagic[4] = { 'W', 'C', 'L', 'B' };
+static const uint32_t BundleVersion = 1;
+
+static const size_t CopyChunkSize = 1024 * 1024;
+
+struct BundleEntry
+{
+	std::filesystem::path target;
+	std::filesystem::path source;
+	uint64_t size;
+	ContentHash hash;
+};
+
+struct ContentHashHasher
+{
+	size_t operator()(const ContentHash& hash) const
+	{
+		size_t value;
+		std::memcpy(&value, hash.data(), sizeof(value));
+		return value;
+	}
+};
+
+static void writeBytes(std::ostream& stream, const void* data, size_t size)
+{
+	stream.write(static_cast<const char*>(data), size);
+	if (stream.fail()) {
+		throw std::system_error(std::make_error_code(std::errc::io_error), "could not write the layer bundle");
+	}
+}
+
+template<typename T>
+static void writeInteger(std::ostream& stream, T value)
+{
+	uint8_t bytes[sizeof(T)];
+	for (size_t i = 0; i < sizeof(T); ++i) {
+		bytes[i] = static_cast<uint8_t>(value >> (i * 8));
+	}
+
+	writeBytes(stream, bytes, sizeof(bytes));
+}
+
+static void writeString(std::ostream& stream, const std::string& value)
+{
+	writeInteger<uint16_t>(stream, static_cast<uint16_t>(value.size()));
+	writeBytes(stream, value.data(), value.size());
+}
+
+static void readBytes(std::istream& stream, void* data, size_t size)
+{
+	stream.read(static_cast<char*>(data), size);
+	if (static_cast<size_t>(stream.gcount()) != size) {
+		throw std::system_error(std::make_error_code(std::errc::io_error), "the layer bundle is truncated");
+	}
+}
+
+template<typename T>
+static T readInteger(std::istream& stream)
+{
+	uint8_t bytes[sizeof(T)];
+	readBytes(stream, bytes, sizeof(bytes));
+
+	T value = 0;
+	for (size_t i = 0; i < sizeof(T); ++i) {
+		value |= static_cast<T>(bytes[i]) << (i * 8);
+	}
+
+	return value;
+}
+
+static std::string readString(std::istream& stream)
+{
+	std::string value(readInteger<uint16_t>(stream), '\0');
+	readBytes(stream, value.data(), value.size());
+	return value;
+}
+
+/**
+ * Copies the content of a file to the stream in chunks.
+ */
+static void writeFileContent(std::ostream& stream, const std::filesystem::path& path, uint64_t size)
+{
+	std::ifstream fileStream(path, std::ios::in | std::ios::binary);
+	std::unique_ptr<char[]> chunk(new char[CopyChunkSize]);
+
+	for (uint64_t remaining = size; remaining;)
+	{
+		const size_t chunkSize = static_cast<size_t>(std::min<uint64_t>(remaining, CopyChunkSize));
+		fileStream.read(chunk.get(), chunkSize);
+		if (static_cast<size_t>(fileStream.gcount()) != chunkSize) {
+			throw std::system_error(std::make_error_code(std::errc::io_error), "a file changed while writing the layer bundle");
+		}
+
+		writeBytes(stream, chunk.get(), chunkSize);
+		remaining -= chunkSize;
+	}
+}
+
+static void skipContent(std::istream& stream, uint64_t size)
+{
+	std::unique_ptr<char[]> chunk(new char[CopyChunkSize]);
+
+	for (uint64_t remaining = size; remaining;)
+	{
+		const size_t chunkSize = static_cast<size_t>(std::min<uint64_t>(remaining, CopyChunkSize));
+		readBytes(stream, chunk.get(), chunkSize);
+		remaining -= chunkSize;
+	}
+}
+
+/**
+ * Copies content from the stream to a new file in chunks, and returns its hash. The next chunk is read
+ * while the previous one is hashed and written, so only two chunks are held.
+ */
+static ContentHash readFileContent(ThreadPool& pool, std::istream& stream, const std::filesystem::path& path, uint64_t size)
+{
+	std::filesystem::create_directories(path.parent_path());
+
+	// a file left by a previous import can be a link to a host file, it is replaced rather than written through
+	std::filesystem::remove(path);
+
+	std::ofstream fileStream(path, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (fileStream.fail()) {
+		throw std::system_error(std::make_error_code(std::errc::io_error), "could not write a file from the layer bundle");
+	}
+
+	Sha256 sha;
+	std::unique_ptr<uint8_t[]> chunks[2] = { std::unique_ptr<uint8_t[]>(new uint8_t[CopyChunkSize]), std::unique_ptr<uint8_t[]>(new uint8_t[CopyChunkSize]) };
+	std::future<void> pendingChunk;
+
+	try
+	{
+		size_t current = 0;
+		for (uint64_t remaining = size; remaining;)
+		{
+			const size_t chunkSize = static_cast<size_t>(std::min<uint64_t>(remaining, CopyChunkSize));
+			readBytes(stream, chunks[current].get(), chunkSize);
+
+			if (pendingChunk.valid())
+			{
+				pool.wait(pendingChunk);
+				pendingChunk.get();
+			}
+
+			const uint8_t* chunk = chunks[current].get();
+			pendingChunk = pool.submit([&sha, &fileStream, chunk, chunkSize]
+				{
+					sha.update(std::span<const uint8_t>(chunk, chunkSize));
+					fileStream.write(reinterpret_cast<const char*>(chunk), chunkSize);
+				});
+
+			current ^= 1;
+			remaining -= chunkSize;
+		}
+
+		if (pendingChunk.valid())
+		{
+			pool.wait(pendingChunk);
+			pendingChunk.get();
+		}
+	}
+	catch (...)
+	{
+		// the pending chunk uses the buffers and the file
+		if (pendingChunk.valid()) {
+			pendingChunk.wait();
+		}
+
+		throw;
+	}
+
+	fileStream.close();
+	if (fileStream.fail()) {
+		throw std::system_error(std::make_error_code(std::errc::io_error), "could not write a file from the layer bundle");
+	}
+
+	return sha.finish();
+}
+
+/**
+ * Returns whether a path read from a bundle stays below the directory it is resolved in: a relative path,
+ * or a single leading separator as in file groups, without parent directory components.
+ */
+static bool isBundlePathContained(const std::filesystem::path& bundlePath)
+{
+	const std::filesystem::path::string_type& native = bundlePath.native();
+	const std::filesystem::path relativePath = !native.empty() && (native[0] == '\\' || native[0] == '/') ? std::filesystem::path(native.substr(1)) : bundlePath;
+
+	if (relativePath.empty() || relativePath.has_root_path()) {
+		return false;
+	}
+
+	for (const std::filesystem::path& component : relativePath)
+	{
+		if (component == "..") {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/**
+ * Returns whether the file is a hive, without its logs, fingerprints and cache metadata.
+ */
+static bool isBaseHiveFile(const std::filesystem::path& path)
+{
+	static const std::filesystem::path::string_type suffix = std::filesystem::path("_BASE").native();
+	return !path.has_extension() && path.filename().native().ends_with(suffix);
+}
+
+BundleReport Files::exportBundle(ThreadPool& pool, std::ostream& stream, const std::vector<LinkEntry>& links, const std::filesystem::path& hivesDir)
+{
+	BundleReport report{};
+
+	// the same target can be listed more than once, the first one was linked
+	std::unordered_set<AccessProfile::key_t> targets;
+	std::vector<const LinkEntry*> bundleLinks;
+	for (const LinkEntry& link : links)
+	{
+		if (targets.insert(AccessProfile::makeKey(link.target)).second) {
+			bundleLinks.push_back(&link);
+		}
+	}
+
+	// hash each host file once
+	std::unordered_map<std::filesystem::path::string_type, size_t> sourceIndexes;
+	std::vector<std::filesystem::path> sources;
+	for (const LinkEntry* link : bundleLinks)
+	{
+		if (sourceIndexes.emplace(link->source.native(), sources.size()).second) {
+			sources.push_back(link->source);
+		}
+	}
+
+	std::vector<ContentHash> hashes(sources.size());
+	std::vector<uint64_t> sizes(sources.size());
+	pool.parallelFor(sources.size(), [&](size_t index)
+		{
+			sizes[index] = std::filesystem::file_size(sources[index]);
+			hashes[index] = hashFile(sources[index]);
+		});
+
+	writeBytes(stream, BundleMagic, sizeof(BundleMagic));
+	writeInteger<uint32_t>(stream, BundleVersion);
+
+	writeInteger<uint32_t>(stream, static_cast<uint32_t>(bundleLinks.size()));
+	for (const LinkEntry* link : bundleLinks)
+	{
+		const size_t index = sourceIndexes[link->source.native()];
+
+		writeString(stream, toUtf8(link->target));
+		writeString(stream, toUtf8(toFileGroupPath(link->source)));
+		writeInteger<uint64_t>(stream, sizes[index]);
+		writeBytes(stream, hashes[index].data(), hashes[index].size());
+	}
+
+	report.links = bundleLinks.size();
+
+	std::vector<std::filesystem::path> hives;
+	for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(hivesDir))
+	{
+		if (entry.is_regular_file() && isBaseHiveFile(entry.path())) {
+			hives.push_back(entry.path());
+		}
+	}
+
+	writeInteger<uint32_t>(stream, static_cast<uint32_t>(hives.size()));
+	for (const std::filesystem::path& hive : hives)
+	{
+		const uint64_t size = std::filesystem::file_size(hive);
+
+		writeString(stream, toUtf8(hive.filename()));
+		writeInteger<uint64_t>(stream, size);
+		writeFileContent(stream, hive, size);
+	}
+
+	report.hives = hives.size();
+
+	// distinct contents, in manifest order
+	std::unordered_set<ContentHash, ContentHashHasher> writtenHashes;
+	std::vector<size_t> contents;
+	for (size_t index = 0; index < sources.size(); ++index)
+	{
+		if (writtenHashes.insert(hashes[index]).second) {
+			contents.push_back(index);
+		}
+	}
+
+	writeInteger<uint32_t>(stream, static_cast<uint32_t>(contents.size()));
+	for (const size_t index : contents)
+	{
+		writeBytes(stream, hashes[index].data(), hashes[index].size());
+		writeInteger<uint64_t>(stream, sizes[index]);
+		writeFileContent(stream, sources[index], sizes[index]);
+
+		report.writtenBytes += sizes[index];
+	}
+
+	report.writtenFiles = contents.size();
+	stream.flush();
+
+	return report;
+}
+
+BundleReport Files::importBundle(
+	ThreadPool& pool,
+	std::istream& stream,
+	const std::filesystem::path& containerPath,
+	const std::filesystem::path& hostRoot,
+	const IFileOperationsPtr& fileOperations,
+	LinkManifestWriter& manifest
+)
+{
+	BundleReport report{};
+
+	const std::filesystem::path filesDir = containerPath / L"Files";
+	const std::filesystem::path hivesDir = containerPath / L"Hives";
+	std::filesystem::create_directories(filesDir);
+	std::filesystem::create_directories(hivesDir);
+
+	char magic[sizeof(BundleMagic)];
+	readBytes(stream, magic, sizeof(magic));
+	if (std::memcmp(magic, BundleMagic, sizeof(magic)) || readInteger<uint32_t>(stream) != BundleVersion) {
+		throw std::system_error(std::make_error_code(std::errc::invalid_argument), "not a supported layer bundle");
+	}
+
+	std::vector<BundleEntry> entries(readInteger<uint32_t>(stream));
+	for (BundleEntry& entry : entries)
+	{
+		entry.target = fromUtf8(readString(stream));
+		entry.source = fromUtf8(readString(stream));
+		entry.size = readInteger<uint64_t>(stream);
+		readBytes(stream, entry.hash.data(), entry.hash.size());
+
+		// checked before anything is created, a link must not point or be created outside its directory
+		if (!isBundlePathContained(entry.target) || !isBundlePathContained(entry.source)) {
+			throw std::system_error(std::make_error_code(std::errc::invalid_argument), "the layer bundle has a path outside the container");
+		}
+	}
+
+	report.links = entries.size();
+
+	// compare each host file with the bundle once, the size first
+	std::unordered_map<std::filesystem::path::string_type, size_t> sourceIndexes;
+	std::vector<const BundleEntry*> sources;
+	for (const BundleEntry& entry : entries)
+	{
+		if (sourceIndexes.emplace(entry.source.native(), sources.size()).second) {
+			sources.push_back(&entry);
+		}
+	}
+
+	std::vector<char> sourceMatches(sources.size());
+	pool.parallelFor(sources.size(), [&](size_t index)
+		{
+			const BundleEntry& entry = *sources[index];
+			const std::filesystem::path hostPath = getLinkPath(hostRoot, entry.source);
+
+			std::error_code ec;
+			sourceMatches[index] = std::filesystem::file_size(hostPath, ec) == entry.size && !ec && hashFile(hostPath) == entry.hash;
+		});
+
+	LinkBatch linkBatch(fileOperations, filesDir);
+	std::vector<const BundleEntry*> linkedEntries;
+	std::unordered_map<ContentHash, std::vector<const BundleEntry*>, ContentHashHasher> missingContents;
+
+	for (size_t index = 0; index < entries.size(); ++index)
+	{
+		const BundleEntry& entry = entries[index];
+		if (sourceMatches[sourceIndexes[entry.source.native()]])
+		{
+			linkBatch.add(getLinkPath(hostRoot, entry.source), getLinkPath(filesDir, entry.target));
+			linkedEntries.push_back(&entry);
+		}
+		else {
+			missingContents[entry.hash].push_back(&entry);
+		}
+	}
+
+	linkBatch.flush();
+
+	// the batch doesn't tell which links failed, none is recorded then
+	if (linkBatch.getFailedCount()) {
+		throw std::system_error(std::make_error_code(std::errc::io_error), "could not link " + std::to_string(linkBatch.getFailedCount()) + " files of the layer bundle");
+	}
+
+	for (const BundleEntry* entry : linkedEntries) {
+		manifest.add(getLinkPath(hostRoot, entry->source), entry->target);
+	}
+
+	report.linkedFiles = linkedEntries.size();
+
+	const uint32_t hiveCount = readInteger<uint32_t>(stream);
+	for (uint32_t i = 0; i < hiveCount; ++i)
+	{
+		const std::filesystem::path name = fromUtf8(readString(stream));
+		const uint64_t size = readInteger<uint64_t>(stream);
+
+		if (name.empty() || name != name.filename() || name == "." || name == "..") {
+			throw std::system_error(std::make_error_code(std::errc::invalid_argument), "the layer bundle has a hive outside the container");
+		}
+
+		readFileContent(pool, stream, hivesDir / name, size);
+	}
+
+	report.hives = hiveCount;
+
+	const uint32_t contentCount = readInteger<uint32_t>(stream);
+	for (uint32_t i = 0; i < contentCount; ++i)
+	{
+		ContentHash hash;
+		readBytes(stream, hash.data(), hash.size());
+		const uint64_t size = readInteger<uint64_t>(stream);
+
+		const auto it = missingContents.find(hash);
+		if (it == missingContents.end())
+		{
+			skipContent(stream, size);
+			continue;
+		}
+
+		const std::vector<const BundleEntry*> contentEntries = std::move(it->second);
+		missingContents.erase(it);
+
+		// the first target gets the content, the others are links to it
+		const std::filesystem::path firstPath = getLinkPath(filesDir, contentEntries.front()->target);
+		if (readFileContent(pool, stream, firstPath, size) != hash)
+		{
+			std::error_code ec;
+			std::filesystem::remove(firstPath, ec);
+			throw std::system_error(std::make_error_code(std::errc::io_error), "the layer bundle is corrupted");
+		}
+
+		for (const BundleEntry* entry : contentEntries)
+		{
+			const std::filesystem::path linkPath = getLinkPath(filesDir, entry->target);
+			if (linkPath == firstPath)
+			{
+				manifest.add(firstPath, entry->target);
+				continue;
+			}
+
+			std::filesystem::create_directories(linkPath.parent_path());
+			std::filesystem::remove(linkPath);
+
+			// a file system without hard links gets a copy
+			std::error_code ec;
+			std::filesystem::create_hard_link(firstPath, linkPath, ec);
+			if (ec)
+			{
+				std::filesystem::copy_file(firstPath, linkPath);
+				manifest.add(linkPath, entry->target);
+			}
+			else {
+				manifest.add(firstPath, entry->target);
+			}
+		}
+
+		report.writtenFiles += contentEntries.size();
+		report.writtenBytes += size;
+	}
+
+	if (!missingContents.empty()) {
+		throw std::system_error(std::make_error_code(std::errc::io_error), "the layer bundle is missing file contents");
+	}
+
+	return report;
+}
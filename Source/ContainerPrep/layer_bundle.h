@@ -0,0 +1,51 @@
+#pragma once
+
+#include "content_hash.h"
+#include "file_operations.h"
+#include "link_manifest.h"
+#include "thread_pool.h"
+
+#include <filesystem>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+namespace Files
+{
+	/**
+	 * A prepared layer packed in one stream, read and written sequentially so that it can go through a pipe.
+	 *
+	 * Little-endian layout, strings are UTF-8 with a 16-bit size:
+	 * - header: "WCLB", u32 version
+	 * - manifest: u32 count, then per link: target, source (file group form), u64 size, content hash
+	 * - hives: u32 count, then per hive: name, u64 size, content
+	 * - data: u32 count, then per distinct content: content hash, u64 size, content
+	 */
+	struct BundleReport
+	{
+		size_t links;
+		size_t linkedFiles;
+		size_t writtenFiles;
+		size_t hives;
+		uintmax_t writtenBytes;
+	};
+
+	/**
+	 * Writes the links and the hives of a container, without their logs and fingerprints. Host files are hashed in parallel.
+	 */
+	BundleReport exportBundle(ThreadPool& pool, std::ostream& stream, const std::vector<LinkEntry>& links, const std::filesystem::path& hivesDir);
+
+	/**
+	 * Imports a bundle into the container directory. Links whose host file (below hostRoot) has the same
+	 * content are linked to it, the others are written from the bundle in chunks. Links are recorded in the manifest.
+	 * Throws if a path of the bundle leads outside the container or the host root, before anything is created.
+	 */
+	BundleReport importBundle(
+		ThreadPool& pool,
+		std::istream& stream,
+		const std::filesystem::path& containerPath,
+		const std::filesystem::path& hostRoot,
+		const IFileOperationsPtr& fileOperations,
+		LinkManifestWriter& manifest
+	);
+}
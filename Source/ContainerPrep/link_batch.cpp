@@ -0,0 +1,162 @@
+#include "link_batch.h"
+
+#include <algorithm>
+#include <iterator>
+
+using namespace Files;
+
+Files::LinkBatch::LinkBatch(const IFileOperationsPtr& inFileOperations, const std::filesystem::path& inRootDir, size_t inMaxPending)
+	: fileOperations(inFileOperations)
+	, rootDir(inRootDir)
+	, maxPending(inMaxPending)
+	, failedCount(0)
+{
+}
+
+bool Files::LinkBatch::add(const std::filesystem::path& source, const std::filesystem::path& linkPath)
+{
+	if (isBelowDirectoryLink(linkPath)) {
+		return false;
+	}
+
+	FileOperation operation{};
+	operation.type = FileOperationType::CreateHardLink;
+	operation.path = linkPath;
+	operation.target = source;
+	links.push_back(std::move(operation));
+
+	if (links.size() >= maxPending) {
+		flush();
+	}
+
+	return true;
+}
+
+void Files::LinkBatch::flush()
+{
+	if (links.empty()) {
+		return;
+	}
+
+	createDirectories(links);
+	execute(links);
+	links.clear();
+}
+
+std::error_code Files::LinkBatch::linkDirectory(const std::filesystem::path& source, const std::filesystem::path& linkPath)
+{
+	if (isBelowDirectoryLink(linkPath)) {
+		return std::make_error_code(std::errc::operation_not_permitted);
+	}
+
+	// the pending links may be below the directory, they must be created in the container first
+	flush();
+
+	std::vector<FileOperation> operations(1);
+	operations[0].type = FileOperationType::CreateDirectoryLink;
+	operations[0].path = linkPath;
+	operations[0].target = source;
+
+	createDirectories(operations);
+	fileOperations->execute(operations);
+
+	std::error_code ec = operations[0].result;
+	if (ec == std::errc::file_exists)
+	{
+		// a link left by an interrupted run is kept, a directory that other rules linked files in is not
+		std::error_code statusEc;
+		if (std::filesystem::is_symlink(linkPath, statusEc)) {
+			ec.clear();
+		}
+	}
+
+	if (!ec) {
+		directoryLinks.insert(linkPath.native());
+	}
+
+	return ec;
+}
+
+size_t Files::LinkBatch::getPendingCount() const
+{
+	return links.size();
+}
+
+size_t Files::LinkBatch::getFailedCount() const
+{
+	return failedCount;
+}
+
+bool Files::LinkBatch::isBelowDirectoryLink(const std::filesystem::path& path) const
+{
+	if (directoryLinks.empty()) {
+		return false;
+	}
+
+	for (std::filesystem::path directory = path;
+		directory.native().size() > rootDir.native().size() && directory.has_relative_path();
+		directory = directory.parent_path())
+	{
+		if (directoryLinks.count(directory.native())) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void Files::LinkBatch::createDirectories(const std::vector<FileOperation>& linkOperations)
+{
+	// the root directory exists, collect the directories below it not created yet
+	std::vector<std::pair<size_t, std::filesystem::path>> directories;
+
+	for (const FileOperation& link : linkOperations)
+	{
+		for (std::filesystem::path directory = link.path.parent_path();
+			directory.native().size() > rootDir.native().size() && directory.has_relative_path();
+			directory = directory.parent_path())
+		{
+			if (!knownDirectories.insert(directory.native()).second) {
+				break;
+			}
+
+			const size_t depth = std::distance(directory.begin(), directory.end());
+			directories.emplace_back(depth, directory);
+		}
+	}
+
+	std::sort(directories.begin(), directories.end(), [](const auto& left, const auto& right)
+		{
+			return left.first < right.first;
+		});
+
+	// directories of the same level don't depend on each other
+	std::vector<FileOperation> operations;
+	for (size_t i = 0; i < directories.size();)
+	{
+		const size_t depth = directories[i].first;
+
+		operations.clear();
+		for (; i < directories.size() && directories[i].first == depth; ++i)
+		{
+			FileOperation operation{};
+			operation.type = FileOperationType::CreateDirectory;
+			operation.path = std::move(directories[i].second);
+			operations.push_back(std::move(operation));
+		}
+
+		execute(operations);
+	}
+}
+
+void Files::LinkBatch::execute(std::vector<FileOperation>& operations)
+{
+	fileOperations->execute(operations);
+
+	for (const FileOperation& operation : operations)
+	{
+		if (operation.result && operation.result != std::errc::file_exists) {
+			++failedCount;
+		}
+	}
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "file_operations.h"
+
+#include <filesystem>
+#include <unordered_set>
+#include <vector>
+
+namespace Files
+{
+	/**
+	 * Creates hard links in batches: the missing directories level by level, then all the links.
+	 * Existing directories and links are left as is. Nothing is created below a directory link,
+	 * it would be created in the host directory.
+	 */
+	class LinkBatch
+	{
+	public:
+		LinkBatch(const IFileOperationsPtr& inFileOperations, const std::filesystem::path& inRootDir, size_t inMaxPending = 4096);
+
+		/**
+		 * Queues a link, the batch is flushed when it is full. Returns false if the link is below a directory link.
+		 */
+		bool add(const std::filesystem::path& source, const std::filesystem::path& linkPath);
+		void flush();
+
+		/**
+		 * Creates a symbolic link to a directory right away, with its missing parent directories,
+		 * once the pending links are created. A symbolic link already at the path is kept.
+		 * The caller handles the error, it is not counted as failed.
+		 */
+		std::error_code linkDirectory(const std::filesystem::path& source, const std::filesystem::path& linkPath);
+
+		/**
+		 * Number of links queued and not created yet.
+		 */
+		size_t getPendingCount() const;
+
+		/**
+		 * Number of directories and links that could not be created.
+		 */
+		size_t getFailedCount() const;
+
+	private:
+		bool isBelowDirectoryLink(const std::filesystem::path& path) const;
+		void createDirectories(const std::vector<FileOperation>& linkOperations);
+		void execute(std::vector<FileOperation>& operations);
+
+	private:
+		IFileOperationsPtr fileOperations;
+		std::filesystem::path rootDir;
+		size_t maxPending;
+		std::vector<FileOperation> links;
+		std::unordered_set<std::filesystem::path::string_type> knownDirectories;
+		std::unordered_set<std::filesystem::path::string_type> directoryLinks;
+		size_t failedCount;
+	};
+}
@@ -0,0 +1,153 @@
+#include "link_manifest.h"
+
+#include <system_error>
+#include <unordered_set>
+
+using namespace Files;
+
+std::string Files::toUtf8(const std::filesystem::path& path)
+{
+	const std::u8string str = path.u8string();
+	return std::string(reinterpret_cast<const char*>(str.data()), str.size());
+}
+
+std::filesystem::path Files::fromUtf8(std::string_view str)
+{
+	return std::filesystem::path(std::u8string(reinterpret_cast<const char8_t*>(str.data()), str.size()));
+}
+
+std::filesystem::path Files::toFileGroupPath(const std::filesystem::path& hostPath)
+{
+	// file groups use paths relative to the system drive, starting with a separator
+	return hostPath.root_directory() / hostPath.relative_path();
+}
+
+std::filesystem::path Files::getLinkPath(const std::filesystem::path& filesDir, const std::filesystem::path& target)
+{
+	const auto& native = target.native();
+	if (!native.empty() && (native[0] == '\\' || native[0] == '/')) {
+		return filesDir / native.substr(1);
+	}
+
+	return filesDir / native;
+}
+
+Files::LinkManifestWriter::LinkManifestWriter(const std::filesystem::path& manifestFile, bool append)
+	: fileStream(manifestFile, std::ios::out | std::ios::binary | (append ? std::ios::app : std::ios::trunc))
+	, stream(fileStream)
+{
+	if (fileStream.fail()) {
+		throw std::system_error(std::make_error_code(std::errc::io_error), "could not create the link manifest");
+	}
+}
+
+Files::LinkManifestWriter::LinkManifestWriter(std::ostream& inStream)
+	: stream(inStream)
+{
+}
+
+void Files::LinkManifestWriter::add(const std::filesystem::path& source, const std::filesystem::path& target)
+{
+	const std::string line = toUtf8(target) + '\t' + toUtf8(source) + '\n';
+
+	std::lock_guard<std::mutex> lock(streamMutex);
+	stream.write(line.data(), line.size());
+}
+
+void Files::LinkManifestWriter::addDirectory(const std::filesystem::path& source, const std::filesystem::path& target)
+{
+	const std::string line = toUtf8(target) + '\t' + toUtf8(source) + "\tdirectory\n";
+
+	std::lock_guard<std::mutex> lock(streamMutex);
+	stream.write(line.data(), line.size());
+}
+
+void Files::LinkManifestWriter::flush()
+{
+	std::lock_guard<std::mutex> lock(streamMutex);
+	stream.flush();
+}
+
+Files::LinkManifest::LinkManifest(std::istream& stream)
+{
+	std::unordered_set<std::filesystem::path::string_type> targets;
+
+	std::string line;
+	while (std::getline(stream, line))
+	{
+		if (!line.empty() && line.back() == '\r') {
+			line.pop_back();
+		}
+
+		const size_t separator = line.find('\t');
+		if (separator == std::string::npos) {
+			continue;
+		}
+
+		std::string_view source = std::string_view(line).substr(separator + 1);
+
+		LinkEntry entry;
+		entry.target = fromUtf8(std::string_view(line).substr(0, separator));
+
+		const size_t kindSeparator = source.find('\t');
+		if (kindSeparator != std::string_view::npos)
+		{
+			entry.directory = source.substr(kindSeparator + 1) == "directory";
+			source = source.substr(0, kindSeparator);
+		}
+
+		entry.source = fromUtf8(source);
+		if (targets.insert(entry.target.native()).second) {
+			entries.push_back(std::move(entry));
+		}
+	}
+}
+
+LinkManifest Files::LinkManifest::load(const std::filesystem::path& manifestFile)
+{
+	std::ifstream stream(manifestFile, std::ios::in | std::ios::binary);
+	if (stream.fail()) {
+		throw std::system_error(std::make_error_code(std::errc::no_such_file_or_directory), "could not open the link manifest");
+	}
+
+	return LinkManifest(stream);
+}
+
+const std::vector<LinkEntry>& Files::LinkManifest::getEntries() const
+{
+	return entries;
+}
+
+std::vector<LinkEntry> Files::expandDirectoryLinks(const std::vector<LinkEntry>& links)
+{
+	std::vector<LinkEntry> expandedLinks;
+	expandedLinks.reserve(links.size());
+
+	for (const LinkEntry& link : links)
+	{
+		if (!link.directory)
+		{
+			expandedLinks.push_back(link);
+			continue;
+		}
+
+		std::error_code ec;
+		for (std::filesystem::recursive_directory_iterator it(link.source, std::filesystem::directory_options::skip_permission_denied, ec), end; it != end; it.increment(ec))
+		{
+			if (ec) {
+				break;
+			}
+
+			if (!it->is_regular_file(ec)) {
+				continue;
+			}
+
+			LinkEntry entry;
+			entry.source = it->path();
+			entry.target = link.target / it->path().lexically_relative(link.source);
+			expandedLinks.push_back(std::move(entry));
+		}
+	}
+
+	return expandedLinks;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Files
+{
+	/**
+	 * A link created in the container files directory.
+	 */
+	struct LinkEntry
+	{
+		/** Absolute path of the host file. */
+		std::filesystem::path source;
+
+		/** Path of the link in the container, in file group form (e.g. \Windows\system32\ntdll.dll). */
+		std::filesystem::path target;
+
+		/** Whether the link is a symbolic link to a host directory rather than a hard link to a file. */
+		bool directory = false;
+	};
+
+	/**
+	 * Records links as they are created, one tab-separated line per link.
+	 * Directory links have a third "directory" field.
+	 */
+	class LinkManifestWriter
+	{
+	public:
+		/**
+		 * Creates the manifest, or adds to it when appending.
+		 */
+		LinkManifestWriter(const std::filesystem::path& manifestFile, bool append = false);
+		LinkManifestWriter(std::ostream& inStream);
+
+		void add(const std::filesystem::path& source, const std::filesystem::path& target);
+		void addDirectory(const std::filesystem::path& source, const std::filesystem::path& target);
+		void flush();
+
+	private:
+		std::ofstream fileStream;
+		std::ostream& stream;
+		std::mutex streamMutex;
+	};
+
+	class LinkManifest
+	{
+	public:
+		/**
+		 * A resumed run adds the links of the rules it runs again, a link listed more than once is kept once,
+		 * with its first entry as the link created first is the one left in the container.
+		 */
+		LinkManifest(std::istream& stream);
+
+		static LinkManifest load(const std::filesystem::path& manifestFile);
+
+		const std::vector<LinkEntry>& getEntries() const;
+
+	private:
+		std::vector<LinkEntry> entries;
+	};
+
+	std::string toUtf8(const std::filesystem::path& path);
+	std::filesystem::path fromUtf8(std::string_view str);
+
+	/**
+	 * Converts an absolute host file path to the form used by file groups (relative to the system drive).
+	 */
+	std::filesystem::path toFileGroupPath(const std::filesystem::path& hostPath);
+
+	/**
+	 * Returns the link path in the container files directory for a path in file group form.
+	 */
+	std::filesystem::path getLinkPath(const std::filesystem::path& filesDir, const std::filesystem::path& target);
+
+	/**
+	 * Replaces the directory links with a link for each file below the host directory.
+	 */
+	std::vector<LinkEntry> expandDirectoryLinks(const std::vector<LinkEntry>& links);
+}
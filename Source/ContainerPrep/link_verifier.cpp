@@ -0,0 +1,215 @@
+#include "link_verifier.h"
+#include "access_profile.h"
+#include "tree_walker.h"
+
+#include <unordered_set>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/stat.h>
+#endif
+
+using namespace Files;
+
+/**
+ * Links checked per pool task.
+ */
+static const size_t LinksPerTask = 256;
+
+struct FileIdentity
+{
+	uint64_t volume;
+	uint64_t index;
+	uint64_t linkCount;
+
+	bool operator==(const FileIdentity& other) const
+	{
+		return volume == other.volume && index == other.index;
+	}
+};
+
+/**
+ * Queries the identity of a file, without following reparse points unless asked. Returns false if the file doesn't exist.
+ */
+static bool getFileIdentity(const std::filesystem::path& path, FileIdentity& identity, bool followLinks = false)
+{
+#ifdef _WIN32
+	HANDLE hFile = CreateFileW(
+		path.c_str(),
+		FILE_READ_ATTRIBUTES,
+		FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		NULL,
+		OPEN_EXISTING,
+		FILE_FLAG_BACKUP_SEMANTICS | (followLinks ? 0 : FILE_FLAG_OPEN_REPARSE_POINT),
+		NULL
+	);
+
+	if (hFile == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+
+	BY_HANDLE_FILE_INFORMATION fileInfo;
+	const BOOL result = GetFileInformationByHandle(hFile, &fileInfo);
+	CloseHandle(hFile);
+
+	if (!result) {
+		return false;
+	}
+
+	identity.volume = fileInfo.dwVolumeSerialNumber;
+	identity.index = (static_cast<uint64_t>(fileInfo.nFileIndexHigh) << 32) | fileInfo.nFileIndexLow;
+	identity.linkCount = fileInfo.nNumberOfLinks;
+#else
+	struct stat status;
+	if ((followLinks ? stat(path.c_str(), &status) : lstat(path.c_str(), &status)) < 0) {
+		return false;
+	}
+
+	identity.volume = status.st_dev;
+	identity.index = status.st_ino;
+	identity.linkCount = status.st_nlink;
+#endif
+
+	return true;
+}
+
+static const char* getStatusName(LinkStatus status)
+{
+	switch (status)
+	{
+	case LinkStatus::Valid:
+		return "valid";
+	case LinkStatus::Missing:
+		return "missing";
+	case LinkStatus::Stale:
+		return "stale";
+	case LinkStatus::Extra:
+		return "extra";
+	}
+
+	return "";
+}
+
+Files::LinkVerifier::LinkVerifier(ThreadPool& inPool, const std::filesystem::path& inFilesDir)
+	: pool(inPool)
+	, filesDir(inFilesDir)
+	, report{}
+{
+}
+
+void Files::LinkVerifier::verify(const std::vector<LinkEntry>& links)
+{
+	problems.clear();
+	report = {};
+
+	// the same target can be listed by several rules, the first one creates the link
+	std::unordered_set<AccessProfile::key_t> expectedTargets;
+	std::vector<const LinkEntry*> expectedLinks;
+	expectedLinks.reserve(links.size());
+
+	for (const LinkEntry& link : links)
+	{
+		if (expectedTargets.insert(AccessProfile::makeKey(link.target)).second) {
+			expectedLinks.push_back(&link);
+		}
+	}
+
+	std::vector<LinkCheck> checks(expectedLinks.size());
+	const size_t taskCount = (expectedLinks.size() + LinksPerTask - 1) / LinksPerTask;
+
+	pool.parallelFor(taskCount, [&](size_t task)
+		{
+			const size_t begin = task * LinksPerTask;
+			const size_t end = std::min(begin + LinksPerTask, expectedLinks.size());
+
+			for (size_t i = begin; i < end; ++i)
+			{
+				const LinkEntry& link = *expectedLinks[i];
+				LinkCheck& check = checks[i];
+
+				FileIdentity linkIdentity{};
+				FileIdentity sourceIdentity{};
+
+				const std::filesystem::path linkPath = getLinkPath(filesDir, link.target);
+				if (!getFileIdentity(linkPath, linkIdentity)) {
+					check.status = LinkStatus::Missing;
+				}
+				else if (link.directory && !getFileIdentity(linkPath, linkIdentity, true)) {
+					// the directory link doesn't resolve
+					check.status = LinkStatus::Stale;
+				}
+				else if (!getFileIdentity(link.source, sourceIdentity) || !(linkIdentity == sourceIdentity)) {
+					check.status = LinkStatus::Stale;
+				}
+				else {
+					check.status = LinkStatus::Valid;
+				}
+
+				check.linkCount = linkIdentity.linkCount;
+			}
+		});
+
+	for (size_t i = 0; i < checks.size(); ++i)
+	{
+		LinkCheck& check = checks[i];
+		switch (check.status)
+		{
+		case LinkStatus::Valid:
+			++report.valid;
+			continue;
+		case LinkStatus::Missing:
+			++report.missing;
+			break;
+		default:
+			++report.stale;
+			break;
+		}
+
+		check.target = expectedLinks[i]->target;
+		check.source = expectedLinks[i]->source;
+		problems.push_back(std::move(check));
+	}
+
+	// files in the container that no rule links
+	std::vector<TreeEntry> entries;
+	std::vector<std::vector<std::filesystem::path>> levels;
+	walkTree(pool, filesDir, entries, levels);
+
+	for (const TreeEntry& entry : entries)
+	{
+		const std::filesystem::path target = filesDir.root_directory() / entry.path.lexically_relative(filesDir);
+		if (expectedTargets.count(AccessProfile::makeKey(target))) {
+			continue;
+		}
+
+		LinkCheck check{ LinkStatus::Extra, target, {}, 0 };
+
+		FileIdentity identity;
+		if (getFileIdentity(entry.path, identity)) {
+			check.linkCount = identity.linkCount;
+		}
+
+		++report.extra;
+		problems.push_back(std::move(check));
+	}
+}
+
+const std::vector<LinkCheck>& Files::LinkVerifier::getProblems() const
+{
+	return problems;
+}
+
+VerifyReport Files::LinkVerifier::getReport() const
+{
+	return report;
+}
+
+void Files::LinkVerifier::writeProblems(std::ostream& stream) const
+{
+	for (const LinkCheck& check : problems)
+	{
+		const std::string line = std::string(getStatusName(check.status)) + '\t' + toUtf8(check.target) + '\t' + toUtf8(check.source) + '\t' + std::to_string(check.linkCount) + '\n';
+		stream.write(line.data(), line.size());
+	}
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "link_manifest.h"
+#include "thread_pool.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <ostream>
+#include <vector>
+
+namespace Files
+{
+	enum class LinkStatus : unsigned char
+	{
+		Valid,
+
+		/** The link doesn't exist in the container. */
+		Missing,
+
+		/** The link is not the host file anymore, or the host file is gone. */
+		Stale,
+
+		/** The file exists in the container but no link is expected there. */
+		Extra
+	};
+
+	struct LinkCheck
+	{
+		LinkStatus status;
+		std::filesystem::path target;
+		std::filesystem::path source;
+
+		/** Link count of the container file, 0 if it is missing. */
+		uint64_t linkCount;
+	};
+
+	struct VerifyReport
+	{
+		size_t valid;
+		size_t missing;
+		size_t stale;
+		size_t extra;
+	};
+
+	/**
+	 * Checks the container links against their host files by file identity
+	 * (volume and file index), without reading their content.
+	 */
+	class LinkVerifier
+	{
+	public:
+		LinkVerifier(ThreadPool& inPool, const std::filesystem::path& inFilesDir);
+
+		/**
+		 * Checks the expected links in parallel, then walks the files directory for extra entries.
+		 */
+		void verify(const std::vector<LinkEntry>& links);
+
+		/**
+		 * Missing, stale and extra entries.
+		 */
+		const std::vector<LinkCheck>& getProblems() const;
+		VerifyReport getReport() const;
+
+		/**
+		 * Writes the problems as tab-separated lines: status, target, source and link count.
+		 */
+		void writeProblems(std::ostream& stream) const;
+
+	private:
+		ThreadPool& pool;
+		std::filesystem::path filesDir;
+		std::vector<LinkCheck> problems;
+		VerifyReport report;
+	};
+}
@@ -4,25 +4,118 @@
 
 #include "registry.h"
 #include "registry_windows_platform.h"
+#include "registry_memory_platform.h"
+#include "registry_hive_file_platform.h"
 #include "registry_configuration.h"
 #include "registry_configuration_visitor.h"
+#include "registry_fingerprint.h"
+#include "registry_hive_cache.h"
+#include "registry_hive_compaction.h"
+#include "registry_tracing.h"
 #include "files_configuration_visitor.h"
+#include "access_profile.h"
+#include "container_teardown.h"
+#include "file_group.h"
+#include "import_closure.h"
+#include "layer_bundle.h"
+#include "link_manifest.h"
+#include "link_verifier.h"
+#include "prefetch_list.h"
+#include "prep_journal.h"
+#include "task_group.h"
+#include "thread_pool.h"
 
 #include <tclap/CmdLine.h>
 
 #include <filesystem>
 #include <iostream>
 #include <fstream>
+#include <optional>
+#include <sstream>
 
 #include <Windows.h>
+#include <fcntl.h>
+#include <io.h>
 
 static const std::filesystem::path DefaultContainerDirectory = L"\\ProgramData\\Containers";
 static const std::filesystem::path DefaultSettingsDirectory = L".\\Settings";
 
+/**
+ * Names how the hive files are written, the hive cache keeps the hives of each format apart.
+ */
+static std::wstring getHiveFormatName(bool bOfflineHives, const Registry::Regf::HiveLayout& layout)
+{
+	if (!bOfflineHives) {
+		return L"apphive";
+	}
+
+	switch (layout.order)
+	{
+	case Registry::Regf::KeyOrder::BreadthFirst:
+		return L"regf-breadth";
+	case Registry::Regf::KeyOrder::AccessOrder:
+	{
+		Registry::Fingerprint fingerprint;
+		for (const std::wstring& keyPath : layout.accessedKeys) {
+			fingerprint.add(std::wstring_view(keyPath));
+		}
+
+		return L"regf-access-" + std::to_wstring(fingerprint.get());
+	}
+	default:
+		return L"regf-depth";
+	}
+}
+
+/**
+ * Computes the DLL import closure of the binaries with the search order of the loader: the directory of the binary,
+ * then the system directory of its bitness and the Windows directory.
+ */
+static std::vector<std::filesystem::path> computeImportClosure(ThreadPool& pool, const std::vector<std::filesystem::path>& roots)
+{
+	const std::filesystem::path systemRoot = std::getenv("SystemRoot");
+
+	std::vector<std::filesystem::path> wow64SearchDirectories;
+	std::error_code ec;
+	if (std::filesystem::is_directory(systemRoot / L"SysWOW64", ec)) {
+		wow64SearchDirectories = { systemRoot / L"SysWOW64", systemRoot };
+	}
+
+	Files::ImportClosure importClosure(pool, { systemRoot / L"System32", systemRoot }, wow64SearchDirectories);
+	std::vector<std::filesystem::path> closure = importClosure.compute(roots);
+
+	for (const std::string& moduleName : importClosure.getUnresolvedModules()) {
+		std::cerr << "warning: unresolved module " << moduleName << std::endl;
+	}
+
+	return closure;
+}
+
 int main(int argc, const char* argv[])
 {
 	std::filesystem::path containerPath;
 	std::filesystem::path settingsDir;
+	std::vector<std::filesystem::path> closureRoots;
+	std::filesystem::path closureOutput;
+	std::filesystem::path profileFile;
+	std::filesystem::path profileKeepFile;
+	std::filesystem::path pruneOutput;
+	std::string exportBundle;
+	std::string importBundle;
+	bool bResume = true;
+	bool bDestroy = false;
+	bool bVerify = false;
+	bool bOfflineHives = false;
+	bool bHiveTimings = false;
+	bool bRebuildHives = false;
+	bool bTraceRegistry = false;
+	bool bHiveCache = true;
+	bool bCompactHives = false;
+	Registry::Regf::HiveLayout hiveLayout;
+	std::filesystem::path hiveCacheDir;
+	std::filesystem::path hostHivesDir;
+	std::filesystem::path verifyOutput;
+	Files::TeardownOptions teardownOptions{ 0, 0 };
 
 	TCLAP::CmdLine cmd("Container preparation tool", ' ');
 	cmd.setExceptionHandling(false);
@@ -32,10 +125,56 @@ int main(int argc, const char* argv[])
 		TCLAP::ValueArg<std::string> containerDrivePathArg("p", "condir", "The container directory on the system drive", false, "", "string");
 		TCLAP::ValueArg<std::string> containerNameArg("c", "name", "Container name", true, "", "string");
 		TCLAP::ValueArg<std::string> settingsDirArg("s", "settings", "Settings path", false, "", "string");
+		TCLAP::MultiArg<std::string> closureRootArg("r", "closure-root", "Binary, or directory of binaries, whose DLL import closure is linked into the container", false, "string");
+		TCLAP::ValueArg<std::string> closureOutputArg("", "closure-out", "Writes the import closure to a file group and exits without preparing the container", false, "", "string");
+		TCLAP::ValueArg<std::string> profileArg("", "profile", "File access trace of a container run, only the accessed files are linked", false, "", "string");
+		TCLAP::ValueArg<std::string> profileKeepArg("", "profile-keep", "Files and directories always linked when using a profile, one per line", false, "", "string");
+		TCLAP::ValueArg<std::string> pruneOutputArg("", "prune-out", "Writes the container links contained in the profile to a file group, instead of preparing the container", false, "", "string");
+		TCLAP::ValueArg<std::string> exportBundleArg("", "export-bundle", "Writes the prepared container to a layer bundle file, - for the standard output", false, "", "string");
+		TCLAP::ValueArg<std::string> importBundleArg("", "import-bundle", "Creates the container from a layer bundle file, - for the standard input", false, "", "string");
+		TCLAP::SwitchArg noResumeArg("", "no-resume", "Prepares the container from the start, even if a previous run was interrupted", false);
+		TCLAP::SwitchArg verifyArg("", "verify", "Checks the container links against the host files instead of preparing the container", false);
+		TCLAP::ValueArg<std::string> verifyOutputArg("", "verify-out", "Missing, stale and extra entries found by --verify, as tab-separated lines", false, "", "string");
+		TCLAP::SwitchArg offlineHivesArg("", "offline-hives", "Builds the hives in memory and writes their files directly, instead of going through application hives", false);
+		TCLAP::ValueArg<std::string> hostHivesArg("", "host-hives", "Directory of hive files (SYSTEM, SOFTWARE, DEFAULT...) read instead of the host registry", false, "", "string");
+		TCLAP::SwitchArg hiveTimingsArg("", "hive-timings", "Prints the time spent reading and applying each host key of the hives", false);
+		TCLAP::SwitchArg traceRegistryArg("", "trace-registry", "Prints the count, latency and bytes of the registry operations of the hives, and the slowest keys", false);
+		TCLAP::SwitchArg rebuildHivesArg("", "rebuild-hives", "Rebuilds every hive, instead of only the keys that changed since the previous run", false);
+		TCLAP::ValueArg<std::string> hiveCacheArg("", "hive-cache", "Directory of the hives shared by the containers of this host, .hivecache in the container directory by default", false, "", "string");
+		TCLAP::SwitchArg noHiveCacheArg("", "no-hive-cache", "Builds the hives without restoring them from the hive cache or adding them to it", false);
+		TCLAP::ValueArg<std::string> hiveLayoutArg("", "hive-layout", "Order of the keys in the hive files written offline or compacted: depth, breadth or access", false, "depth", "string");
+		TCLAP::ValueArg<std::string> hiveAccessOrderArg("", "hive-access-order", "Keys written first by the access layout, one path per line starting with the hive name", false, "", "string");
+		TCLAP::SwitchArg compactHivesArg("", "compact-hives", "Rewrites the hive files of the container with the hive layout and without free space, instead of preparing it", false);
+		TCLAP::SwitchArg destroyArg("", "destroy", "Deletes the container instead of preparing it", false);
+		TCLAP::ValueArg<size_t> destroyThreadsArg("", "destroy-threads", "Maximum number of deletions in flight", false, 0, "count");
+		TCLAP::ValueArg<size_t> destroyRateArg("", "destroy-rate", "Maximum number of deletions per second", false, 0, "count");
 
 		cmd.add(containerDrivePathArg);
 		cmd.add(containerNameArg);
 		cmd.add(settingsDirArg);
+		cmd.add(closureRootArg);
+		cmd.add(closureOutputArg);
+		cmd.add(profileArg);
+		cmd.add(profileKeepArg);
+		cmd.add(pruneOutputArg);
+		cmd.add(exportBundleArg);
+		cmd.add(importBundleArg);
+		cmd.add(noResumeArg);
+		cmd.add(verifyArg);
+		cmd.add(verifyOutputArg);
+		cmd.add(offlineHivesArg);
+		cmd.add(hostHivesArg);
+		cmd.add(hiveTimingsArg);
+		cmd.add(traceRegistryArg);
+		cmd.add(rebuildHivesArg);
+		cmd.add(hiveCacheArg);
+		cmd.add(noHiveCacheArg);
+		cmd.add(hiveLayoutArg);
+		cmd.add(hiveAccessOrderArg);
+		cmd.add(compactHivesArg);
+		cmd.add(destroyArg);
+		cmd.add(destroyThreadsArg);
+		cmd.add(destroyRateArg);
 
 		cmd.parse(argc, argv);
 
@@ -55,6 +194,13 @@ int main(int argc, const char* argv[])
 
 		containerPath = containerDir / containerNameArg.getValue();
 
+		if (hiveCacheArg.isSet()) {
+			hiveCacheDir = hiveCacheArg.getValue();
+		}
+		else {
+			hiveCacheDir = containerDir / L".hivecache";
+		}
+
 		if (settingsDirArg.isSet())
 		{
 			settingsDir = settingsDirArg.getValue();
@@ -62,6 +208,74 @@ int main(int argc, const char* argv[])
 		else {
 			settingsDir = DefaultSettingsDirectory;
 		}
+
+		for (const std::string& root : closureRootArg.getValue()) {
+			closureRoots.push_back(root);
+		}
+
+		if (closureOutputArg.isSet()) {
+			closureOutput = closureOutputArg.getValue();
+		}
+
+		if (profileArg.isSet()) {
+			profileFile = profileArg.getValue();
+		}
+
+		if (profileKeepArg.isSet()) {
+			profileKeepFile = profileKeepArg.getValue();
+		}
+
+		if (pruneOutputArg.isSet())
+		{
+			if (!profileArg.isSet()) {
+				throw TCLAP::ArgException("requires a profile", pruneOutputArg.toString());
+			}
+
+			pruneOutput = pruneOutputArg.getValue();
+		}
+
+		exportBundle = exportBundleArg.getValue();
+		importBundle = importBundleArg.getValue();
+		bResume = !noResumeArg.getValue();
+		bVerify = verifyArg.getValue();
+		bOfflineHives = offlineHivesArg.getValue();
+		bHiveTimings = hiveTimingsArg.getValue();
+		bTraceRegistry = traceRegistryArg.getValue();
+		bRebuildHives = rebuildHivesArg.getValue();
+		bHiveCache = !noHiveCacheArg.getValue();
+		bCompactHives = compactHivesArg.getValue();
+
+		if (hiveLayoutArg.getValue() == "depth") {
+			hiveLayout.order = Registry::Regf::KeyOrder::DepthFirst;
+		}
+		else if (hiveLayoutArg.getValue() == "breadth") {
+			hiveLayout.order = Registry::Regf::KeyOrder::BreadthFirst;
+		}
+		else if (hiveLayoutArg.getValue() == "access")
+		{
+			if (!hiveAccessOrderArg.isSet()) {
+				throw TCLAP::ArgException("requires an access order", hiveLayoutArg.toString());
+			}
+
+			hiveLayout.order = Registry::Regf::KeyOrder::AccessOrder;
+
+			std::ifstream accessOrderStream(hiveAccessOrderArg.getValue(), std::ios::in | std::ios::binary);
+			hiveLayout.accessedKeys = Registry::readAccessedKeys(accessOrderStream);
+		}
+		else {
+			throw TCLAP::ArgException("unknown layout", hiveLayoutArg.toString());
+		}
+
+		if (hostHivesArg.isSet()) {
+			hostHivesDir = hostHivesArg.getValue();
+		}
+		if (verifyOutputArg.isSet()) {
+			verifyOutput = verifyOutputArg.getValue();
+		}
+
+		bDestroy = destroyArg.getValue();
+		teardownOptions.maxConcurrency = destroyThreadsArg.getValue();
+		teardownOptions.maxRate = destroyRateArg.getValue();
 	}
 	catch (const TCLAP::ArgException& e)
 	{
@@ -78,27 +292,356 @@ int main(int argc, const char* argv[])
 		return 3;
 	}
 
-	Registry::Platform::Host::RegistryManager registryManager;
-
 	const std::filesystem::path containerFilesPath = containerPath / L"Files";
 	const std::filesystem::path containerHivesPath = containerPath / L"Hives";
+	const std::filesystem::path manifestPath = containerPath / L"links.manifest";
+
+	if (bDestroy)
+	{
+		ThreadPool pool;
+		Files::ContainerTeardown teardown(pool, teardownOptions);
+		teardown.destroy(containerPath);
+
+		const Files::TeardownReport report = teardown.getReport();
+		std::cout << "deleted " << report.files << " files and " << report.directories << " directories" << std::endl;
+		if (report.failed) {
+			std::cerr << "warning: " << report.failed << " entries could not be deleted" << std::endl;
+		}
+
+		return report.failed ? 4 : 0;
+	}
+
+	std::optional<Files::AccessProfile> profile;
+	if (!profileFile.empty())
+	{
+		profile = Files::AccessProfile::load(profileFile);
+		profile->addDefaultSafetyPaths();
+
+		if (!profileKeepFile.empty())
+		{
+			std::ifstream keepStream(profileKeepFile, std::ios::in | std::ios::binary);
+			profile->addSafetyPaths(keepStream);
+		}
+	}
+
+	if (!pruneOutput.empty())
+	{
+		// join the links of the prepared container with the profile, file by file
+		const Files::LinkManifest manifest = Files::LinkManifest::load(manifestPath);
+
+		Files::PruneReport report;
+		const std::vector<Files::LinkEntry> keptLinks = Files::pruneLinks(Files::expandDirectoryLinks(manifest.getEntries()), *profile, report);
+
+		std::ofstream pruneStream(pruneOutput, std::ios::out | std::ios::binary);
+		Files::writeFileGroup(pruneStream, L"Profile", keptLinks);
+
+		std::cout << "links: " << report.keptLinks << " kept out of " << report.totalLinks << std::endl;
+		std::cout << "files: " << report.keptFiles << " kept out of " << report.totalFiles << std::endl;
+		return 0;
+	}
+
+	if (!exportBundle.empty())
+	{
+		ThreadPool pool;
+		const Files::LinkManifest manifest = Files::LinkManifest::load(manifestPath);
+
+		std::ofstream bundleFile;
+		if (exportBundle == "-") {
+			_setmode(_fileno(stdout), _O_BINARY);
+		}
+		else {
+			bundleFile.open(exportBundle, std::ios::out | std::ios::binary | std::ios::trunc);
+		}
+
+		std::ostream& bundleStream = exportBundle == "-" ? std::cout : bundleFile;
+		// the bundle has the files below directory links, the host that imports it may not have the directories
+		const Files::BundleReport report = Files::exportBundle(pool, bundleStream, Files::expandDirectoryLinks(manifest.getEntries()), containerHivesPath);
+
+		std::cerr << "exported " << report.links << " links, " << report.writtenFiles << " distinct files (" << report.writtenBytes / (1024 * 1024) << " MB) and " << report.hives << " hives" << std::endl;
+		return 0;
+	}
+
+	if (!importBundle.empty())
+	{
+		// requires this privilege to create hard links
+		Privilege privilege(SE_RESTORE_NAME);
+
+		ThreadPool pool;
+
+		std::ifstream bundleFile;
+		if (importBundle == "-") {
+			_setmode(_fileno(stdin), _O_BINARY);
+		}
+		else {
+			bundleFile.open(importBundle, std::ios::in | std::ios::binary);
+		}
+
+		std::istream& bundleStream = importBundle == "-" ? std::cin : bundleFile;
+		Files::LinkManifestWriter manifestWriter(manifestPath);
+
+		const char* systemDrive = std::getenv("SystemDrive");
+		const Files::BundleReport report = Files::importBundle(pool, bundleStream, containerPath, systemDrive, Files::createFileOperations(pool), manifestWriter);
+
+		std::cout << "imported " << report.links << " links: " << report.linkedFiles << " linked to host files, " << report.writtenFiles << " written from the bundle (" << report.writtenBytes / (1024 * 1024) << " MB)" << std::endl;
+		return 0;
+	}
+
+	if (!closureOutput.empty())
+	{
+		ThreadPool pool;
+		const std::vector<std::filesystem::path> closure = computeImportClosure(pool, closureRoots);
+
+		std::ofstream closureStream(closureOutput, std::ios::out | std::ios::binary);
+		Files::writeFileGroup(closureStream, L"ImportClosure", closure);
+
+		std::cout << "closure: " << closure.size() << " files" << std::endl;
+		return 0;
+	}
+
+	if (bVerify)
+	{
+		ThreadPool pool;
+
+		std::vector<Files::LinkEntry> links;
+		std::error_code ec;
+		if (std::filesystem::exists(manifestPath, ec)) {
+			links = Files::LinkManifest::load(manifestPath).getEntries();
+		}
+		else
+		{
+			// resolve the rules without linking
+			std::stringstream manifestStream;
+			Files::LinkManifestWriter manifestWriter(manifestStream);
+
+			std::ifstream filesConf(settingsDir / L"file_groups.xml", std::ios::in | std::ios::binary);
+			Files::Config::FilesGroupReader filesReader(filesConf, settingsDir);
+
+			Files::FilesVisitorPtr fileVisitor(new Files::FilesVisitor(containerFilesPath, Files::IFileOperationsPtr(new Files::DryRunFileOperations()), &manifestWriter, profile ? &*profile : nullptr));
+			filesReader.parse(fileVisitor, fileVisitor);
+			fileVisitor->flush();
+
+			links = Files::LinkManifest(manifestStream).getEntries();
+		}
+
+		Files::LinkVerifier verifier(pool, containerFilesPath);
+		verifier.verify(links);
+
+		if (!verifyOutput.empty())
+		{
+			std::ofstream verifyStream(verifyOutput, std::ios::out | std::ios::binary);
+			verifier.writeProblems(verifyStream);
+		}
+
+		const Files::VerifyReport report = verifier.getReport();
+		std::cout << "valid: " << report.valid << std::endl;
+		std::cout << "missing: " << report.missing << std::endl;
+		std::cout << "stale: " << report.stale << std::endl;
+		std::cout << "extra: " << report.extra << std::endl;
+
+		return verifier.getProblems().empty() ? 0 : 4;
+	}
+
+	if (bCompactHives)
+	{
+		bool bFailed = false;
+		for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(containerHivesPath))
+		{
+			// hive files have no extension, unlike their logs and fingerprints
+			if (!entry.is_regular_file() || entry.path().has_extension()) {
+				continue;
+			}
+
+			try
+			{
+				const Registry::HiveCompaction compaction = Registry::compactHive(entry.path(), hiveLayout);
+
+				const auto originalReadTime = std::chrono::duration_cast<std::chrono::microseconds>(compaction.originalReadTime);
+				const auto compactedReadTime = std::chrono::duration_cast<std::chrono::microseconds>(compaction.compactedReadTime);
+				std::cout << entry.path().filename().string() << ": " << compaction.originalSize / 1024 << " KB -> " << compaction.compactedSize / 1024 << " KB, read "
+					<< originalReadTime.count() << " us -> " << compactedReadTime.count() << " us" << std::endl;
+			}
+			catch (const std::exception& e)
+			{
+				std::cerr << "error: " << entry.path().filename().string() << ": " << e.what() << std::endl;
+				bFailed = true;
+			}
+		}
+
+		return bFailed ? 4 : 0;
+	}
+
+	Registry::Platform::Host::RegistryManager registryManager;
+	Registry::Platform::Memory::RegistryManager offlineRegistryManager(Registry::Platform::Memory::HiveFormat::Regf, hiveLayout);
+
+	std::optional<Registry::Platform::HiveFile::RegistryManager> hiveFileRegistryManager;
+	if (!hostHivesDir.empty()) {
+		hiveFileRegistryManager.emplace(hostHivesDir);
+	}
+
+	Registry::IRegistryManager* hostRegistry = hiveFileRegistryManager ? static_cast<Registry::IRegistryManager*>(&*hiveFileRegistryManager) : &registryManager;
+	Registry::IRegistryManager* targetRegistry = bOfflineHives ? static_cast<Registry::IRegistryManager*>(&offlineRegistryManager) : &registryManager;
+
+	// the registries are traced through wrappers, a registry read and written is traced once
+	std::optional<Registry::Tracing::RegistryManager> hostTracing;
+	std::optional<Registry::Tracing::RegistryManager> targetTracing;
+	if (bTraceRegistry)
+	{
+		hostTracing.emplace(*hostRegistry);
+		if (targetRegistry != hostRegistry)
+		{
+			targetTracing.emplace(*targetRegistry);
+			targetRegistry = &*targetTracing;
+		}
+		else {
+			targetRegistry = &*hostTracing;
+		}
+
+		hostRegistry = &*hostTracing;
+	}
+
+	Registry::IRegistryManager& hostRegistryManager = *hostRegistry;
+	Registry::IRegistryManager& targetRegistryManager = *targetRegistry;
 
 	std::filesystem::create_directories(containerFilesPath);
 	std::filesystem::create_directories(containerHivesPath);
 
-	// Read hives configuration
-	std::ifstream hivesConf(settingsDir / L"hives.xml", std::ios::in | std::ios::binary);
-	Registry::Config::HivesConfigReader hivesReader(hivesConf, settingsDir);
+	// Completed steps of an interrupted run are skipped
+	PrepJournal journal(containerPath / L"prep.journal", bResume);
+	if (journal.isResuming()) {
+		std::cout << "resuming the interrupted preparation" << std::endl;
+	}
+
+	ThreadPool pool;
+
+	Files::LinkManifestWriter manifestWriter(manifestPath, journal.isResuming());
+
+	// both phases toggle these privileges, keep them enabled while they run
+	Privilege backupPrivilege(SE_BACKUP_NAME);
+	Privilege restorePrivilege(SE_RESTORE_NAME);
 
-	Registry::Config::IHiveVisitorPtr visitor(new Registry::HiveConfigVisitor(registryManager, containerHivesPath, L"_BASE"));
-	hivesReader.parse(visitor);
+	Registry::HostKeyReport hostKeyReport;
+
+	// hives are shared by the containers built from the same host build, settings and host keys
+	std::optional<Registry::HiveCache> hiveCache;
+	if (bHiveCache) {
+		hiveCache.emplace(hiveCacheDir, Registry::HiveCache::readHostBuild(hostRegistryManager), getHiveFormatName(bOfflineHives, hiveLayout));
+	}
+
+	// The registry is bound on registry calls and the files on filesystem metadata, both phases run at the same time
+	TaskGroup phases(pool);
+
+	phases.run("hives", [&](const CancellationToken& token)
+		{
+			if (journal.contains("phase", "hives")) {
+				return;
+			}
+
+			// Read hives configuration
+			std::ifstream hivesConf(settingsDir / L"hives.xml", std::ios::in | std::ios::binary);
+			Registry::Config::HivesConfigReader hivesReader(hivesConf, settingsDir, &pool);
+
+			Registry::Config::IHiveVisitorPtr visitor(new Registry::HiveConfigVisitor(hostRegistryManager, targetRegistryManager, containerHivesPath, L"_BASE", &token, &pool, &hostKeyReport, bRebuildHives, hiveCache ? &*hiveCache : nullptr));
+			hivesReader.parse(visitor);
+
+			journal.append("phase", "hives");
+			journal.commit();
+		});
+
+	phases.run("files", [&](const CancellationToken& token)
+		{
+			// Read files configuration
+			std::ifstream filesConf(settingsDir / L"file_groups.xml", std::ios::in | std::ios::binary);
+			Files::Config::FilesGroupReader filesReader(filesConf, settingsDir);
+
+			Files::FilesVisitorPtr fileVisitor(new Files::FilesVisitor(containerFilesPath, Files::createFileOperations(pool), &manifestWriter, profile ? &*profile : nullptr, &journal, &token));
+			filesReader.parse(fileVisitor, fileVisitor);
+
+			if (!closureRoots.empty()) {
+				Files::visitHostFiles(*fileVisitor, computeImportClosure(pool, closureRoots));
+			}
+
+			fileVisitor->flush();
+			if (fileVisitor->getFailedCount()) {
+				std::cerr << "warning: " << fileVisitor->getFailedCount() << " links or directories could not be created" << std::endl;
+			}
+		});
+
+	try
+	{
+		phases.wait();
+	}
+	catch (...)
+	{
+		// report every phase, the completed steps are kept for the next run
+		for (const TaskGroup::TaskError& taskError : phases.getErrors())
+		{
+			try
+			{
+				std::rethrow_exception(taskError.error);
+			}
+			catch (const std::exception& e)
+			{
+				std::cerr << "error: " << taskError.taskName << ": " << e.what() << std::endl;
+			}
+			catch (...)
+			{
+				std::cerr << "error: " << taskError.taskName << ": unknown error" << std::endl;
+			}
+		}
+
+		manifestWriter.flush();
+		return 2;
+	}
+
+	manifestWriter.flush();
+
+	if (hiveCache)
+	{
+		const Registry::HiveCacheReport cacheReport = hiveCache->getReport();
+		if (cacheReport.hits || cacheReport.misses)
+		{
+			const auto savedTime = std::chrono::duration_cast<std::chrono::milliseconds>(cacheReport.savedTime);
+			std::cout << "hive cache: " << cacheReport.hits << " hits, " << cacheReport.misses << " misses, " << savedTime.count() << " ms saved" << std::endl;
+		}
+	}
+
+	if (bHiveTimings)
+	{
+		for (const Registry::HostKeyTiming& timing : hostKeyReport.getTimings())
+		{
+			const auto readTime = std::chrono::duration_cast<std::chrono::milliseconds>(timing.readTime);
+			const auto applyTime = std::chrono::duration_cast<std::chrono::milliseconds>(timing.applyTime);
+			std::cout << (std::filesystem::path(timing.hiveName) / timing.hostPath).string() << ": " << timing.keyCount << " keys, read " << readTime.count() << " ms, applied " << applyTime.count() << " ms" << std::endl;
+		}
+	}
+
+	if (hostTracing)
+	{
+		Registry::Tracing::writeTrace(std::cout, hostTracing->getTrace(), targetTracing ? "host" : "registry");
+		if (targetTracing) {
+			Registry::Tracing::writeTrace(std::cout, targetTracing->getTrace(), "target");
+		}
+	}
+
+	// Write the files to read ahead of the container start
+	std::vector<std::filesystem::path> prefetchFiles;
+	for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(containerHivesPath))
+	{
+		// hives are loaded first, their logs are replayed only after a failure and their fingerprints are only read by the next preparation
+		if (entry.is_regular_file() && !entry.path().has_extension() && entry.path().filename().native().ends_with(L"_BASE")) {
+			prefetchFiles.push_back(entry.path());
+		}
+	}
+
+	const Files::LinkManifest manifest = Files::LinkManifest::load(manifestPath);
+	for (std::filesystem::path& file : Files::buildPrefetchList(manifest.getEntries(), profile ? &*profile : nullptr)) {
+		prefetchFiles.push_back(std::move(file));
+	}
 
-	// Read files configuration
-	std::ifstream filesConf(settingsDir / L"file_groups.xml", std::ios::in | std::ios::binary);
-	Files::Config::FilesGroupReader filesReader(filesConf, settingsDir);
+	std::ofstream prefetchStream(containerPath / L"prefetch.lst", std::ios::out | std::ios::binary);
+	Files::writePrefetchList(prefetchStream, prefetchFiles);
 
-	Files::FilesVisitorPtr fileVisitor(new Files::FilesVisitor(containerFilesPath));
-	filesReader.parse(fileVisitor, fileVisitor);
+	journal.complete();
 
 	return 0;
 }
\ No newline at end of file
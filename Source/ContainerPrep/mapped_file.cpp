@@ -0,0 +1,157 @@
+#include "mapped_file.h"
+
+#include <cerrno>
+#include <system_error>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+	: data(nullptr)
+	, size(0)
+	, fileHandle(nullptr)
+	, mappingHandle(nullptr)
+{
+}
+
+MappedFile::MappedFile(const std::filesystem::path& path)
+	: MappedFile()
+{
+#ifdef _WIN32
+	HANDLE hFile = CreateFileW(path.native().c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile == INVALID_HANDLE_VALUE) {
+		throw std::system_error(std::error_code(GetLastError(), std::system_category()), "could not open file for mapping");
+	}
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(hFile, &fileSize))
+	{
+		const DWORD lastError = GetLastError();
+		CloseHandle(hFile);
+		throw std::system_error(std::error_code(lastError, std::system_category()), "could not query file size");
+	}
+
+	fileHandle = hFile;
+	size = static_cast<size_t>(fileSize.QuadPart);
+	if (!size)
+	{
+		// empty files cannot be mapped
+		return;
+	}
+
+	HANDLE hMapping = CreateFileMappingW(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!hMapping)
+	{
+		const DWORD lastError = GetLastError();
+		close();
+		throw std::system_error(std::error_code(lastError, std::system_category()), "could not create file mapping");
+	}
+
+	mappingHandle = hMapping;
+	data = static_cast<const unsigned char*>(MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0));
+	if (!data)
+	{
+		const DWORD lastError = GetLastError();
+		close();
+		throw std::system_error(std::error_code(lastError, std::system_category()), "could not map view of file");
+	}
+#else
+	const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		throw std::system_error(std::error_code(errno, std::system_category()), "could not open file for mapping");
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) < 0)
+	{
+		const int lastError = errno;
+		::close(fd);
+		throw std::system_error(std::error_code(lastError, std::system_category()), "could not query file size");
+	}
+
+	size = static_cast<size_t>(st.st_size);
+	if (size)
+	{
+		void* view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (view == MAP_FAILED)
+		{
+			const int lastError = errno;
+			::close(fd);
+			throw std::system_error(std::error_code(lastError, std::system_category()), "could not map view of file");
+		}
+
+		data = static_cast<const unsigned char*>(view);
+	}
+
+	// the mapping stays valid after the descriptor is closed
+	::close(fd);
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+MappedFile::MappedFile(MappedFile&& other)
+	: data(other.data)
+	, size(other.size)
+	, fileHandle(other.fileHandle)
+	, mappingHandle(other.mappingHandle)
+{
+	other.data = nullptr;
+	other.size = 0;
+	other.fileHandle = nullptr;
+	other.mappingHandle = nullptr;
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other)
+{
+	if (this != &other)
+	{
+		close();
+
+		data = other.data;
+		size = other.size;
+		fileHandle = other.fileHandle;
+		mappingHandle = other.mappingHandle;
+		other.data = nullptr;
+		other.size = 0;
+		other.fileHandle = nullptr;
+		other.mappingHandle = nullptr;
+	}
+
+	return *this;
+}
+
+void MappedFile::close()
+{
+#ifdef _WIN32
+	if (data) UnmapViewOfFile(data);
+	if (mappingHandle) CloseHandle(mappingHandle);
+	if (fileHandle) CloseHandle(fileHandle);
+#else
+	if (data) munmap(const_cast<unsigned char*>(data), size);
+#endif
+
+	data = nullptr;
+	size = 0;
+	fileHandle = nullptr;
+	mappingHandle = nullptr;
+}
+
+std::span<const unsigned char> MappedFile::getData() const
+{
+	return std::span<const unsigned char>(data, data ? size : 0);
+}
+
+bool MappedFile::empty() const
+{
+	return !data;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <filesystem>
+#include <span>
+
+/**
+ * Read-only view of a whole file mapped in memory.
+ */
+class MappedFile
+{
+public:
+	MappedFile();
+	MappedFile(const std::filesystem::path& path);
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	MappedFile(MappedFile&& other);
+	MappedFile& operator=(MappedFile&& other);
+
+	void close();
+
+	std::span<const unsigned char> getData() const;
+	bool empty() const;
+
+private:
+	const unsigned char* data;
+	size_t size;
+	void* fileHandle;
+	void* mappingHandle;
+};
@@ -0,0 +1,370 @@
+#include "pe_image.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+using namespace Files;
+
+constexpr uint16_t DosSignature = 0x5A4D;
+constexpr uint32_t NtSignature = 0x00004550;
+constexpr uint16_t OptionalHeaderMagic32 = 0x10B;
+constexpr uint16_t OptionalHeaderMagic64 = 0x20B;
+constexpr uint32_t DirectoryEntryImport = 1;
+constexpr uint32_t DirectoryEntryDelayImport = 13;
+constexpr size_t ImportDescriptorSize = 20;
+constexpr size_t DelayImportDescriptorSize = 32;
+constexpr size_t SectionHeaderSize = 40;
+constexpr size_t MaxModuleNameLength = 256;
+
+template<typename T>
+static bool readAt(std::span<const unsigned char> data, size_t offset, T& out)
+{
+	if (offset > data.size() || data.size() - offset < sizeof(T)) {
+		return false;
+	}
+
+	std::memcpy(&out, data.data() + offset, sizeof(T));
+	return true;
+}
+
+template<typename T>
+static T readField(std::span<const unsigned char> data, size_t offset)
+{
+	T value;
+	if (!readAt(data, offset, value)) {
+		throw std::runtime_error("truncated PE image");
+	}
+
+	return value;
+}
+
+std::string Pe::toLower(std::string_view str)
+{
+	std::string result(str);
+	for (char& c : result)
+	{
+		if (c >= 'A' && c <= 'Z') c += 'a' - 'A';
+	}
+
+	return result;
+}
+
+Pe::Image::Image(std::span<const unsigned char> inData)
+	: data(inData)
+	, imageBase(0)
+	, b32Bit(false)
+{
+	if (readField<uint16_t>(data, 0) != DosSignature) {
+		throw std::runtime_error("not a PE image");
+	}
+
+	const uint32_t ntHeaderOffset = readField<uint32_t>(data, 0x3C);
+	if (readField<uint32_t>(data, ntHeaderOffset) != NtSignature) {
+		throw std::runtime_error("not a PE image");
+	}
+
+	// COFF file header follows the signature
+	const size_t fileHeaderOffset = size_t(ntHeaderOffset) + 4;
+	const uint16_t numSections = readField<uint16_t>(data, fileHeaderOffset + 2);
+	const uint16_t optionalHeaderSize = readField<uint16_t>(data, fileHeaderOffset + 16);
+
+	const size_t optionalHeaderOffset = fileHeaderOffset + 20;
+	const uint16_t magic = readField<uint16_t>(data, optionalHeaderOffset);
+
+	size_t numDirectoriesOffset;
+	size_t directoriesOffset;
+	if (magic == OptionalHeaderMagic32)
+	{
+		imageBase = readField<uint32_t>(data, optionalHeaderOffset + 28);
+		b32Bit = true;
+		numDirectoriesOffset = optionalHeaderOffset + 92;
+		directoriesOffset = optionalHeaderOffset + 96;
+	}
+	else if (magic == OptionalHeaderMagic64)
+	{
+		imageBase = readField<uint64_t>(data, optionalHeaderOffset + 24);
+		numDirectoriesOffset = optionalHeaderOffset + 108;
+		directoriesOffset = optionalHeaderOffset + 112;
+	}
+	else {
+		throw std::runtime_error("unsupported PE optional header");
+	}
+
+	const uint32_t numDirectories = readField<uint32_t>(data, numDirectoriesOffset);
+
+	const size_t sectionsOffset = optionalHeaderOffset + optionalHeaderSize;
+	sections.reserve(numSections);
+	for (uint16_t i = 0; i < numSections; ++i)
+	{
+		const size_t headerOffset = sectionsOffset + i * SectionHeaderSize;
+
+		Section section;
+		if (headerOffset > data.size() || data.size() - headerOffset < SectionHeaderSize) {
+			throw std::runtime_error("truncated PE section table");
+		}
+
+		std::memcpy(section.name, data.data() + headerOffset, sizeof(section.name));
+		section.virtualSize = readField<uint32_t>(data, headerOffset + 8);
+		section.virtualAddress = readField<uint32_t>(data, headerOffset + 12);
+		section.rawSize = readField<uint32_t>(data, headerOffset + 16);
+		section.rawOffset = readField<uint32_t>(data, headerOffset + 20);
+		sections.push_back(section);
+	}
+
+	if (numDirectories > DirectoryEntryImport)
+	{
+		const uint32_t importRva = readField<uint32_t>(data, directoriesOffset + DirectoryEntryImport * 8);
+		if (importRva) {
+			parseImports(importRva);
+		}
+	}
+
+	if (numDirectories > DirectoryEntryDelayImport)
+	{
+		const uint32_t delayImportRva = readField<uint32_t>(data, directoriesOffset + DirectoryEntryDelayImport * 8);
+		if (delayImportRva) {
+			parseDelayImports(delayImportRva);
+		}
+	}
+}
+
+const std::vector<std::string>& Pe::Image::getImports() const
+{
+	return imports;
+}
+
+const std::vector<std::string>& Pe::Image::getDelayImports() const
+{
+	return delayImports;
+}
+
+bool Pe::Image::is32Bit() const
+{
+	return b32Bit;
+}
+
+std::span<const unsigned char> Pe::Image::findSection(std::string_view sectionName) const
+{
+	for (const Section& section : sections)
+	{
+		const std::string_view name(section.name, strnlen(section.name, sizeof(section.name)));
+		if (name == sectionName)
+		{
+			if (section.rawOffset > data.size()) {
+				return {};
+			}
+
+			const size_t available = data.size() - section.rawOffset;
+			const size_t size = std::min<size_t>(std::min(section.rawSize, section.virtualSize ? section.virtualSize : section.rawSize), available);
+			return data.subspan(section.rawOffset, size);
+		}
+	}
+
+	return {};
+}
+
+const unsigned char* Pe::Image::rvaToPointer(uint32_t rva, size_t minSize) const
+{
+	for (const Section& section : sections)
+	{
+		const uint32_t sectionSize = std::max(section.virtualSize, section.rawSize);
+		if (rva >= section.virtualAddress && rva - section.virtualAddress < sectionSize)
+		{
+			const size_t delta = rva - section.virtualAddress;
+			if (delta >= section.rawSize) {
+				// uninitialized data
+				return nullptr;
+			}
+
+			const size_t offset = size_t(section.rawOffset) + delta;
+			if (offset > data.size() || data.size() - offset < minSize) {
+				return nullptr;
+			}
+
+			return data.data() + offset;
+		}
+	}
+
+	return nullptr;
+}
+
+std::string Pe::Image::readName(uint32_t rva) const
+{
+	const unsigned char* name = rvaToPointer(rva);
+	if (!name) {
+		return {};
+	}
+
+	const size_t available = static_cast<size_t>(data.data() + data.size() - name);
+	const size_t length = strnlen(reinterpret_cast<const char*>(name), std::min(available, MaxModuleNameLength));
+
+	return toLower(std::string_view(reinterpret_cast<const char*>(name), length));
+}
+
+void Pe::Image::parseImports(uint32_t rva)
+{
+	for (uint32_t descriptorRva = rva;; descriptorRva += ImportDescriptorSize)
+	{
+		const unsigned char* descriptor = rvaToPointer(descriptorRva, ImportDescriptorSize);
+		if (!descriptor) {
+			break;
+		}
+
+		uint32_t nameRva;
+		uint32_t firstThunk;
+		std::memcpy(&nameRva, descriptor + 12, sizeof(nameRva));
+		std::memcpy(&firstThunk, descriptor + 16, sizeof(firstThunk));
+		if (!nameRva && !firstThunk) {
+			// null terminating descriptor
+			break;
+		}
+
+		std::string name = readName(nameRva);
+		if (!name.empty()) {
+			imports.push_back(std::move(name));
+		}
+	}
+}
+
+void Pe::Image::parseDelayImports(uint32_t rva)
+{
+	for (uint32_t descriptorRva = rva;; descriptorRva += DelayImportDescriptorSize)
+	{
+		const unsigned char* descriptor = rvaToPointer(descriptorRva, DelayImportDescriptorSize);
+		if (!descriptor) {
+			break;
+		}
+
+		uint32_t attributes;
+		uint32_t nameAddress;
+		std::memcpy(&attributes, descriptor, sizeof(attributes));
+		std::memcpy(&nameAddress, descriptor + 4, sizeof(nameAddress));
+		if (!nameAddress) {
+			break;
+		}
+
+		// old images (attribute bit 0 unset) store virtual addresses instead of RVAs
+		const uint32_t nameRva = (attributes & 1) ? nameAddress : static_cast<uint32_t>(nameAddress - imageBase);
+
+		std::string name = readName(nameRva);
+		if (!name.empty()) {
+			delayImports.push_back(std::move(name));
+		}
+	}
+}
+
+Pe::ApiSetSchema::ApiSetSchema()
+{
+}
+
+static std::string readSchemaName(std::span<const unsigned char> schemaData, uint32_t offset, uint32_t length)
+{
+	if (offset > schemaData.size() || schemaData.size() - offset < length) {
+		throw std::runtime_error("invalid API set schema name");
+	}
+
+	// names are UTF-16, contracts and host names are plain ASCII
+	std::string name;
+	name.reserve(length / 2);
+	for (uint32_t i = 0; i + 1 < length; i += 2)
+	{
+		const uint16_t ch = uint16_t(schemaData[offset + i]) | (uint16_t(schemaData[offset + i + 1]) << 8);
+		name.push_back(ch < 0x80 ? static_cast<char>(ch) : '?');
+	}
+
+	return Pe::toLower(name);
+}
+
+Pe::ApiSetSchema::ApiSetSchema(std::span<const unsigned char> schemaData)
+{
+	constexpr uint32_t SupportedVersion = 6;
+	constexpr size_t NamespaceEntrySize = 24;
+	constexpr size_t ValueEntrySize = 20;
+
+	const uint32_t version = readField<uint32_t>(schemaData, 0);
+	if (version != SupportedVersion) {
+		throw std::runtime_error("unsupported API set schema version");
+	}
+
+	const uint32_t count = readField<uint32_t>(schemaData, 12);
+	const uint32_t entryOffset = readField<uint32_t>(schemaData, 16);
+
+	entries.reserve(count);
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		const size_t entryPos = size_t(entryOffset) + i * NamespaceEntrySize;
+		const uint32_t nameOffset = readField<uint32_t>(schemaData, entryPos + 4);
+		const uint32_t hashedLength = readField<uint32_t>(schemaData, entryPos + 12);
+		const uint32_t valueOffset = readField<uint32_t>(schemaData, entryPos + 16);
+		const uint32_t valueCount = readField<uint32_t>(schemaData, entryPos + 20);
+
+		// the hashed part excludes the trailing revision number, so any revision resolves the same way
+		Entry entry;
+		for (uint32_t v = 0; v < valueCount; ++v)
+		{
+			const size_t valuePos = size_t(valueOffset) + v * ValueEntrySize;
+			const uint32_t importerOffset = readField<uint32_t>(schemaData, valuePos + 4);
+			const uint32_t importerLength = readField<uint32_t>(schemaData, valuePos + 8);
+			const uint32_t hostOffset = readField<uint32_t>(schemaData, valuePos + 12);
+			const uint32_t hostLength = readField<uint32_t>(schemaData, valuePos + 16);
+			if (!hostLength) {
+				continue;
+			}
+
+			std::string host = readSchemaName(schemaData, hostOffset, hostLength);
+			if (!importerLength)
+			{
+				if (entry.defaultHost.empty()) {
+					entry.defaultHost = std::move(host);
+				}
+			}
+			else {
+				entry.importerHosts.emplace(readSchemaName(schemaData, importerOffset, importerLength), std::move(host));
+			}
+		}
+
+		entries.emplace(readSchemaName(schemaData, nameOffset, hashedLength), std::move(entry));
+	}
+}
+
+bool Pe::ApiSetSchema::isApiSetName(std::string_view moduleName)
+{
+	if (moduleName.size() < 4) {
+		return false;
+	}
+
+	const std::string prefix = toLower(moduleName.substr(0, 4));
+	return prefix == "api-" || prefix == "ext-";
+}
+
+std::string Pe::ApiSetSchema::resolve(std::string_view moduleName, std::string_view importingModule) const
+{
+	std::string name = toLower(moduleName);
+	if (name.size() > 4 && !name.compare(name.size() - 4, 4, ".dll")) {
+		name.resize(name.size() - 4);
+	}
+
+	// strip the revision number
+	const size_t lastHyphen = name.rfind('-');
+	if (lastHyphen == std::string::npos) {
+		return {};
+	}
+
+	name.resize(lastHyphen);
+
+	const auto it = entries.find(name);
+	if (it == entries.end()) {
+		return {};
+	}
+
+	if (!importingModule.empty())
+	{
+		const auto importerIt = it->second.importerHosts.find(toLower(importingModule));
+		if (importerIt != it->second.importerHosts.end()) {
+			return importerIt->second;
+		}
+	}
+
+	return it->second.defaultHost;
+}
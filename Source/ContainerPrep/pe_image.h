@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace Files
+{
+	namespace Pe
+	{
+		/**
+		 * Minimal PE/COFF reader, only parses what is needed to follow DLL dependencies.
+		 */
+		class Image
+		{
+		public:
+			/**
+			 * Parses the image. Throws std::runtime_error if the data is not a valid PE image.
+			 */
+			Image(std::span<const unsigned char> inData);
+
+			/**
+			 * Lower-case names of the modules from the import table.
+			 */
+			const std::vector<std::string>& getImports() const;
+
+			/**
+			 * Lower-case names of the modules from the delay import table.
+			 */
+			const std::vector<std::string>& getDelayImports() const;
+
+			/**
+			 * Whether the image has a 32-bit optional header, such images are loaded from SysWOW64 on 64-bit hosts.
+			 */
+			bool is32Bit() const;
+
+			/**
+			 * Returns the raw data of the section with the specified name, or an empty span.
+			 */
+			std::span<const unsigned char> findSection(std::string_view sectionName) const;
+
+		private:
+			struct Section
+			{
+				char name[8];
+				uint32_t virtualSize;
+				uint32_t virtualAddress;
+				uint32_t rawSize;
+				uint32_t rawOffset;
+			};
+
+			const unsigned char* rvaToPointer(uint32_t rva, size_t minSize = 1) const;
+			std::string readName(uint32_t rva) const;
+			void parseImports(uint32_t rva);
+			void parseDelayImports(uint32_t rva);
+
+		private:
+			std::span<const unsigned char> data;
+			std::vector<Section> sections;
+			uint64_t imageBase;
+			bool b32Bit;
+			std::vector<std::string> imports;
+			std::vector<std::string> delayImports;
+		};
+
+		/**
+		 * API set schema (version 6, Windows 10 and later) as found in the .apiset section of apisetschema.dll.
+		 */
+		class ApiSetSchema
+		{
+		public:
+			ApiSetSchema();
+			ApiSetSchema(std::span<const unsigned char> schemaData);
+
+			/**
+			 * Whether the module name is an API set contract (api-* or ext-*).
+			 */
+			static bool isApiSetName(std::string_view moduleName);
+
+			/**
+			 * Resolves an API set contract to its host module. Returns an empty string if it cannot be resolved.
+			 */
+			std::string resolve(std::string_view moduleName, std::string_view importingModule = {}) const;
+
+		private:
+			struct Entry
+			{
+				std::string defaultHost;
+				std::unordered_map<std::string, std::string> importerHosts;
+			};
+
+			std::unordered_map<std::string, Entry> entries;
+		};
+
+		std::string toLower(std::string_view str);
+	}
+}
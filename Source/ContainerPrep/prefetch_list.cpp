@@ -0,0 +1,108 @@
+#include "prefetch_list.h"
+
+#include <unordered_map>
+#include <unordered_set>
+
+using namespace Files;
+
+static const wchar_t* DefaultPrefetchFiles[] =
+{
+	L"\\Windows\\system32\\ntdll.dll",
+	L"\\Windows\\system32\\smss.exe",
+	L"\\Windows\\system32\\csrss.exe",
+	L"\\Windows\\system32\\csrsrv.dll",
+	L"\\Windows\\system32\\basesrv.dll",
+	L"\\Windows\\system32\\winsrv.dll",
+	L"\\Windows\\system32\\sxssrv.dll",
+	L"\\Windows\\system32\\kernel32.dll",
+	L"\\Windows\\system32\\KernelBase.dll",
+	L"\\Windows\\system32\\ucrtbase.dll",
+	L"\\Windows\\system32\\msvcrt.dll",
+	L"\\Windows\\system32\\advapi32.dll",
+	L"\\Windows\\system32\\sechost.dll",
+	L"\\Windows\\system32\\rpcrt4.dll",
+	L"\\Windows\\system32\\combase.dll",
+	L"\\Windows\\system32\\bcrypt.dll",
+	L"\\Windows\\system32\\bcryptprimitives.dll",
+	L"\\Windows\\system32\\wininit.exe",
+	L"\\Windows\\system32\\services.exe",
+	L"\\Windows\\system32\\lsass.exe",
+	L"\\Windows\\system32\\lsasrv.dll",
+	L"\\Windows\\system32\\svchost.exe",
+	L"\\Windows\\system32\\CExecSvc.exe",
+	L"\\Windows\\system32\\cmd.exe",
+};
+
+std::vector<std::filesystem::path> Files::buildPrefetchList(const std::vector<LinkEntry>& links, const AccessProfile* profile)
+{
+	std::unordered_map<AccessProfile::key_t, const std::filesystem::path*> sources;
+	std::vector<std::pair<AccessProfile::key_t, const LinkEntry*>> directoryLinks;
+	for (const LinkEntry& link : links)
+	{
+		if (link.directory)
+		{
+			AccessProfile::key_t directoryKey = AccessProfile::makeKey(link.target);
+			directoryKey += '\\';
+			directoryLinks.emplace_back(std::move(directoryKey), &link);
+		}
+		else {
+			sources.emplace(AccessProfile::makeKey(link.target), &link.source);
+		}
+	}
+
+	std::vector<std::filesystem::path> files;
+	std::unordered_set<std::filesystem::path::string_type> added;
+
+	const auto addFile = [&](const std::filesystem::path& target)
+	{
+		const AccessProfile::key_t key = AccessProfile::makeKey(target);
+
+		const auto it = sources.find(key);
+		if (it != sources.end())
+		{
+			if (added.insert(it->second->native()).second) {
+				files.push_back(*it->second);
+			}
+
+			return;
+		}
+
+		// files below a directory link are not listed one by one
+		for (const auto& [directoryKey, link] : directoryLinks)
+		{
+			if (!key.compare(0, directoryKey.size(), directoryKey))
+			{
+				std::filesystem::path source = link->source / key.substr(directoryKey.size());
+				if (added.insert(source.native()).second) {
+					files.push_back(std::move(source));
+				}
+
+				return;
+			}
+		}
+	};
+
+	if (profile)
+	{
+		for (const std::filesystem::path& target : profile->getAccessOrder()) {
+			addFile(target);
+		}
+	}
+	else
+	{
+		for (const wchar_t* target : DefaultPrefetchFiles) {
+			addFile(target);
+		}
+	}
+
+	return files;
+}
+
+void Files::writePrefetchList(std::ostream& stream, const std::vector<std::filesystem::path>& files)
+{
+	for (const std::filesystem::path& file : files)
+	{
+		const std::string line = toUtf8(file) + '\n';
+		stream.write(line.data(), line.size());
+	}
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "access_profile.h"
+#include "link_manifest.h"
+
+#include <filesystem>
+#include <ostream>
+#include <vector>
+
+namespace Files
+{
+	/**
+	 * Builds the list of host files to read ahead of a container start, in order of first access.
+	 *
+	 * The order comes from the profile when there is one, otherwise from a default list
+	 * of the files loaded while the container boots. Only linked files are listed,
+	 * including the files below directory links.
+	 */
+	std::vector<std::filesystem::path> buildPrefetchList(const std::vector<LinkEntry>& links, const AccessProfile* profile);
+
+	/**
+	 * Writes the list as UTF-8, one absolute host path per line.
+	 */
+	void writePrefetchList(std::ostream& stream, const std::vector<std::filesystem::path>& files);
+}
@@ -0,0 +1,180 @@
+#include "prep_journal.h"
+
+#include <cerrno>
+#include <fstream>
+#include <system_error>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+PrepJournal::PrepJournal(const std::filesystem::path& journalFile, bool resume)
+	: fileHandle(nullptr)
+	, resuming(false)
+{
+	// the records of the interrupted run stay in the file, only a cut last record is removed
+	const uint64_t keptSize = resume ? load(journalFile) : 0;
+
+#ifdef _WIN32
+	HANDLE hFile = CreateFileW(
+		journalFile.c_str(),
+		GENERIC_WRITE,
+		FILE_SHARE_READ,
+		NULL,
+		OPEN_ALWAYS,
+		FILE_ATTRIBUTE_NORMAL,
+		NULL
+	);
+
+	if (hFile == INVALID_HANDLE_VALUE) {
+		throw std::system_error(std::error_code(GetLastError(), std::system_category()), "could not open the journal");
+	}
+
+	LARGE_INTEGER size;
+	size.QuadPart = static_cast<LONGLONG>(keptSize);
+	if (!SetFilePointerEx(hFile, size, NULL, FILE_BEGIN) || !SetEndOfFile(hFile) || !FlushFileBuffers(hFile))
+	{
+		const DWORD error = GetLastError();
+		CloseHandle(hFile);
+		throw std::system_error(std::error_code(error, std::system_category()), "could not open the journal");
+	}
+
+	fileHandle = hFile;
+#else
+	const int fd = ::open(journalFile.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+	if (fd < 0) {
+		throw std::system_error(std::error_code(errno, std::system_category()), "could not open the journal");
+	}
+
+	if (::ftruncate(fd, static_cast<off_t>(keptSize)) < 0 || fdatasync(fd) < 0)
+	{
+		const int error = errno;
+		::close(fd);
+		throw std::system_error(std::error_code(error, std::system_category()), "could not open the journal");
+	}
+
+	fileHandle = reinterpret_cast<void*>(static_cast<intptr_t>(fd));
+#endif
+}
+
+PrepJournal::~PrepJournal()
+{
+#ifdef _WIN32
+	CloseHandle(fileHandle);
+#else
+	::close(static_cast<int>(reinterpret_cast<intptr_t>(fileHandle)));
+#endif
+}
+
+uint64_t PrepJournal::load(const std::filesystem::path& journalFile)
+{
+	std::ifstream stream(journalFile, std::ios::in | std::ios::binary);
+	if (stream.fail()) {
+		return 0;
+	}
+
+	std::unordered_set<std::string> loadedRecords;
+	uint64_t loadedSize = 0;
+	std::string line;
+	while (std::getline(stream, line))
+	{
+		if (stream.eof())
+		{
+			// the last record was not fully written
+			break;
+		}
+
+		loadedSize += line.size() + 1;
+		loadedRecords.insert(line);
+	}
+
+	if (loadedRecords.empty() || loadedRecords.count(makeRecord("phase", "complete")))
+	{
+		// nothing to resume
+		return 0;
+	}
+
+	records = std::move(loadedRecords);
+	resuming = true;
+
+	return loadedSize;
+}
+
+std::string PrepJournal::makeRecord(std::string_view kind, std::string_view name)
+{
+	std::string record;
+	record.reserve(kind.size() + name.size() + 1);
+	record += kind;
+	record += '\t';
+	record += name;
+
+	return record;
+}
+
+bool PrepJournal::isResuming() const
+{
+	return resuming;
+}
+
+bool PrepJournal::contains(std::string_view kind, std::string_view name) const
+{
+	std::lock_guard<std::mutex> lock(recordsMutex);
+	return records.count(makeRecord(kind, name)) != 0;
+}
+
+void PrepJournal::append(std::string_view kind, std::string_view name)
+{
+	std::string record = makeRecord(kind, name);
+
+	std::lock_guard<std::mutex> lock(recordsMutex);
+	pendingRecords += record;
+	pendingRecords += '\n';
+	records.insert(std::move(record));
+}
+
+void PrepJournal::commit()
+{
+	std::lock_guard<std::mutex> lock(recordsMutex);
+	if (pendingRecords.empty()) {
+		return;
+	}
+
+	// one write and one flush for all the pending records
+#ifdef _WIN32
+	DWORD bytesWritten = 0;
+	if (!WriteFile(fileHandle, pendingRecords.data(), static_cast<DWORD>(pendingRecords.size()), &bytesWritten, NULL) || !FlushFileBuffers(fileHandle)) {
+		throw std::system_error(std::error_code(GetLastError(), std::system_category()), "could not write the journal");
+	}
+#else
+	const int fd = static_cast<int>(reinterpret_cast<intptr_t>(fileHandle));
+	for (size_t offset = 0; offset < pendingRecords.size();)
+	{
+		const ssize_t written = ::write(fd, pendingRecords.data() + offset, pendingRecords.size() - offset);
+		if (written < 0)
+		{
+			if (errno == EINTR) {
+				continue;
+			}
+
+			throw std::system_error(std::error_code(errno, std::system_category()), "could not write the journal");
+		}
+
+		offset += written;
+	}
+
+	if (fdatasync(fd) < 0) {
+		throw std::system_error(std::error_code(errno, std::system_category()), "could not write the journal");
+	}
+#endif
+
+	pendingRecords.clear();
+}
+
+void PrepJournal::complete()
+{
+	append("phase", "complete");
+	commit();
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+
+/**
+ * Append-only record of the completed steps of a container preparation.
+ *
+ * Records are buffered and written together by commit(), which waits until they are on disk.
+ * A run that is interrupted before its last record resumes from the committed records.
+ */
+class PrepJournal
+{
+public:
+	/**
+	 * Opens the journal. Records of an interrupted run are kept in the file when resuming and new records
+	 * are appended to them, only a last record cut by the interruption is removed. Otherwise the journal starts over.
+	 */
+	PrepJournal(const std::filesystem::path& journalFile, bool resume);
+	~PrepJournal();
+
+	PrepJournal(const PrepJournal&) = delete;
+	PrepJournal& operator=(const PrepJournal&) = delete;
+
+	/**
+	 * Whether records of an interrupted run were loaded.
+	 */
+	bool isResuming() const;
+
+	bool contains(std::string_view kind, std::string_view name) const;
+
+	/**
+	 * Adds a record, written on the next commit.
+	 */
+	void append(std::string_view kind, std::string_view name);
+	void commit();
+
+	/**
+	 * Marks the preparation as complete, the next run starts over.
+	 */
+	void complete();
+
+private:
+	static std::string makeRecord(std::string_view kind, std::string_view name);
+	/**
+	 * Loads the records of an interrupted run, and returns the size of the complete records to keep.
+	 */
+	uint64_t load(const std::filesystem::path& journalFile);
+
+private:
+	void* fileHandle;
+	std::unordered_set<std::string> records;
+	std::string pendingRecords;
+	mutable std::mutex recordsMutex;
+	bool resuming;
+};
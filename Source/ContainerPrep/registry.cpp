@@ -1,12 +1,15 @@
 #include "registry.h"
 
+#include <system_error>
+
 using namespace Registry;
 
 IDataType* IDataType::head = nullptr;
 IDataType* IDataType::last = nullptr;
 
-IDataType::IDataType(const wchar_t* name)
+IDataType::IDataType(const wchar_t* name, uint32_t inRawType)
 	: typeName(name)
+	, rawType(inRawType)
 {
 	if (!head) head = this;
 	if (last) last->next = this;
@@ -23,11 +26,21 @@ IDataType::~IDataType()
 	if (last == this) last = prev;
 }
 
+const wchar_t* IDataType::getName() const
+{
+	return typeName;
+}
+
+uint32_t IDataType::getRawType() const
+{
+	return rawType;
+}
+
 const IDataType* IDataType::findDataType(const wchar_t* name)
 {
 	for (const IDataType* dt = head; dt; dt = dt->next)
 	{
-		if (!_wcsicmp(dt->typeName, name)) {
+		if (!compareNames(dt->typeName, name)) {
 			return dt;
 		}
 	}
@@ -35,6 +48,18 @@ const IDataType* IDataType::findDataType(const wchar_t* name)
 	return nullptr;
 }
 
+const IDataType* IDataType::findDataType(uint32_t rawType)
+{
+	for (const IDataType* dt = head; dt; dt = dt->next)
+	{
+		if (dt->rawType == rawType) {
+			return dt;
+		}
+	}
+
+	return &Types::Binary;
+}
+
 IValue::IValue()
 {
 }
@@ -115,36 +140,127 @@ void Data::QWordData::set(uint64_t intValue)
 
 void Helpers::copyKeysValues(IRegistryManager& registryManager, const IKey* sourceKey, const IKey* targetKey, size_t maxDepth)
 {
-	// copy values for the root key
-	IKeyManager& keyManager = registryManager.getKeyManager();
-	IValueManager& valueManager = registryManager.getValueManager();
+	copyKeysValues(registryManager, registryManager, sourceKey, targetKey, maxDepth);
+}
+
+/**
+ * Batch reused by the copies of a thread. The copies don't call each other while values are being set.
+ */
+static ValueBatch& getScratchBatch()
+{
+	thread_local ValueBatch batch;
+	return batch;
+}
+
+static void setValues(IValueManager& valueManager, const IKey* key, const ValueBatch& batch, const ICopyFilter* filter, const std::wstring& keyPath)
+{
+	for (size_t i = 0; i < batch.size(); ++i)
+	{
+		const ValueView value = batch[i];
+		if (!filter || filter->includeValue(keyPath, value.getValueName())) {
+			valueManager.setValue(key, value);
+		}
+	}
+}
 
-	copyValues(valueManager, sourceKey, targetKey);
+void Helpers::copyKeysValues(IRegistryManager& sourceRegistry, IRegistryManager& targetRegistry, const IKey* sourceKey, const IKey* targetKey, size_t maxDepth)
+{
+	copyTree(sourceRegistry, targetRegistry, sourceKey, targetKey, nullptr, maxDepth);
+}
 
-	keyManager.visitKeys(sourceKey, [&registryManager, &keyManager, targetKey](const IKey* parentKey, const wchar_t* keyName) -> bool
+void Helpers::copyTree(IKeyManager& sourceKeyManager, IValueManager& sourceValueManager, IKeyManager& targetKeyManager, IValueManager& targetValueManager, const IKey* sourceKey, const IKey* targetKey, const ICopyFilter* filter, size_t maxDepth)
+{
+	// a subkey to copy, opened when it is reached so that only the parents of pending keys are open
+	struct PendingKey
+	{
+		IKeyPtr sourceParent;
+		IKeyPtr targetParent;
+		std::wstring name;
+		std::wstring path;
+		size_t depth;
+	};
+
+	std::vector<PendingKey> pendingKeys;
+	std::vector<std::wstring> subKeyNames;
+	ValueBatch& batch = getScratchBatch();
+
+	const auto copyKey = [&](const IKeyPtr& source, const IKeyPtr& target, const std::wstring& path, size_t depth)
 		{
-			try
-			{
-				const IKeyPtr subSourceKey = keyManager.getKey(keyName, Permission::Read, parentKey);
-				const IKeyPtr subTargetKey = keyManager.getOrCreateKey(keyName, Permission::Write, targetKey);
+			sourceValueManager.readKeyValues(source.get(), batch);
+			setValues(targetValueManager, target.get(), batch, filter, path);
 
-				copyKeysValues(registryManager, subSourceKey.get(), subTargetKey.get());
+			if (depth > maxDepth) {
+				return;
 			}
-			catch (const std::exception&)
+
+			// the source is a malformed hive whose keys loop
+			if (depth >= MaxKeyDepth) {
+				throw std::system_error(std::make_error_code(std::errc::bad_message), "registry keys are nested too deep");
+			}
+
+			subKeyNames.clear();
+			sourceKeyManager.visitKeys(source.get(), [&](const IKey* parentKey, const wchar_t* keyName) -> bool
+				{
+					subKeyNames.emplace_back(keyName);
+					return true;
+				}, 0);
+
+			// pushed in reverse, subkeys are copied in their order
+			for (auto it = subKeyNames.rbegin(); it != subKeyNames.rend(); ++it)
 			{
+				std::wstring subKeyPath = path.empty() ? *it : path + L'\\' + *it;
+				if (!filter || filter->includeKey(subKeyPath)) {
+					pendingKeys.push_back({ source, target, std::move(*it), std::move(subKeyPath), depth + 1 });
+				}
 			}
+		};
+
+	// the caller owns the keys to copy
+	copyKey(IKeyPtr(IKeyPtr(), const_cast<IKey*>(sourceKey)), IKeyPtr(IKeyPtr(), const_cast<IKey*>(targetKey)), std::wstring(), 0);
+
+	while (!pendingKeys.empty())
+	{
+		PendingKey pendingKey = std::move(pendingKeys.back());
+		pendingKeys.pop_back();
+
+		IKeyPtr subSourceKey;
+		IKeyPtr subTargetKey;
+		try
+		{
+			subSourceKey = sourceKeyManager.getKey(pendingKey.name.c_str(), Permission::Read, pendingKey.sourceParent.get());
+			subTargetKey = targetKeyManager.getOrCreateKey(pendingKey.name.c_str(), Permission::Write, pendingKey.targetParent.get());
+		}
+		catch (const std::exception&)
+		{
+			continue;
+		}
 
-			return true;
-		}, 0);
+		copyKey(subSourceKey, subTargetKey, pendingKey.path, pendingKey.depth);
+	}
 }
 
-void Helpers::copyValues(IValueManager& valueManager, const IKey* sourceKey, const IKey* targetKey)
+void Helpers::copyTree(IRegistryManager& sourceRegistry, IRegistryManager& targetRegistry, const IKey* sourceKey, const IKey* targetKey, const ICopyFilter* filter, size_t maxDepth)
 {
-	valueManager.visitKeyValues(sourceKey, [&valueManager, targetKey](const IValue& value) -> bool
-		{
-			// set the same value to the target key
-			valueManager.setValue(targetKey, value);
+	if (&sourceRegistry == &targetRegistry)
+	{
+		// the backend copies between its own keys
+		targetRegistry.getKeyManager().copyTree(sourceKey, targetKey, filter, maxDepth);
+		return;
+	}
 
-			return true;
-		});
+	copyTree(sourceRegistry.getKeyManager(), sourceRegistry.getValueManager(), targetRegistry.getKeyManager(), targetRegistry.getValueManager(), sourceKey, targetKey, filter, maxDepth);
 }
+
+void Helpers::copyValues(IValueManager& valueManager, const IKey* sourceKey, const IKey* targetKey)
+{
+	copyValues(valueManager, valueManager, sourceKey, targetKey);
+}
+
+void Helpers::copyValues(IValueManager& sourceValueManager, IValueManager& targetValueManager, const IKey* sourceKey, const IKey* targetKey)
+{
+	ValueBatch& batch = getScratchBatch();
+	sourceValueManager.readKeyValues(sourceKey, batch);
+
+	// set the same values to the target key
+	setValues(targetValueManager, targetKey, batch, nullptr, std::wstring());
+}
\ No newline at end of file
@@ -2,10 +2,13 @@
 
 #include "registry_data.h"
 #include "registry_hive.h"
+#include "registry_value_batch.h"
 
+#include <cstdint>
 #include <span>
 #include <vector>
 #include <string>
+#include <string_view>
 #include <memory>
 #include <functional>
 
@@ -34,6 +37,36 @@ namespace Registry
 		virtual bool operator()(const IValue& value) const = 0;
 	};
 
+	/**
+	 * Selects the keys and values copied by copyTree.
+	 * Key paths are relative to the copied key, the copied key itself has an empty path.
+	 */
+	class ICopyFilter
+	{
+	public:
+		virtual ~ICopyFilter() = default;
+
+		virtual bool includeKey(const std::wstring_view& keyPath) const = 0;
+		virtual bool includeValue(const std::wstring_view& keyPath, const std::wstring_view& valueName) const = 0;
+	};
+
+	/**
+	 * Information of a key, read without enumerating its subkeys and values.
+	 */
+	struct KeyInfo
+	{
+		size_t subKeyCount = 0;
+		size_t valueCount = 0;
+
+		/** Time of the last change to the values or subkeys of the key, as a FILETIME. 0 if the registry doesn't keep it. */
+		uint64_t lastWriteTime = 0;
+	};
+
+	/**
+	 * Levels of subkeys Windows allows below a key. Keys read deeper than this from a hive file are a loop of its cells.
+	 */
+	constexpr size_t MaxKeyDepth = 512;
+
 	using KeyVisitor = std::function<bool(const IKey* parentKey, const wchar_t* subKeyName)>;
 	using ValueVisitor = std::function<bool(const IValue& value)>;
 
@@ -52,10 +85,31 @@ namespace Registry
 		 */
 		virtual IKeyPtr getOrCreateKey(const wchar_t* keyName, Permission permissions, const IKey* parentKey = nullptr) = 0;
 
+		/**
+		 * Retrieves a predefined root key (HKLM, HKU...), nullptr if the registry doesn't have it.
+		 */
+		virtual IKeyPtr getPredefinedKey(const wchar_t* rootName) = 0;
+
 		/**
 		 * Enumerate keys and subkeys.
 		 */
-		virtual bool visitKeys(const IKey* key, const KeyVisitor& visitor, size_t maxDepth = ~0) = 0;
+		virtual bool visitKeys(const IKey* key, const KeyVisitor& visitor, size_t maxDepth = SIZE_MAX) = 0;
+
+		/**
+		 * Copies the values and subkeys of a key to another key of the same registry, down to maxDepth levels of subkeys
+		 * as visitKeys does. Subkeys that can't be opened are skipped.
+		 */
+		virtual void copyTree(const IKey* sourceKey, const IKey* targetKey, const ICopyFilter* filter = nullptr, size_t maxDepth = SIZE_MAX) = 0;
+
+		/**
+		 * Reads the subkey and value counts and the last write time of a key.
+		 */
+		virtual KeyInfo queryKeyInfo(const IKey* key) = 0;
+
+		/**
+		 * Deletes a subkey with its subkeys and values. Keys open below it must not be used afterwards.
+		 */
+		virtual void deleteKey(const IKey* parentKey, const wchar_t* subKeyName) = 0;
 	};
 
 	class IValueManager
@@ -82,6 +136,11 @@ namespace Registry
 		 * Enumerate all values of a key.
 		 */
 		virtual bool visitKeyValues(const IKey* key, const ValueVisitor& visitor) = 0;
+
+		/**
+		 * Reads all values of a key in a batch, replacing its content.
+		 */
+		virtual void readKeyValues(const IKey* key, ValueBatch& batch) = 0;
 	};
 
 	class IRegistryManager
@@ -101,15 +160,58 @@ namespace Registry
 
 	namespace Helpers
 	{
+		/**
+		 * Calls func with each non-empty component of a backslash-separated key path.
+		 */
+		template<typename Func>
+		void forEachPathComponent(const std::wstring_view& path, Func&& func)
+		{
+			size_t start = 0;
+			while (start <= path.size())
+			{
+				size_t end = path.find(L'\\', start);
+				if (end == std::wstring_view::npos) {
+					end = path.size();
+				}
+
+				if (end > start) {
+					func(path.substr(start, end - start));
+				}
+
+				start = end + 1;
+			}
+		}
+
+		/**
+		 * Copies a tree through the registry interfaces, between any registries.
+		 * The traversal keeps its pending keys on the heap, deep trees don't grow the stack.
+		 */
+		void copyTree(IKeyManager& sourceKeyManager, IValueManager& sourceValueManager, IKeyManager& targetKeyManager, IValueManager& targetValueManager, const IKey* sourceKey, const IKey* targetKey, const ICopyFilter* filter = nullptr, size_t maxDepth = SIZE_MAX);
+
+		/**
+		 * Copies a tree between registries, with the native copy of the backend within a registry.
+		 */
+		void copyTree(IRegistryManager& sourceRegistry, IRegistryManager& targetRegistry, const IKey* sourceKey, const IKey* targetKey, const ICopyFilter* filter = nullptr, size_t maxDepth = SIZE_MAX);
+
 		/**
 		 * Copy keys and values from source to target key
 		 */
-		void copyKeysValues(IRegistryManager& registryManager, const IKey* sourceKey, const IKey* targetKey, size_t maxDepth = ~0ul);
+		void copyKeysValues(IRegistryManager& registryManager, const IKey* sourceKey, const IKey* targetKey, size_t maxDepth = SIZE_MAX);
+
+		/**
+		 * Copy keys and values from a source key to a target key of another registry
+		 */
+		void copyKeysValues(IRegistryManager& sourceRegistry, IRegistryManager& targetRegistry, const IKey* sourceKey, const IKey* targetKey, size_t maxDepth = SIZE_MAX);
 		
 		/**
 		 * Copy values from source key to target key
 		 */
 		void copyValues(IValueManager& valueManager, const IKey* sourceKey, const IKey* targetKey);
+
+		/**
+		 * Copy values from a source key to a target key of another registry
+		 */
+		void copyValues(IValueManager& sourceValueManager, IValueManager& targetValueManager, const IKey* sourceKey, const IKey* targetKey);
 	}
 
 	namespace Data
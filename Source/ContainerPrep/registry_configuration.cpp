@@ -1,20 +1,41 @@
 #include "registry_configuration.h"
-#include "registry_windows_platform.h"
+#include "registry_fingerprint.h"
 
 #include <set>
 #include <fstream>
+#include <optional>
+#include <stdexcept>
 
 using namespace Registry;
 
 Config::KeyParser keyParser;
 Config::HiveParser hiveParser;
 
+/**
+ * Rethrows the current exception with the part of the configuration it comes from. Cancellations are rethrown as they are.
+ */
+[[noreturn]] static void rethrowWithContext(const std::string& context)
+{
+	try
+	{
+		throw;
+	}
+	catch (const TaskCancelled&)
+	{
+		throw;
+	}
+	catch (const std::exception& e)
+	{
+		throw std::runtime_error(context + ": " + e.what());
+	}
+}
+
 Config::IndividualConfigReader::IndividualConfigReader(std::istream& inReader)
 	: reader(inReader)
 {
 }
 
-void Config::IndividualConfigReader::parse(const IHiveVisitorPtr& hiveVisitor)
+void Config::IndividualConfigReader::parse(const IHiveVisitorPtr& hiveVisitor, const CancellationToken* cancellation)
 {
 	IKeyVisitorPtr keyVisitor;
 
@@ -26,28 +47,37 @@ void Config::IndividualConfigReader::parse(const IHiveVisitorPtr& hiveVisitor)
 	const char* hiveNameA = hiveNode.attribute("Name").value();
 	std::wstring hiveName(hiveNameA, hiveNameA + std::strlen(hiveNameA));
 
-	pugi::xml_attribute rootAttr = hiveNode.attribute("HostRoot");
-	pugi::xml_attribute pathAttr = hiveNode.attribute("HostPath");
-	if (!rootAttr.empty() && !pathAttr.empty())
+	try
 	{
-		const char* rootAttrA = rootAttr.value();
-		const char* pathAttrA = pathAttr.value();
-		std::wstring rootAttrStr(rootAttrA, rootAttrA + std::strlen(rootAttrA));
-		std::wstring pathAttrStr(pathAttrA, pathAttrA + std::strlen(pathAttrA));
+		pugi::xml_attribute rootAttr = hiveNode.attribute("HostRoot");
+		pugi::xml_attribute pathAttr = hiveNode.attribute("HostPath");
+		if (!rootAttr.empty() && !pathAttr.empty())
+		{
+			const char* rootAttrA = rootAttr.value();
+			const char* pathAttrA = pathAttr.value();
+			std::wstring rootAttrStr(rootAttrA, rootAttrA + std::strlen(rootAttrA));
+			std::wstring pathAttrStr(pathAttrA, pathAttrA + std::strlen(pathAttrA));
 
-		keyVisitor = hiveVisitor->visit(Hive(hiveName, rootAttrStr, pathAttrStr));
+			keyVisitor = hiveVisitor->visit(Hive(hiveName, rootAttrStr, pathAttrStr));
+		}
+		else
+		{
+			keyVisitor = hiveVisitor->visit(Hive(hiveName));
+		}
+
+		hiveParser.parse(keyVisitor, hiveNode, cancellation);
+		keyVisitor->finish();
 	}
-	else
+	catch (...)
 	{
-		keyVisitor = hiveVisitor->visit(Hive(hiveName));
+		rethrowWithContext(std::string("hive ") + hiveNameA);
 	}
-
-	hiveParser.parse(keyVisitor, hiveNode);
 }
 
-Config::HivesConfigReader::HivesConfigReader(std::istream& inReader, const std::filesystem::path& inWorkingDir)
+Config::HivesConfigReader::HivesConfigReader(std::istream& inReader, const std::filesystem::path& inWorkingDir, ThreadPool* inPool)
 	: reader(inReader)
 	, workingDir(inWorkingDir)
+	, pool(inPool)
 {
 }
 
@@ -56,6 +86,24 @@ void Config::HivesConfigReader::parse(const IHiveVisitorPtr& visitor)
 	pugi::xml_document doc;
 	pugi::xml_parse_result result = doc.load(reader);
 
+	const auto parseHive = [this, &visitor](const std::wstring& targetPath, const CancellationToken* cancellation)
+		{
+			const std::filesystem::path path = workingDir / targetPath;
+
+			std::ifstream fileStream(path, std::ios::in | std::ios::binary);
+			if (!fileStream.fail())
+			{
+				IndividualConfigReader config(fileStream);
+				config.parse(visitor, cancellation);
+			}
+		};
+
+	// hives are separate files, each one is built and written by its own task
+	std::optional<TaskGroup> hives;
+	if (pool) {
+		hives.emplace(*pool);
+	}
+
 	pugi::xml_node rootNode = doc.child("Hives");
 	for (pugi::xml_node::iterator subNode = rootNode.begin(); subNode != rootNode.end(); subNode++)
 	{
@@ -63,18 +111,24 @@ void Config::HivesConfigReader::parse(const IHiveVisitorPtr& visitor)
 		{
 			pugi::xml_attribute targetAttr = subNode->attribute("Target");
 			const char* targetAttrA = targetAttr.value();
-			const std::wstring targetPath(targetAttrA, targetAttrA + std::strlen(targetAttrA));
-
-			const std::filesystem::path path = workingDir / targetPath;
+			std::wstring targetPath(targetAttrA, targetAttrA + std::strlen(targetAttrA));
 
-			std::ifstream fileStream(path, std::ios::in | std::ios::binary);
-			if (!fileStream.fail())
+			if (hives)
 			{
-				IndividualConfigReader config(fileStream);
-				config.parse(visitor);
+				hives->run(targetAttrA, [&parseHive, targetPath = std::move(targetPath)](const CancellationToken& token)
+					{
+						parseHive(targetPath, &token);
+					});
+			}
+			else {
+				parseHive(targetPath, nullptr);
 			}
 		}
 	}
+
+	if (hives) {
+		hives->wait();
+	}
 }
 
 Config::Hive::Hive(const std::wstring_view& hiveName, const std::wstring_view& hostRootName, const std::wstring_view& hostHiveName)
@@ -100,8 +154,9 @@ const std::wstring& Config::Hive::getRootHiveName() const
 	return rootHive;
 }
 
-Config::Key::Key(const std::wstring& keyPath)
+Config::Key::Key(const std::wstring& keyPath, uint64_t inConfigHash)
 	: path(keyPath)
+	, configHash(inConfigHash)
 {
 
 }
@@ -111,9 +166,16 @@ const std::wstring& Config::Key::getPath() const
 	return path;
 }
 
-Config::HostKey::HostKey(const std::wstring_view& hostPath, const std::wstring_view& targetPath)
+uint64_t Config::Key::getConfigHash() const
+{
+	return configHash;
+}
+
+Config::HostKey::HostKey(const std::wstring_view& hostPath, const std::wstring_view& targetPath, uint64_t inConfigHash, const HostKeyFilterPtr& inFilter)
 	: sourcePath(hostPath)
 	, targetPath(targetPath)
+	, configHash(inConfigHash)
+	, filter(inFilter)
 {
 
 }
@@ -128,6 +190,16 @@ const std::wstring& Config::HostKey::getTargetPath() const
 	return targetPath.empty() ? sourcePath : targetPath;
 }
 
+uint64_t Config::HostKey::getConfigHash() const
+{
+	return configHash;
+}
+
+const Config::HostKeyFilterPtr& Config::HostKey::getFilter() const
+{
+	return filter;
+}
+
 Config::HostValue::HostValue(const std::wstring_view& valueName, const std::wstring_view& targetValueName)
 	: name(valueName)
 	, targetName(targetValueName)
@@ -168,49 +240,147 @@ std::span<const unsigned char> Config::Value::getData() const
 	return std::span<const unsigned char>(data.begin(), data.end());
 }
 
-void Config::HiveParser::parse(const IKeyVisitorPtr& keyVisitor, const pugi::xml_node& node)
+static void hashNode(Fingerprint& fingerprint, const pugi::xml_node& node)
 {
-	IValueVisitorPtr valueVisitor;
+	fingerprint.add(std::string_view(node.name()));
+	for (pugi::xml_attribute attribute = node.first_attribute(); attribute; attribute = attribute.next_attribute())
+	{
+		fingerprint.add(std::string_view(attribute.name()));
+		fingerprint.add(std::string_view(attribute.value()));
+	}
+
+	for (pugi::xml_node::iterator subNode = node.begin(); subNode != node.end(); subNode++) {
+		hashNode(fingerprint, *subNode);
+	}
+}
+
+/**
+ * Returns the hash of a node with its attributes and subnodes.
+ */
+static uint64_t hashNode(const pugi::xml_node& node)
+{
+	Fingerprint fingerprint;
+	hashNode(fingerprint, node);
+	return fingerprint.get();
+}
+
+static Config::Key readKey(const pugi::xml_node& node)
+{
+	pugi::xml_attribute pathAttribute = node.attribute("Path");
+	const char* pathAttributeA = pathAttribute.value();
+	if (*pathAttributeA == '\\' || *pathAttributeA == '/') pathAttributeA++;
+
+	return Config::Key(std::wstring(pathAttributeA, pathAttributeA + std::strlen(pathAttributeA)), hashNode(node));
+}
+
+/**
+ * Reads the filter of a host key from its MaxDepth attribute and its Include, Exclude, IncludeValue and ExcludeValue nodes.
+ * Returns null if it has none.
+ */
+static Config::HostKeyFilterPtr readHostKeyFilter(const pugi::xml_node& node)
+{
+	std::shared_ptr<Config::HostKeyFilter> filter;
+	const auto getFilter = [&filter]() -> Config::HostKeyFilter&
+		{
+			if (!filter) {
+				filter = std::make_shared<Config::HostKeyFilter>();
+			}
+
+			return *filter;
+		};
+
+	const auto readAttribute = [](const pugi::xml_node& subNode, const char* name)
+		{
+			const char* attributeA = subNode.attribute(name).value();
+			return std::wstring(attributeA, attributeA + std::strlen(attributeA));
+		};
+
+	pugi::xml_attribute maxDepthAttribute = node.attribute("MaxDepth");
+	if (!maxDepthAttribute.empty()) {
+		getFilter().setMaxLevels(Config::HostKeyFilter::parseMaxLevels(maxDepthAttribute.value()));
+	}
 
 	for (pugi::xml_node::iterator subNode = node.begin(); subNode != node.end(); subNode++)
 	{
-		if (!std::strcmp(subNode->name(), "Key"))
-		{
-			pugi::xml_attribute pathAttribute = subNode->attribute("Path");
-			const char* pathAttributeA = pathAttribute.value();
-			if (*pathAttributeA == '\\' || *pathAttributeA == '/') pathAttributeA++;
+		if (!std::strcmp(subNode->name(), "Include")) {
+			getFilter().addInclude(readAttribute(*subNode, "Path"));
+		}
+		else if (!std::strcmp(subNode->name(), "Exclude")) {
+			getFilter().addExclude(readAttribute(*subNode, "Path"));
+		}
+		else if (!std::strcmp(subNode->name(), "IncludeValue")) {
+			getFilter().addIncludeValue(readAttribute(*subNode, "Name"));
+		}
+		else if (!std::strcmp(subNode->name(), "ExcludeValue")) {
+			getFilter().addExcludeValue(readAttribute(*subNode, "Name"));
+		}
+	}
 
-			Key key(std::wstring(pathAttributeA, pathAttributeA + std::strlen(pathAttributeA)));
-			valueVisitor = keyVisitor->visit(key);
+	return filter;
+}
+
+static Config::HostKey readHostKey(const pugi::xml_node& node)
+{
+	pugi::xml_attribute pathAttribute = node.attribute("Path");
+	const char* pathAttributeA = pathAttribute.value();
+	if (*pathAttributeA == '\\' || *pathAttributeA == '/') pathAttributeA++;
 
-			keyParser.parse(valueVisitor, *subNode);
+	pugi::xml_attribute targetPathAttribute = node.attribute("TargetPath");
+
+	if (targetPathAttribute.empty())
+	{
+		return Config::HostKey(std::wstring(pathAttributeA, pathAttributeA + strlen(pathAttributeA)), {}, hashNode(node), readHostKeyFilter(node));
+	}
+
+	const char* targetPathAttributeA = targetPathAttribute.value();
+	if (*targetPathAttributeA == '\\' || *targetPathAttributeA == '/') targetPathAttributeA++;
+	return Config::HostKey(
+		std::wstring(pathAttributeA, pathAttributeA + std::strlen(pathAttributeA)),
+		std::wstring(targetPathAttributeA, targetPathAttributeA + std::strlen(targetPathAttributeA)),
+		hashNode(node),
+		readHostKeyFilter(node)
+	);
+}
+
+void Config::HiveParser::parse(const IKeyVisitorPtr& keyVisitor, const pugi::xml_node& node, const CancellationToken* cancellation)
+{
+	IValueVisitorPtr valueVisitor;
+
+	// host keys can be read ahead while the previous keys are written, and unchanged keys skipped
+	for (pugi::xml_node::iterator subNode = node.begin(); subNode != node.end(); subNode++)
+	{
+		if (!std::strcmp(subNode->name(), "Key")) {
+			keyVisitor->prepare(readKey(*subNode));
 		}
-		else if (!std::strcmp(subNode->name(), "HostKey"))
-		{
-			pugi::xml_attribute pathAttribute = subNode->attribute("Path");
-			const char* pathAttributeA = pathAttribute.value();
-			if (*pathAttributeA == '\\' || *pathAttributeA == '/') pathAttributeA++;
+		else if (!std::strcmp(subNode->name(), "HostKey")) {
+			keyVisitor->prepare(readHostKey(*subNode));
+		}
+	}
 
-			pugi::xml_attribute targetPathAttribute = subNode->attribute("TargetPath");
+	for (pugi::xml_node::iterator subNode = node.begin(); subNode != node.end(); subNode++)
+	{
+		if (cancellation) {
+			cancellation->check();
+		}
 
-			if (targetPathAttribute.empty())
+		try
+		{
+			if (!std::strcmp(subNode->name(), "Key"))
 			{
-				HostKey hostKey(std::wstring(pathAttributeA, pathAttributeA + strlen(pathAttributeA)));
-				valueVisitor = keyVisitor->visit(hostKey);
+				valueVisitor = keyVisitor->visit(readKey(*subNode));
+
+				keyParser.parse(valueVisitor, *subNode);
 			}
-			else
+			else if (!std::strcmp(subNode->name(), "HostKey"))
 			{
-				const char* targetPathAttributeA = targetPathAttribute.value();
-				if (*targetPathAttributeA == '\\' || *targetPathAttributeA == '/') targetPathAttributeA++;
-				HostKey hostKey(
-					std::wstring(pathAttributeA, pathAttributeA + std::strlen(pathAttributeA)),
-					std::wstring(targetPathAttributeA, targetPathAttributeA + std::strlen(targetPathAttributeA))
-				);
+				valueVisitor = keyVisitor->visit(readHostKey(*subNode));
 
-				valueVisitor = keyVisitor->visit(hostKey);
+				keyParser.parse(valueVisitor, *subNode);
 			}
-
-			keyParser.parse(valueVisitor, *subNode);
+		}
+		catch (...)
+		{
+			rethrowWithContext(std::string(subNode->name()) + ' ' + subNode->attribute("Path").value());
 		}
 	}
 }
@@ -257,36 +427,37 @@ void Config::KeyParser::parse(const IValueVisitorPtr& valueVisitor, const pugi::
 
 			pugi::xml_attribute dataAttr = subNode->attribute("Data");
 			const char* dataAttrA = dataAttr.value();
-			std::wstring strData;
+			// strings are stored as UTF-16 in hives, whatever the size of wchar_t
+			std::u16string strData;
 			union {
 				uint32_t dwordData;
 				uint64_t qwordData;
 			};
 			std::span<const unsigned char> data;
 
-			if (dt == &Platform::Host::StringDataType
-				|| dt == &Platform::Host::MultiStringDataType
-				|| dt == &Platform::Host::ExpandableStringDataType)
+			if (dt == &Types::String
+				|| dt == &Types::MultiString
+				|| dt == &Types::ExpandableString)
 			{
-				strData = std::wstring(dataAttrA, dataAttrA + std::strlen(dataAttrA));
+				strData = std::u16string(dataAttrA, dataAttrA + std::strlen(dataAttrA));
 				data = std::span<const unsigned char>(
 					(const unsigned char*)strData.c_str(),
 					(const unsigned char*)(strData.c_str() + strData.length() + 1)
 				);
 			}
-			else if (dt == &Platform::Host::DWordDataType)
+			else if (dt == &Types::DWord)
 			{
 				dwordData = std::stoi(dataAttrA);
 				data = std::span<const unsigned char>((const unsigned char*)&dwordData, sizeof(dwordData));
 			}
-			else if (dt == &Platform::Host::QWordDataType)
+			else if (dt == &Types::QWord)
 			{
 				qwordData = std::stoi(dataAttrA);
 				data = std::span<const unsigned char>((const unsigned char*)&qwordData, sizeof(qwordData));
 			}
 			else
 			{
-				strData = std::wstring(dataAttrA, dataAttrA + std::strlen(dataAttrA));
+				strData = std::u16string(dataAttrA, dataAttrA + std::strlen(dataAttrA));
 				data = std::span<const unsigned char>(
 					(const unsigned char*)strData.c_str(),
 					(const unsigned char*)(strData.c_str() + strData.length() + 1)
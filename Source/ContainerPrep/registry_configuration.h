@@ -2,8 +2,13 @@
 
 #include "configurator.h"
 #include "registry.h"
+#include "registry_host_key_filter.h"
+#include "task_group.h"
 
 #include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
 
 #include <pugixml.hpp>
 
@@ -31,25 +36,43 @@ namespace Registry
 		class Key
 		{
 		public:
-			Key(const std::wstring& keyPath);
+			Key(const std::wstring& keyPath, uint64_t inConfigHash = 0);
 
 			const std::wstring& getPath() const;
 
+			/**
+			 * Hash of the configuration of the key and its values.
+			 */
+			uint64_t getConfigHash() const;
+
 		private:
 			std::wstring path;
+			uint64_t configHash;
 		};
 
 		class HostKey
 		{
 		public:
-			HostKey(const std::wstring_view& keyPath, const std::wstring_view& targetPath = {});
+			HostKey(const std::wstring_view& keyPath, const std::wstring_view& targetPath = {}, uint64_t inConfigHash = 0, const HostKeyFilterPtr& inFilter = nullptr);
 
 			const std::wstring& getHostPath() const;
 			const std::wstring& getTargetPath() const;
 
+			/**
+			 * Null if the whole host key is copied.
+			 */
+			const HostKeyFilterPtr& getFilter() const;
+
+			/**
+			 * Hash of the configuration of the host key and its values.
+			 */
+			uint64_t getConfigHash() const;
+
 		private:
 			std::wstring sourcePath;
 			std::wstring targetPath;
+			uint64_t configHash;
+			HostKeyFilterPtr filter;
 		};
 
 		class HostValue
@@ -95,8 +118,19 @@ namespace Registry
 		public:
 			virtual ~IKeyVisitor() = default;
 
+			/**
+			 * Called for every key and host key of the hive before the keys are visited, in the order they are visited.
+			 */
+			virtual void prepare(const HostKey& hostKey) = 0;
+			virtual void prepare(const Key& key) = 0;
+
 			virtual IValueVisitorPtr visit(const HostKey& hostKey) = 0;
 			virtual IValueVisitorPtr visit(const Key& key) = 0;
+
+			/**
+			 * Called once all the keys of the hive are visited.
+			 */
+			virtual void finish() = 0;
 		};
 		using IKeyVisitorPtr = std::shared_ptr<IKeyVisitor>;
 
@@ -124,7 +158,10 @@ namespace Registry
 		class HiveParser
 		{
 		public:
-			void parse(const IKeyVisitorPtr& keyVisitor, const pugi::xml_node& node);
+			/**
+			 * Errors are rethrown with the key they come from. If a cancellation token is specified, it is checked before each key.
+			 */
+			void parse(const IKeyVisitorPtr& keyVisitor, const pugi::xml_node& node, const CancellationToken* cancellation = nullptr);
 		};
 
 		class IndividualConfigReader
@@ -132,7 +169,10 @@ namespace Registry
 		public:
 			IndividualConfigReader(std::istream& inReader);
 
-			void parse(const IHiveVisitorPtr& visitor);
+			/**
+			 * Errors are rethrown with the hive they come from.
+			 */
+			void parse(const IHiveVisitorPtr& visitor, const CancellationToken* cancellation = nullptr);
 
 		private:
 			std::istream& reader;
@@ -141,13 +181,17 @@ namespace Registry
 		class HivesConfigReader
 		{
 		public:
-			HivesConfigReader(std::istream& inReader, const std::filesystem::path& inWorkingDir);
+			/**
+			 * If a pool is specified, the hives are built concurrently, the first failure stops the other hives.
+			 */
+			HivesConfigReader(std::istream& inReader, const std::filesystem::path& inWorkingDir, ThreadPool* inPool = nullptr);
 
 			void parse(const IHiveVisitorPtr& visitor);
 
 		private:
 			std::istream& reader;
 			std::filesystem::path workingDir;
+			ThreadPool* pool;
 		};
 	}
 }
@@ -1,22 +1,47 @@
 #include "registry_configuration_visitor.h"
-#include "registry_windows_platform.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <system_error>
 
 using namespace Registry;
 
-HiveConfigVisitor::HiveConfigVisitor(IRegistryManager& inRegistryManager, const std::filesystem::path& inWorkingDir, const std::wstring_view& hivePostfix)
-	: registryManager(inRegistryManager)
-	, workingDir(inWorkingDir)
+void HostKeyReport::add(HostKeyTiming&& timing)
+{
+	std::lock_guard<std::mutex> lock(timingsMutex);
+	timings.push_back(std::move(timing));
+}
+
+std::vector<HostKeyTiming> HostKeyReport::getTimings() const
+{
+	std::lock_guard<std::mutex> lock(timingsMutex);
+	return timings;
+}
+
+HiveConfigVisitor::HiveConfigVisitor(IRegistryManager& inHostRegistry, IRegistryManager& inTargetRegistry, const std::filesystem::path& inWorkingDir, const std::wstring_view& hivePostfix, const CancellationToken* inCancellation, ThreadPool* inPool, HostKeyReport* inReport, bool bInRebuild, HiveCache* inCache)
+	: workingDir(inWorkingDir)
 	, postfix(hivePostfix)
+	, hostRegistry(inHostRegistry)
+	, targetRegistry(inTargetRegistry)
+	, cancellation(inCancellation)
+	, pool(inPool)
+	, report(inReport)
+	, cache(inCache)
+	, bRebuild(bInRebuild)
 {
 }
 
 Registry::Config::IKeyVisitorPtr HiveConfigVisitor::visit(const Config::Hive& hive)
 {
-	const IKeyPtr predefinedKey = Platform::Windows::PredefinedKeys::findByName(hive.getRootName().c_str());
+	if (cancellation) {
+		cancellation->check();
+	}
+
+	const IKeyPtr predefinedKey = hostRegistry.getKeyManager().getPredefinedKey(hive.getRootName().c_str());
 	IKeyPtr hostSourceKey;
 	try
 	{
-		hostSourceKey = registryManager.getKeyManager().getKey(hive.getRootHiveName().c_str(), Permission::Read, predefinedKey.get());
+		hostSourceKey = hostRegistry.getKeyManager().getKey(hive.getRootHiveName().c_str(), Permission::Read, predefinedKey.get());
 	}
 	catch (const std::exception&) {
 	}
@@ -29,75 +54,397 @@ Registry::Config::IKeyVisitorPtr HiveConfigVisitor::visit(const Config::Hive& hi
 		hiveFilename = workingDir / hive.getName();
 	}
 
-	IHivePtr hivePtr = registryManager.getHiveManager().createHive(hiveFilename);
-	return std::make_shared<KeyConfigVisitor>(registryManager, hivePtr, hostSourceKey);
+	return std::make_shared<KeyConfigVisitor>(hostRegistry, targetRegistry, hiveFilename, hostSourceKey, bRebuild, cancellation, pool, report, cache);
 }
 
-KeyConfigVisitor::KeyConfigVisitor(IRegistryManager& inRegistryManager, const IHivePtr& inHive, const IKeyPtr& inHostHive)
-	: registryManager(inRegistryManager)
-	, hive(inHive)
+void SkippedValueConfigVisitor::visit(const Config::Value& value)
+{
+}
+
+void SkippedValueConfigVisitor::visit(const Config::HostValue& hostValue)
+{
+}
+
+KeyConfigVisitor::KeyConfigVisitor(IRegistryManager& inHostRegistry, IRegistryManager& inTargetRegistry, const std::filesystem::path& inHiveFileName, const IKeyPtr& inHostHive, bool bInRebuild, const CancellationToken* inCancellation, ThreadPool* inPool, HostKeyReport* inReport, HiveCache* inCache)
+	: hiveFileName(inHiveFileName)
 	, hostHive(inHostHive)
+	, hostRegistry(inHostRegistry)
+	, targetRegistry(inTargetRegistry)
+	, cancellation(inCancellation)
+	, pool(inPool)
+	, report(inReport)
+	, cache(inCache)
+	, visitedRuleCount(0)
+	, cacheKey(0)
+	, bRebuild(bInRebuild)
+	, bHiveOpened(false)
+	, hostKeys(inHostRegistry.getKeyManager(), inHostHive, Permission::Read, false)
 {
 }
 
-Registry::Config::IValueVisitorPtr KeyConfigVisitor::visit(const Config::HostKey& hostKey)
+KeyConfigVisitor::~KeyConfigVisitor()
 {
-	IKeyManager& keyManager = registryManager.getKeyManager();
-	IKeyPtr sourceKey = keyManager.getKey(hostKey.getHostPath().c_str(), Permission::Read, hostHive.get());
-	IKeyPtr targetKey = keyManager.getOrCreateKey(hostKey.getTargetPath().c_str(), Permission::All, hive->getRootKey().get());
+	// the reads use the host registry, they must not outlive the visitor
+	for (const std::future<HostSnapshot>& pendingSnapshot : pendingSnapshots) {
+		pool->wait(pendingSnapshot);
+	}
+}
+
+KeyConfigVisitor::HostSnapshot KeyConfigVisitor::readHostKey(const std::wstring& hostPath, const ICopyFilter* filter) const
+{
+	if (cancellation) {
+		cancellation->check();
+	}
 
-	// copy source -> target
-	Helpers::copyKeysValues(registryManager, sourceKey.get(), targetKey.get());
+	const auto startTime = std::chrono::steady_clock::now();
 
-	return std::make_shared<ValueConfigVisitor>(registryManager, targetKey);
+	const IKeyPtr sourceKey = hostRegistry.getKeyManager().getKey(hostPath.c_str(), Permission::Read, hostHive.get());
+	KeySnapshotPtr snapshot = std::make_shared<KeySnapshot>(hostRegistry, sourceKey.get(), filter);
+
+	return { std::move(snapshot), std::chrono::steady_clock::now() - startTime };
 }
 
-Registry::Config::IValueVisitorPtr KeyConfigVisitor::visit(const Config::Key& key)
+uint64_t KeyConfigVisitor::fingerprintRule(const Rule& rule) const
 {
-	IKeyManager& keyManager = registryManager.getKeyManager();
-	const IKeyPtr createdKey = keyManager.getOrCreateKey(key.getPath().c_str(), Permission::All, hive->getRootKey().get());
+	if (cancellation) {
+		cancellation->check();
+	}
+
+	Fingerprint fingerprint;
+	fingerprint.add(rule.configHash);
+
+	// a missing host key is fingerprinted as such, the rule fails when it is applied
+	IKeyPtr hostKey;
 	try
 	{
-		const IKeyPtr hostKey = keyManager.getKey(key.getPath().c_str(), Permission::Read, hostHive.get());
-		return std::make_shared<ValueConfigVisitor>(registryManager, createdKey, hostKey);
+		if (hostHive) {
+			hostKey = hostRegistry.getKeyManager().getKey(rule.hostPath.c_str(), Permission::Read, hostHive.get());
+		}
+	}
+	catch (const std::exception&) {
+	}
+
+	if (!hostKey) {
+		return fingerprint.get();
+	}
+
+	if (rule.bHostKey)
+	{
+		// a filter already bounds the keys read
+		const size_t maxLevels = rule.filter ? SIZE_MAX : HostKeyFingerprintLevels;
+		fingerprint.add(fingerprintTree(hostRegistry.getKeyManager(), hostKey.get(), rule.filter.get(), maxLevels));
+	}
+	else
+	{
+		// keys only read host values
+		const KeyInfo info = hostRegistry.getKeyManager().queryKeyInfo(hostKey.get());
+		fingerprint.add(static_cast<uint64_t>(info.valueCount));
+		fingerprint.add(info.lastWriteTime);
+	}
+
+	return fingerprint.get();
+}
+
+void KeyConfigVisitor::prepare(const Config::HostKey& hostKey)
+{
+	rules.push_back({ hostKey.getHostPath(), hostKey.getTargetPath(), hostKey.getConfigHash(), true, true, hostKey.getFilter() });
+}
+
+void KeyConfigVisitor::prepare(const Config::Key& key)
+{
+	// host values are read from the same path
+	rules.push_back({ key.getPath(), key.getPath(), key.getConfigHash(), false, true, nullptr });
+}
+
+void KeyConfigVisitor::deleteChangedKeys(const std::vector<bool>& changedRules)
+{
+	IKeyManager& keyManager = targetRegistry.getKeyManager();
+	const IKeyPtr rootKey = hive->getRootKey();
+
+	for (size_t i = 0; i < rules.size(); ++i)
+	{
+		if (!changedRules[i]) {
+			continue;
+		}
+
+		const std::wstring& targetPath = rules[i].targetPath;
+
+		// the key doesn't exist if it was below a deleted key
+		IKeyPtr parentKey;
+		const size_t separator = targetPath.rfind(L'\\');
+		try
+		{
+			keyManager.getKey(targetPath.c_str(), Permission::Read, rootKey.get());
+			parentKey = separator != std::wstring::npos ? keyManager.getKey(targetPath.substr(0, separator).c_str(), Permission::All, rootKey.get()) : rootKey;
+		}
+		catch (const std::exception&)
+		{
+			continue;
+		}
+
+		// the rule writes the key again from the start
+		keyManager.deleteKey(parentKey.get(), targetPath.c_str() + (separator != std::wstring::npos ? separator + 1 : 0));
+	}
+}
+
+void KeyConfigVisitor::openHive()
+{
+	bHiveOpened = true;
+
+	fingerprints.resize(rules.size());
+	const auto fingerprintRuleAt = [this](size_t index)
+		{
+			fingerprints[index] = { rules[index].targetPath, fingerprintRule(rules[index]) };
+		};
+
+	if (pool) {
+		pool->parallelFor(rules.size(), fingerprintRuleAt);
+	}
+	else
+	{
+		for (size_t i = 0; i < rules.size(); ++i) {
+			fingerprintRuleAt(i);
+		}
+	}
+
+	std::vector<RuleFingerprint> previousFingerprints;
+	std::error_code ec;
+	if (!bRebuild && std::filesystem::exists(hiveFileName, ec)) {
+		previousFingerprints = loadFingerprints(hiveFileName);
+	}
+
+	std::vector<bool> changedRules;
+	std::vector<bool> appliedRules;
+	const bool bPreviousRules = !previousFingerprints.empty() && selectChangedRules(previousFingerprints, fingerprints, changedRules, appliedRules);
+	if (bPreviousRules)
+	{
+		for (size_t i = 0; i < rules.size(); ++i) {
+			rules[i].bApplied = appliedRules[i];
+		}
+	}
+	if (bPreviousRules && std::find(changedRules.begin(), changedRules.end(), true) == changedRules.end())
+	{
+		// the hive is kept as it is
+		return;
+	}
+
+	// an interrupted update leaves no fingerprints, and the next run rebuilds the hive
+	std::filesystem::remove(getFingerprintFileName(hiveFileName), ec);
+
+	buildStartTime = std::chrono::steady_clock::now();
+
+	if (cache)
+	{
+		Fingerprint hiveFingerprint;
+		for (const RuleFingerprint& ruleFingerprint : fingerprints)
+		{
+			hiveFingerprint.add(std::wstring_view(ruleFingerprint.targetPath));
+			hiveFingerprint.add(ruleFingerprint.fingerprint);
+		}
+
+		cacheKey = hiveFingerprint.get();
+		if (!bRebuild && cache->restore(hiveFileName.filename().wstring(), cacheKey, hiveFileName))
+		{
+			for (Rule& rule : rules) {
+				rule.bApplied = false;
+			}
+
+			saveFingerprints(hiveFileName, fingerprints);
+			return;
+		}
+	}
+
+	if (bPreviousRules)
+	{
+		try
+		{
+			hive = targetRegistry.getHiveManager().loadHive(hiveFileName);
+		}
+		catch (const std::exception&) {
+		}
 	}
-	catch(const std::exception&)
+
+	if (hive) {
+		deleteChangedKeys(changedRules);
+	}
+	else
 	{
-		return std::make_shared<ValueConfigVisitor>(registryManager, createdKey);
+		for (Rule& rule : rules) {
+			rule.bApplied = true;
+		}
+
+		hive = targetRegistry.getHiveManager().createHive(hiveFileName);
+	}
+
+	targetKeys.emplace(targetRegistry.getKeyManager(), hive->getRootKey(), Permission::All, true);
+
+	if (!pool) {
+		return;
 	}
 
+	for (const Rule& rule : rules)
+	{
+		if (!rule.bHostKey || !rule.bApplied) {
+			continue;
+		}
+
+		// errors are thrown when the key is visited
+		pendingSnapshots.push_back(pool->submit([this, hostPath = rule.hostPath, filter = rule.filter]()
+			{
+				return readHostKey(hostPath, filter.get());
+			}));
+	}
 }
 
-ValueConfigVisitor::ValueConfigVisitor(IRegistryManager& inRegistryManager, const IKeyPtr& inKey, const IKeyPtr& inHostKey)
-	: registryManager(inRegistryManager)
-	, key(inKey)
-	, hostKey(inHostKey)
+const KeyConfigVisitor::Rule& KeyConfigVisitor::getVisitedRule()
+{
+	if (!bHiveOpened) {
+		openHive();
+	}
+
+	if (visitedRuleCount == rules.size()) {
+		throw std::logic_error("key visited without being prepared");
+	}
+
+	return rules[visitedRuleCount++];
+}
+
+Registry::Config::IValueVisitorPtr KeyConfigVisitor::visit(const Config::HostKey& hostKey)
+{
+	if (cancellation) {
+		cancellation->check();
+	}
+
+	if (!getVisitedRule().bApplied) {
+		return std::make_shared<SkippedValueConfigVisitor>();
+	}
+
+	HostKeyTiming timing{ hive->getHiveName(), hostKey.getHostPath() };
+
+	IKeyPtr targetKey;
+	if (!pendingSnapshots.empty())
+	{
+		std::future<HostSnapshot> pendingSnapshot = std::move(pendingSnapshots.front());
+		pendingSnapshots.pop_front();
+
+		pool->wait(pendingSnapshot);
+		const HostSnapshot hostSnapshot = pendingSnapshot.get();
+
+		const auto startTime = std::chrono::steady_clock::now();
+
+		// snapshots are applied in the order of the configuration, the hive doesn't depend on the order of the reads
+		targetKey = targetKeys->getKey(hostKey.getTargetPath());
+		hostSnapshot.snapshot->apply(targetRegistry, targetKey.get());
+
+		timing.keyCount = hostSnapshot.snapshot->getKeyCount();
+		timing.readTime = hostSnapshot.readTime;
+		timing.applyTime = std::chrono::steady_clock::now() - startTime;
+	}
+	else
+	{
+		const auto startTime = std::chrono::steady_clock::now();
+
+		IKeyPtr sourceKey = hostRegistry.getKeyManager().getKey(hostKey.getHostPath().c_str(), Permission::Read, hostHive.get());
+		targetKey = targetKeys->getKey(hostKey.getTargetPath());
+
+		// copy source -> target
+		Helpers::copyTree(hostRegistry, targetRegistry, sourceKey.get(), targetKey.get(), hostKey.getFilter().get());
+
+		timing.readTime = std::chrono::steady_clock::now() - startTime;
+	}
+
+	if (report) {
+		report->add(std::move(timing));
+	}
+
+	return std::make_shared<ValueConfigVisitor>(hostRegistry, targetRegistry, targetKey);
+}
+
+Registry::Config::IValueVisitorPtr KeyConfigVisitor::visit(const Config::Key& key)
+{
+	if (cancellation) {
+		cancellation->check();
+	}
+
+	if (!getVisitedRule().bApplied) {
+		return std::make_shared<SkippedValueConfigVisitor>();
+	}
+
+	const IKeyPtr createdKey = targetKeys->getKey(key.getPath());
+	return std::make_shared<ValueConfigVisitor>(hostRegistry, targetRegistry, createdKey, &hostKeys, key.getPath());
+}
+
+void KeyConfigVisitor::finish()
+{
+	if (!bHiveOpened) {
+		openHive();
+	}
+
+	if (!hive) {
+		return;
+	}
+
+	// the hive can't be unloaded while its keys are open
+	targetKeys->clear();
+	hostKeys.clear();
+
+	targetRegistry.getHiveManager().commitHive(*hive);
+
+	// the fingerprints are only valid once the hive is written
+	saveFingerprints(hiveFileName, fingerprints);
+
+	if (cache)
+	{
+		// application hives are unloaded once closed, their file can't be read while they are loaded
+		hive.reset();
+		cache->store(hiveFileName.filename().wstring(), cacheKey, hiveFileName, std::chrono::steady_clock::now() - buildStartTime);
+	}
+}
+
+ValueConfigVisitor::ValueConfigVisitor(IRegistryManager& inHostRegistry, IRegistryManager& inTargetRegistry, const IKeyPtr& inKey, KeyCache* inHostKeys, const std::wstring_view& inHostPath)
+	: key(inKey)
+	, hostRegistry(inHostRegistry)
+	, targetRegistry(inTargetRegistry)
+	, hostKeys(inHostKeys)
+	, hostPath(inHostPath)
+	, bHostValuesRead(false)
 {
 
 }
 
 void ValueConfigVisitor::visit(const Config::Value& value)
 {
-	IValueManager& valueManager = registryManager.getValueManager();
-	const IValuePtr createdValue = valueManager.newValue(value.getValueName().c_str(), *value.getDataType());
-	createdValue->setRawData(value.getData());
-	valueManager.setValue(key.get(), *createdValue);
+	// the data is copied once, by the target registry
+	const ValueView configValue(value.getValueName().c_str(), *value.getDataType(), value.getData());
+	targetRegistry.getValueManager().setValue(key.get(), configValue);
 }
 
 void ValueConfigVisitor::visit(const Config::HostValue& hostValue)
 {
-	IValueManager& valueManager = registryManager.getValueManager();
-	if (hostKey)
+	IValueManager& valueManager = targetRegistry.getValueManager();
+
+	// the values of a key are read at once, keys usually have several host values
+	if (!bHostValuesRead)
 	{
-		const IValuePtr hostValuePtr = valueManager.getValue(hostKey.get(), hostValue.getHostValueName().c_str());
+		hostKey = hostKeys ? hostKeys->findKey(hostPath) : nullptr;
+		if (hostKey) {
+			hostRegistry.getValueManager().readKeyValues(hostKey.get(), hostValues);
+		}
 
-		const IValuePtr createdValue = valueManager.newValue(hostValue.getValueName().c_str(), hostValuePtr->getType());
-		if (hostValuePtr)
-		{
-			// copy value from host
-			createdValue->setRawData(hostValuePtr->getRawData());
+		bHostValuesRead = true;
+	}
+
+	if (hostKey)
+	{
+		const size_t index = hostValues.find(hostValue.getHostValueName());
+		if (index == hostValues.size()) {
+			throw std::system_error(std::make_error_code(std::errc::no_such_file_or_directory), "couldn't open registry value");
 		}
 
-		valueManager.setValue(key.get(), *createdValue);
+		const ValueView hostValueData = hostValues[index];
+
+		// copy value from host, under its target name
+		const ValueView targetValue(hostValue.getValueName().c_str(), hostValueData.getType(), hostValueData.getRawData());
+		valueManager.setValue(key.get(), targetValue);
 	}
 }
@@ -2,13 +2,54 @@
 
 #include "registry.h"
 #include "registry_configuration.h"
+#include "registry_fingerprint.h"
+#include "registry_hive_cache.h"
+#include "registry_key_cache.h"
+#include "registry_snapshot.h"
+#include "task_group.h"
+
+#include <chrono>
+#include <deque>
+#include <filesystem>
+#include <future>
+#include <mutex>
+#include <optional>
+#include <vector>
 
 namespace Registry
 {
+	struct HostKeyTiming
+	{
+		std::wstring hiveName;
+		std::wstring hostPath;
+		/** Keys copied without a snapshot are not counted, and their copy is reported as read time. */
+		size_t keyCount = 0;
+		std::chrono::steady_clock::duration readTime{};
+		std::chrono::steady_clock::duration applyTime{};
+	};
+
+	/**
+	 * Times of the host keys copied to the hives, in the order they were applied.
+	 */
+	class HostKeyReport
+	{
+	public:
+		void add(HostKeyTiming&& timing);
+		std::vector<HostKeyTiming> getTimings() const;
+
+	private:
+		std::vector<HostKeyTiming> timings;
+		mutable std::mutex timingsMutex;
+	};
+
 	class ValueConfigVisitor : public Config::IValueVisitor
 	{
 	public:
-		ValueConfigVisitor(IRegistryManager& inRegistryManager, const IKeyPtr& inKey, const IKeyPtr& inHostKey = nullptr);
+		/**
+		 * Host values are read from the key of the host path, opened with the first host value.
+		 * Without host keys, host values are ignored.
+		 */
+		ValueConfigVisitor(IRegistryManager& inHostRegistry, IRegistryManager& inTargetRegistry, const IKeyPtr& inKey, KeyCache* inHostKeys = nullptr, const std::wstring_view& inHostPath = {});
 
 		void visit(const Config::Value& value) override;
 		void visit(const Config::HostValue& hostValue) override;
@@ -16,33 +57,138 @@ namespace Registry
 	private:
 		IKeyPtr key;
 		IKeyPtr hostKey;
-		IRegistryManager& registryManager;
+		IRegistryManager& hostRegistry;
+		IRegistryManager& targetRegistry;
+		KeyCache* hostKeys;
+		std::wstring hostPath;
+
+		/** Values of the host key, read with the first host value. */
+		ValueBatch hostValues;
+		bool bHostValuesRead;
+	};
+
+	/**
+	 * Ignores the values of a key kept from the previous hive.
+	 */
+	class SkippedValueConfigVisitor : public Config::IValueVisitor
+	{
+	public:
+		void visit(const Config::Value& value) override;
+		void visit(const Config::HostValue& hostValue) override;
 	};
 
 	class KeyConfigVisitor : public Config::IKeyVisitor
 	{
 	public:
-		KeyConfigVisitor(IRegistryManager& inRegistryManager, const IHivePtr& inHive, const IKeyPtr& inHostHive);
+		/**
+		 * The hive is opened once its keys are prepared. Unless it is rebuilt, the keys whose configuration
+		 * and host keys have the fingerprints of the previous run are kept, and the hive isn't written if none changed.
+		 * If a pool is specified, host keys are read on the pool once the hive is opened.
+		 * If a cache is specified, a hive built with the same fingerprints is copied from it instead of being built.
+		 */
+		KeyConfigVisitor(IRegistryManager& inHostRegistry, IRegistryManager& inTargetRegistry, const std::filesystem::path& inHiveFileName, const IKeyPtr& inHostHive, bool bInRebuild = true, const CancellationToken* inCancellation = nullptr, ThreadPool* inPool = nullptr, HostKeyReport* inReport = nullptr, HiveCache* inCache = nullptr);
 
+		/**
+		 * Waits for the host keys still being read.
+		 */
+		~KeyConfigVisitor();
+
+		void prepare(const Config::HostKey& hostKey) override;
+		void prepare(const Config::Key& key) override;
 		Config::IValueVisitorPtr visit(const Config::HostKey& hostKey) override;
 		Config::IValueVisitorPtr visit(const Config::Key& key) override;
+		void finish() override;
 
 	private:
+		struct HostSnapshot
+		{
+			KeySnapshotPtr snapshot;
+			std::chrono::steady_clock::duration readTime;
+		};
+
+		/**
+		 * A key or host key of the hive, in the order of the configuration.
+		 */
+		struct Rule
+		{
+			std::wstring hostPath;
+			std::wstring targetPath;
+			uint64_t configHash;
+			bool bHostKey;
+
+			/** Whether the rule is written to the hive, rather than kept from the previous hive. */
+			bool bApplied;
+
+			/** Subkeys and values of a host key that are read, null to read them all. */
+			Config::HostKeyFilterPtr filter;
+		};
+
+		HostSnapshot readHostKey(const std::wstring& hostPath, const ICopyFilter* filter) const;
+		uint64_t fingerprintRule(const Rule& rule) const;
+
+		/**
+		 * Selects the rules to apply and opens the hive, once all the rules are prepared.
+		 * The hive is left closed if no rule changed.
+		 */
+		void openHive();
+
+		void deleteChangedKeys(const std::vector<bool>& changedRules);
+
+		/**
+		 * Returns the prepared rule of the visited key.
+		 */
+		const Rule& getVisitedRule();
+
+	private:
+		std::filesystem::path hiveFileName;
 		IHivePtr hive;
 		IKeyPtr hostHive;
-		IRegistryManager& registryManager;
+		IRegistryManager& hostRegistry;
+		IRegistryManager& targetRegistry;
+		const CancellationToken* cancellation;
+		ThreadPool* pool;
+		HostKeyReport* report;
+		HiveCache* cache;
+
+		std::vector<Rule> rules;
+		std::vector<RuleFingerprint> fingerprints;
+		size_t visitedRuleCount;
+		std::chrono::steady_clock::time_point buildStartTime;
+		uint64_t cacheKey;
+		bool bRebuild;
+		bool bHiveOpened;
+
+		/** Snapshots of the applied host keys, in the order they are visited. */
+		std::deque<std::future<HostSnapshot>> pendingSnapshots;
+
+		/** Keys opened while building the hive, closed when it is finished. */
+		std::optional<KeyCache> targetKeys;
+		KeyCache hostKeys;
 	};
 
 	class HiveConfigVisitor : public Config::IHiveVisitor
 	{
 	public:
-		HiveConfigVisitor(IRegistryManager& inRegistryManager, const std::filesystem::path& inWorkingDir, const std::wstring_view& hivePostfix = nullptr);
+		/**
+		 * Keys and values are read from the host registry, and hives are built with the target registry.
+		 * If a cancellation token is specified, it is checked before each hive and key.
+		 * If a pool is specified, the host keys of a hive are read concurrently and applied in order.
+		 * Unless hives are rebuilt, only the keys that changed since the previous run are written.
+		 * If a cache is specified, hives are restored from it when possible, and the built hives are added to it.
+		 */
+		HiveConfigVisitor(IRegistryManager& inHostRegistry, IRegistryManager& inTargetRegistry, const std::filesystem::path& inWorkingDir, const std::wstring_view& hivePostfix = nullptr, const CancellationToken* inCancellation = nullptr, ThreadPool* inPool = nullptr, HostKeyReport* inReport = nullptr, bool bInRebuild = true, HiveCache* inCache = nullptr);
 
 		Config::IKeyVisitorPtr visit(const Config::Hive& hive) override;
 
 	private:
 		std::filesystem::path workingDir;
 		std::wstring postfix;
-		IRegistryManager& registryManager;
+		IRegistryManager& hostRegistry;
+		IRegistryManager& targetRegistry;
+		const CancellationToken* cancellation;
+		ThreadPool* pool;
+		HostKeyReport* report;
+		HiveCache* cache;
+		bool bRebuild;
 	};
 }
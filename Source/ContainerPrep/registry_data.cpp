@@ -0,0 +1,319 @@
+#include "registry_data.h"
+
+#include <cstring>
+#include <system_error>
+
+using namespace Registry;
+
+const IDataType Types::None(L"REG_NONE", 0);
+const IDataType Types::String(L"REG_SZ", 1);
+const IDataType Types::ExpandableString(L"REG_EXPAND_SZ", 2);
+const IDataType Types::Binary(L"REG_BINARY", 3);
+const IDataType Types::DWord(L"REG_DWORD", 4);
+const IDataType Types::DWordBigEndian(L"REG_DWORD_BIG_ENDIAN", 5);
+const IDataType Types::Link(L"REG_LINK", 6);
+const IDataType Types::MultiString(L"REG_MULTI_SZ", 7);
+const IDataType Types::ResourceList(L"REG_RESOURCE_LIST", 8);
+const IDataType Types::FullResourceDescriptor(L"REG_FULL_RESOURCE_DESCRIPTOR", 9);
+const IDataType Types::ResourceRequirementsList(L"REG_RESOURCE_REQUIREMENTS_LIST", 10);
+const IDataType Types::QWord(L"REG_QWORD", 11);
+
+char16_t Registry::upcaseChar(char16_t ch)
+{
+	if (ch < 0x80) {
+		return ch >= 'a' && ch <= 'z' ? static_cast<char16_t>(ch - 0x20) : ch;
+	}
+
+	// Latin-1
+	if (ch >= 0xE0 && ch <= 0xFE && ch != 0xF7) {
+		return static_cast<char16_t>(ch - 0x20);
+	}
+
+	if (ch == 0xFF) {
+		return 0x178;
+	}
+
+	// Latin Extended-A, pairs of upper and lower case letters
+	if ((ch >= 0x100 && ch <= 0x137 && ch != 0x131) || (ch >= 0x14A && ch <= 0x177)) {
+		return static_cast<char16_t>(ch & ~1);
+	}
+
+	if ((ch >= 0x139 && ch <= 0x148) || (ch >= 0x179 && ch <= 0x17E)) {
+		return ch & 1 ? ch : static_cast<char16_t>(ch - 1);
+	}
+
+	// Greek
+	if (ch >= 0x3B1 && ch <= 0x3CB && ch != 0x3C2) {
+		return static_cast<char16_t>(ch - 0x20);
+	}
+
+	// Cyrillic
+	if (ch >= 0x430 && ch <= 0x44F) {
+		return static_cast<char16_t>(ch - 0x20);
+	}
+
+	if (ch >= 0x450 && ch <= 0x45F) {
+		return static_cast<char16_t>(ch - 0x50);
+	}
+
+	if ((ch >= 0x460 && ch <= 0x481) || (ch >= 0x48A && ch <= 0x4BF)) {
+		return static_cast<char16_t>(ch & ~1);
+	}
+
+	// Armenian
+	if (ch >= 0x561 && ch <= 0x586) {
+		return static_cast<char16_t>(ch - 0x30);
+	}
+
+	// fullwidth Latin
+	if (ch >= 0xFF41 && ch <= 0xFF5A) {
+		return static_cast<char16_t>(ch - 0x20);
+	}
+
+	return ch;
+}
+
+static wchar_t upcaseName(wchar_t ch)
+{
+	// characters out of the BMP have no case
+	if (static_cast<uint32_t>(ch) > 0xFFFF) {
+		return ch;
+	}
+
+	return static_cast<wchar_t>(upcaseChar(static_cast<char16_t>(ch)));
+}
+
+int Registry::compareNames(const std::wstring_view& left, const std::wstring_view& right)
+{
+	const size_t length = left.size() < right.size() ? left.size() : right.size();
+	for (size_t i = 0; i < length; ++i)
+	{
+		const wchar_t leftChar = upcaseName(left[i]);
+		const wchar_t rightChar = upcaseName(right[i]);
+		if (leftChar != rightChar) {
+			return leftChar < rightChar ? -1 : 1;
+		}
+	}
+
+	if (left.size() != right.size()) {
+		return left.size() < right.size() ? -1 : 1;
+	}
+
+	return 0;
+}
+
+std::wstring Registry::foldName(const std::wstring_view& name)
+{
+	std::wstring folded(name);
+	for (wchar_t& ch : folded) {
+		ch = upcaseName(ch);
+	}
+
+	return folded;
+}
+
+std::u16string Registry::toUtf16(const std::wstring_view& str)
+{
+	std::u16string text;
+	text.reserve(str.size());
+
+	for (const wchar_t ch : str)
+	{
+		const uint32_t codePoint = static_cast<uint32_t>(ch);
+		if (codePoint > 0xFFFF)
+		{
+			text += static_cast<char16_t>(0xD800 + ((codePoint - 0x10000) >> 10));
+			text += static_cast<char16_t>(0xDC00 + ((codePoint - 0x10000) & 0x3FF));
+		}
+		else {
+			text += static_cast<char16_t>(codePoint);
+		}
+	}
+
+	return text;
+}
+
+std::wstring Registry::fromUtf16(const std::u16string_view& str)
+{
+	std::wstring text;
+	text.reserve(str.size());
+
+	for (size_t i = 0; i < str.size(); ++i)
+	{
+		const char16_t ch = str[i];
+		if constexpr (sizeof(wchar_t) > sizeof(char16_t))
+		{
+			// combine surrogate pairs
+			if (ch >= 0xD800 && ch < 0xDC00 && i + 1 < str.size() && str[i + 1] >= 0xDC00 && str[i + 1] < 0xE000)
+			{
+				text += static_cast<wchar_t>(0x10000 + ((ch - 0xD800) << 10) + (str[i + 1] - 0xDC00));
+				++i;
+				continue;
+			}
+		}
+
+		text += static_cast<wchar_t>(ch);
+	}
+
+	return text;
+}
+
+ValueView::ValueView(const wchar_t* inName, const IDataType& inType, const std::span<const unsigned char>& inData)
+	: name(inName)
+	, dataType(&inType)
+	, rawData(inData)
+{
+}
+
+const wchar_t* ValueView::getValueName() const
+{
+	return name;
+}
+
+const IDataType& ValueView::getType() const
+{
+	return *dataType;
+}
+
+std::span<const unsigned char> ValueView::getRawData() const
+{
+	return rawData;
+}
+
+void ValueView::setRawData(const std::span<const unsigned char>& data)
+{
+	throw std::system_error(std::make_error_code(std::errc::operation_not_permitted), "value views are read-only");
+}
+
+ValueData::ValueData()
+	: dataSize(0)
+{
+}
+
+ValueData::ValueData(const std::span<const unsigned char>& data)
+	: dataSize(0)
+{
+	assign(data);
+}
+
+ValueData::~ValueData()
+{
+	if (!isInline()) {
+		delete[] heapData;
+	}
+}
+
+ValueData::ValueData(const ValueData& other)
+	: dataSize(0)
+{
+	assign(other.get());
+}
+
+ValueData& ValueData::operator=(const ValueData& other)
+{
+	if (this != &other) {
+		assign(other.get());
+	}
+
+	return *this;
+}
+
+ValueData::ValueData(ValueData&& other) noexcept
+	: dataSize(other.dataSize)
+{
+	if (other.isInline()) {
+		std::memcpy(inlineData, other.inlineData, dataSize);
+	}
+	else {
+		heapData = other.heapData;
+	}
+
+	other.dataSize = 0;
+}
+
+ValueData& ValueData::operator=(ValueData&& other) noexcept
+{
+	if (this != &other)
+	{
+		if (!isInline()) {
+			delete[] heapData;
+		}
+
+		dataSize = other.dataSize;
+		if (other.isInline()) {
+			std::memcpy(inlineData, other.inlineData, dataSize);
+		}
+		else {
+			heapData = other.heapData;
+		}
+
+		other.dataSize = 0;
+	}
+
+	return *this;
+}
+
+std::span<const unsigned char> ValueData::get() const
+{
+	return std::span<const unsigned char>(isInline() ? inlineData : heapData, dataSize);
+}
+
+size_t ValueData::size() const
+{
+	return dataSize;
+}
+
+std::span<unsigned char> ValueData::getBuffer()
+{
+	return std::span<unsigned char>(isInline() ? inlineData : heapData, dataSize);
+}
+
+void ValueData::assign(const std::span<const unsigned char>& data)
+{
+	const std::span<unsigned char> buffer = reset(data.size());
+	if (!data.empty()) {
+		std::memcpy(buffer.data(), data.data(), data.size());
+	}
+}
+
+std::span<unsigned char> ValueData::reset(size_t newSize)
+{
+	// a buffer of the same size is reused
+	if (newSize != dataSize)
+	{
+		unsigned char* newHeapData = newSize > InlineSize ? new unsigned char[newSize] : nullptr;
+		if (!isInline()) {
+			delete[] heapData;
+		}
+
+		dataSize = newSize;
+		if (newHeapData) {
+			heapData = newHeapData;
+		}
+	}
+
+	return std::span<unsigned char>(isInline() ? inlineData : heapData, dataSize);
+}
+
+bool ValueData::isInline() const
+{
+	return dataSize <= InlineSize;
+}
+
+const wchar_t* NameTable::intern(const std::wstring_view& name)
+{
+	const auto it = index.find(name);
+	if (it != index.end()) {
+		return it->second;
+	}
+
+	const std::wstring& storedName = names.emplace_back(name);
+	index.emplace(storedName, storedName.c_str());
+
+	return storedName.c_str();
+}
+
+size_t NameTable::size() const
+{
+	return names.size();
+}
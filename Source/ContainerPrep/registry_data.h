@@ -1,14 +1,19 @@
 #pragma once
 
+#include <cstdint>
+#include <deque>
 #include <memory>
 #include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
 
 namespace Registry
 {
 	class IDataType
 	{
 	public:
-		IDataType(const wchar_t* name);
+		IDataType(const wchar_t* name, uint32_t inRawType);
 		virtual ~IDataType();
 
 		// non-copyable
@@ -18,16 +23,69 @@ namespace Registry
 		IDataType(IDataType&&) = delete;
 		IDataType& operator=(IDataType&&) = delete;
 
+		const wchar_t* getName() const;
+
+		/**
+		 * Type identifier stored in hives (REG_SZ, REG_DWORD...).
+		 */
+		uint32_t getRawType() const;
+
 		static const IDataType* findDataType(const wchar_t* name);
 
+		/**
+		 * Finds a type by identifier, unknown identifiers map to REG_BINARY.
+		 */
+		static const IDataType* findDataType(uint32_t rawType);
+
 	private:
 		IDataType* prev;
 		IDataType* next;
 		static IDataType* head;
 		static IDataType* last;
 		const wchar_t* typeName;
+		uint32_t rawType;
 	};
 
+	/**
+	 * Value types, the same on every platform.
+	 */
+	namespace Types
+	{
+		extern const IDataType None;
+		extern const IDataType String;
+		extern const IDataType ExpandableString;
+		extern const IDataType Binary;
+		extern const IDataType DWord;
+		extern const IDataType DWordBigEndian;
+		extern const IDataType Link;
+		extern const IDataType MultiString;
+		extern const IDataType ResourceList;
+		extern const IDataType FullResourceDescriptor;
+		extern const IDataType ResourceRequirementsList;
+		extern const IDataType QWord;
+	}
+
+	/**
+	 * Returns the upper case of a character the way the registry compares names, whatever the locale.
+	 */
+	char16_t upcaseChar(char16_t ch);
+
+	/**
+	 * Compares key or value names, which are case-insensitive.
+	 */
+	int compareNames(const std::wstring_view& left, const std::wstring_view& right);
+
+	/**
+	 * Returns the name with its case folded, to look it up by hash.
+	 */
+	std::wstring foldName(const std::wstring_view& name);
+
+	/**
+	 * Names are stored as UTF-16 in hives, wchar_t is 32-bit on some platforms.
+	 */
+	std::u16string toUtf16(const std::wstring_view& str);
+	std::wstring fromUtf16(const std::u16string_view& str);
+
 	/**
 	 * Platform-specific key
 	 */
@@ -56,4 +114,91 @@ namespace Registry
 		virtual void setRawData(const std::span<const unsigned char>& data) = 0;
 	};
 	using IValuePtr = std::shared_ptr<IValue>;
+
+	/**
+	 * Value over a name and data owned by someone else, to pass them as a value without copying them.
+	 */
+	class ValueView : public IValue
+	{
+	public:
+		ValueView(const wchar_t* inName, const IDataType& inType, const std::span<const unsigned char>& inData);
+
+		const wchar_t* getValueName() const override;
+		const IDataType& getType() const override;
+
+		std::span<const unsigned char> getRawData() const override;
+		void setRawData(const std::span<const unsigned char>& data) override;
+
+	private:
+		const wchar_t* name;
+		const IDataType* dataType;
+		std::span<const unsigned char> rawData;
+	};
+
+	/**
+	 * Data of a value. Data up to InlineSize bytes, which covers DWORD, QWORD and short strings, is stored
+	 * in the object itself and larger data in a single allocation.
+	 */
+	class ValueData
+	{
+	public:
+		static constexpr size_t InlineSize = 16;
+
+	public:
+		ValueData();
+		ValueData(const std::span<const unsigned char>& data);
+		~ValueData();
+
+		ValueData(const ValueData& other);
+		ValueData& operator=(const ValueData& other);
+		ValueData(ValueData&& other) noexcept;
+		ValueData& operator=(ValueData&& other) noexcept;
+
+		std::span<const unsigned char> get() const;
+		size_t size() const;
+
+		/**
+		 * Returns the data to modify in place.
+		 */
+		std::span<unsigned char> getBuffer();
+
+		void assign(const std::span<const unsigned char>& data);
+
+		/**
+		 * Resizes the data without keeping it, and returns the buffer to fill.
+		 */
+		std::span<unsigned char> reset(size_t newSize);
+
+	private:
+		bool isInline() const;
+
+	private:
+		size_t dataSize;
+		union
+		{
+			unsigned char inlineData[InlineSize];
+			unsigned char* heapData;
+		};
+	};
+
+	/**
+	 * Names stored once, such as the value names repeated in every key of a hive.
+	 * Interned names stay valid as long as the table.
+	 */
+	class NameTable
+	{
+	public:
+		NameTable() = default;
+
+		NameTable(const NameTable&) = delete;
+		NameTable& operator=(const NameTable&) = delete;
+
+		const wchar_t* intern(const std::wstring_view& name);
+		size_t size() const;
+
+	private:
+		// the deque keeps the address of existing names
+		std::deque<std::wstring> names;
+		std::unordered_map<std::wstring_view, const wchar_t*> index;
+	};
 }
@@ -0,0 +1,253 @@
+#include "registry_fingerprint.h"
+
+#include <charconv>
+#include <fstream>
+#include <system_error>
+
+using namespace Registry;
+
+static const uint64_t FnvOffsetBasis = 0xCBF29CE484222325ull;
+static const uint64_t FnvPrime = 0x100000001B3ull;
+
+Fingerprint::Fingerprint()
+	: hash(FnvOffsetBasis)
+{
+}
+
+void Fingerprint::add(std::span<const unsigned char> data)
+{
+	for (const unsigned char byte : data)
+	{
+		hash ^= byte;
+		hash *= FnvPrime;
+	}
+}
+
+void Fingerprint::add(const std::string_view& str)
+{
+	// the length separates consecutive strings
+	add(static_cast<uint64_t>(str.size()));
+	add(std::span<const unsigned char>(reinterpret_cast<const unsigned char*>(str.data()), str.size()));
+}
+
+void Fingerprint::add(const std::wstring_view& str)
+{
+	add(static_cast<uint64_t>(str.size()));
+	add(std::span<const unsigned char>(reinterpret_cast<const unsigned char*>(str.data()), str.size() * sizeof(wchar_t)));
+}
+
+void Fingerprint::add(uint64_t number)
+{
+	add(std::span<const unsigned char>(reinterpret_cast<const unsigned char*>(&number), sizeof(number)));
+}
+
+uint64_t Fingerprint::get() const
+{
+	return hash;
+}
+
+uint64_t Registry::fingerprintTree(IKeyManager& keyManager, const IKey* key, const ICopyFilter* filter, size_t maxLevels)
+{
+	struct PendingKey
+	{
+		IKeyPtr parent;
+		std::wstring name;
+		std::wstring path;
+		size_t level;
+	};
+
+	Fingerprint fingerprint;
+	std::vector<PendingKey> pendingKeys;
+	std::vector<std::wstring> subKeyNames;
+
+	const auto addKey = [&](const IKeyPtr& currentKey, const std::wstring& path, size_t level)
+		{
+			const KeyInfo info = keyManager.queryKeyInfo(currentKey.get());
+			fingerprint.add(static_cast<uint64_t>(info.subKeyCount));
+			fingerprint.add(static_cast<uint64_t>(info.valueCount));
+			fingerprint.add(info.lastWriteTime);
+
+			if (level >= maxLevels) {
+				return;
+			}
+
+			subKeyNames.clear();
+			keyManager.visitKeys(currentKey.get(), [&](const IKey* parentKey, const wchar_t* keyName) -> bool
+				{
+					subKeyNames.emplace_back(keyName);
+					return true;
+				}, 0);
+
+			// pushed in reverse, subkeys are hashed in their order
+			for (auto it = subKeyNames.rbegin(); it != subKeyNames.rend(); ++it)
+			{
+				std::wstring subKeyPath;
+				if (filter)
+				{
+					subKeyPath = path.empty() ? *it : path + L'\\' + *it;
+					if (!filter->includeKey(subKeyPath)) {
+						continue;
+					}
+				}
+
+				pendingKeys.push_back({ currentKey, std::move(*it), std::move(subKeyPath), level + 1 });
+			}
+		};
+
+	// the caller owns the key
+	addKey(IKeyPtr(IKeyPtr(), const_cast<IKey*>(key)), std::wstring(), 0);
+
+	while (!pendingKeys.empty())
+	{
+		PendingKey pendingKey = std::move(pendingKeys.back());
+		pendingKeys.pop_back();
+
+		fingerprint.add(std::wstring_view(pendingKey.name));
+
+		// as in copies, subkeys that can't be opened are skipped
+		IKeyPtr subKey;
+		try
+		{
+			subKey = keyManager.getKey(pendingKey.name.c_str(), Permission::Read, pendingKey.parent.get());
+		}
+		catch (const std::exception&)
+		{
+			continue;
+		}
+
+		addKey(subKey, pendingKey.path, pendingKey.level);
+	}
+
+	return fingerprint.get();
+}
+
+/**
+ * Whether a key path is the same as another or one of its subkeys.
+ */
+static bool isSameOrSubKey(const std::wstring_view& path, const std::wstring_view& parentPath)
+{
+	if (parentPath.empty()) {
+		return true;
+	}
+
+	if (path.size() < parentPath.size() || compareNames(path.substr(0, parentPath.size()), parentPath)) {
+		return false;
+	}
+
+	return path.size() == parentPath.size() || path[parentPath.size()] == L'\\';
+}
+
+bool Registry::selectChangedRules(const std::vector<RuleFingerprint>& previousRules, const std::vector<RuleFingerprint>& rules, std::vector<bool>& changedRules, std::vector<bool>& appliedRules)
+{
+	if (previousRules.size() != rules.size()) {
+		return false;
+	}
+
+	changedRules.assign(rules.size(), false);
+	for (size_t i = 0; i < rules.size(); ++i)
+	{
+		// rules were added, removed or moved
+		if (compareNames(previousRules[i].targetPath, rules[i].targetPath)) {
+			return false;
+		}
+
+		if (previousRules[i].fingerprint != rules[i].fingerprint)
+		{
+			// the root key can't be deleted
+			if (rules[i].targetPath.empty()) {
+				return false;
+			}
+
+			changedRules[i] = true;
+		}
+	}
+
+	appliedRules = changedRules;
+
+	bool bSelected = true;
+	while (bSelected)
+	{
+		bSelected = false;
+		for (size_t i = 0; i < rules.size(); ++i)
+		{
+			if (appliedRules[i]) {
+				continue;
+			}
+
+			for (size_t j = 0; j < rules.size(); ++j)
+			{
+				if (appliedRules[j] && (isSameOrSubKey(rules[i].targetPath, rules[j].targetPath) || isSameOrSubKey(rules[j].targetPath, rules[i].targetPath)))
+				{
+					appliedRules[i] = true;
+					bSelected = true;
+					break;
+				}
+			}
+		}
+	}
+
+	return true;
+}
+
+std::filesystem::path Registry::getFingerprintFileName(const std::filesystem::path& hiveFileName)
+{
+	std::filesystem::path fileName = hiveFileName;
+	fileName += L".fingerprints";
+	return fileName;
+}
+
+std::vector<RuleFingerprint> Registry::loadFingerprints(const std::filesystem::path& hiveFileName)
+{
+	std::vector<RuleFingerprint> rules;
+
+	std::ifstream stream(getFingerprintFileName(hiveFileName), std::ios::in | std::ios::binary);
+	if (stream.fail()) {
+		return rules;
+	}
+
+	// one line per rule: the fingerprint in hexadecimal, a tab, and the UTF-8 path of the target key
+	std::string line;
+	while (std::getline(stream, line))
+	{
+		const size_t separator = line.find('\t');
+		if (separator == std::string::npos) {
+			return {};
+		}
+
+		RuleFingerprint rule;
+		const auto [end, ec] = std::from_chars(line.data(), line.data() + separator, rule.fingerprint, 16);
+		if (ec != std::errc() || end != line.data() + separator) {
+			return {};
+		}
+
+		const std::string_view path = std::string_view(line).substr(separator + 1);
+		rule.targetPath = std::filesystem::path(std::u8string(reinterpret_cast<const char8_t*>(path.data()), path.size())).wstring();
+		rules.push_back(std::move(rule));
+	}
+
+	return rules;
+}
+
+void Registry::saveFingerprints(const std::filesystem::path& hiveFileName, const std::vector<RuleFingerprint>& rules)
+{
+	std::string content;
+	for (const RuleFingerprint& rule : rules)
+	{
+		char hexFingerprint[16];
+		const auto [end, ec] = std::to_chars(std::begin(hexFingerprint), std::end(hexFingerprint), rule.fingerprint, 16);
+
+		const std::u8string path = std::filesystem::path(rule.targetPath).u8string();
+
+		content.append(hexFingerprint, end);
+		content += '\t';
+		content.append(reinterpret_cast<const char*>(path.data()), path.size());
+		content += '\n';
+	}
+
+	std::ofstream stream(getFingerprintFileName(hiveFileName), std::ios::out | std::ios::binary | std::ios::trunc);
+	stream.write(content.data(), content.size());
+	stream.flush();
+	if (stream.fail()) {
+		throw std::system_error(std::make_error_code(std::errc::io_error), "could not save the hive fingerprints");
+	}
+}
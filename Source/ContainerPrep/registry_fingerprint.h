@@ -0,0 +1,74 @@
+#pragma once
+
+#include "registry.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Registry
+{
+	/**
+	 * 64-bit FNV-1a hash, to tell whether the rules of a hive or the host keys they read have changed.
+	 */
+	class Fingerprint
+	{
+	public:
+		Fingerprint();
+
+		void add(std::span<const unsigned char> data);
+		void add(const std::string_view& str);
+		void add(const std::wstring_view& str);
+		void add(uint64_t number);
+
+		uint64_t get() const;
+
+	private:
+		uint64_t hash;
+	};
+
+	/**
+	 * Returns the fingerprint of a key and its subkeys, from their names, subkey and value counts and last write times.
+	 * Values are not read, a changed value is seen through the last write time of its key.
+	 * If a filter is specified, the subkeys it doesn't select are skipped as in copies.
+	 * Keys more than maxLevels below the key are not read, so their changes are not seen. The immediate subkeys are level 1.
+	 */
+	uint64_t fingerprintTree(IKeyManager& keyManager, const IKey* key, const ICopyFilter* filter = nullptr, size_t maxLevels = SIZE_MAX);
+
+	/**
+	 * Levels of subkeys fingerprinted below a host key copied without a filter. Walking a whole host subtree opens, queries
+	 * and enumerates every key of it on each run, changes further down are only copied when the hive is rebuilt.
+	 */
+	constexpr size_t HostKeyFingerprintLevels = 3;
+
+	/**
+	 * Fingerprint of a rule of a hive, stored with the path of the key it writes.
+	 */
+	struct RuleFingerprint
+	{
+		std::wstring targetPath;
+		uint64_t fingerprint = 0;
+	};
+
+	/**
+	 * Compares the rule fingerprints of a hive with those of its previous build. Marks the rules that changed, and the rules
+	 * to apply again: the changed rules and, in their order, the rules that write the same keys, so that later rules
+	 * still override earlier ones. Returns false if the hive must be rebuilt.
+	 */
+	bool selectChangedRules(const std::vector<RuleFingerprint>& previousRules, const std::vector<RuleFingerprint>& rules, std::vector<bool>& changedRules, std::vector<bool>& appliedRules);
+
+	/**
+	 * Returns the file that stores the rule fingerprints of a hive, next to the hive file.
+	 */
+	std::filesystem::path getFingerprintFileName(const std::filesystem::path& hiveFileName);
+
+	/**
+	 * Reads the rule fingerprints of a hive, in the order of the rules. Empty if they can't be read.
+	 */
+	std::vector<RuleFingerprint> loadFingerprints(const std::filesystem::path& hiveFileName);
+
+	void saveFingerprints(const std::filesystem::path& hiveFileName, const std::vector<RuleFingerprint>& rules);
+}
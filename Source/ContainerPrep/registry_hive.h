@@ -44,5 +44,10 @@ namespace Registry
 		virtual IHivePtr createHive(const std::filesystem::path& hiveFileName) = 0;
 		virtual IHivePtr loadHive(const std::filesystem::path& hiveFileName) = 0;
 		virtual void saveHive(const IHive& hive, const std::filesystem::path& hiveFileName) = 0;
+
+		/**
+		 * Writes a hive created with createHive to its file, once all its keys are set.
+		 */
+		virtual void commitHive(const IHive& hive) = 0;
 	};
 }
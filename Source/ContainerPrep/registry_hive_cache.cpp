@@ -0,0 +1,185 @@
+#include "registry_hive_cache.h"
+#include "registry_fingerprint.h"
+
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <system_error>
+
+using namespace Registry;
+
+HiveCache::HiveCache(const std::filesystem::path& inCacheDirectory, const std::wstring_view& hostBuild, const std::wstring_view& hiveFormat)
+	: cacheDirectory(inCacheDirectory)
+	, buildDirectory(inCacheDirectory / (hostBuild.empty() ? std::wstring_view(L"unknown") : hostBuild))
+	, formatDirectory(buildDirectory / hiveFormat)
+	, bOtherBuildsRemoved(false)
+{
+}
+
+std::filesystem::path HiveCache::getEntryFileName(const std::wstring_view& hiveName, uint64_t key) const
+{
+	char hexKey[16];
+	const auto [end, ec] = std::to_chars(std::begin(hexKey), std::end(hexKey), key, 16);
+
+	std::wstring entryName(hiveName);
+	entryName += L'_';
+	entryName.append(hexKey, end);
+	return formatDirectory / entryName;
+}
+
+bool HiveCache::restore(const std::wstring_view& hiveName, uint64_t key, const std::filesystem::path& hiveFileName)
+{
+	const auto startTime = std::chrono::steady_clock::now();
+	const std::filesystem::path entryFileName = getEntryFileName(hiveName, key);
+
+	// the file system may clone the blocks of the cached hive instead of copying them
+	std::error_code ec;
+	if (!std::filesystem::copy_file(entryFileName, hiveFileName, std::filesystem::copy_options::overwrite_existing, ec) || ec)
+	{
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		++report.misses;
+		return false;
+	}
+
+	// the build time is stored next to the hive, in milliseconds
+	std::filesystem::path timeFileName = entryFileName;
+	timeFileName += L".time";
+
+	std::ifstream timeStream(timeFileName, std::ios::in | std::ios::binary);
+	uint64_t buildMilliseconds = 0;
+	timeStream >> buildMilliseconds;
+
+	const auto savedTime = std::chrono::milliseconds(buildMilliseconds) - (std::chrono::steady_clock::now() - startTime);
+
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	++report.hits;
+	if (savedTime.count() > 0) {
+		report.savedTime += std::chrono::duration_cast<std::chrono::steady_clock::duration>(savedTime);
+	}
+
+	return true;
+}
+
+void HiveCache::store(const std::wstring_view& hiveName, uint64_t key, const std::filesystem::path& hiveFileName, std::chrono::steady_clock::duration buildTime)
+{
+	removeOtherBuilds();
+
+	std::error_code ec;
+	std::filesystem::create_directories(formatDirectory, ec);
+
+	const std::filesystem::path entryFileName = getEntryFileName(hiveName, key);
+
+	// containers prepared at the same time may store the same hive, each writes its own files before renaming them
+	Fingerprint partialSuffix;
+	partialSuffix.add(std::wstring_view(hiveFileName.wstring()));
+	const std::wstring partialExtension = L".partial" + std::to_wstring(partialSuffix.get());
+
+	std::filesystem::path partialFileName = entryFileName;
+	partialFileName += partialExtension;
+
+	if (!std::filesystem::copy_file(hiveFileName, partialFileName, std::filesystem::copy_options::overwrite_existing, ec) || ec)
+	{
+		std::filesystem::remove(partialFileName, ec);
+		return;
+	}
+
+	std::filesystem::rename(partialFileName, entryFileName, ec);
+	if (ec)
+	{
+		std::filesystem::remove(partialFileName, ec);
+		return;
+	}
+
+	// the time is written once the hive is in place, a hive restored without it saved no time
+	std::filesystem::path timeFileName = entryFileName;
+	timeFileName += L".time";
+
+	std::filesystem::path partialTimeFileName = timeFileName;
+	partialTimeFileName += partialExtension;
+
+	std::ofstream timeStream(partialTimeFileName, std::ios::out | std::ios::binary | std::ios::trunc);
+	timeStream << std::chrono::duration_cast<std::chrono::milliseconds>(buildTime).count();
+	timeStream.close();
+
+	if (timeStream) {
+		std::filesystem::rename(partialTimeFileName, timeFileName, ec);
+	}
+
+	if (!timeStream || ec) {
+		std::filesystem::remove(partialTimeFileName, ec);
+	}
+}
+
+void HiveCache::removeOtherBuilds()
+{
+	{
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		if (bOtherBuildsRemoved) {
+			return;
+		}
+
+		bOtherBuildsRemoved = true;
+	}
+
+	// the host was updated, the hives of its previous builds can't be restored anymore
+	std::error_code ec;
+	for (std::filesystem::directory_iterator it(cacheDirectory, ec), end; it != end; it.increment(ec))
+	{
+		if (ec) {
+			break;
+		}
+
+		if (it->path() != buildDirectory && it->is_directory(ec)) {
+			std::filesystem::remove_all(it->path(), ec);
+		}
+	}
+}
+
+HiveCacheReport HiveCache::getReport() const
+{
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	return report;
+}
+
+std::wstring HiveCache::readHostBuild(IRegistryManager& hostRegistry)
+{
+	try
+	{
+		IKeyManager& keyManager = hostRegistry.getKeyManager();
+		const IKeyPtr localMachine = keyManager.getPredefinedKey(L"HKLM");
+		if (!localMachine) {
+			return std::wstring();
+		}
+
+		const IKeyPtr versionKey = keyManager.getKey(L"SOFTWARE\\Microsoft\\Windows NT\\CurrentVersion", Permission::Read, localMachine.get());
+
+		ValueBatch values;
+		hostRegistry.getValueManager().readKeyValues(versionKey.get(), values);
+
+		const size_t buildIndex = values.find(L"CurrentBuildNumber");
+		const size_t ubrIndex = values.find(L"UBR");
+		if (buildIndex == values.size() || ubrIndex == values.size()) {
+			return std::wstring();
+		}
+
+		// the build number is a string, the update revision a DWORD
+		const std::span<const unsigned char> buildData = values[buildIndex].getRawData();
+		std::u16string build(buildData.size() / sizeof(char16_t), u'\0');
+		std::memcpy(build.data(), buildData.data(), build.size() * sizeof(char16_t));
+		build.resize(std::char_traits<char16_t>::length(build.c_str()));
+
+		const std::span<const unsigned char> ubrData = values[ubrIndex].getRawData();
+		if (ubrData.size() < sizeof(uint32_t)) {
+			return std::wstring();
+		}
+
+		uint32_t ubr;
+		std::memcpy(&ubr, ubrData.data(), sizeof(ubr));
+
+		return fromUtf16(build) + L'.' + std::to_wstring(ubr);
+	}
+	catch (const std::exception&)
+	{
+		return std::wstring();
+	}
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "registry.h"
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+namespace Registry
+{
+	struct HiveCacheReport
+	{
+		size_t hits = 0;
+		size_t misses = 0;
+
+		/** Time the restored hives took to build, minus the time to restore them. */
+		std::chrono::steady_clock::duration savedTime{};
+	};
+
+	/**
+	 * Hive files built on this host, shared by all the containers. Hives are stored by a key computed
+	 * from the fingerprints of their rules, in a directory per host build and hive format, so that a container
+	 * with the same settings, host keys and hive format as a previous one copies its hives instead of building them.
+	 * Errors are not reported, a hive that can't be restored is built.
+	 */
+	class HiveCache
+	{
+	public:
+		/**
+		 * The hive format names how the hive files are written, hives written differently are never restored in its place.
+		 */
+		HiveCache(const std::filesystem::path& inCacheDirectory, const std::wstring_view& hostBuild, const std::wstring_view& hiveFormat);
+
+		HiveCache(const HiveCache&) = delete;
+		HiveCache& operator=(const HiveCache&) = delete;
+
+		/**
+		 * Copies a cached hive to a hive file. Returns false if the hive isn't cached.
+		 */
+		bool restore(const std::wstring_view& hiveName, uint64_t key, const std::filesystem::path& hiveFileName);
+
+		/**
+		 * Adds a hive file to the cache, with the time taken to build it.
+		 * The hives of other host builds are removed with the first hive stored.
+		 */
+		void store(const std::wstring_view& hiveName, uint64_t key, const std::filesystem::path& hiveFileName, std::chrono::steady_clock::duration buildTime);
+
+		HiveCacheReport getReport() const;
+
+		/**
+		 * Returns the build of the host (CurrentBuildNumber.UBR), empty if it can't be read.
+		 */
+		static std::wstring readHostBuild(IRegistryManager& hostRegistry);
+
+	private:
+		std::filesystem::path getEntryFileName(const std::wstring_view& hiveName, uint64_t key) const;
+		void removeOtherBuilds();
+
+	private:
+		std::filesystem::path cacheDirectory;
+		std::filesystem::path buildDirectory;
+		std::filesystem::path formatDirectory;
+		HiveCacheReport report;
+		mutable std::mutex cacheMutex;
+		bool bOtherBuildsRemoved;
+	};
+}
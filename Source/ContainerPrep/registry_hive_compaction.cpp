@@ -0,0 +1,130 @@
+#include "registry_hive_compaction.h"
+#include "registry_hive_file_platform.h"
+#include "registry_regf_writer.h"
+
+#include <fstream>
+#include <system_error>
+#include <unordered_set>
+
+using namespace Registry;
+
+HiveReadStats Registry::readHive(const std::filesystem::path& hiveFileName)
+{
+	HiveReadStats stats;
+
+	const auto startTime = std::chrono::steady_clock::now();
+
+	const Platform::HiveFile::HiveImagePtr image = std::make_shared<Platform::HiveFile::HiveImage>(hiveFileName);
+
+	std::vector<uint32_t> pendingKeys{ image->getRootOffset() };
+
+	// a key listed twice would loop
+	std::unordered_set<uint32_t> keyOffsets{ image->getRootOffset() };
+
+	while (!pendingKeys.empty())
+	{
+		const uint32_t keyOffset = pendingKeys.back();
+		pendingKeys.pop_back();
+		stats.keys++;
+
+		image->visitValues(keyOffset, [&](uint32_t valueOffset)
+			{
+				const Platform::HiveFile::Value value(image, valueOffset);
+				for (unsigned char byte : value.getRawData()) {
+					stats.dataSum += byte;
+				}
+
+				stats.values++;
+				stats.dataBytes += value.getRawData().size();
+				return true;
+			});
+
+		image->visitSubKeys(keyOffset, [&](uint32_t subKeyOffset)
+			{
+				if (!keyOffsets.insert(subKeyOffset).second) {
+					throw std::system_error(std::make_error_code(std::errc::bad_message), "hive key listed more than once");
+				}
+
+				pendingKeys.push_back(subKeyOffset);
+				return true;
+			});
+	}
+
+	stats.readTime = std::chrono::steady_clock::now() - startTime;
+	return stats;
+}
+
+HiveCompaction Registry::compactHive(const std::filesystem::path& hiveFileName, const Regf::HiveLayout& layout)
+{
+	// a hive with changes in its logs is rejected when it is read
+	HiveCompaction compaction;
+	compaction.originalSize = std::filesystem::file_size(hiveFileName);
+
+	// both hives are timed once their file is cached
+	const HiveReadStats originalStats = readHive(hiveFileName);
+	compaction.originalReadTime = readHive(hiveFileName).readTime;
+
+	std::vector<unsigned char> image;
+	{
+		// the source is unmapped before it is replaced
+		const Platform::HiveFile::HiveImagePtr source = std::make_shared<Platform::HiveFile::HiveImage>(hiveFileName);
+
+		Regf::HiveWriter writer(Regf::getCurrentTimestamp(), layout);
+		image = writer.compact(source, hiveFileName.stem().wstring());
+	}
+
+	std::filesystem::path compactedFileName = hiveFileName;
+	compactedFileName += L".compact";
+
+	{
+		std::ofstream stream(compactedFileName, std::ios::out | std::ios::binary | std::ios::trunc);
+		stream.write(reinterpret_cast<const char*>(image.data()), image.size());
+		stream.flush();
+		if (stream.fail()) {
+			throw std::system_error(std::make_error_code(std::errc::io_error), "could not write compacted hive");
+		}
+	}
+
+	const HiveReadStats compactedStats = readHive(compactedFileName);
+	if (compactedStats.keys != originalStats.keys || compactedStats.values != originalStats.values || compactedStats.dataBytes != originalStats.dataBytes || compactedStats.dataSum != originalStats.dataSum)
+	{
+		std::filesystem::remove(compactedFileName);
+		throw std::system_error(std::make_error_code(std::errc::bad_message), "compacted hive doesn't match the hive");
+	}
+
+	std::filesystem::rename(compactedFileName, hiveFileName);
+
+	// the logs belong to the previous file
+	for (const wchar_t* logExtension : { L".LOG", L".LOG1", L".LOG2" })
+	{
+		std::filesystem::path logFileName = hiveFileName;
+		logFileName += logExtension;
+
+		std::error_code ec;
+		std::filesystem::remove(logFileName, ec);
+	}
+
+	compaction.compactedSize = image.size();
+	compaction.compactedReadTime = readHive(hiveFileName).readTime;
+
+	return compaction;
+}
+
+std::vector<std::wstring> Registry::readAccessedKeys(std::istream& stream)
+{
+	std::vector<std::wstring> keyPaths;
+
+	std::string line;
+	while (std::getline(stream, line))
+	{
+		if (!line.empty() && line.back() == '\r') {
+			line.pop_back();
+		}
+
+		if (!line.empty() && line[0] != '#') {
+			keyPaths.push_back(std::filesystem::path(std::u8string(reinterpret_cast<const char8_t*>(line.data()), line.size())).wstring());
+		}
+	}
+
+	return keyPaths;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "registry_regf.h"
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <istream>
+#include <string>
+#include <vector>
+
+namespace Registry
+{
+	/**
+	 * Keys and values read from a hive file, to compare a hive before and after it is compacted.
+	 */
+	struct HiveReadStats
+	{
+		size_t keys = 0;
+		size_t values = 0;
+		uint64_t dataBytes = 0;
+
+		/** Sum of the data bytes, changes if the data of any value changes. */
+		uint64_t dataSum = 0;
+
+		std::chrono::nanoseconds readTime{};
+	};
+
+	struct HiveCompaction
+	{
+		uint64_t originalSize = 0;
+		uint64_t compactedSize = 0;
+		std::chrono::nanoseconds originalReadTime{};
+		std::chrono::nanoseconds compactedReadTime{};
+	};
+
+	/**
+	 * Reads every key and value of a hive file through its mapping, the way it is loaded.
+	 */
+	HiveReadStats readHive(const std::filesystem::path& hiveFileName);
+
+	/**
+	 * Rewrites a hive file with its keys in the order of the layout and without free space.
+	 * The hive must not be loaded and its logs must have been written to it, they are deleted
+	 * with the previous file. The hive is kept if the compacted one doesn't read the same.
+	 */
+	HiveCompaction compactHive(const std::filesystem::path& hiveFileName, const Regf::HiveLayout& layout);
+
+	/**
+	 * Reads the paths of the keys of an access order, one per line in UTF-8. Lines starting with # are skipped.
+	 */
+	std::vector<std::wstring> readAccessedKeys(std::istream& stream);
+}
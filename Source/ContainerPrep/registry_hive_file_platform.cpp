@@ -0,0 +1,656 @@
+#include "registry_hive_file_platform.h"
+#include "registry_regf.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+
+using namespace Registry;
+
+static std::system_error corruptedHive(const char* message)
+{
+	return std::system_error(std::make_error_code(std::errc::bad_message), message);
+}
+
+static std::system_error readOnlyHive()
+{
+	return std::system_error(std::make_error_code(std::errc::read_only_file_system), "hive files are read-only");
+}
+
+static bool hasSignature(const std::span<const unsigned char>& cell, const char* signature)
+{
+	return cell.size() >= 2 && cell[0] == signature[0] && cell[1] == signature[1];
+}
+
+/**
+ * Compares a name stored in a cell, in Latin-1 or UTF-16, without decoding it.
+ */
+static bool isSameName(const std::span<const unsigned char>& storedName, bool compressed, const std::u16string_view& name)
+{
+	const size_t length = compressed ? storedName.size() : storedName.size() / sizeof(char16_t);
+	if (length != name.size()) {
+		return false;
+	}
+
+	for (size_t i = 0; i < length; ++i)
+	{
+		const char16_t ch = compressed ? storedName[i] : Regf::readUInt16(storedName.data() + i * sizeof(char16_t));
+		if (upcaseChar(ch) != upcaseChar(name[i])) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static std::wstring decodeName(const std::span<const unsigned char>& storedName, bool compressed)
+{
+	if (compressed) {
+		return std::wstring(storedName.begin(), storedName.end());
+	}
+
+	std::u16string name(storedName.size() / sizeof(char16_t), u'\0');
+	for (size_t i = 0; i < name.size(); ++i) {
+		name[i] = Regf::readUInt16(storedName.data() + i * sizeof(char16_t));
+	}
+
+	return fromUtf16(name);
+}
+
+static std::span<const unsigned char> getStoredKeyName(const std::span<const unsigned char>& keyCell, bool& compressed)
+{
+	compressed = (Regf::readUInt16(keyCell.data() + Regf::Key::Flags) & Regf::Key::CompressedName) != 0;
+	return keyCell.subspan(Regf::Key::Name, Regf::readUInt16(keyCell.data() + Regf::Key::NameLength));
+}
+
+static std::span<const unsigned char> getValueCell(const Platform::HiveFile::HiveImage& image, uint32_t offset)
+{
+	const std::span<const unsigned char> cell = image.getCell(offset);
+	if (cell.size() < Regf::Value::Name || !hasSignature(cell, "vk") || Regf::Value::Name + Regf::readUInt16(cell.data() + Regf::Value::NameLength) > cell.size()) {
+		throw corruptedHive("corrupted hive value");
+	}
+
+	return cell;
+}
+
+static std::span<const unsigned char> getStoredValueName(const std::span<const unsigned char>& valueCell, bool& compressed)
+{
+	compressed = (Regf::readUInt16(valueCell.data() + Regf::Value::Flags) & Regf::Value::CompressedName) != 0;
+	return valueCell.subspan(Regf::Value::Name, Regf::readUInt16(valueCell.data() + Regf::Value::NameLength));
+}
+
+Platform::HiveFile::HiveImage::HiveImage(const std::filesystem::path& fileName)
+	: file(fileName)
+	, rootOffset(Regf::NullOffset)
+{
+	const std::span<const unsigned char> data = file.getData();
+	if (data.size() < Regf::BaseBlockSize || std::memcmp(data.data() + Regf::BaseBlock::Signature, "regf", 4)) {
+		throw corruptedHive("not a hive file");
+	}
+
+	if (Regf::readUInt32(data.data() + Regf::BaseBlock::Checksum) != Regf::computeChecksum(data.first(Regf::BaseBlockSize))) {
+		throw corruptedHive("corrupted hive base block");
+	}
+
+	// the logs are not replayed, the hive would be read without their changes
+	if (Regf::readUInt32(data.data() + Regf::BaseBlock::PrimarySequence) != Regf::readUInt32(data.data() + Regf::BaseBlock::SecondarySequence)) {
+		throw std::system_error(std::make_error_code(std::errc::device_or_resource_busy), "hive has changes in its logs");
+	}
+
+	const uint32_t binsSize = Regf::readUInt32(data.data() + Regf::BaseBlock::BinsSize);
+	if (binsSize > data.size() - Regf::BaseBlockSize) {
+		throw corruptedHive("truncated hive file");
+	}
+
+	bins = data.subspan(Regf::BaseBlockSize, binsSize);
+	rootOffset = Regf::readUInt32(data.data() + Regf::BaseBlock::RootCell);
+
+	// throws if the root is not a key
+	getKeyCell(rootOffset);
+}
+
+uint32_t Platform::HiveFile::HiveImage::getRootOffset() const
+{
+	return rootOffset;
+}
+
+size_t Platform::HiveFile::HiveImage::getBinsSize() const
+{
+	return bins.size();
+}
+
+std::span<const unsigned char> Platform::HiveFile::HiveImage::getCell(uint32_t offset) const
+{
+	if (bins.size() < sizeof(uint32_t) || offset > bins.size() - sizeof(uint32_t)) {
+		throw corruptedHive("hive cell out of the file");
+	}
+
+	// allocated cells have a negative size
+	const uint32_t rawSize = Regf::readUInt32(bins.data() + offset);
+	if (!(rawSize & 0x80000000)) {
+		throw corruptedHive("hive cell is not allocated");
+	}
+
+	const uint32_t cellSize = 0u - rawSize;
+	if (cellSize < sizeof(uint32_t) || cellSize > bins.size() - offset) {
+		throw corruptedHive("corrupted hive cell");
+	}
+
+	return bins.subspan(offset + sizeof(uint32_t), cellSize - sizeof(uint32_t));
+}
+
+std::span<const unsigned char> Platform::HiveFile::HiveImage::getKeyCell(uint32_t offset) const
+{
+	const std::span<const unsigned char> cell = getCell(offset);
+	if (cell.size() < Regf::Key::Name || !hasSignature(cell, "nk") || Regf::Key::Name + Regf::readUInt16(cell.data() + Regf::Key::NameLength) > cell.size()) {
+		throw corruptedHive("corrupted hive key");
+	}
+
+	return cell;
+}
+
+uint32_t Platform::HiveFile::HiveImage::findSubKey(uint32_t keyOffset, const std::u16string_view& name) const
+{
+	uint32_t foundOffset = Regf::NullOffset;
+	visitSubKeys(keyOffset, [&](uint32_t subKeyOffset)
+		{
+			bool compressed;
+			const std::span<const unsigned char> subKeyName = getStoredKeyName(getKeyCell(subKeyOffset), compressed);
+			if (!isSameName(subKeyName, compressed, name)) {
+				return true;
+			}
+
+			foundOffset = subKeyOffset;
+			return false;
+		});
+
+	return foundOffset;
+}
+
+uint32_t Platform::HiveFile::HiveImage::findValue(uint32_t keyOffset, const std::u16string_view& name) const
+{
+	uint32_t foundOffset = Regf::NullOffset;
+	visitValues(keyOffset, [&](uint32_t valueOffset)
+		{
+			bool compressed;
+			const std::span<const unsigned char> valueName = getStoredValueName(getValueCell(*this, valueOffset), compressed);
+			if (!isSameName(valueName, compressed, name)) {
+				return true;
+			}
+
+			foundOffset = valueOffset;
+			return false;
+		});
+
+	return foundOffset;
+}
+
+bool Platform::HiveFile::HiveImage::visitSubKeys(uint32_t keyOffset, const std::function<bool(uint32_t subKeyOffset)>& visitor) const
+{
+	const std::span<const unsigned char> keyCell = getKeyCell(keyOffset);
+	if (!Regf::readUInt32(keyCell.data() + Regf::Key::SubKeyCount)) {
+		return true;
+	}
+
+	return visitSubKeyList(Regf::readUInt32(keyCell.data() + Regf::Key::SubKeyList), visitor, true);
+}
+
+bool Platform::HiveFile::HiveImage::visitSubKeyList(uint32_t listOffset, const std::function<bool(uint32_t subKeyOffset)>& visitor, bool bIndex) const
+{
+	const std::span<const unsigned char> cell = getCell(listOffset);
+	if (cell.size() < Regf::SubKeyList::Entries) {
+		throw corruptedHive("corrupted hive subkey list");
+	}
+
+	const bool bIndexRoot = hasSignature(cell, "ri");
+
+	// li and ri lists have offsets, lf and lh lists have an offset and a hash
+	size_t entrySize;
+	if (hasSignature(cell, "lf") || hasSignature(cell, "lh")) {
+		entrySize = Regf::SubKeyList::LeafEntrySize;
+	}
+	else if (hasSignature(cell, "li") || (bIndexRoot && bIndex)) {
+		entrySize = Regf::SubKeyList::IndexEntrySize;
+	}
+	else {
+		throw corruptedHive("corrupted hive subkey list");
+	}
+
+	const uint16_t count = Regf::readUInt16(cell.data() + Regf::SubKeyList::Count);
+	if (Regf::SubKeyList::Entries + count * entrySize > cell.size()) {
+		throw corruptedHive("corrupted hive subkey list");
+	}
+
+	for (uint16_t i = 0; i < count; ++i)
+	{
+		const uint32_t offset = Regf::readUInt32(cell.data() + Regf::SubKeyList::Entries + i * entrySize);
+
+		// index roots are not nested
+		const bool bContinue = bIndexRoot ? visitSubKeyList(offset, visitor, false) : std::invoke(visitor, offset);
+		if (!bContinue) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool Platform::HiveFile::HiveImage::visitValues(uint32_t keyOffset, const std::function<bool(uint32_t valueOffset)>& visitor) const
+{
+	const std::span<const unsigned char> keyCell = getKeyCell(keyOffset);
+	const uint32_t count = Regf::readUInt32(keyCell.data() + Regf::Key::ValueCount);
+	if (!count) {
+		return true;
+	}
+
+	const std::span<const unsigned char> list = getCell(Regf::readUInt32(keyCell.data() + Regf::Key::ValueList));
+	if (count > list.size() / sizeof(uint32_t)) {
+		throw corruptedHive("corrupted hive value list");
+	}
+
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		if (!std::invoke(visitor, Regf::readUInt32(list.data() + i * sizeof(uint32_t)))) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+Platform::HiveFile::Key::Key(const HiveImagePtr& inImage, uint32_t inOffset)
+	: image(inImage)
+	, offset(inOffset)
+{
+	bool compressed;
+	const std::span<const unsigned char> storedName = getStoredKeyName(image->getKeyCell(offset), compressed);
+	name = decodeName(storedName, compressed);
+}
+
+Platform::HiveFile::Key::Key(const std::wstring_view& predefinedName)
+	: offset(Regf::NullOffset)
+	, name(predefinedName)
+{
+}
+
+const wchar_t* Platform::HiveFile::Key::getKeyName() const
+{
+	return name.c_str();
+}
+
+bool Platform::HiveFile::Key::isPredefined() const
+{
+	return !image;
+}
+
+const Platform::HiveFile::HiveImagePtr& Platform::HiveFile::Key::getImage() const
+{
+	return image;
+}
+
+uint32_t Platform::HiveFile::Key::getOffset() const
+{
+	return offset;
+}
+
+Platform::HiveFile::Value::Value(const HiveImagePtr& inImage, uint32_t offset)
+	: image(inImage)
+{
+	const std::span<const unsigned char> cell = getValueCell(*image, offset);
+
+	bool compressed;
+	const std::span<const unsigned char> storedName = getStoredValueName(cell, compressed);
+	name = decodeName(storedName, compressed);
+	dataType = IDataType::findDataType(Regf::readUInt32(cell.data() + Regf::Value::Type));
+
+	const uint32_t dataSize = Regf::readUInt32(cell.data() + Regf::Value::DataSize);
+	if (dataSize & Regf::Value::InlineData)
+	{
+		// stored in place of the data offset
+		const uint32_t inlineSize = dataSize & ~Regf::Value::InlineData;
+		if (inlineSize > sizeof(uint32_t)) {
+			throw corruptedHive("corrupted hive value");
+		}
+
+		rawData = cell.subspan(Regf::Value::Data, inlineSize);
+		return;
+	}
+
+	if (!dataSize) {
+		return;
+	}
+
+	const std::span<const unsigned char> dataCell = image->getCell(Regf::readUInt32(cell.data() + Regf::Value::Data));
+	if (dataSize <= Regf::BigData::MaxSegmentSize || dataCell.size() < Regf::BigData::Size || !hasSignature(dataCell, "db"))
+	{
+		if (dataSize > dataCell.size()) {
+			throw corruptedHive("corrupted hive value");
+		}
+
+		rawData = dataCell.first(dataSize);
+		return;
+	}
+
+	// the segments are not contiguous in the file, this is the only copy
+	const uint16_t segmentCount = Regf::readUInt16(dataCell.data() + Regf::BigData::SegmentCount);
+	const std::span<const unsigned char> segmentList = image->getCell(Regf::readUInt32(dataCell.data() + Regf::BigData::SegmentList));
+	if (segmentCount > segmentList.size() / sizeof(uint32_t)) {
+		throw corruptedHive("corrupted hive value");
+	}
+
+	ownedData.reserve(dataSize);
+	for (uint16_t i = 0; i < segmentCount && ownedData.size() < dataSize; ++i)
+	{
+		const std::span<const unsigned char> segment = image->getCell(Regf::readUInt32(segmentList.data() + i * sizeof(uint32_t)));
+		const size_t segmentSize = std::min<size_t>({ segment.size(), Regf::BigData::MaxSegmentSize, dataSize - ownedData.size() });
+		ownedData.insert(ownedData.end(), segment.begin(), segment.begin() + segmentSize);
+	}
+
+	if (ownedData.size() != dataSize) {
+		throw corruptedHive("corrupted hive value");
+	}
+
+	rawData = ownedData;
+}
+
+const wchar_t* Platform::HiveFile::Value::getValueName() const
+{
+	return name.c_str();
+}
+
+const IDataType& Platform::HiveFile::Value::getType() const
+{
+	return *dataType;
+}
+
+std::span<const unsigned char> Platform::HiveFile::Value::getRawData() const
+{
+	return rawData;
+}
+
+void Platform::HiveFile::Value::setRawData(const std::span<const unsigned char>& data)
+{
+	ownedData.assign(data.begin(), data.end());
+	rawData = ownedData;
+}
+
+Platform::HiveFile::Hive::Hive(const HiveImagePtr& inImage, std::wstring&& name)
+	: image(inImage)
+	, hiveName(std::move(name))
+{
+}
+
+const wchar_t* Platform::HiveFile::Hive::getHiveName() const
+{
+	return hiveName.c_str();
+}
+
+IKeyPtr Platform::HiveFile::Hive::getRootKey() const
+{
+	return std::make_shared<HiveFile::Key>(image, image->getRootOffset());
+}
+
+Platform::HiveFile::KeyManager::KeyManager(const std::filesystem::path& inHiveDirectory)
+	: hiveDirectory(inHiveDirectory)
+{
+}
+
+IKeyPtr Platform::HiveFile::KeyManager::getKey(const wchar_t* keyName, Permission permissions, const IKey* parentKey)
+{
+	if (!parentKey) {
+		throw std::invalid_argument("null key");
+	}
+
+	const HiveFile::Key& fileKey = static_cast<const HiveFile::Key&>(*parentKey);
+
+	HiveImagePtr image = fileKey.getImage();
+	uint32_t offset = fileKey.getOffset();
+	Helpers::forEachPathComponent(keyName, [&](std::wstring_view name)
+		{
+			if (offset == Regf::NullOffset && image) {
+				return;
+			}
+
+			if (!image)
+			{
+				// the first component below a predefined key names the hive, HKU\.DEFAULT is saved as DEFAULT
+				if (name.front() == L'.') {
+					name.remove_prefix(1);
+				}
+
+				image = getImage(name);
+				offset = image->getRootOffset();
+				return;
+			}
+
+			offset = image->findSubKey(offset, toUtf16(name));
+		});
+
+	if (!image) {
+		return std::make_shared<HiveFile::Key>(fileKey.getKeyName());
+	}
+
+	if (offset == Regf::NullOffset) {
+		throw std::system_error(std::make_error_code(std::errc::no_such_file_or_directory), "couldn't open registry key");
+	}
+
+	return std::make_shared<HiveFile::Key>(image, offset);
+}
+
+IKeyPtr Platform::HiveFile::KeyManager::getOrCreateKey(const wchar_t* keyName, Permission permissions, const IKey* parentKey)
+{
+	throw readOnlyHive();
+}
+
+IKeyPtr Platform::HiveFile::KeyManager::getPredefinedKey(const wchar_t* rootName)
+{
+	// the hives of these keys are files of the directory
+	if (!compareNames(rootName, L"HKLM") || !compareNames(rootName, L"HKU")) {
+		return std::make_shared<HiveFile::Key>(rootName);
+	}
+
+	return nullptr;
+}
+
+void Platform::HiveFile::KeyManager::copyTree(const IKey* sourceKey, const IKey* targetKey, const ICopyFilter* filter, size_t maxDepth)
+{
+	throw readOnlyHive();
+}
+
+KeyInfo Platform::HiveFile::KeyManager::queryKeyInfo(const IKey* key)
+{
+	if (!key) {
+		throw std::invalid_argument("null key");
+	}
+
+	const HiveFile::Key& fileKey = static_cast<const HiveFile::Key&>(*key);
+
+	KeyInfo info;
+	if (fileKey.isPredefined()) {
+		return info;
+	}
+
+	const std::span<const unsigned char> keyCell = fileKey.getImage()->getKeyCell(fileKey.getOffset());
+	info.subKeyCount = Regf::readUInt32(keyCell.data() + Regf::Key::SubKeyCount);
+	info.valueCount = Regf::readUInt32(keyCell.data() + Regf::Key::ValueCount);
+	info.lastWriteTime = Regf::readUInt64(keyCell.data() + Regf::Key::Timestamp);
+	return info;
+}
+
+void Platform::HiveFile::KeyManager::deleteKey(const IKey* parentKey, const wchar_t* subKeyName)
+{
+	throw readOnlyHive();
+}
+
+bool Platform::HiveFile::KeyManager::visitKeys(const IKey* key, const KeyVisitor& visitor, size_t maxDepth)
+{
+	if (!key) {
+		throw std::invalid_argument("null key");
+	}
+
+	const HiveFile::Key& fileKey = static_cast<const HiveFile::Key&>(*key);
+	if (fileKey.isPredefined()) {
+		return true;
+	}
+
+	return visitKeysInternal(fileKey, visitor, maxDepth, 0);
+}
+
+bool Platform::HiveFile::KeyManager::visitKeysInternal(const Key& key, const KeyVisitor& visitor, size_t currentDepth, size_t level)
+{
+	// a subkey list pointing back to a parent would never end
+	if (level >= MaxKeyDepth) {
+		throw corruptedHive("hive keys are nested too deep");
+	}
+
+	return key.getImage()->visitSubKeys(key.getOffset(), [&](uint32_t subKeyOffset)
+		{
+			const HiveFile::Key subKey(key.getImage(), subKeyOffset);
+			if (!std::invoke(visitor, &key, subKey.getKeyName()))
+			{
+				// stop enumerating
+				return false;
+			}
+
+			return currentDepth == 0 || visitKeysInternal(subKey, visitor, currentDepth - 1, level + 1);
+		});
+}
+
+Platform::HiveFile::HiveImagePtr Platform::HiveFile::KeyManager::getImage(const std::wstring_view& hiveName)
+{
+	std::lock_guard<std::mutex> lock(imagesMutex);
+
+	HiveImagePtr& image = images[foldName(hiveName)];
+	if (!image) {
+		image = std::make_shared<HiveImage>(hiveDirectory / hiveName);
+	}
+
+	return image;
+}
+
+IValuePtr Platform::HiveFile::ValueManager::getValue(const IKey* key, const wchar_t* valueName)
+{
+	if (!key) {
+		throw std::invalid_argument("null key");
+	}
+
+	const HiveFile::Key& fileKey = static_cast<const HiveFile::Key&>(*key);
+
+	uint32_t offset = Regf::NullOffset;
+	if (!fileKey.isPredefined()) {
+		offset = fileKey.getImage()->findValue(fileKey.getOffset(), toUtf16(valueName ? valueName : L""));
+	}
+
+	if (offset == Regf::NullOffset) {
+		throw std::system_error(std::make_error_code(std::errc::no_such_file_or_directory), "couldn't open registry value");
+	}
+
+	return std::make_shared<HiveFile::Value>(fileKey.getImage(), offset);
+}
+
+IValuePtr Platform::HiveFile::ValueManager::newValue(const wchar_t* valueName, const IDataType& dataType)
+{
+	throw readOnlyHive();
+}
+
+void Platform::HiveFile::ValueManager::setValue(const IKey* key, const IValue& value)
+{
+	throw readOnlyHive();
+}
+
+bool Platform::HiveFile::ValueManager::visitKeyValues(const IKey* key, const ValueVisitor& visitor)
+{
+	if (!key) {
+		throw std::invalid_argument("null key");
+	}
+
+	const HiveFile::Key& fileKey = static_cast<const HiveFile::Key&>(*key);
+	if (fileKey.isPredefined()) {
+		return true;
+	}
+
+	const HiveImagePtr& image = fileKey.getImage();
+	return image->visitValues(fileKey.getOffset(), [&](uint32_t valueOffset)
+		{
+			const HiveFile::Value value(image, valueOffset);
+			return std::invoke(visitor, value);
+		});
+}
+
+void Platform::HiveFile::ValueManager::readKeyValues(const IKey* key, ValueBatch& batch)
+{
+	if (!key) {
+		throw std::invalid_argument("null key");
+	}
+
+	batch.clear();
+
+	const HiveFile::Key& fileKey = static_cast<const HiveFile::Key&>(*key);
+	if (fileKey.isPredefined()) {
+		return;
+	}
+
+	const HiveImagePtr& image = fileKey.getImage();
+	image->visitValues(fileKey.getOffset(), [&](uint32_t valueOffset)
+		{
+			const HiveFile::Value value(image, valueOffset);
+			batch.add(value.getValueName(), value.getType(), value.getRawData());
+			return true;
+		});
+}
+
+IHivePtr Platform::HiveFile::HiveManager::createHive(const std::filesystem::path& hiveFileName)
+{
+	throw readOnlyHive();
+}
+
+IHivePtr Platform::HiveFile::HiveManager::loadHive(const std::filesystem::path& hiveFileName)
+{
+	return std::make_shared<HiveFile::Hive>(std::make_shared<HiveImage>(hiveFileName), hiveFileName.filename().wstring());
+}
+
+void Platform::HiveFile::HiveManager::saveHive(const IHive& hive, const std::filesystem::path& hiveFileName)
+{
+	throw readOnlyHive();
+}
+
+void Platform::HiveFile::HiveManager::commitHive(const IHive& hive)
+{
+	throw readOnlyHive();
+}
+
+Platform::HiveFile::RegistryManager::RegistryManager(const std::filesystem::path& hiveDirectory)
+	: keyManager(hiveDirectory)
+{
+}
+
+IKeyManager& Platform::HiveFile::RegistryManager::getKeyManager()
+{
+	return keyManager;
+}
+
+const IKeyManager& Platform::HiveFile::RegistryManager::getKeyManager() const
+{
+	return keyManager;
+}
+
+IValueManager& Platform::HiveFile::RegistryManager::getValueManager()
+{
+	return valueManager;
+}
+
+const IValueManager& Platform::HiveFile::RegistryManager::getValueManager() const
+{
+	return valueManager;
+}
+
+IHiveManager& Platform::HiveFile::RegistryManager::getHiveManager()
+{
+	return hiveManager;
+}
+
+const IHiveManager& Platform::HiveFile::RegistryManager::getHiveManager() const
+{
+	return hiveManager;
+}
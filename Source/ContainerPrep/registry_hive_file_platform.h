@@ -0,0 +1,206 @@
+#pragma once
+
+#include "registry.h"
+#include "mapped_file.h"
+
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Registry
+{
+	namespace Platform
+	{
+		/**
+		 * Read-only registry over hive files mapped in memory, such as hives saved from the host
+		 * or the Config directory of an offline Windows image. Hive logs are not replayed.
+		 */
+		namespace HiveFile
+		{
+			/**
+			 * Cells of a hive file, read in place. Offsets out of the file or malformed cells throw.
+			 */
+			class HiveImage
+			{
+			public:
+				HiveImage(const std::filesystem::path& fileName);
+
+				HiveImage(const HiveImage&) = delete;
+				HiveImage& operator=(const HiveImage&) = delete;
+
+				uint32_t getRootOffset() const;
+
+				/**
+				 * Returns the size of the hive bins, free cells included.
+				 */
+				size_t getBinsSize() const;
+
+				/**
+				 * Returns the data of an allocated cell.
+				 */
+				std::span<const unsigned char> getCell(uint32_t offset) const;
+
+				/**
+				 * Returns the key node cell at an offset, after checking it.
+				 */
+				std::span<const unsigned char> getKeyCell(uint32_t offset) const;
+
+				/**
+				 * Returns the offset of a subkey, or Regf::NullOffset.
+				 */
+				uint32_t findSubKey(uint32_t keyOffset, const std::u16string_view& name) const;
+
+				/**
+				 * Returns the offset of a value, or Regf::NullOffset. The default value has an empty name.
+				 */
+				uint32_t findValue(uint32_t keyOffset, const std::u16string_view& name) const;
+
+				bool visitSubKeys(uint32_t keyOffset, const std::function<bool(uint32_t subKeyOffset)>& visitor) const;
+				bool visitValues(uint32_t keyOffset, const std::function<bool(uint32_t valueOffset)>& visitor) const;
+
+			private:
+				bool visitSubKeyList(uint32_t listOffset, const std::function<bool(uint32_t subKeyOffset)>& visitor, bool bIndex) const;
+
+			private:
+				MappedFile file;
+				std::span<const unsigned char> bins;
+				uint32_t rootOffset;
+			};
+			using HiveImagePtr = std::shared_ptr<const HiveImage>;
+
+			/**
+			 * Key of a hive, or a predefined key (HKLM, HKU) whose subkeys are the hive files.
+			 */
+			class Key : public IKey
+			{
+			public:
+				Key(const HiveImagePtr& inImage, uint32_t inOffset);
+				Key(const std::wstring_view& predefinedName);
+
+				const wchar_t* getKeyName() const override;
+
+				bool isPredefined() const;
+				const HiveImagePtr& getImage() const;
+				uint32_t getOffset() const;
+
+			private:
+				HiveImagePtr image;
+				uint32_t offset;
+				std::wstring name;
+			};
+
+			/**
+			 * Value read from a hive, its data is a view of the hive file.
+			 */
+			class Value : public IValue
+			{
+			public:
+				Value(const HiveImagePtr& inImage, uint32_t offset);
+
+				// the data may point to the value itself
+				Value(const Value&) = delete;
+				Value& operator=(const Value&) = delete;
+
+				const wchar_t* getValueName() const override;
+				const IDataType& getType() const override;
+
+				std::span<const unsigned char> getRawData() const override;
+				void setRawData(const std::span<const unsigned char>& data) override;
+
+			private:
+				HiveImagePtr image;
+				std::wstring name;
+				const IDataType* dataType;
+				std::span<const unsigned char> rawData;
+
+				/** Data split in segments, or set after reading. */
+				std::vector<unsigned char> ownedData;
+			};
+
+			class Hive : public IHive
+			{
+			public:
+				Hive(const HiveImagePtr& inImage, std::wstring&& name);
+
+				const wchar_t* getHiveName() const override;
+				IKeyPtr getRootKey() const override;
+
+			private:
+				HiveImagePtr image;
+				std::wstring hiveName;
+			};
+
+			class KeyManager : public IKeyManager
+			{
+			public:
+				KeyManager(const std::filesystem::path& inHiveDirectory);
+
+				IKeyPtr getKey(const wchar_t* keyName, Permission permissions, const IKey* parentKey) override;
+				IKeyPtr getOrCreateKey(const wchar_t* keyName, Permission permissions, const IKey* parentKey) override;
+				IKeyPtr getPredefinedKey(const wchar_t* rootName) override;
+				bool visitKeys(const IKey* key, const KeyVisitor& visitor, size_t maxDepth = SIZE_MAX) override;
+				void copyTree(const IKey* sourceKey, const IKey* targetKey, const ICopyFilter* filter = nullptr, size_t maxDepth = SIZE_MAX) override;
+				KeyInfo queryKeyInfo(const IKey* key) override;
+				void deleteKey(const IKey* parentKey, const wchar_t* subKeyName) override;
+
+				/**
+				 * Maps a hive file of the directory, once.
+				 */
+				HiveImagePtr getImage(const std::wstring_view& hiveName);
+
+			private:
+				bool visitKeysInternal(const Key& key, const KeyVisitor& visitor, size_t currentDepth, size_t level);
+
+			private:
+				std::filesystem::path hiveDirectory;
+				std::map<std::wstring, HiveImagePtr> images;
+				std::mutex imagesMutex;
+			};
+
+			class ValueManager : public IValueManager
+			{
+			public:
+				IValuePtr getValue(const IKey* key, const wchar_t* valueName) override;
+				IValuePtr newValue(const wchar_t* valueName, const IDataType& dataType) override;
+				void setValue(const IKey* key, const IValue& value) override;
+				bool visitKeyValues(const IKey* key, const ValueVisitor& visitor) override;
+				void readKeyValues(const IKey* key, ValueBatch& batch) override;
+			};
+
+			class HiveManager : public IHiveManager
+			{
+			public:
+				IHivePtr createHive(const std::filesystem::path& hiveFileName) override;
+				IHivePtr loadHive(const std::filesystem::path& hiveFileName) override;
+				void saveHive(const IHive& hive, const std::filesystem::path& hiveFileName) override;
+				void commitHive(const IHive& hive) override;
+			};
+
+			class RegistryManager : public IRegistryManager
+			{
+			public:
+				/**
+				 * Reads the hives of a directory, named as in System32\config (SYSTEM, SOFTWARE, DEFAULT...).
+				 */
+				RegistryManager(const std::filesystem::path& hiveDirectory);
+
+				virtual IKeyManager& getKeyManager() override;
+				virtual const IKeyManager& getKeyManager() const override;
+
+				virtual IValueManager& getValueManager() override;
+				virtual const IValueManager& getValueManager() const override;
+
+				virtual IHiveManager& getHiveManager() override;
+				virtual const IHiveManager& getHiveManager() const override;
+
+			private:
+				KeyManager keyManager;
+				ValueManager valueManager;
+				HiveManager hiveManager;
+			};
+		}
+	}
+}
@@ -0,0 +1,201 @@
+#include "registry_host_key_filter.h"
+
+#include <algorithm>
+#include <charconv>
+#include <stdexcept>
+
+using namespace Registry;
+
+/**
+ * Splits a key path into the names of its keys, an empty path has none.
+ */
+static std::vector<std::wstring_view> splitPath(const std::wstring_view& path)
+{
+	std::vector<std::wstring_view> keyNames;
+	for (size_t start = 0; start < path.size();)
+	{
+		const size_t end = std::min(path.find(L'\\', start), path.size());
+		if (end > start) {
+			keyNames.push_back(path.substr(start, end - start));
+		}
+
+		start = end + 1;
+	}
+
+	return keyNames;
+}
+
+/**
+ * Matches a folded name against a folded pattern, * matches any run of characters and ? any single character.
+ */
+static bool matchName(const std::wstring_view& pattern, const std::wstring_view& name)
+{
+	size_t patternIndex = 0;
+	size_t nameIndex = 0;
+
+	// position of the last * and of the name where it started matching, to backtrack to
+	size_t starIndex = std::wstring_view::npos;
+	size_t starNameIndex = 0;
+
+	while (nameIndex < name.size())
+	{
+		if (patternIndex < pattern.size() && (pattern[patternIndex] == L'?' || pattern[patternIndex] == name[nameIndex]))
+		{
+			patternIndex++;
+			nameIndex++;
+		}
+		else if (patternIndex < pattern.size() && pattern[patternIndex] == L'*')
+		{
+			starIndex = patternIndex++;
+			starNameIndex = nameIndex;
+		}
+		else if (starIndex != std::wstring_view::npos)
+		{
+			patternIndex = starIndex + 1;
+			nameIndex = ++starNameIndex;
+		}
+		else {
+			return false;
+		}
+	}
+
+	while (patternIndex < pattern.size() && pattern[patternIndex] == L'*') {
+		patternIndex++;
+	}
+
+	return patternIndex == pattern.size();
+}
+
+static bool matchAnyName(const std::vector<std::wstring>& patterns, const std::wstring_view& name)
+{
+	return std::any_of(patterns.begin(), patterns.end(), [&name](const std::wstring& pattern) { return matchName(pattern, name); });
+}
+
+Config::HostKeyFilter::PathPattern Config::HostKeyFilter::makePathPattern(const std::wstring_view& keyPath, const char* settingName)
+{
+	// a path of separators names no key, it would match them all
+	const std::wstring foldedPath = foldName(keyPath);
+	const std::vector<std::wstring_view> keyNames = splitPath(foldedPath);
+	if (keyNames.empty()) {
+		throw std::runtime_error(std::string(settingName) + " without Path");
+	}
+
+	return PathPattern(keyNames.begin(), keyNames.end());
+}
+
+void Config::HostKeyFilter::addInclude(const std::wstring_view& keyPath)
+{
+	includes.push_back(makePathPattern(keyPath, "Include"));
+}
+
+void Config::HostKeyFilter::addExclude(const std::wstring_view& keyPath)
+{
+	excludes.push_back(makePathPattern(keyPath, "Exclude"));
+}
+
+void Config::HostKeyFilter::addIncludeValue(const std::wstring_view& valueName)
+{
+	if (valueName.empty()) {
+		throw std::runtime_error("IncludeValue without Name");
+	}
+
+	includedValues.push_back(foldName(valueName));
+}
+
+void Config::HostKeyFilter::addExcludeValue(const std::wstring_view& valueName)
+{
+	if (valueName.empty()) {
+		throw std::runtime_error("ExcludeValue without Name");
+	}
+
+	excludedValues.push_back(foldName(valueName));
+}
+
+void Config::HostKeyFilter::setMaxLevels(size_t inMaxLevels)
+{
+	maxLevels = inMaxLevels;
+}
+
+size_t Config::HostKeyFilter::parseMaxLevels(const std::string_view& maxDepth)
+{
+	size_t levels = 0;
+	const auto [end, ec] = std::from_chars(maxDepth.data(), maxDepth.data() + maxDepth.size(), levels);
+	if (maxDepth.empty() || ec != std::errc() || end != maxDepth.data() + maxDepth.size()) {
+		throw std::runtime_error("invalid MaxDepth \"" + std::string(maxDepth) + "\", expected a number of subkey levels");
+	}
+
+	return levels;
+}
+
+bool Config::HostKeyFilter::isIncluded(const std::vector<std::wstring_view>& keyNames, bool bLeadingKeys) const
+{
+	// a path pattern matches the keys of its length at the start of the path
+	const auto matchPath = [&keyNames](const PathPattern& pattern, size_t length)
+		{
+			for (size_t i = 0; i < length; ++i)
+			{
+				if (!matchName(pattern[i], keyNames[i])) {
+					return false;
+				}
+			}
+
+			return true;
+		};
+
+	for (const PathPattern& exclude : excludes)
+	{
+		if (exclude.size() <= keyNames.size() && matchPath(exclude, exclude.size())) {
+			return false;
+		}
+	}
+
+	if (includes.empty()) {
+		return true;
+	}
+
+	for (const PathPattern& include : includes)
+	{
+		if (include.size() <= keyNames.size() || bLeadingKeys)
+		{
+			if (matchPath(include, std::min(include.size(), keyNames.size()))) {
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+bool Config::HostKeyFilter::includeKey(const std::wstring_view& keyPath) const
+{
+	const std::wstring foldedPath = foldName(keyPath);
+	const std::vector<std::wstring_view> keyNames = splitPath(foldedPath);
+	if (keyNames.size() > maxLevels) {
+		return false;
+	}
+
+	return isIncluded(keyNames, true);
+}
+
+bool Config::HostKeyFilter::includeValue(const std::wstring_view& keyPath, const std::wstring_view& valueName) const
+{
+	if (!includedValues.empty() || !excludedValues.empty())
+	{
+		const std::wstring foldedName = foldName(valueName);
+		if (!includedValues.empty() && !matchAnyName(includedValues, foldedName)) {
+			return false;
+		}
+
+		if (matchAnyName(excludedValues, foldedName)) {
+			return false;
+		}
+	}
+
+	// the keys leading to an included key are copied without their values
+	if (includes.empty()) {
+		return true;
+	}
+
+	const std::wstring foldedPath = foldName(keyPath);
+	return isIncluded(splitPath(foldedPath), false);
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "registry.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Registry
+{
+	namespace Config
+	{
+		/**
+		 * Subkeys and values of a host key that are copied. Key paths are relative to the host key,
+		 * names and paths may contain * and ? wildcards, which don't match across a backslash.
+		 * Excluded keys and keys below the maximum level are never read, nor are the keys outside the included ones.
+		 * An empty path or name would select every key or value, it throws instead.
+		 */
+		class HostKeyFilter : public ICopyFilter
+		{
+		public:
+			/**
+			 * Once a key is included, only the included keys, the keys below them and the keys leading to them are copied,
+			 * and only the values of the included keys and the keys below them.
+			 */
+			void addInclude(const std::wstring_view& keyPath);
+			void addExclude(const std::wstring_view& keyPath);
+
+			/**
+			 * Once a value name is included, only the values of the included names are copied.
+			 */
+			void addIncludeValue(const std::wstring_view& valueName);
+			void addExcludeValue(const std::wstring_view& valueName);
+
+			/**
+			 * Levels of subkeys copied, 0 to only copy the values of the host key.
+			 * Unlike the maxDepth of visitKeys and copyTree, the immediate subkeys are level 1.
+			 */
+			void setMaxLevels(size_t inMaxLevels);
+
+			/**
+			 * Reads the levels of a MaxDepth setting, throws if it isn't a number.
+			 */
+			static size_t parseMaxLevels(const std::string_view& maxDepth);
+
+			bool includeKey(const std::wstring_view& keyPath) const override;
+			bool includeValue(const std::wstring_view& keyPath, const std::wstring_view& valueName) const override;
+
+		private:
+			/** Folded names of the keys of a path. */
+			using PathPattern = std::vector<std::wstring>;
+
+			static PathPattern makePathPattern(const std::wstring_view& keyPath, const char* settingName);
+			bool isIncluded(const std::vector<std::wstring_view>& keyNames, bool bLeadingKeys) const;
+
+		private:
+			std::vector<PathPattern> includes;
+			std::vector<PathPattern> excludes;
+			std::vector<std::wstring> includedValues;
+			std::vector<std::wstring> excludedValues;
+			size_t maxLevels = SIZE_MAX;
+		};
+		using HostKeyFilterPtr = std::shared_ptr<const HostKeyFilter>;
+	}
+}
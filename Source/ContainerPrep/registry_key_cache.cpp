@@ -0,0 +1,56 @@
+#include "registry_key_cache.h"
+
+using namespace Registry;
+
+KeyCache::KeyCache(IKeyManager& inKeyManager, const IKeyPtr& inRootKey, Permission inPermissions, bool bInCreateKeys)
+	: keyManager(inKeyManager)
+	, permissions(inPermissions)
+	, bCreateKeys(bInCreateKeys)
+{
+	root.key = inRootKey;
+}
+
+IKeyPtr KeyCache::getKey(const std::wstring_view& path)
+{
+	Node* node = &root;
+	Helpers::forEachPathComponent(path, [&](const std::wstring_view& name)
+		{
+			std::unique_ptr<Node>& child = node->children[foldName(name)];
+			if (!child)
+			{
+				// a key that failed to open leaves an empty entry, it is opened again next time
+				const std::wstring keyName(name);
+				IKeyPtr key = bCreateKeys
+					? keyManager.getOrCreateKey(keyName.c_str(), permissions, node->key.get())
+					: keyManager.getKey(keyName.c_str(), permissions, node->key.get());
+
+				child = std::make_unique<Node>();
+				child->key = std::move(key);
+			}
+
+			node = child.get();
+		});
+
+	return node->key;
+}
+
+IKeyPtr KeyCache::findKey(const std::wstring_view& path)
+{
+	if (!root.key) {
+		return nullptr;
+	}
+
+	try
+	{
+		return getKey(path);
+	}
+	catch (const std::exception&)
+	{
+		return nullptr;
+	}
+}
+
+void KeyCache::clear()
+{
+	root.children.clear();
+}
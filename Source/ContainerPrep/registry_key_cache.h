@@ -0,0 +1,59 @@
+#pragma once
+
+#include "registry.h"
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace Registry
+{
+	/**
+	 * Keys opened below a root key, by path. Each path component is opened once from its parent,
+	 * so paths sharing a prefix are opened from their deepest cached ancestor.
+	 * The keys stay open until the cache is cleared or destroyed.
+	 */
+	class KeyCache
+	{
+	public:
+		/**
+		 * If keys are created, missing keys of a path are created instead of failing.
+		 */
+		KeyCache(IKeyManager& inKeyManager, const IKeyPtr& inRootKey, Permission inPermissions, bool bInCreateKeys);
+
+		KeyCache(const KeyCache&) = delete;
+		KeyCache& operator=(const KeyCache&) = delete;
+
+		/**
+		 * Returns the key of a path relative to the root key, the root key itself for an empty path.
+		 * Throws if the key can't be opened.
+		 */
+		IKeyPtr getKey(const std::wstring_view& path);
+
+		/**
+		 * Returns the key of a path, or nullptr if it can't be opened.
+		 */
+		IKeyPtr findKey(const std::wstring_view& path);
+
+		/**
+		 * Closes every key opened by the cache, the root key is kept.
+		 */
+		void clear();
+
+	private:
+		struct Node
+		{
+			IKeyPtr key;
+
+			/** Subkeys by case-folded name. */
+			std::unordered_map<std::wstring, std::unique_ptr<Node>> children;
+		};
+
+	private:
+		IKeyManager& keyManager;
+		Node root;
+		Permission permissions;
+		bool bCreateKeys;
+	};
+}
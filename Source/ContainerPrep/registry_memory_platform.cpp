@@ -0,0 +1,664 @@
+#include "registry_memory_platform.h"
+#include "registry_hive_file_platform.h"
+#include "registry_regf_writer.h"
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+#include <system_error>
+
+using namespace Registry;
+
+static const Platform::Memory::Key& getMemoryKey(const IKey* key)
+{
+	if (!key) {
+		throw std::invalid_argument("null key");
+	}
+
+	return *static_cast<const Platform::Memory::Key*>(key);
+}
+
+Platform::Memory::Value::Value(const std::wstring_view& valueName, const IDataType& type)
+	: name(valueName)
+	, dataType(&type)
+{
+}
+
+Platform::Memory::Value::Value(const std::wstring_view& valueName, const IDataType& type, const std::span<const unsigned char>& data)
+	: name(valueName)
+	, dataType(&type)
+	, rawData(data)
+{
+}
+
+const wchar_t* Platform::Memory::Value::getValueName() const
+{
+	return name.c_str();
+}
+
+const IDataType& Platform::Memory::Value::getType() const
+{
+	return *dataType;
+}
+
+std::span<const unsigned char> Platform::Memory::Value::getRawData() const
+{
+	return rawData.get();
+}
+
+void Platform::Memory::Value::setRawData(const std::span<const unsigned char>& data)
+{
+	rawData.assign(data);
+}
+
+ValueView Platform::Memory::KeyValue::getView() const
+{
+	return ValueView(name, *type, data.get());
+}
+
+bool Platform::Memory::KeyTree::ChildName::operator==(const ChildName& other) const
+{
+	return parent == other.parent && foldedName == other.foldedName;
+}
+
+size_t Platform::Memory::KeyTree::ChildNameHasher::operator()(const ChildName& childName) const
+{
+	return std::hash<std::wstring>()(childName.foldedName) ^ (std::hash<const void*>()(childName.parent) * 31);
+}
+
+Platform::Memory::KeyTree::KeyTree()
+{
+	nodes.emplace_back();
+}
+
+Platform::Memory::KeyNode* Platform::Memory::KeyTree::getRoot()
+{
+	return &nodes.front();
+}
+
+const Platform::Memory::KeyNode* Platform::Memory::KeyTree::getRoot() const
+{
+	return &nodes.front();
+}
+
+Platform::Memory::KeyNode* Platform::Memory::KeyTree::findSubKey(const KeyNode* parent, const std::wstring_view& name) const
+{
+	const auto it = children.find({ parent, foldName(name) });
+	return it != children.end() ? it->second : nullptr;
+}
+
+Platform::Memory::KeyNode* Platform::Memory::KeyTree::createSubKey(KeyNode* parent, const std::wstring_view& name)
+{
+	const auto [it, inserted] = children.try_emplace({ parent, foldName(name) }, nullptr);
+	if (inserted)
+	{
+		// the deque keeps the address of existing nodes
+		KeyNode& node = nodes.emplace_back();
+		node.name = name;
+		node.parent = parent;
+
+		parent->subKeys.push_back(&node);
+		it->second = &node;
+	}
+
+	return it->second;
+}
+
+bool Platform::Memory::KeyTree::deleteSubKey(KeyNode* parent, const std::wstring_view& name)
+{
+	const auto it = children.find({ parent, foldName(name) });
+	if (it == children.end()) {
+		return false;
+	}
+
+	KeyNode* node = it->second;
+	children.erase(it);
+	parent->subKeys.erase(std::find(parent->subKeys.begin(), parent->subKeys.end(), node));
+
+	// the subkeys can't be reached anymore, only their lookup entries are removed
+	std::vector<KeyNode*> pendingNodes{ node };
+	while (!pendingNodes.empty())
+	{
+		KeyNode* pendingNode = pendingNodes.back();
+		pendingNodes.pop_back();
+
+		for (KeyNode* subKey : pendingNode->subKeys)
+		{
+			children.erase({ pendingNode, foldName(subKey->name) });
+			pendingNodes.push_back(subKey);
+		}
+
+		++deletedKeyCount;
+	}
+
+	return true;
+}
+
+const wchar_t* Platform::Memory::KeyTree::internName(const std::wstring_view& name)
+{
+	return names.intern(name);
+}
+
+size_t Platform::Memory::KeyTree::getKeyCount() const
+{
+	return nodes.size() - deletedKeyCount;
+}
+
+Platform::Memory::Key::Key(const KeyTreePtr& inTree, KeyNode* inNode)
+	: tree(inTree)
+	, node(inNode)
+{
+}
+
+const wchar_t* Platform::Memory::Key::getKeyName() const
+{
+	return node->name.c_str();
+}
+
+const Platform::Memory::KeyTreePtr& Platform::Memory::Key::getTree() const
+{
+	return tree;
+}
+
+Platform::Memory::KeyNode* Platform::Memory::Key::getNode() const
+{
+	return node;
+}
+
+Platform::Memory::Hive::Hive(const KeyTreePtr& inTree, std::wstring&& name, const std::filesystem::path& inFileName)
+	: tree(inTree)
+	, hiveName(std::move(name))
+	, fileName(inFileName)
+{
+}
+
+const wchar_t* Platform::Memory::Hive::getHiveName() const
+{
+	return hiveName.c_str();
+}
+
+IKeyPtr Platform::Memory::Hive::getRootKey() const
+{
+	return std::make_shared<Memory::Key>(tree, tree->getRoot());
+}
+
+const Platform::Memory::KeyTree& Platform::Memory::Hive::getTree() const
+{
+	return *tree;
+}
+
+const std::filesystem::path& Platform::Memory::Hive::getFileName() const
+{
+	return fileName;
+}
+
+IKeyPtr Platform::Memory::KeyManager::getKey(const wchar_t* keyName, Permission permissions, const IKey* parentKey)
+{
+	const Memory::Key& memKey = getMemoryKey(parentKey);
+	const KeyTreePtr& tree = memKey.getTree();
+
+	KeyNode* node = memKey.getNode();
+	Helpers::forEachPathComponent(keyName, [&](const std::wstring_view& name)
+		{
+			if (node) {
+				node = tree->findSubKey(node, name);
+			}
+		});
+
+	if (!node) {
+		throw std::system_error(std::make_error_code(std::errc::no_such_file_or_directory), "couldn't open registry key");
+	}
+
+	return std::make_shared<Memory::Key>(tree, node);
+}
+
+IKeyPtr Platform::Memory::KeyManager::getOrCreateKey(const wchar_t* keyName, Permission permissions, const IKey* parentKey)
+{
+	const Memory::Key& memKey = getMemoryKey(parentKey);
+	const KeyTreePtr& tree = memKey.getTree();
+
+	KeyNode* node = memKey.getNode();
+	Helpers::forEachPathComponent(keyName, [&](const std::wstring_view& name)
+		{
+			node = tree->createSubKey(node, name);
+		});
+
+	return std::make_shared<Memory::Key>(tree, node);
+}
+
+IKeyPtr Platform::Memory::KeyManager::getPredefinedKey(const wchar_t* rootName)
+{
+	// hives in memory are not mounted
+	return nullptr;
+}
+
+bool Platform::Memory::KeyManager::visitKeys(const IKey* key, const KeyVisitor& visitor, size_t maxDepth)
+{
+	const Memory::Key& memKey = getMemoryKey(key);
+	return visitKeysInternal(memKey.getTree(), memKey.getNode(), visitor, maxDepth);
+}
+
+bool Platform::Memory::KeyManager::visitKeysInternal(const KeyTreePtr& tree, KeyNode* node, const KeyVisitor& visitor, size_t currentDepth)
+{
+	const Memory::Key parentKey(tree, node);
+
+	// the visitor may add subkeys, don't iterate over the vector itself
+	for (size_t i = 0; i < node->subKeys.size(); ++i)
+	{
+		KeyNode* subKey = node->subKeys[i];
+		if (!std::invoke(visitor, &parentKey, subKey->name.c_str()))
+		{
+			// stop enumerating
+			return false;
+		}
+
+		if (currentDepth > 0 && !visitKeysInternal(tree, subKey, visitor, currentDepth - 1))
+		{
+			// stop enumerating
+			return false;
+		}
+	}
+
+	return true;
+}
+
+KeyInfo Platform::Memory::KeyManager::queryKeyInfo(const IKey* key)
+{
+	const Memory::Key& memKey = getMemoryKey(key);
+
+	// keys in memory have no write time
+	KeyInfo info;
+	info.subKeyCount = memKey.getNode()->subKeys.size();
+	info.valueCount = memKey.getNode()->values.size();
+	return info;
+}
+
+void Platform::Memory::KeyManager::deleteKey(const IKey* parentKey, const wchar_t* subKeyName)
+{
+	const Memory::Key& memKey = getMemoryKey(parentKey);
+
+	if (!memKey.getTree()->deleteSubKey(memKey.getNode(), subKeyName)) {
+		throw std::system_error(std::make_error_code(std::errc::no_such_file_or_directory), "couldn't delete registry key");
+	}
+}
+
+static Platform::Memory::KeyValue* findValue(Platform::Memory::KeyNode& node, const std::wstring_view& valueName)
+{
+	for (Platform::Memory::KeyValue& value : node.values)
+	{
+		if (!compareNames(value.name, valueName)) {
+			return &value;
+		}
+	}
+
+	return nullptr;
+}
+
+static void setNodeValue(Platform::Memory::KeyTree& tree, Platform::Memory::KeyNode& node, const IValue& value)
+{
+	// values from any platform can be set
+	if (Platform::Memory::KeyValue* existingValue = findValue(node, value.getValueName()))
+	{
+		existingValue->type = &value.getType();
+		existingValue->data.assign(value.getRawData());
+	}
+	else {
+		node.values.push_back({ tree.internName(value.getValueName()), &value.getType(), ValueData(value.getRawData()) });
+	}
+}
+
+void Platform::Memory::KeyManager::copyTree(const IKey* sourceKey, const IKey* targetKey, const ICopyFilter* filter, size_t maxDepth)
+{
+	const Memory::Key& sourceMemKey = getMemoryKey(sourceKey);
+	const Memory::Key& targetMemKey = getMemoryKey(targetKey);
+	KeyTree& targetTree = *targetMemKey.getTree();
+
+	// nodes are copied directly, key paths are only built for the filter
+	struct PendingKey
+	{
+		const KeyNode* source;
+		KeyNode* target;
+		std::wstring path;
+		size_t depth;
+	};
+
+	std::vector<PendingKey> pendingKeys;
+	pendingKeys.push_back({ sourceMemKey.getNode(), targetMemKey.getNode(), std::wstring(), 0 });
+
+	while (!pendingKeys.empty())
+	{
+		PendingKey pendingKey = std::move(pendingKeys.back());
+		pendingKeys.pop_back();
+
+		for (const KeyValue& value : pendingKey.source->values)
+		{
+			if (!filter || filter->includeValue(pendingKey.path, value.name)) {
+				setNodeValue(targetTree, *pendingKey.target, value.getView());
+			}
+		}
+
+		if (pendingKey.depth > maxDepth) {
+			continue;
+		}
+
+		// subkeys are created in their order and copied in that order
+		const size_t firstPending = pendingKeys.size();
+		for (const KeyNode* subKey : pendingKey.source->subKeys)
+		{
+			std::wstring subKeyPath;
+			if (filter)
+			{
+				subKeyPath = pendingKey.path.empty() ? subKey->name : pendingKey.path + L'\\' + subKey->name;
+				if (!filter->includeKey(subKeyPath)) {
+					continue;
+				}
+			}
+
+			KeyNode* targetSubKey = targetTree.createSubKey(pendingKey.target, subKey->name);
+			pendingKeys.push_back({ subKey, targetSubKey, std::move(subKeyPath), pendingKey.depth + 1 });
+		}
+
+		std::reverse(pendingKeys.begin() + firstPending, pendingKeys.end());
+	}
+}
+
+IValuePtr Platform::Memory::ValueManager::getValue(const IKey* key, const wchar_t* valueName)
+{
+	const Memory::Key& memKey = getMemoryKey(key);
+
+	const KeyValue* value = findValue(*memKey.getNode(), valueName ? valueName : L"");
+	if (!value) {
+		throw std::system_error(std::make_error_code(std::errc::no_such_file_or_directory), "couldn't open registry value");
+	}
+
+	return std::make_shared<Memory::Value>(value->name, *value->type, value->data.get());
+}
+
+IValuePtr Platform::Memory::ValueManager::newValue(const wchar_t* valueName, const IDataType& dataType)
+{
+	return std::make_shared<Memory::Value>(valueName ? valueName : L"", dataType);
+}
+
+void Platform::Memory::ValueManager::setValue(const IKey* key, const IValue& value)
+{
+	const Memory::Key& memKey = getMemoryKey(key);
+	setNodeValue(*memKey.getTree(), *memKey.getNode(), value);
+}
+
+bool Platform::Memory::ValueManager::visitKeyValues(const IKey* key, const ValueVisitor& visitor)
+{
+	const Memory::Key& memKey = getMemoryKey(key);
+
+	for (const KeyValue& value : memKey.getNode()->values)
+	{
+		if (!std::invoke(visitor, value.getView())) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void Platform::Memory::ValueManager::readKeyValues(const IKey* key, ValueBatch& batch)
+{
+	const Memory::Key& memKey = getMemoryKey(key);
+
+	batch.clear();
+	for (const KeyValue& value : memKey.getNode()->values) {
+		batch.add(value.name, *value.type, value.data.get());
+	}
+}
+
+Platform::Memory::HiveManager::HiveManager(HiveFormat inFormat, const Regf::HiveLayout& inLayout)
+	: format(inFormat)
+	, layout(inLayout)
+{
+}
+
+IHivePtr Platform::Memory::HiveManager::createHive(const std::filesystem::path& hiveFileName)
+{
+	return std::make_shared<Memory::Hive>(std::make_shared<KeyTree>(), hiveFileName.stem().wstring(), hiveFileName);
+}
+
+IHivePtr Platform::Memory::HiveManager::loadHive(const std::filesystem::path& hiveFileName)
+{
+	if (format != HiveFormat::Regf) {
+		throw std::system_error(std::make_error_code(std::errc::operation_not_supported), "only hive files can be loaded in memory");
+	}
+
+	const KeyTreePtr tree = std::make_shared<KeyTree>();
+
+	{
+		// the file is read through its mapping, which is closed before the hive is written again
+		HiveFile::HiveManager fileHiveManager;
+		const IHivePtr fileHive = fileHiveManager.loadHive(hiveFileName);
+
+		HiveFile::KeyManager fileKeyManager(hiveFileName.parent_path());
+		HiveFile::ValueManager fileValueManager;
+		Memory::KeyManager keyManager;
+		Memory::ValueManager valueManager;
+
+		const Memory::Key rootKey(tree, tree->getRoot());
+		Helpers::copyTree(fileKeyManager, fileValueManager, keyManager, valueManager, fileHive->getRootKey().get(), &rootKey);
+	}
+
+	return std::make_shared<Memory::Hive>(tree, hiveFileName.stem().wstring(), hiveFileName);
+}
+
+void Platform::Memory::HiveManager::saveHive(const IHive& hive, const std::filesystem::path& hiveFileName)
+{
+	const Memory::Hive& memHive = static_cast<const Memory::Hive&>(hive);
+
+	std::ofstream stream(hiveFileName, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (stream.fail()) {
+		throw std::system_error(std::make_error_code(std::errc::io_error), "could not save hive to file");
+	}
+
+	switch (format)
+	{
+	case HiveFormat::Regf:
+		Regf::writeHive(stream, memHive.getTree(), memHive.getHiveName(), layout);
+		break;
+	case HiveFormat::RegText:
+		writeRegText(stream, memHive.getTree(), memHive.getHiveName());
+		break;
+	}
+
+	stream.flush();
+	if (stream.fail()) {
+		throw std::system_error(std::make_error_code(std::errc::io_error), "could not save hive to file");
+	}
+}
+
+void Platform::Memory::HiveManager::commitHive(const IHive& hive)
+{
+	const Memory::Hive& memHive = static_cast<const Memory::Hive&>(hive);
+	saveHive(hive, memHive.getFileName());
+}
+
+Platform::Memory::RegistryManager::RegistryManager(HiveFormat format, const Regf::HiveLayout& layout)
+	: hiveManager(format, layout)
+{
+}
+
+IKeyManager& Platform::Memory::RegistryManager::getKeyManager()
+{
+	return keyManager;
+}
+
+const IKeyManager& Platform::Memory::RegistryManager::getKeyManager() const
+{
+	return keyManager;
+}
+
+IValueManager& Platform::Memory::RegistryManager::getValueManager()
+{
+	return valueManager;
+}
+
+const IValueManager& Platform::Memory::RegistryManager::getValueManager() const
+{
+	return valueManager;
+}
+
+IHiveManager& Platform::Memory::RegistryManager::getHiveManager()
+{
+	return hiveManager;
+}
+
+const IHiveManager& Platform::Memory::RegistryManager::getHiveManager() const
+{
+	return hiveManager;
+}
+
+static void appendAscii(std::u16string& text, const char* str)
+{
+	for (; *str; ++str) {
+		text += static_cast<char16_t>(*str);
+	}
+}
+
+static void appendQuoted(std::u16string& text, const std::u16string_view& str)
+{
+	text += u'"';
+	for (const char16_t ch : str)
+	{
+		if (ch == u'\\' || ch == u'"') {
+			text += u'\\';
+		}
+
+		text += ch;
+	}
+	text += u'"';
+}
+
+static void appendHex(std::u16string& text, const std::span<const unsigned char>& data)
+{
+	static const char digits[] = "0123456789abcdef";
+
+	for (size_t i = 0; i < data.size(); ++i)
+	{
+		if (i) {
+			text += u',';
+		}
+
+		text += static_cast<char16_t>(digits[data[i] >> 4]);
+		text += static_cast<char16_t>(digits[data[i] & 0xF]);
+	}
+}
+
+/**
+ * Reads string data as UTF-16 without its terminator. Returns false if it is not a single string.
+ */
+static bool getStringData(const std::span<const unsigned char>& data, std::u16string& str)
+{
+	if (data.size() < 2 || data.size() % 2) {
+		return false;
+	}
+
+	str.clear();
+	for (size_t i = 0; i + 1 < data.size(); i += 2) {
+		str += static_cast<char16_t>(data[i] | (data[i + 1] << 8));
+	}
+
+	if (str.back() != u'\0') {
+		return false;
+	}
+
+	str.pop_back();
+	return str.find(u'\0') == std::u16string::npos;
+}
+
+static void appendValue(std::u16string& text, const IValue& value)
+{
+	const std::wstring_view name = value.getValueName();
+	if (name.empty()) {
+		text += u'@';
+	}
+	else
+	{
+		appendQuoted(text, toUtf16(name));
+	}
+
+	text += u'=';
+
+	const std::span<const unsigned char> data = value.getRawData();
+	const uint32_t rawType = value.getType().getRawType();
+
+	std::u16string str;
+	if (rawType == Types::String.getRawType() && getStringData(data, str)) {
+		appendQuoted(text, str);
+	}
+	else if (rawType == Types::DWord.getRawType() && data.size() == sizeof(uint32_t))
+	{
+		static const char digits[] = "0123456789abcdef";
+
+		appendAscii(text, "dword:");
+		for (size_t i = data.size(); i-- > 0;)
+		{
+			text += static_cast<char16_t>(digits[data[i] >> 4]);
+			text += static_cast<char16_t>(digits[data[i] & 0xF]);
+		}
+	}
+	else
+	{
+		if (rawType == Types::Binary.getRawType()) {
+			appendAscii(text, "hex:");
+		}
+		else
+		{
+			appendAscii(text, "hex(");
+			appendAscii(text, std::to_string(rawType).c_str());
+			appendAscii(text, "):");
+		}
+
+		appendHex(text, data);
+	}
+
+	appendAscii(text, "\r\n");
+}
+
+static void appendKey(std::u16string& text, const Platform::Memory::KeyNode& node, std::u16string& path)
+{
+	text += u'[';
+	text += path;
+	appendAscii(text, "]\r\n");
+
+	for (const Platform::Memory::KeyValue& value : node.values) {
+		appendValue(text, value.getView());
+	}
+
+	appendAscii(text, "\r\n");
+
+	for (const Platform::Memory::KeyNode* subKey : node.subKeys)
+	{
+		const size_t pathLength = path.size();
+
+		path += u'\\';
+		path += toUtf16(subKey->name);
+		appendKey(text, *subKey, path);
+
+		path.resize(pathLength);
+	}
+}
+
+void Platform::Memory::writeRegText(std::ostream& stream, const KeyTree& tree, const std::wstring_view& rootPath)
+{
+	std::u16string text;
+	text += u'\xFEFF';
+	appendAscii(text, "Windows Registry Editor Version 5.00\r\n\r\n");
+
+	std::u16string path = toUtf16(rootPath);
+	appendKey(text, *tree.getRoot(), path);
+
+	// UTF-16 little-endian
+	std::vector<char> bytes;
+	bytes.reserve(text.size() * 2);
+	for (const char16_t ch : text)
+	{
+		bytes.push_back(static_cast<char>(ch & 0xFF));
+		bytes.push_back(static_cast<char>(ch >> 8));
+	}
+
+	stream.write(bytes.data(), bytes.size());
+}
@@ -0,0 +1,236 @@
+#pragma once
+
+#include "registry.h"
+#include "registry_regf.h"
+
+#include <deque>
+#include <filesystem>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Registry
+{
+	namespace Platform
+	{
+		/**
+		 * Registry kept in memory, to build hives without going through the live registry.
+		 * Hives are written to their file in a single step when they are committed.
+		 */
+		namespace Memory
+		{
+			class Value : public IValue
+			{
+			public:
+				Value(const std::wstring_view& valueName, const IDataType& type);
+				Value(const std::wstring_view& valueName, const IDataType& type, const std::span<const unsigned char>& data);
+
+				Value(const Value&) = default;
+				Value& operator=(const Value&) = default;
+				Value(Value&&) = default;
+				Value& operator=(Value&&) = default;
+
+				const wchar_t* getValueName() const override;
+				const IDataType& getType() const override;
+
+				std::span<const unsigned char> getRawData() const override;
+				void setRawData(const std::span<const unsigned char>& data) override;
+
+			private:
+				std::wstring name;
+				const IDataType* dataType;
+				ValueData rawData;
+			};
+
+			/**
+			 * Value stored in a key node, named in the table of its tree.
+			 */
+			struct KeyValue
+			{
+				const wchar_t* name;
+				const IDataType* type;
+				ValueData data;
+
+				ValueView getView() const;
+			};
+
+			struct KeyNode
+			{
+				std::wstring name;
+				KeyNode* parent = nullptr;
+
+				/** Subkeys in creation order. */
+				std::vector<KeyNode*> subKeys;
+
+				/** Values are stored in the node. */
+				std::vector<KeyValue> values;
+			};
+
+			/**
+			 * Keys of a hive. Nodes are allocated from an arena that lives as long as the tree,
+			 * and subkeys are found by hash of their parent and case-folded name.
+			 */
+			class KeyTree
+			{
+			public:
+				KeyTree();
+
+				KeyTree(const KeyTree&) = delete;
+				KeyTree& operator=(const KeyTree&) = delete;
+
+				KeyNode* getRoot();
+				const KeyNode* getRoot() const;
+
+				KeyNode* findSubKey(const KeyNode* parent, const std::wstring_view& name) const;
+
+				/**
+				 * Returns the existing subkey or creates it.
+				 */
+				KeyNode* createSubKey(KeyNode* parent, const std::wstring_view& name);
+
+				/**
+				 * Removes a subkey and its subkeys from the tree, their nodes are freed with the tree.
+				 * Returns false if the subkey doesn't exist.
+				 */
+				bool deleteSubKey(KeyNode* parent, const std::wstring_view& name);
+
+				/**
+				 * Returns the name stored in the tree, value names are shared by all the keys.
+				 */
+				const wchar_t* internName(const std::wstring_view& name);
+
+				size_t getKeyCount() const;
+
+			private:
+				struct ChildName
+				{
+					const KeyNode* parent;
+					std::wstring foldedName;
+
+					bool operator==(const ChildName& other) const;
+				};
+
+				struct ChildNameHasher
+				{
+					size_t operator()(const ChildName& childName) const;
+				};
+
+			private:
+				std::deque<KeyNode> nodes;
+				std::unordered_map<ChildName, KeyNode*, ChildNameHasher> children;
+				NameTable names;
+				size_t deletedKeyCount = 0;
+			};
+			using KeyTreePtr = std::shared_ptr<KeyTree>;
+
+			class Key : public IKey
+			{
+			public:
+				Key(const KeyTreePtr& inTree, KeyNode* inNode);
+
+				const wchar_t* getKeyName() const override;
+
+				const KeyTreePtr& getTree() const;
+				KeyNode* getNode() const;
+
+			private:
+				KeyTreePtr tree;
+				KeyNode* node;
+			};
+
+			class Hive : public IHive
+			{
+			public:
+				Hive(const KeyTreePtr& inTree, std::wstring&& name, const std::filesystem::path& inFileName);
+
+				const wchar_t* getHiveName() const override;
+				IKeyPtr getRootKey() const override;
+
+				const KeyTree& getTree() const;
+				const std::filesystem::path& getFileName() const;
+
+			private:
+				KeyTreePtr tree;
+				std::wstring hiveName;
+				std::filesystem::path fileName;
+			};
+
+			class KeyManager : public IKeyManager
+			{
+			public:
+				IKeyPtr getKey(const wchar_t* keyName, Permission permissions, const IKey* parentKey) override;
+				IKeyPtr getOrCreateKey(const wchar_t* keyName, Permission permissions, const IKey* parentKey) override;
+				IKeyPtr getPredefinedKey(const wchar_t* rootName) override;
+				bool visitKeys(const IKey* key, const KeyVisitor& visitor, size_t maxDepth = SIZE_MAX) override;
+				void copyTree(const IKey* sourceKey, const IKey* targetKey, const ICopyFilter* filter = nullptr, size_t maxDepth = SIZE_MAX) override;
+				KeyInfo queryKeyInfo(const IKey* key) override;
+				void deleteKey(const IKey* parentKey, const wchar_t* subKeyName) override;
+
+			private:
+				bool visitKeysInternal(const KeyTreePtr& tree, KeyNode* node, const KeyVisitor& visitor, size_t currentDepth);
+			};
+
+			class ValueManager : public IValueManager
+			{
+			public:
+				IValuePtr getValue(const IKey* key, const wchar_t* valueName) override;
+				IValuePtr newValue(const wchar_t* valueName, const IDataType& dataType) override;
+				void setValue(const IKey* key, const IValue& value) override;
+				bool visitKeyValues(const IKey* key, const ValueVisitor& visitor) override;
+				void readKeyValues(const IKey* key, ValueBatch& batch) override;
+			};
+
+			enum class HiveFormat
+			{
+				/** Hive file, as loaded by Windows. */
+				Regf,
+				/** Registry editor export (.reg), UTF-16 text. */
+				RegText
+			};
+
+			class HiveManager : public IHiveManager
+			{
+			public:
+				/**
+				 * Hive files are written with the keys in the order of the layout.
+				 */
+				HiveManager(HiveFormat inFormat = HiveFormat::Regf, const Regf::HiveLayout& inLayout = Regf::HiveLayout());
+
+				IHivePtr createHive(const std::filesystem::path& hiveFileName) override;
+				IHivePtr loadHive(const std::filesystem::path& hiveFileName) override;
+				void saveHive(const IHive& hive, const std::filesystem::path& hiveFileName) override;
+				void commitHive(const IHive& hive) override;
+
+			private:
+				HiveFormat format;
+				Regf::HiveLayout layout;
+			};
+
+			class RegistryManager : public IRegistryManager
+			{
+			public:
+				RegistryManager(HiveFormat format = HiveFormat::Regf, const Regf::HiveLayout& layout = Regf::HiveLayout());
+
+				virtual IKeyManager& getKeyManager() override;
+				virtual const IKeyManager& getKeyManager() const override;
+
+				virtual IValueManager& getValueManager() override;
+				virtual const IValueManager& getValueManager() const override;
+
+				virtual IHiveManager& getHiveManager() override;
+				virtual const IHiveManager& getHiveManager() const override;
+
+			private:
+				KeyManager keyManager;
+				ValueManager valueManager;
+				HiveManager hiveManager;
+			};
+
+			/**
+			 * Writes the keys of a hive as a registry editor export, below the specified root path.
+			 */
+			void writeRegText(std::ostream& stream, const KeyTree& tree, const std::wstring_view& rootPath);
+		}
+	}
+}
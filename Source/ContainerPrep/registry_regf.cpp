@@ -0,0 +1,63 @@
+#include "registry_regf.h"
+#include "registry_data.h"
+
+#include <chrono>
+
+using namespace Registry;
+
+/** 100ns intervals between 1601-01-01 and 1970-01-01. */
+static const uint64_t UnixEpochTimestamp = 116444736000000000ull;
+
+uint32_t Regf::computeChecksum(std::span<const unsigned char> baseBlock)
+{
+	uint32_t checksum = 0;
+	for (uint32_t offset = 0; offset < BaseBlock::Checksum; offset += sizeof(uint32_t)) {
+		checksum ^= readUInt32(baseBlock.data() + offset);
+	}
+
+	// these values are reserved
+	if (checksum == 0xFFFFFFFF) {
+		return 0xFFFFFFFE;
+	}
+
+	if (!checksum) {
+		return 1;
+	}
+
+	return checksum;
+}
+
+uint32_t Regf::hashName(const std::u16string_view& name)
+{
+	uint32_t hash = 0;
+	for (const char16_t ch : name) {
+		hash = hash * 37 + upcaseChar(ch);
+	}
+
+	return hash;
+}
+
+int Regf::compareNames(const std::u16string_view& left, const std::u16string_view& right)
+{
+	const size_t length = left.size() < right.size() ? left.size() : right.size();
+	for (size_t i = 0; i < length; ++i)
+	{
+		const char16_t leftChar = upcaseChar(left[i]);
+		const char16_t rightChar = upcaseChar(right[i]);
+		if (leftChar != rightChar) {
+			return leftChar < rightChar ? -1 : 1;
+		}
+	}
+
+	if (left.size() != right.size()) {
+		return left.size() < right.size() ? -1 : 1;
+	}
+
+	return 0;
+}
+
+uint64_t Regf::getCurrentTimestamp()
+{
+	const auto sinceEpoch = std::chrono::system_clock::now().time_since_epoch();
+	return UnixEpochTimestamp + std::chrono::duration_cast<std::chrono::duration<uint64_t, std::ratio<1, 10000000>>>(sinceEpoch).count();
+}
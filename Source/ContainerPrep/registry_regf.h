@@ -0,0 +1,213 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Registry
+{
+	/**
+	 * Layout of hive files (regf) as Windows loads them.
+	 * Fields are little-endian, and cell offsets are relative to the first hive bin.
+	 */
+	namespace Regf
+	{
+		constexpr uint32_t BaseBlockSize = 0x1000;
+		constexpr uint32_t BinAlignment = 0x1000;
+		constexpr uint32_t BinHeaderSize = 0x20;
+		constexpr uint32_t CellAlignment = 8;
+
+		/** No cell, for empty lists and missing class names. */
+		constexpr uint32_t NullOffset = 0xFFFFFFFF;
+
+		constexpr uint32_t MajorVersion = 1;
+		/** Version 1.5 has lh subkey lists and big data. */
+		constexpr uint32_t MinorVersion = 5;
+
+		namespace BaseBlock
+		{
+			constexpr uint32_t Signature = 0x00;
+			constexpr uint32_t PrimarySequence = 0x04;
+			constexpr uint32_t SecondarySequence = 0x08;
+			constexpr uint32_t Timestamp = 0x0C;
+			constexpr uint32_t MajorVersion = 0x14;
+			constexpr uint32_t MinorVersion = 0x18;
+			constexpr uint32_t FileType = 0x1C;
+			constexpr uint32_t FileFormat = 0x20;
+			constexpr uint32_t RootCell = 0x24;
+			constexpr uint32_t BinsSize = 0x28;
+			constexpr uint32_t Clustering = 0x2C;
+			constexpr uint32_t FileName = 0x30;
+			constexpr uint32_t FileNameSize = 0x40;
+			constexpr uint32_t Checksum = 0x1FC;
+		}
+
+		namespace Bin
+		{
+			constexpr uint32_t Signature = 0x00;
+			constexpr uint32_t Offset = 0x04;
+			constexpr uint32_t Size = 0x08;
+			constexpr uint32_t Timestamp = 0x14;
+		}
+
+		/** Key node (nk). */
+		namespace Key
+		{
+			constexpr uint32_t Signature = 0x00;
+			constexpr uint32_t Flags = 0x02;
+			constexpr uint32_t Timestamp = 0x04;
+			constexpr uint32_t Parent = 0x10;
+			constexpr uint32_t SubKeyCount = 0x14;
+			constexpr uint32_t VolatileSubKeyCount = 0x18;
+			constexpr uint32_t SubKeyList = 0x1C;
+			constexpr uint32_t VolatileSubKeyList = 0x20;
+			constexpr uint32_t ValueCount = 0x24;
+			constexpr uint32_t ValueList = 0x28;
+			constexpr uint32_t Security = 0x2C;
+			constexpr uint32_t Class = 0x30;
+			constexpr uint32_t MaxNameLength = 0x34;
+			constexpr uint32_t MaxClassLength = 0x38;
+			constexpr uint32_t MaxValueNameLength = 0x3C;
+			constexpr uint32_t MaxValueDataLength = 0x40;
+			constexpr uint32_t NameLength = 0x48;
+			constexpr uint32_t ClassLength = 0x4A;
+			constexpr uint32_t Name = 0x4C;
+
+			constexpr uint16_t HiveEntry = 0x0004;
+			constexpr uint16_t NoDelete = 0x0008;
+			/** The name is stored in Latin-1 rather than UTF-16. */
+			constexpr uint16_t CompressedName = 0x0020;
+		}
+
+		/** Value (vk). */
+		namespace Value
+		{
+			constexpr uint32_t Signature = 0x00;
+			constexpr uint32_t NameLength = 0x02;
+			constexpr uint32_t DataSize = 0x04;
+			constexpr uint32_t Data = 0x08;
+			constexpr uint32_t Type = 0x0C;
+			constexpr uint32_t Flags = 0x10;
+			constexpr uint32_t Name = 0x14;
+
+			constexpr uint16_t CompressedName = 0x0001;
+
+			/** Set in the data size when the data (4 bytes at most) is stored in place of its offset. */
+			constexpr uint32_t InlineData = 0x80000000;
+		}
+
+		/** Subkey lists: hash leaves (lh) and index roots of leaves (ri). */
+		namespace SubKeyList
+		{
+			constexpr uint32_t Signature = 0x00;
+			constexpr uint32_t Count = 0x02;
+			constexpr uint32_t Entries = 0x04;
+
+			constexpr uint32_t LeafEntrySize = 8;
+			constexpr uint32_t IndexEntrySize = 4;
+
+			/** Entries of a leaf that fits in a single bin. */
+			constexpr uint32_t MaxLeafEntries = (BinAlignment - BinHeaderSize - sizeof(uint32_t) - Entries) / LeafEntrySize;
+		}
+
+		/** Security descriptor (sk), shared by the keys and chained in a list. */
+		namespace Security
+		{
+			constexpr uint32_t Signature = 0x00;
+			constexpr uint32_t Next = 0x04;
+			constexpr uint32_t Previous = 0x08;
+			constexpr uint32_t ReferenceCount = 0x0C;
+			constexpr uint32_t DescriptorSize = 0x10;
+			constexpr uint32_t Descriptor = 0x14;
+		}
+
+		/** Data split in segments (db), for values larger than a cell holds. */
+		namespace BigData
+		{
+			constexpr uint32_t Signature = 0x00;
+			constexpr uint32_t SegmentCount = 0x02;
+			constexpr uint32_t SegmentList = 0x04;
+			constexpr uint32_t Size = 0x08;
+
+			constexpr uint32_t MaxSegmentSize = 0x3FD8;
+		}
+
+		/**
+		 * Order in which the keys of a hive are written. Each key is followed by its values and their data.
+		 */
+		enum class KeyOrder
+		{
+			/** Keys with their subtree, as the tree is enumerated. */
+			DepthFirst,
+			/** Keys level by level, the subkeys of a key next to each other. */
+			BreadthFirst,
+			/** Accessed keys first in their order of access, then the other keys depth first. */
+			AccessOrder
+		};
+
+		struct HiveLayout
+		{
+			KeyOrder order = KeyOrder::DepthFirst;
+
+			/** Paths of the accessed keys, starting with the name of their hive. */
+			std::vector<std::wstring> accessedKeys;
+		};
+
+		inline uint16_t readUInt16(const unsigned char* data)
+		{
+			return static_cast<uint16_t>(data[0] | (data[1] << 8));
+		}
+
+		inline uint32_t readUInt32(const unsigned char* data)
+		{
+			return static_cast<uint32_t>(data[0]) | (static_cast<uint32_t>(data[1]) << 8) | (static_cast<uint32_t>(data[2]) << 16) | (static_cast<uint32_t>(data[3]) << 24);
+		}
+
+		inline uint64_t readUInt64(const unsigned char* data)
+		{
+			return static_cast<uint64_t>(readUInt32(data)) | (static_cast<uint64_t>(readUInt32(data + 4)) << 32);
+		}
+
+		inline void writeUInt16(unsigned char* data, uint16_t value)
+		{
+			data[0] = static_cast<unsigned char>(value);
+			data[1] = static_cast<unsigned char>(value >> 8);
+		}
+
+		inline void writeUInt32(unsigned char* data, uint32_t value)
+		{
+			for (size_t i = 0; i < sizeof(value); ++i) {
+				data[i] = static_cast<unsigned char>(value >> (i * 8));
+			}
+		}
+
+		inline void writeUInt64(unsigned char* data, uint64_t value)
+		{
+			for (size_t i = 0; i < sizeof(value); ++i) {
+				data[i] = static_cast<unsigned char>(value >> (i * 8));
+			}
+		}
+
+		/**
+		 * Returns the checksum of a base block, the XOR of its first 127 dwords.
+		 */
+		uint32_t computeChecksum(std::span<const unsigned char> baseBlock);
+
+		/**
+		 * Returns the hash of a key name stored in hash leaves.
+		 */
+		uint32_t hashName(const std::u16string_view& name);
+
+		/**
+		 * Compares key names in the order of subkey lists, by their upper case UTF-16 code units.
+		 */
+		int compareNames(const std::u16string_view& left, const std::u16string_view& right);
+
+		/**
+		 * Returns the current time as a FILETIME, for the timestamps of the hive.
+		 */
+		uint64_t getCurrentTimestamp();
+	}
+}
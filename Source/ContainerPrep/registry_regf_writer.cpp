@@ -0,0 +1,726 @@
+#include "registry_regf_writer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <cwchar>
+#include <system_error>
+#include <unordered_set>
+
+using namespace Registry;
+
+/**
+ * Full control for SYSTEM and Administrators, read access for Users, inherited by subkeys.
+ * Self-relative: header, DACL, owner (Administrators) and group (SYSTEM).
+ */
+static const unsigned char DefaultSecurityDescriptor[] = {
+	0x01, 0x00, 0x04, 0x80, 0x60, 0x00, 0x00, 0x00, 0x70, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x14, 0x00, 0x00, 0x00,
+	0x02, 0x00, 0x4C, 0x00, 0x03, 0x00, 0x00, 0x00,
+	0x00, 0x02, 0x14, 0x00, 0x3F, 0x00, 0x0F, 0x00, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x05, 0x12, 0x00, 0x00, 0x00,
+	0x00, 0x02, 0x18, 0x00, 0x3F, 0x00, 0x0F, 0x00, 0x01, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x05, 0x20, 0x00, 0x00, 0x00, 0x20, 0x02, 0x00, 0x00,
+	0x00, 0x02, 0x18, 0x00, 0x19, 0x00, 0x02, 0x00, 0x01, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x05, 0x20, 0x00, 0x00, 0x00, 0x21, 0x02, 0x00, 0x00,
+	0x01, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x05, 0x20, 0x00, 0x00, 0x00, 0x20, 0x02, 0x00, 0x00,
+	0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x05, 0x12, 0x00, 0x00, 0x00
+};
+
+static uint32_t alignUp(size_t size, uint32_t alignment)
+{
+	return static_cast<uint32_t>((size + alignment - 1) & ~static_cast<size_t>(alignment - 1));
+}
+
+/**
+ * Names with only Latin-1 characters are stored with a byte per character.
+ */
+static bool isCompressible(const std::u16string_view& name)
+{
+	return std::all_of(name.begin(), name.end(), [](char16_t ch) { return ch <= 0xFF; });
+}
+
+static uint32_t getNameSize(const std::u16string_view& name, bool compressed)
+{
+	return static_cast<uint32_t>(compressed ? name.size() : name.size() * sizeof(char16_t));
+}
+
+static void storeName(unsigned char* dest, const std::u16string_view& name, bool compressed)
+{
+	for (size_t i = 0; i < name.size(); ++i)
+	{
+		if (compressed) {
+			dest[i] = static_cast<unsigned char>(name[i]);
+		}
+		else {
+			Regf::writeUInt16(dest + i * sizeof(char16_t), name[i]);
+		}
+	}
+}
+
+static void storeSignature(unsigned char* dest, const char* signature)
+{
+	std::memcpy(dest, signature, std::strlen(signature));
+}
+
+/**
+ * Returns about the size of the cells of a key and its subkeys, to allocate the image once.
+ */
+static size_t estimateSize(const Platform::Memory::KeyNode& node)
+{
+	size_t size = Regf::Key::Name + node.name.size() * sizeof(char16_t) + Regf::CellAlignment;
+	size += node.subKeys.size() * Regf::SubKeyList::LeafEntrySize + Regf::CellAlignment;
+
+	for (const Platform::Memory::KeyValue& value : node.values) {
+		size += Regf::Value::Name + std::wcslen(value.name) * sizeof(char16_t) + sizeof(uint32_t) + value.data.size() + 2 * Regf::CellAlignment;
+	}
+
+	for (const Platform::Memory::KeyNode* subKey : node.subKeys) {
+		size += estimateSize(*subKey);
+	}
+
+	return size;
+}
+
+/**
+ * Reads the name of a key cell of the hive being compacted.
+ */
+static std::u16string readKeyName(const std::span<const unsigned char>& keyCell)
+{
+	const bool compressed = (Regf::readUInt16(keyCell.data() + Regf::Key::Flags) & Regf::Key::CompressedName) != 0;
+	const std::span<const unsigned char> storedName = keyCell.subspan(Regf::Key::Name, Regf::readUInt16(keyCell.data() + Regf::Key::NameLength));
+
+	if (compressed) {
+		return std::u16string(storedName.begin(), storedName.end());
+	}
+
+	std::u16string name(storedName.size() / sizeof(char16_t), u'\0');
+	for (size_t i = 0; i < name.size(); ++i) {
+		name[i] = Regf::readUInt16(storedName.data() + i * sizeof(char16_t));
+	}
+
+	return name;
+}
+
+static std::system_error corruptedHive(const char* message)
+{
+	return std::system_error(std::make_error_code(std::errc::bad_message), message);
+}
+
+Regf::HiveWriter::HiveWriter(uint64_t inTimestamp, const HiveLayout& inLayout)
+	: timestamp(inTimestamp)
+	, layout(inLayout)
+	, binEnd(0)
+	, securityOffset(NullOffset)
+{
+}
+
+std::vector<unsigned char> Regf::HiveWriter::write(const Platform::Memory::KeyTree& tree, const std::wstring_view& hiveName)
+{
+	const size_t estimatedSize = estimateSize(*tree.getRoot());
+
+	// bins are not filled up to their end
+	image.clear();
+	image.reserve(BaseBlockSize + estimatedSize + estimatedSize / 8 + BinAlignment);
+	image.resize(BaseBlockSize);
+	binEnd = image.size();
+
+	source.reset();
+	addTreeKeys(tree, toUtf16(hiveName));
+
+	// all the keys share the security descriptor
+	securityOffset = writeSecurity();
+
+	return writeKeys(hiveName);
+}
+
+std::vector<unsigned char> Regf::HiveWriter::compact(const Platform::HiveFile::HiveImagePtr& inSource, const std::wstring_view& hiveName)
+{
+	// the cells of the source without its free space
+	image.clear();
+	image.reserve(BaseBlockSize + inSource->getBinsSize() + BinAlignment);
+	image.resize(BaseBlockSize);
+	binEnd = image.size();
+
+	source = inSource;
+	securityOffset = NullOffset;
+	securityOffsets.clear();
+	addSourceKeys();
+
+	return writeKeys(hiveName);
+}
+
+void Regf::HiveWriter::addTreeKeys(const Platform::Memory::KeyTree& tree, const std::u16string& rootName)
+{
+	keys.clear();
+	keys.push_back({ rootName, NoKey, {}, tree.getRoot(), NullOffset, NullOffset, 0 });
+
+	for (size_t index = 0; index < keys.size(); ++index)
+	{
+		// the entries move as keys are added
+		const Platform::Memory::KeyNode* node = keys[index].node;
+		for (const Platform::Memory::KeyNode* subKey : node->subKeys)
+		{
+			keys[index].subKeys.push_back(keys.size());
+			keys.push_back({ toUtf16(subKey->name), index, {}, subKey, NullOffset, NullOffset, 0 });
+		}
+
+		sortSubKeys(keys[index]);
+	}
+}
+
+void Regf::HiveWriter::addSourceKeys()
+{
+	keys.clear();
+
+	const uint32_t rootOffset = source->getRootOffset();
+	keys.push_back({ readKeyName(source->getKeyCell(rootOffset)), NoKey, {}, nullptr, rootOffset, NullOffset, 0 });
+
+	// a key listed twice would loop
+	std::unordered_set<uint32_t> sourceOffsets{ rootOffset };
+
+	for (size_t index = 0; index < keys.size(); ++index)
+	{
+		source->visitSubKeys(keys[index].sourceOffset, [&](uint32_t subKeyOffset)
+			{
+				if (!sourceOffsets.insert(subKeyOffset).second) {
+					throw corruptedHive("hive key listed more than once");
+				}
+
+				keys[index].subKeys.push_back(keys.size());
+				keys.push_back({ readKeyName(source->getKeyCell(subKeyOffset)), index, {}, nullptr, subKeyOffset, NullOffset, 0 });
+				return true;
+			});
+
+		sortSubKeys(keys[index]);
+	}
+}
+
+void Regf::HiveWriter::sortSubKeys(KeyEntry& key)
+{
+	// subkey lists are sorted by name
+	std::sort(key.subKeys.begin(), key.subKeys.end(), [&](size_t left, size_t right)
+		{
+			return compareNames(keys[left].name, keys[right].name) < 0;
+		});
+}
+
+std::vector<size_t> Regf::HiveWriter::getKeyOrder(const std::wstring_view& hiveName) const
+{
+	std::vector<size_t> order;
+	order.reserve(keys.size());
+
+	std::vector<bool> bOrdered(keys.size());
+	const auto addKey = [&](size_t index)
+		{
+			if (!bOrdered[index])
+			{
+				bOrdered[index] = true;
+				order.push_back(index);
+			}
+		};
+
+	if (layout.order == KeyOrder::BreadthFirst)
+	{
+		addKey(0);
+		for (size_t position = 0; position < order.size(); ++position)
+		{
+			for (size_t subKey : keys[order[position]].subKeys) {
+				addKey(subKey);
+			}
+		}
+
+		return order;
+	}
+
+	if (layout.order == KeyOrder::AccessOrder)
+	{
+		std::vector<size_t> ancestors;
+		for (const std::wstring& keyPath : layout.accessedKeys)
+		{
+			size_t index = findKey(keyPath, hiveName);
+
+			// the parents are written first, they are read to reach the key
+			ancestors.clear();
+			for (; index != NoKey && !bOrdered[index]; index = keys[index].parent) {
+				ancestors.push_back(index);
+			}
+
+			for (auto ancestor = ancestors.rbegin(); ancestor != ancestors.rend(); ++ancestor) {
+				addKey(*ancestor);
+			}
+		}
+	}
+
+	// depth first, the keys already ordered are skipped but not their subkeys
+	std::vector<size_t> pendingKeys{ 0 };
+	while (!pendingKeys.empty())
+	{
+		const size_t index = pendingKeys.back();
+		pendingKeys.pop_back();
+
+		addKey(index);
+		pendingKeys.insert(pendingKeys.end(), keys[index].subKeys.rbegin(), keys[index].subKeys.rend());
+	}
+
+	return order;
+}
+
+size_t Regf::HiveWriter::findKey(const std::wstring_view& keyPath, const std::wstring_view& hiveName) const
+{
+	size_t index = NoKey;
+	Helpers::forEachPathComponent(keyPath, [&](const std::wstring_view& component)
+		{
+			if (index == NoKey)
+			{
+				// the path starts with the hive, keys of other hives are ignored
+				index = !Registry::compareNames(component, hiveName) ? 0 : keys.size();
+				return;
+			}
+
+			if (index == keys.size()) {
+				return;
+			}
+
+			const std::u16string name = toUtf16(component);
+			const std::vector<size_t>& subKeys = keys[index].subKeys;
+			const auto subKey = std::lower_bound(subKeys.begin(), subKeys.end(), name, [&](size_t subKeyIndex, const std::u16string& subKeyName)
+				{
+					return compareNames(keys[subKeyIndex].name, subKeyName) < 0;
+				});
+
+			index = subKey != subKeys.end() && !compareNames(keys[*subKey].name, name) ? *subKey : keys.size();
+		});
+
+	return index < keys.size() ? index : NoKey;
+}
+
+uint32_t Regf::HiveWriter::allocateCell(uint32_t size)
+{
+	const uint32_t cellSize = alignUp(sizeof(uint32_t) + size, CellAlignment);
+	if (image.size() + cellSize > binEnd)
+	{
+		closeBin();
+
+		// large cells have a bin of their own
+		openBin(alignUp(BinHeaderSize + cellSize, BinAlignment));
+	}
+
+	const size_t position = image.size();
+	image.resize(position + cellSize);
+
+	// allocated cells have a negative size
+	writeUInt32(image.data() + position, static_cast<uint32_t>(-static_cast<int32_t>(cellSize)));
+
+	return static_cast<uint32_t>(position - BaseBlockSize);
+}
+
+unsigned char* Regf::HiveWriter::getCell(uint32_t offset)
+{
+	return image.data() + BaseBlockSize + offset + sizeof(uint32_t);
+}
+
+void Regf::HiveWriter::openBin(uint32_t size)
+{
+	const size_t position = image.size();
+	image.resize(position + BinHeaderSize);
+	binEnd = position + size;
+
+	unsigned char* bin = image.data() + position;
+	storeSignature(bin + Bin::Signature, "hbin");
+	writeUInt32(bin + Bin::Offset, static_cast<uint32_t>(position - BaseBlockSize));
+	writeUInt32(bin + Bin::Size, size);
+	writeUInt64(bin + Bin::Timestamp, timestamp);
+}
+
+void Regf::HiveWriter::closeBin()
+{
+	const size_t position = image.size();
+	if (position >= binEnd) {
+		return;
+	}
+
+	// the rest of the bin is a free cell
+	image.resize(binEnd);
+	writeUInt32(image.data() + position, static_cast<uint32_t>(binEnd - position));
+}
+
+uint32_t Regf::HiveWriter::writeSecurity()
+{
+	const uint32_t offset = allocateCell(Security::Descriptor + sizeof(DefaultSecurityDescriptor));
+
+	unsigned char* cell = getCell(offset);
+	storeSignature(cell + Security::Signature, "sk");
+
+	// the only descriptor of the list
+	writeUInt32(cell + Security::Next, offset);
+	writeUInt32(cell + Security::Previous, offset);
+	writeUInt32(cell + Security::DescriptorSize, sizeof(DefaultSecurityDescriptor));
+	std::memcpy(cell + Security::Descriptor, DefaultSecurityDescriptor, sizeof(DefaultSecurityDescriptor));
+
+	return offset;
+}
+
+uint32_t Regf::HiveWriter::copySecurity(uint32_t sourceOffset)
+{
+	const auto found = securityOffsets.find(sourceOffset);
+	if (found != securityOffsets.end()) {
+		return found->second;
+	}
+
+	const std::span<const unsigned char> sourceCell = source->getCell(sourceOffset);
+	if (sourceCell.size() < Security::Descriptor || sourceCell[0] != 's' || sourceCell[1] != 'k' || readUInt32(sourceCell.data() + Security::DescriptorSize) > sourceCell.size() - Security::Descriptor) {
+		throw corruptedHive("corrupted hive security descriptor");
+	}
+
+	const uint32_t descriptorSize = readUInt32(sourceCell.data() + Security::DescriptorSize);
+	const uint32_t offset = allocateCell(Security::Descriptor + descriptorSize);
+
+	unsigned char* cell = getCell(offset);
+	storeSignature(cell + Security::Signature, "sk");
+	writeUInt32(cell + Security::DescriptorSize, descriptorSize);
+	std::copy(sourceCell.begin() + Security::Descriptor, sourceCell.begin() + Security::Descriptor + descriptorSize, cell + Security::Descriptor);
+
+	// appended to the list of descriptors, which loops back to the first one
+	if (securityOffset == NullOffset)
+	{
+		securityOffset = offset;
+		writeUInt32(cell + Security::Next, offset);
+		writeUInt32(cell + Security::Previous, offset);
+	}
+	else
+	{
+		const uint32_t lastOffset = readUInt32(getCell(securityOffset) + Security::Previous);
+		writeUInt32(cell + Security::Next, securityOffset);
+		writeUInt32(cell + Security::Previous, lastOffset);
+		writeUInt32(getCell(lastOffset) + Security::Next, offset);
+		writeUInt32(getCell(securityOffset) + Security::Previous, offset);
+	}
+
+	securityOffsets.emplace(sourceOffset, offset);
+	return offset;
+}
+
+std::vector<unsigned char> Regf::HiveWriter::writeKeys(const std::wstring_view& hiveName)
+{
+	for (size_t index : getKeyOrder(hiveName))
+	{
+		KeyEntry& key = keys[index];
+		writeKey(key);
+
+		// the subkey list follows the last subkey written
+		if (key.parent != NoKey)
+		{
+			KeyEntry& parent = keys[key.parent];
+			if (++parent.writtenSubKeys == parent.subKeys.size()) {
+				writeSubKeys(parent);
+			}
+		}
+	}
+
+	closeBin();
+
+	writeBaseBlock(keys.front().offset, toUtf16(hiveName));
+
+	keys.clear();
+	source.reset();
+	securityOffsets.clear();
+
+	return std::move(image);
+}
+
+void Regf::HiveWriter::writeKey(KeyEntry& key)
+{
+	const bool compressed = isCompressible(key.name);
+	const uint32_t nameSize = getNameSize(key.name, compressed);
+
+	uint16_t flags = key.parent == NoKey ? Key::HiveEntry | Key::NoDelete : 0;
+	uint64_t keyTimestamp = timestamp;
+	uint32_t keySecurityOffset = securityOffset;
+	std::span<const unsigned char> className;
+
+	if (source)
+	{
+		// the key is copied as it is, only its cells move
+		const std::span<const unsigned char> sourceCell = source->getKeyCell(key.sourceOffset);
+		flags = readUInt16(sourceCell.data() + Key::Flags) & ~Key::CompressedName;
+		keyTimestamp = readUInt64(sourceCell.data() + Key::Timestamp);
+		keySecurityOffset = copySecurity(readUInt32(sourceCell.data() + Key::Security));
+
+		const uint16_t classLength = readUInt16(sourceCell.data() + Key::ClassLength);
+		if (classLength)
+		{
+			className = source->getCell(readUInt32(sourceCell.data() + Key::Class));
+			if (className.size() < classLength) {
+				throw corruptedHive("corrupted hive key class");
+			}
+
+			className = className.first(classLength);
+		}
+	}
+
+	key.offset = allocateCell(Key::Name + nameSize);
+
+	unsigned char* cell = getCell(key.offset);
+	storeSignature(cell + Key::Signature, "nk");
+	writeUInt16(cell + Key::Flags, flags | (compressed ? Key::CompressedName : 0));
+	writeUInt64(cell + Key::Timestamp, keyTimestamp);
+	writeUInt32(cell + Key::Parent, key.parent != NoKey ? keys[key.parent].offset : NullOffset);
+	writeUInt32(cell + Key::SubKeyList, NullOffset);
+	writeUInt32(cell + Key::VolatileSubKeyList, NullOffset);
+	writeUInt32(cell + Key::ValueList, NullOffset);
+	writeUInt32(cell + Key::Security, keySecurityOffset);
+	writeUInt32(cell + Key::Class, NullOffset);
+	writeUInt16(cell + Key::NameLength, static_cast<uint16_t>(nameSize));
+	storeName(cell + Key::Name, key.name, compressed);
+
+	unsigned char* security = getCell(keySecurityOffset);
+	writeUInt32(security + Security::ReferenceCount, readUInt32(security + Security::ReferenceCount) + 1);
+
+	if (!className.empty())
+	{
+		const uint32_t classOffset = allocateCell(static_cast<uint32_t>(className.size()));
+		std::copy(className.begin(), className.end(), getCell(classOffset));
+
+		cell = getCell(key.offset);
+		writeUInt32(cell + Key::Class, classOffset);
+		writeUInt16(cell + Key::ClassLength, static_cast<uint16_t>(className.size()));
+	}
+
+	writeKeyValues(key);
+}
+
+void Regf::HiveWriter::writeKeyValues(const KeyEntry& key)
+{
+	std::vector<uint32_t> valueOffsets;
+	if (source)
+	{
+		source->visitValues(key.sourceOffset, [&](uint32_t valueOffset)
+			{
+				valueOffsets.push_back(valueOffset);
+				return true;
+			});
+
+		for (uint32_t& valueOffset : valueOffsets) {
+			valueOffset = copyValue(valueOffset);
+		}
+	}
+	else
+	{
+		valueOffsets.reserve(key.node->values.size());
+		for (const Platform::Memory::KeyValue& value : key.node->values) {
+			valueOffsets.push_back(writeValue(value.getView()));
+		}
+	}
+
+	if (valueOffsets.empty()) {
+		return;
+	}
+
+	uint32_t maxValueNameLength = 0;
+	uint32_t maxValueDataLength = 0;
+	for (uint32_t valueOffset : valueOffsets)
+	{
+		// lengths of the names in UTF-16
+		const unsigned char* value = getCell(valueOffset);
+		const uint32_t nameLength = readUInt16(value + Value::NameLength) * ((readUInt16(value + Value::Flags) & Value::CompressedName) ? sizeof(char16_t) : 1);
+
+		maxValueNameLength = std::max(maxValueNameLength, nameLength);
+		maxValueDataLength = std::max(maxValueDataLength, readUInt32(value + Value::DataSize) & ~Value::InlineData);
+	}
+
+	const uint32_t listOffset = allocateCell(static_cast<uint32_t>(valueOffsets.size() * sizeof(uint32_t)));
+	unsigned char* list = getCell(listOffset);
+	for (size_t i = 0; i < valueOffsets.size(); ++i) {
+		writeUInt32(list + i * sizeof(uint32_t), valueOffsets[i]);
+	}
+
+	unsigned char* cell = getCell(key.offset);
+	writeUInt32(cell + Key::ValueCount, static_cast<uint32_t>(valueOffsets.size()));
+	writeUInt32(cell + Key::ValueList, listOffset);
+	writeUInt32(cell + Key::MaxValueNameLength, maxValueNameLength);
+	writeUInt32(cell + Key::MaxValueDataLength, maxValueDataLength);
+}
+
+void Regf::HiveWriter::writeSubKeys(const KeyEntry& key)
+{
+	std::vector<SubKeyEntry> entries;
+	entries.reserve(key.subKeys.size());
+
+	uint32_t maxNameLength = 0;
+	uint32_t maxClassLength = 0;
+	for (size_t index : key.subKeys)
+	{
+		const KeyEntry& subKey = keys[index];
+		entries.push_back({ subKey.offset, hashName(subKey.name) });
+
+		maxNameLength = std::max(maxNameLength, static_cast<uint32_t>(subKey.name.size() * sizeof(char16_t)));
+		maxClassLength = std::max<uint32_t>(maxClassLength, readUInt16(getCell(subKey.offset) + Key::ClassLength));
+	}
+
+	const uint32_t listOffset = writeSubKeyList(entries);
+
+	unsigned char* cell = getCell(key.offset);
+	writeUInt32(cell + Key::SubKeyCount, static_cast<uint32_t>(entries.size()));
+	writeUInt32(cell + Key::SubKeyList, listOffset);
+	writeUInt32(cell + Key::MaxNameLength, maxNameLength);
+	writeUInt32(cell + Key::MaxClassLength, maxClassLength);
+}
+
+uint32_t Regf::HiveWriter::writeValue(const IValue& value)
+{
+	const std::u16string name = toUtf16(value.getValueName());
+	const bool compressed = isCompressible(name);
+
+	std::vector<unsigned char> storedName(getNameSize(name, compressed));
+	storeName(storedName.data(), name, compressed);
+
+	return writeValueCell(storedName, compressed ? Value::CompressedName : 0, value.getType().getRawType(), value.getRawData());
+}
+
+uint32_t Regf::HiveWriter::copyValue(uint32_t sourceOffset)
+{
+	// reads the data, checking the cell and joining the segments of big data
+	const Platform::HiveFile::Value value(source, sourceOffset);
+
+	// the name and raw type are kept as they are stored
+	const std::span<const unsigned char> sourceCell = source->getCell(sourceOffset);
+	const std::span<const unsigned char> storedName = sourceCell.subspan(Value::Name, readUInt16(sourceCell.data() + Value::NameLength));
+
+	return writeValueCell(storedName, readUInt16(sourceCell.data() + Value::Flags), readUInt32(sourceCell.data() + Value::Type), value.getRawData());
+}
+
+uint32_t Regf::HiveWriter::writeValueCell(std::span<const unsigned char> storedName, uint16_t flags, uint32_t rawType, std::span<const unsigned char> data)
+{
+	uint32_t dataSize = static_cast<uint32_t>(data.size());
+	uint32_t dataOffset = 0;
+	if (data.size() > sizeof(uint32_t)) {
+		dataOffset = writeData(data);
+	}
+	else {
+		dataSize |= Value::InlineData;
+	}
+
+	const uint32_t valueOffset = allocateCell(static_cast<uint32_t>(Value::Name + storedName.size()));
+
+	unsigned char* cell = getCell(valueOffset);
+	storeSignature(cell + Value::Signature, "vk");
+	writeUInt16(cell + Value::NameLength, static_cast<uint16_t>(storedName.size()));
+	writeUInt32(cell + Value::DataSize, dataSize);
+	writeUInt32(cell + Value::Data, dataOffset);
+	writeUInt32(cell + Value::Type, rawType);
+	writeUInt16(cell + Value::Flags, flags);
+	std::copy(storedName.begin(), storedName.end(), cell + Value::Name);
+
+	if (dataSize & Value::InlineData) {
+		std::copy(data.begin(), data.end(), cell + Value::Data);
+	}
+
+	return valueOffset;
+}
+
+uint32_t Regf::HiveWriter::writeData(std::span<const unsigned char> data)
+{
+	if (data.size() <= BigData::MaxSegmentSize)
+	{
+		const uint32_t offset = allocateCell(static_cast<uint32_t>(data.size()));
+		std::copy(data.begin(), data.end(), getCell(offset));
+
+		return offset;
+	}
+
+	// split in segments, listed by a big data cell
+	std::vector<uint32_t> segmentOffsets;
+	for (size_t position = 0; position < data.size(); position += BigData::MaxSegmentSize)
+	{
+		const std::span<const unsigned char> segment = data.subspan(position, std::min<size_t>(BigData::MaxSegmentSize, data.size() - position));
+
+		const uint32_t offset = allocateCell(static_cast<uint32_t>(segment.size()));
+		std::copy(segment.begin(), segment.end(), getCell(offset));
+		segmentOffsets.push_back(offset);
+	}
+
+	const uint32_t listOffset = allocateCell(static_cast<uint32_t>(segmentOffsets.size() * sizeof(uint32_t)));
+	unsigned char* list = getCell(listOffset);
+	for (size_t i = 0; i < segmentOffsets.size(); ++i) {
+		writeUInt32(list + i * sizeof(uint32_t), segmentOffsets[i]);
+	}
+
+	const uint32_t offset = allocateCell(BigData::Size);
+
+	unsigned char* cell = getCell(offset);
+	storeSignature(cell + BigData::Signature, "db");
+	writeUInt16(cell + BigData::SegmentCount, static_cast<uint16_t>(segmentOffsets.size()));
+	writeUInt32(cell + BigData::SegmentList, listOffset);
+
+	return offset;
+}
+
+uint32_t Regf::HiveWriter::writeSubKeyList(std::span<const SubKeyEntry> entries)
+{
+	if (entries.size() <= SubKeyList::MaxLeafEntries) {
+		return writeLeaf(entries);
+	}
+
+	// too many subkeys for a leaf, index the leaves
+	std::vector<uint32_t> leafOffsets;
+	for (size_t position = 0; position < entries.size(); position += SubKeyList::MaxLeafEntries) {
+		leafOffsets.push_back(writeLeaf(entries.subspan(position, std::min<size_t>(SubKeyList::MaxLeafEntries, entries.size() - position))));
+	}
+
+	const uint32_t offset = allocateCell(static_cast<uint32_t>(SubKeyList::Entries + leafOffsets.size() * SubKeyList::IndexEntrySize));
+
+	unsigned char* cell = getCell(offset);
+	storeSignature(cell + SubKeyList::Signature, "ri");
+	writeUInt16(cell + SubKeyList::Count, static_cast<uint16_t>(leafOffsets.size()));
+	for (size_t i = 0; i < leafOffsets.size(); ++i) {
+		writeUInt32(cell + SubKeyList::Entries + i * SubKeyList::IndexEntrySize, leafOffsets[i]);
+	}
+
+	return offset;
+}
+
+uint32_t Regf::HiveWriter::writeLeaf(std::span<const SubKeyEntry> entries)
+{
+	const uint32_t offset = allocateCell(static_cast<uint32_t>(SubKeyList::Entries + entries.size() * SubKeyList::LeafEntrySize));
+
+	unsigned char* cell = getCell(offset);
+	storeSignature(cell + SubKeyList::Signature, "lh");
+	writeUInt16(cell + SubKeyList::Count, static_cast<uint16_t>(entries.size()));
+	for (size_t i = 0; i < entries.size(); ++i)
+	{
+		unsigned char* entry = cell + SubKeyList::Entries + i * SubKeyList::LeafEntrySize;
+		writeUInt32(entry, entries[i].offset);
+		writeUInt32(entry + sizeof(uint32_t), entries[i].hash);
+	}
+
+	return offset;
+}
+
+void Regf::HiveWriter::writeBaseBlock(uint32_t rootOffset, const std::u16string_view& fileName)
+{
+	unsigned char* baseBlock = image.data();
+	storeSignature(baseBlock + BaseBlock::Signature, "regf");
+
+	// equal sequence numbers, the hive is consistent without its logs
+	writeUInt32(baseBlock + BaseBlock::PrimarySequence, 1);
+	writeUInt32(baseBlock + BaseBlock::SecondarySequence, 1);
+	writeUInt64(baseBlock + BaseBlock::Timestamp, timestamp);
+	writeUInt32(baseBlock + BaseBlock::MajorVersion, MajorVersion);
+	writeUInt32(baseBlock + BaseBlock::MinorVersion, MinorVersion);
+	writeUInt32(baseBlock + BaseBlock::FileType, 0);
+	writeUInt32(baseBlock + BaseBlock::FileFormat, 1);
+	writeUInt32(baseBlock + BaseBlock::RootCell, rootOffset);
+	writeUInt32(baseBlock + BaseBlock::BinsSize, static_cast<uint32_t>(image.size() - BaseBlockSize));
+	writeUInt32(baseBlock + BaseBlock::Clustering, 1);
+
+	// the end of the name, with its terminator
+	const size_t maxNameLength = BaseBlock::FileNameSize / sizeof(char16_t) - 1;
+	const std::u16string_view name = fileName.size() > maxNameLength ? fileName.substr(fileName.size() - maxNameLength) : fileName;
+	storeName(baseBlock + BaseBlock::FileName, name, false);
+
+	writeUInt32(baseBlock + BaseBlock::Checksum, computeChecksum(std::span<const unsigned char>(baseBlock, BaseBlockSize)));
+}
+
+void Regf::writeHive(std::ostream& stream, const Platform::Memory::KeyTree& tree, const std::wstring_view& hiveName, const HiveLayout& layout)
+{
+	HiveWriter writer(getCurrentTimestamp(), layout);
+	const std::vector<unsigned char> image = writer.write(tree, hiveName);
+
+	stream.write(reinterpret_cast<const char*>(image.data()), image.size());
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include "registry_hive_file_platform.h"
+#include "registry_memory_platform.h"
+#include "registry_regf.h"
+
+#include <ostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace Registry
+{
+	namespace Regf
+	{
+		/**
+		 * Lays out a key tree as a hive file image, in a buffer allocated once for the whole hive.
+		 * Keys are written in the order of the layout, each followed by its values, and the subkey list
+		 * of a key once its last subkey is written. Bins are only left free at their end.
+		 */
+		class HiveWriter
+		{
+		public:
+			HiveWriter(uint64_t inTimestamp = getCurrentTimestamp(), const HiveLayout& inLayout = HiveLayout());
+
+			/**
+			 * Returns the image of the hive file, the root key is named after the hive.
+			 */
+			std::vector<unsigned char> write(const Platform::Memory::KeyTree& tree, const std::wstring_view& hiveName);
+
+			/**
+			 * Returns the image of an existing hive laid out again, without its free cells. The keys keep their
+			 * security descriptors, classes, flags and timestamps, and the values their raw types.
+			 */
+			std::vector<unsigned char> compact(const Platform::HiveFile::HiveImagePtr& inSource, const std::wstring_view& hiveName);
+
+		private:
+			/** Parent of the root key. */
+			static constexpr size_t NoKey = ~static_cast<size_t>(0);
+
+			struct SubKeyEntry
+			{
+				uint32_t offset;
+				uint32_t hash;
+			};
+
+			/**
+			 * A key to write, from the key tree or from the hive being compacted.
+			 */
+			struct KeyEntry
+			{
+				std::u16string name;
+				size_t parent;
+
+				/** Indexes of the subkeys, sorted by name. */
+				std::vector<size_t> subKeys;
+
+				const Platform::Memory::KeyNode* node;
+				uint32_t sourceOffset;
+
+				uint32_t offset;
+				size_t writtenSubKeys;
+			};
+
+			void addTreeKeys(const Platform::Memory::KeyTree& tree, const std::u16string& rootName);
+			void addSourceKeys();
+			void sortSubKeys(KeyEntry& key);
+
+			/**
+			 * Returns the keys in the order they are written, each after its parent.
+			 */
+			std::vector<size_t> getKeyOrder(const std::wstring_view& hiveName) const;
+			size_t findKey(const std::wstring_view& keyPath, const std::wstring_view& hiveName) const;
+
+			/**
+			 * Allocates a cell in the current bin, or in a new bin if it doesn't fit.
+			 */
+			uint32_t allocateCell(uint32_t size);
+			unsigned char* getCell(uint32_t offset);
+
+			void openBin(uint32_t size);
+			void closeBin();
+
+			std::vector<unsigned char> writeKeys(const std::wstring_view& hiveName);
+			uint32_t writeSecurity();
+			uint32_t copySecurity(uint32_t sourceOffset);
+			void writeKey(KeyEntry& key);
+			void writeKeyValues(const KeyEntry& key);
+			void writeSubKeys(const KeyEntry& key);
+			uint32_t writeValue(const IValue& value);
+			uint32_t copyValue(uint32_t sourceOffset);
+			uint32_t writeValueCell(std::span<const unsigned char> storedName, uint16_t flags, uint32_t rawType, std::span<const unsigned char> data);
+			uint32_t writeData(std::span<const unsigned char> data);
+			uint32_t writeSubKeyList(std::span<const SubKeyEntry> entries);
+			uint32_t writeLeaf(std::span<const SubKeyEntry> entries);
+			void writeBaseBlock(uint32_t rootOffset, const std::u16string_view& fileName);
+
+		private:
+			uint64_t timestamp;
+			HiveLayout layout;
+			std::vector<unsigned char> image;
+			size_t binEnd;
+			uint32_t securityOffset;
+
+			std::vector<KeyEntry> keys;
+			Platform::HiveFile::HiveImagePtr source;
+
+			/** Security descriptors of the compacted hive, by their offset in the source. */
+			std::unordered_map<uint32_t, uint32_t> securityOffsets;
+		};
+
+		/**
+		 * Writes the hive file of a key tree in a single write.
+		 */
+		void writeHive(std::ostream& stream, const Platform::Memory::KeyTree& tree, const std::wstring_view& hiveName, const HiveLayout& layout = HiveLayout());
+	}
+}
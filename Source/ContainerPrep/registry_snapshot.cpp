@@ -0,0 +1,28 @@
+#include "registry_snapshot.h"
+
+using namespace Registry;
+
+KeySnapshot::KeySnapshot(IRegistryManager& sourceRegistry, const IKey* sourceKey, const ICopyFilter* filter)
+	: tree(std::make_shared<Platform::Memory::KeyTree>())
+{
+	// the managers of the memory registry are stateless
+	Platform::Memory::KeyManager keyManager;
+	Platform::Memory::ValueManager valueManager;
+
+	const Platform::Memory::Key rootKey(tree, tree->getRoot());
+	Helpers::copyTree(sourceRegistry.getKeyManager(), sourceRegistry.getValueManager(), keyManager, valueManager, sourceKey, &rootKey, filter);
+}
+
+void KeySnapshot::apply(IRegistryManager& targetRegistry, const IKey* targetKey) const
+{
+	Platform::Memory::KeyManager keyManager;
+	Platform::Memory::ValueManager valueManager;
+
+	const Platform::Memory::Key rootKey(tree, tree->getRoot());
+	Helpers::copyTree(keyManager, valueManager, targetRegistry.getKeyManager(), targetRegistry.getValueManager(), &rootKey, targetKey);
+}
+
+size_t KeySnapshot::getKeyCount() const
+{
+	return tree->getKeyCount();
+}
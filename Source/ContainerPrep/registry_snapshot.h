@@ -0,0 +1,39 @@
+#pragma once
+
+#include "registry.h"
+#include "registry_memory_platform.h"
+
+#include <memory>
+
+namespace Registry
+{
+	/**
+	 * Copy of a registry subtree held in memory. It is not modified once read,
+	 * so it can be read on one thread and applied on another.
+	 */
+	class KeySnapshot
+	{
+	public:
+		/**
+		 * Reads the values and subkeys of a key, only those selected by the filter if one is specified.
+		 */
+		KeySnapshot(IRegistryManager& sourceRegistry, const IKey* sourceKey, const ICopyFilter* filter = nullptr);
+
+		KeySnapshot(const KeySnapshot&) = delete;
+		KeySnapshot& operator=(const KeySnapshot&) = delete;
+
+		/**
+		 * Copies the values and subkeys of the snapshot to a key.
+		 */
+		void apply(IRegistryManager& targetRegistry, const IKey* targetKey) const;
+
+		/**
+		 * Number of keys read, including the key itself.
+		 */
+		size_t getKeyCount() const;
+
+	private:
+		Platform::Memory::KeyTreePtr tree;
+	};
+	using KeySnapshotPtr = std::shared_ptr<const KeySnapshot>;
+}
@@ -0,0 +1,600 @@
+#include "registry_tracing.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <filesystem>
+#include <iomanip>
+
+using namespace Registry;
+
+static std::atomic<uint64_t> nextTraceId(0);
+
+static const char* operationNames[] =
+{
+	"getKey",
+	"getOrCreateKey",
+	"getPredefinedKey",
+	"visitKeys",
+	"copyTree",
+	"queryKeyInfo",
+	"deleteKey",
+	"getValue",
+	"newValue",
+	"setValue",
+	"visitKeyValues",
+	"readKeyValues",
+	"createHive",
+	"loadHive",
+	"saveHive",
+	"commitHive"
+};
+
+const char* Tracing::getOperationName(Operation operation)
+{
+	return operationNames[static_cast<size_t>(operation)];
+}
+
+size_t Tracing::LatencyBuckets::getBucket(uint64_t nanoseconds)
+{
+	if (nanoseconds < 16) {
+		return static_cast<size_t>(nanoseconds);
+	}
+
+	// 8 buckets for each power of two, from the 3 bits after the highest one
+	const size_t exponent = std::bit_width(nanoseconds) - 1;
+	const size_t subBucket = (nanoseconds >> (exponent - 3)) & 7;
+	return 16 + (exponent - 4) * 8 + subBucket;
+}
+
+uint64_t Tracing::LatencyBuckets::getLatency(size_t bucket)
+{
+	if (bucket < 16) {
+		return bucket;
+	}
+
+	const size_t exponent = (bucket - 16) / 8 + 4;
+	const uint64_t subBucket = (bucket - 16) % 8;
+	return (8 + subBucket) << (exponent - 3);
+}
+
+std::chrono::nanoseconds Tracing::OperationTrace::getPercentile(double fraction) const
+{
+	const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(count * fraction)));
+
+	uint64_t total = 0;
+	for (size_t bucket = 0; bucket < buckets.size(); ++bucket)
+	{
+		total += buckets[bucket];
+		if (total >= rank)
+		{
+			// the highest latency of the bucket, at most the slowest operation
+			if (bucket + 1 < buckets.size()) {
+				return std::min(maxTime, std::chrono::nanoseconds(LatencyBuckets::getLatency(bucket + 1) - 1));
+			}
+
+			break;
+		}
+	}
+
+	return maxTime;
+}
+
+/**
+ * Adds to a counter only written by the calling thread.
+ */
+static void addToCounter(std::atomic<uint64_t>& counter, uint64_t value)
+{
+	counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+static bool isFaster(const Tracing::SlowKeyTrace& left, const Tracing::SlowKeyTrace& right)
+{
+	return left.time > right.time;
+}
+
+Tracing::RegistryTrace::RegistryTrace()
+	: traceId(nextTraceId++)
+{
+}
+
+Tracing::RegistryTrace::ThreadTrace& Tracing::RegistryTrace::getThreadTrace()
+{
+	// counters of the thread for each trace it recorded in
+	thread_local std::vector<std::pair<uint64_t, ThreadTrace*>> threadCounters;
+
+	for (const auto& [id, threadTrace] : threadCounters)
+	{
+		if (id == traceId) {
+			return *threadTrace;
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(threadTracesMutex);
+	ThreadTrace* threadTrace = threadTraces.emplace_back(std::make_unique<ThreadTrace>()).get();
+	threadCounters.emplace_back(traceId, threadTrace);
+
+	return *threadTrace;
+}
+
+void Tracing::RegistryTrace::addCounters(OperationCounters& counters, uint64_t time, uint64_t bytes)
+{
+	addToCounter(counters.count, 1);
+	addToCounter(counters.bytes, bytes);
+	addToCounter(counters.totalTime, time);
+	addToCounter(counters.buckets[LatencyBuckets::getBucket(time)], 1);
+
+	if (time > counters.maxTime.load(std::memory_order_relaxed)) {
+		counters.maxTime.store(time, std::memory_order_relaxed);
+	}
+}
+
+void Tracing::RegistryTrace::addSlowKey(ThreadTrace& threadTrace, Operation operation, std::chrono::nanoseconds time, std::wstring&& keyPath)
+{
+	std::lock_guard<std::mutex> lock(threadTrace.slowestKeysMutex);
+
+	std::vector<SlowKeyTrace>& slowestKeys = threadTrace.slowestKeys;
+	if (slowestKeys.size() == slowestKeyCount)
+	{
+		std::pop_heap(slowestKeys.begin(), slowestKeys.end(), isFaster);
+		slowestKeys.pop_back();
+	}
+
+	slowestKeys.push_back({ operation, time, std::move(keyPath) });
+	std::push_heap(slowestKeys.begin(), slowestKeys.end(), isFaster);
+
+	if (slowestKeys.size() == slowestKeyCount) {
+		threadTrace.slowestKeyThreshold.store(slowestKeys.front().time.count(), std::memory_order_relaxed);
+	}
+}
+
+void Tracing::RegistryTrace::record(Operation operation, std::chrono::nanoseconds time, uint64_t bytes, const IKey* key, const std::wstring_view& subKeyName)
+{
+	ThreadTrace& threadTrace = getThreadTrace();
+	addCounters(threadTrace.operations[static_cast<size_t>(operation)], time.count(), bytes);
+
+	if (static_cast<uint64_t>(time.count()) > threadTrace.slowestKeyThreshold.load(std::memory_order_relaxed)) {
+		addSlowKey(threadTrace, operation, time, getKeyPath(key, subKeyName));
+	}
+}
+
+void Tracing::RegistryTrace::record(Operation operation, std::chrono::nanoseconds time, const std::wstring_view& hiveName)
+{
+	ThreadTrace& threadTrace = getThreadTrace();
+	addCounters(threadTrace.operations[static_cast<size_t>(operation)], time.count(), 0);
+
+	if (static_cast<uint64_t>(time.count()) > threadTrace.slowestKeyThreshold.load(std::memory_order_relaxed)) {
+		addSlowKey(threadTrace, operation, time, std::wstring(hiveName));
+	}
+}
+
+Tracing::RegistryTrace::KeyShard& Tracing::RegistryTrace::getKeyShard(const IKey* key)
+{
+	// keys are allocated on at least 16 bytes, the low bits are the same for all of them
+	return keyShards[(reinterpret_cast<uintptr_t>(key) >> 4) % keyShardCount];
+}
+
+const Tracing::RegistryTrace::KeyShard& Tracing::RegistryTrace::getKeyShard(const IKey* key) const
+{
+	return keyShards[(reinterpret_cast<uintptr_t>(key) >> 4) % keyShardCount];
+}
+
+Tracing::RegistryTrace::KeyNamePtr Tracing::RegistryTrace::findKeyName(const IKey* key) const
+{
+	if (!key) {
+		return nullptr;
+	}
+
+	const KeyShard& shard = getKeyShard(key);
+
+	std::lock_guard<std::mutex> lock(shard.mutex);
+	auto it = shard.keys.find(key);
+	return it != shard.keys.end() ? it->second.keyName : nullptr;
+}
+
+std::wstring Tracing::RegistryTrace::getKeyPath(const IKey* key, const std::wstring_view& subKeyName) const
+{
+	std::vector<const std::wstring*> names;
+	const KeyNamePtr keyName = findKeyName(key);
+	for (const KeyName* name = keyName.get(); name; name = name->parent.get()) {
+		names.push_back(&name->name);
+	}
+
+	// names from the first key opened through the registry
+	std::wstring path;
+	for (auto it = names.rbegin(); it != names.rend(); ++it)
+	{
+		if (!path.empty()) {
+			path += L'\\';
+		}
+
+		path += **it;
+	}
+
+	if (!subKeyName.empty())
+	{
+		if (!path.empty()) {
+			path += L'\\';
+		}
+
+		path += subKeyName;
+	}
+
+	return path;
+}
+
+IKeyPtr Tracing::RegistryTrace::addKey(IKeyPtr&& key, const IKey* parentKey, const std::wstring_view& keyName)
+{
+	if (!key) {
+		return std::move(key);
+	}
+
+	KeyNamePtr name = std::make_shared<const KeyName>(KeyName{ findKeyName(parentKey), std::wstring(keyName) });
+	{
+		KeyShard& shard = getKeyShard(key.get());
+
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		OpenedKey& openedKey = shard.keys.try_emplace(key.get(), OpenedKey{ std::move(name), 0 }).first->second;
+		openedKey.refCount++;
+	}
+
+	// the same key is returned, its path is forgotten when it is released
+	IKey* rawKey = key.get();
+	return IKeyPtr(rawKey, [this, key = std::move(key)](IKey*)
+		{
+			removeKey(key.get());
+		});
+}
+
+void Tracing::RegistryTrace::removeKey(const IKey* key)
+{
+	KeyShard& shard = getKeyShard(key);
+
+	std::lock_guard<std::mutex> lock(shard.mutex);
+	auto it = shard.keys.find(key);
+	if (it != shard.keys.end() && !--it->second.refCount) {
+		shard.keys.erase(it);
+	}
+}
+
+std::vector<Tracing::OperationTrace> Tracing::RegistryTrace::getOperations() const
+{
+	std::vector<OperationTrace> operations;
+
+	std::lock_guard<std::mutex> lock(threadTracesMutex);
+	for (size_t i = 0; i < static_cast<size_t>(Operation::Count); ++i)
+	{
+		OperationTrace operation;
+		operation.operation = static_cast<Operation>(i);
+		operation.buckets.resize(LatencyBuckets::count);
+
+		for (const std::unique_ptr<ThreadTrace>& threadTrace : threadTraces)
+		{
+			const OperationCounters& counters = threadTrace->operations[i];
+			operation.count += counters.count.load(std::memory_order_relaxed);
+			operation.bytes += counters.bytes.load(std::memory_order_relaxed);
+			operation.totalTime += std::chrono::nanoseconds(counters.totalTime.load(std::memory_order_relaxed));
+			operation.maxTime = std::max(operation.maxTime, std::chrono::nanoseconds(counters.maxTime.load(std::memory_order_relaxed)));
+
+			for (size_t bucket = 0; bucket < LatencyBuckets::count; ++bucket) {
+				operation.buckets[bucket] += counters.buckets[bucket].load(std::memory_order_relaxed);
+			}
+		}
+
+		if (operation.count) {
+			operations.push_back(std::move(operation));
+		}
+	}
+
+	return operations;
+}
+
+std::vector<Tracing::SlowKeyTrace> Tracing::RegistryTrace::getSlowestKeys() const
+{
+	std::vector<SlowKeyTrace> slowestKeys;
+
+	std::lock_guard<std::mutex> lock(threadTracesMutex);
+	for (const std::unique_ptr<ThreadTrace>& threadTrace : threadTraces)
+	{
+		std::lock_guard<std::mutex> keysLock(threadTrace->slowestKeysMutex);
+		slowestKeys.insert(slowestKeys.end(), threadTrace->slowestKeys.begin(), threadTrace->slowestKeys.end());
+	}
+
+	std::sort(slowestKeys.begin(), slowestKeys.end(), isFaster);
+	if (slowestKeys.size() > slowestKeyCount) {
+		slowestKeys.resize(slowestKeyCount);
+	}
+
+	return slowestKeys;
+}
+
+/**
+ * Records an operation on a key when it returns or throws.
+ */
+class KeyOperationScope
+{
+public:
+	KeyOperationScope(Tracing::RegistryTrace& inTrace, Tracing::Operation inOperation, const IKey* inKey, const wchar_t* inSubKeyName = nullptr)
+		: trace(inTrace)
+		, operation(inOperation)
+		, key(inKey)
+		, subKeyName(inSubKeyName ? inSubKeyName : L"")
+		, startTime(std::chrono::steady_clock::now())
+		, bytes(0)
+	{
+	}
+
+	~KeyOperationScope()
+	{
+		trace.record(operation, std::chrono::steady_clock::now() - startTime, bytes, key, subKeyName);
+	}
+
+private:
+	Tracing::RegistryTrace& trace;
+	Tracing::Operation operation;
+	const IKey* key;
+	std::wstring_view subKeyName;
+	std::chrono::steady_clock::time_point startTime;
+
+public:
+	uint64_t bytes;
+};
+
+class HiveOperationScope
+{
+public:
+	HiveOperationScope(Tracing::RegistryTrace& inTrace, Tracing::Operation inOperation, const std::wstring& inHiveName)
+		: trace(inTrace)
+		, operation(inOperation)
+		, hiveName(inHiveName)
+		, startTime(std::chrono::steady_clock::now())
+	{
+	}
+
+	~HiveOperationScope()
+	{
+		trace.record(operation, std::chrono::steady_clock::now() - startTime, hiveName);
+	}
+
+private:
+	Tracing::RegistryTrace& trace;
+	Tracing::Operation operation;
+	std::wstring hiveName;
+	std::chrono::steady_clock::time_point startTime;
+};
+
+Tracing::KeyManager::KeyManager(IKeyManager& inKeyManager, RegistryTrace& inTrace)
+	: keyManager(inKeyManager)
+	, trace(inTrace)
+{
+}
+
+IKeyPtr Tracing::KeyManager::getKey(const wchar_t* keyName, Permission permissions, const IKey* parentKey)
+{
+	IKeyPtr key;
+	{
+		KeyOperationScope scope(trace, Operation::GetKey, parentKey, keyName);
+		key = keyManager.getKey(keyName, permissions, parentKey);
+	}
+
+	return trace.addKey(std::move(key), parentKey, keyName);
+}
+
+IKeyPtr Tracing::KeyManager::getOrCreateKey(const wchar_t* keyName, Permission permissions, const IKey* parentKey)
+{
+	IKeyPtr key;
+	{
+		KeyOperationScope scope(trace, Operation::GetOrCreateKey, parentKey, keyName);
+		key = keyManager.getOrCreateKey(keyName, permissions, parentKey);
+	}
+
+	return trace.addKey(std::move(key), parentKey, keyName);
+}
+
+IKeyPtr Tracing::KeyManager::getPredefinedKey(const wchar_t* rootName)
+{
+	IKeyPtr key;
+	{
+		KeyOperationScope scope(trace, Operation::GetPredefinedKey, nullptr, rootName);
+		key = keyManager.getPredefinedKey(rootName);
+	}
+
+	return trace.addKey(std::move(key), nullptr, rootName);
+}
+
+bool Tracing::KeyManager::visitKeys(const IKey* key, const KeyVisitor& visitor, size_t maxDepth)
+{
+	// the time includes the visitor
+	KeyOperationScope scope(trace, Operation::VisitKeys, key);
+	return keyManager.visitKeys(key, visitor, maxDepth);
+}
+
+void Tracing::KeyManager::copyTree(const IKey* sourceKey, const IKey* targetKey, const ICopyFilter* filter, size_t maxDepth)
+{
+	KeyOperationScope scope(trace, Operation::CopyTree, sourceKey);
+	keyManager.copyTree(sourceKey, targetKey, filter, maxDepth);
+}
+
+KeyInfo Tracing::KeyManager::queryKeyInfo(const IKey* key)
+{
+	KeyOperationScope scope(trace, Operation::QueryKeyInfo, key);
+	return keyManager.queryKeyInfo(key);
+}
+
+void Tracing::KeyManager::deleteKey(const IKey* parentKey, const wchar_t* subKeyName)
+{
+	KeyOperationScope scope(trace, Operation::DeleteKey, parentKey, subKeyName);
+	keyManager.deleteKey(parentKey, subKeyName);
+}
+
+Tracing::ValueManager::ValueManager(IValueManager& inValueManager, RegistryTrace& inTrace)
+	: valueManager(inValueManager)
+	, trace(inTrace)
+{
+}
+
+IValuePtr Tracing::ValueManager::getValue(const IKey* key, const wchar_t* valueName)
+{
+	KeyOperationScope scope(trace, Operation::GetValue, key);
+	IValuePtr value = valueManager.getValue(key, valueName);
+	if (value) {
+		scope.bytes = value->getRawData().size();
+	}
+
+	return value;
+}
+
+IValuePtr Tracing::ValueManager::newValue(const wchar_t* valueName, const IDataType& dataType)
+{
+	KeyOperationScope scope(trace, Operation::NewValue, nullptr);
+	return valueManager.newValue(valueName, dataType);
+}
+
+void Tracing::ValueManager::setValue(const IKey* key, const IValue& value)
+{
+	KeyOperationScope scope(trace, Operation::SetValue, key);
+	scope.bytes = value.getRawData().size();
+	valueManager.setValue(key, value);
+}
+
+bool Tracing::ValueManager::visitKeyValues(const IKey* key, const ValueVisitor& visitor)
+{
+	// the time includes the visitor
+	KeyOperationScope scope(trace, Operation::VisitKeyValues, key);
+	return valueManager.visitKeyValues(key, [&](const IValue& value) -> bool
+		{
+			scope.bytes += value.getRawData().size();
+			return visitor(value);
+		});
+}
+
+void Tracing::ValueManager::readKeyValues(const IKey* key, ValueBatch& batch)
+{
+	KeyOperationScope scope(trace, Operation::ReadKeyValues, key);
+	valueManager.readKeyValues(key, batch);
+
+	for (size_t i = 0; i < batch.size(); ++i) {
+		scope.bytes += batch[i].getRawData().size();
+	}
+}
+
+Tracing::HiveManager::HiveManager(IHiveManager& inHiveManager, RegistryTrace& inTrace)
+	: hiveManager(inHiveManager)
+	, trace(inTrace)
+{
+}
+
+IHivePtr Tracing::HiveManager::createHive(const std::filesystem::path& hiveFileName)
+{
+	HiveOperationScope scope(trace, Operation::CreateHive, hiveFileName.wstring());
+	return hiveManager.createHive(hiveFileName);
+}
+
+IHivePtr Tracing::HiveManager::loadHive(const std::filesystem::path& hiveFileName)
+{
+	HiveOperationScope scope(trace, Operation::LoadHive, hiveFileName.wstring());
+	return hiveManager.loadHive(hiveFileName);
+}
+
+void Tracing::HiveManager::saveHive(const IHive& hive, const std::filesystem::path& hiveFileName)
+{
+	HiveOperationScope scope(trace, Operation::SaveHive, hiveFileName.wstring());
+	hiveManager.saveHive(hive, hiveFileName);
+}
+
+void Tracing::HiveManager::commitHive(const IHive& hive)
+{
+	HiveOperationScope scope(trace, Operation::CommitHive, hive.getHiveName());
+	hiveManager.commitHive(hive);
+}
+
+Tracing::RegistryManager::RegistryManager(IRegistryManager& inRegistry)
+	: keyManager(inRegistry.getKeyManager(), trace)
+	, valueManager(inRegistry.getValueManager(), trace)
+	, hiveManager(inRegistry.getHiveManager(), trace)
+{
+}
+
+IKeyManager& Tracing::RegistryManager::getKeyManager()
+{
+	return keyManager;
+}
+
+const IKeyManager& Tracing::RegistryManager::getKeyManager() const
+{
+	return keyManager;
+}
+
+IValueManager& Tracing::RegistryManager::getValueManager()
+{
+	return valueManager;
+}
+
+const IValueManager& Tracing::RegistryManager::getValueManager() const
+{
+	return valueManager;
+}
+
+IHiveManager& Tracing::RegistryManager::getHiveManager()
+{
+	return hiveManager;
+}
+
+const IHiveManager& Tracing::RegistryManager::getHiveManager() const
+{
+	return hiveManager;
+}
+
+const Tracing::RegistryTrace& Tracing::RegistryManager::getTrace() const
+{
+	return trace;
+}
+
+static double toMicroseconds(std::chrono::nanoseconds time)
+{
+	return std::chrono::duration<double, std::micro>(time).count();
+}
+
+void Tracing::writeTrace(std::ostream& stream, const RegistryTrace& trace, const std::string_view& registryName)
+{
+	const std::vector<OperationTrace> operations = trace.getOperations();
+	if (operations.empty()) {
+		return;
+	}
+
+	stream << "registry trace: " << registryName << std::endl;
+	stream << std::left << std::setw(18) << "operation" << std::right
+		<< std::setw(12) << "count"
+		<< std::setw(12) << "total ms"
+		<< std::setw(10) << "p50 us"
+		<< std::setw(10) << "p90 us"
+		<< std::setw(10) << "p99 us"
+		<< std::setw(12) << "max us"
+		<< std::setw(14) << "bytes" << std::endl;
+
+	const std::ios_base::fmtflags flags = stream.flags();
+	stream << std::fixed << std::setprecision(1);
+
+	for (const OperationTrace& operation : operations)
+	{
+		stream << std::left << std::setw(18) << getOperationName(operation.operation) << std::right
+			<< std::setw(12) << operation.count
+			<< std::setw(12) << toMicroseconds(operation.totalTime) / 1000
+			<< std::setw(10) << toMicroseconds(operation.getPercentile(0.5))
+			<< std::setw(10) << toMicroseconds(operation.getPercentile(0.9))
+			<< std::setw(10) << toMicroseconds(operation.getPercentile(0.99))
+			<< std::setw(12) << toMicroseconds(operation.maxTime)
+			<< std::setw(14) << operation.bytes << std::endl;
+	}
+
+	const std::vector<SlowKeyTrace> slowestKeys = trace.getSlowestKeys();
+	if (!slowestKeys.empty()) {
+		stream << "slowest keys:" << std::endl;
+	}
+
+	for (const SlowKeyTrace& slowKey : slowestKeys) {
+		stream << std::setw(12) << toMicroseconds(slowKey.time) << " us  " << std::left << std::setw(18) << getOperationName(slowKey.operation) << std::right << std::filesystem::path(slowKey.keyPath).string() << std::endl;
+	}
+
+	stream.flags(flags);
+}
@@ -0,0 +1,279 @@
+#pragma once
+
+#include "registry.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace Registry
+{
+	/**
+	 * Registry wrapping another one, that records the count, latency and bytes of each operation
+	 * and the slowest keys. Keys and hives are those of the wrapped registry, it works over any backend.
+	 */
+	namespace Tracing
+	{
+		enum class Operation
+		{
+			GetKey,
+			GetOrCreateKey,
+			GetPredefinedKey,
+			VisitKeys,
+			CopyTree,
+			QueryKeyInfo,
+			DeleteKey,
+			GetValue,
+			NewValue,
+			SetValue,
+			VisitKeyValues,
+			ReadKeyValues,
+			CreateHive,
+			LoadHive,
+			SaveHive,
+			CommitHive,
+			Count
+		};
+
+		const char* getOperationName(Operation operation);
+
+		/**
+		 * Latency buckets of nanoseconds, 8 per power of two, so that a recorded latency is known within 12.5%.
+		 */
+		namespace LatencyBuckets
+		{
+			constexpr size_t count = 16 + (64 - 4) * 8;
+
+			size_t getBucket(uint64_t nanoseconds);
+
+			/**
+			 * Smallest latency of a bucket.
+			 */
+			uint64_t getLatency(size_t bucket);
+		}
+
+		/**
+		 * Counters of an operation, merged from every thread.
+		 */
+		struct OperationTrace
+		{
+			Operation operation;
+			uint64_t count = 0;
+			uint64_t bytes = 0;
+			std::chrono::nanoseconds totalTime{};
+			std::chrono::nanoseconds maxTime{};
+			std::vector<uint64_t> buckets;
+
+			/**
+			 * Latency below which the specified fraction of the operations completed.
+			 */
+			std::chrono::nanoseconds getPercentile(double fraction) const;
+		};
+
+		struct SlowKeyTrace
+		{
+			Operation operation;
+			std::chrono::nanoseconds time;
+
+			/** Path of the key from the first key opened through the registry, or hive file name. */
+			std::wstring keyPath;
+		};
+
+		/**
+		 * Operations recorded by a registry. Each thread records in its own counters without locking,
+		 * they are merged when the trace is read.
+		 */
+		class RegistryTrace
+		{
+		public:
+			static constexpr size_t slowestKeyCount = 16;
+
+		public:
+			RegistryTrace();
+
+			RegistryTrace(const RegistryTrace&) = delete;
+			RegistryTrace& operator=(const RegistryTrace&) = delete;
+
+			/**
+			 * Records an operation on a key. The path of the key is only looked up if the operation is one of the slowest.
+			 */
+			void record(Operation operation, std::chrono::nanoseconds time, uint64_t bytes, const IKey* key, const std::wstring_view& subKeyName = {});
+
+			/**
+			 * Records an operation on a hive file.
+			 */
+			void record(Operation operation, std::chrono::nanoseconds time, const std::wstring_view& hiveName);
+
+			/**
+			 * Keeps the parent and name of an opened key until it is released, its path is only built for the slowest operations.
+			 */
+			IKeyPtr addKey(IKeyPtr&& key, const IKey* parentKey, const std::wstring_view& keyName);
+
+			/**
+			 * Operations that were called at least once.
+			 */
+			std::vector<OperationTrace> getOperations() const;
+
+			/**
+			 * Slowest key operations, slowest first.
+			 */
+			std::vector<SlowKeyTrace> getSlowestKeys() const;
+
+		private:
+			struct OperationCounters
+			{
+				std::atomic<uint64_t> count{ 0 };
+				std::atomic<uint64_t> bytes{ 0 };
+				std::atomic<uint64_t> totalTime{ 0 };
+				std::atomic<uint64_t> maxTime{ 0 };
+				std::array<std::atomic<uint64_t>, LatencyBuckets::count> buckets{};
+			};
+
+			/**
+			 * Counters written by a single thread, read by the thread getting the trace.
+			 */
+			struct ThreadTrace
+			{
+				std::array<OperationCounters, static_cast<size_t>(Operation::Count)> operations;
+
+				/** Heap of the slowest operations, the fastest of them first. */
+				std::vector<SlowKeyTrace> slowestKeys;
+				std::atomic<uint64_t> slowestKeyThreshold{ 0 };
+				mutable std::mutex slowestKeysMutex;
+			};
+
+			/**
+			 * Name of an opened key, below the name of its parent. Names outlive their key while a subkey is open.
+			 */
+			struct KeyName
+			{
+				std::shared_ptr<const KeyName> parent;
+				std::wstring name;
+			};
+			using KeyNamePtr = std::shared_ptr<const KeyName>;
+
+			struct OpenedKey
+			{
+				KeyNamePtr keyName;
+				size_t refCount;
+			};
+
+			/**
+			 * Opened keys are spread over shards by address, so that keys opened at the same time rarely share a lock.
+			 */
+			struct KeyShard
+			{
+				std::unordered_map<const IKey*, OpenedKey> keys;
+				mutable std::mutex mutex;
+			};
+			static constexpr size_t keyShardCount = 64;
+
+		private:
+			ThreadTrace& getThreadTrace();
+			void addCounters(OperationCounters& counters, uint64_t time, uint64_t bytes);
+			void addSlowKey(ThreadTrace& threadTrace, Operation operation, std::chrono::nanoseconds time, std::wstring&& keyPath);
+			KeyShard& getKeyShard(const IKey* key);
+			const KeyShard& getKeyShard(const IKey* key) const;
+			KeyNamePtr findKeyName(const IKey* key) const;
+			std::wstring getKeyPath(const IKey* key, const std::wstring_view& subKeyName) const;
+			void removeKey(const IKey* key);
+
+		private:
+			/** Identifies the trace in the thread-local lookups, never reused. */
+			uint64_t traceId;
+
+			std::vector<std::unique_ptr<ThreadTrace>> threadTraces;
+			mutable std::mutex threadTracesMutex;
+
+			std::array<KeyShard, keyShardCount> keyShards;
+		};
+
+		class KeyManager : public IKeyManager
+		{
+		public:
+			KeyManager(IKeyManager& inKeyManager, RegistryTrace& inTrace);
+
+			IKeyPtr getKey(const wchar_t* keyName, Permission permissions, const IKey* parentKey = nullptr) override;
+			IKeyPtr getOrCreateKey(const wchar_t* keyName, Permission permissions, const IKey* parentKey = nullptr) override;
+			IKeyPtr getPredefinedKey(const wchar_t* rootName) override;
+			bool visitKeys(const IKey* key, const KeyVisitor& visitor, size_t maxDepth = SIZE_MAX) override;
+			void copyTree(const IKey* sourceKey, const IKey* targetKey, const ICopyFilter* filter = nullptr, size_t maxDepth = SIZE_MAX) override;
+			KeyInfo queryKeyInfo(const IKey* key) override;
+			void deleteKey(const IKey* parentKey, const wchar_t* subKeyName) override;
+
+		private:
+			IKeyManager& keyManager;
+			RegistryTrace& trace;
+		};
+
+		class ValueManager : public IValueManager
+		{
+		public:
+			ValueManager(IValueManager& inValueManager, RegistryTrace& inTrace);
+
+			IValuePtr getValue(const IKey* key, const wchar_t* valueName = nullptr) override;
+			IValuePtr newValue(const wchar_t* valueName, const IDataType& dataType) override;
+			void setValue(const IKey* key, const IValue& value) override;
+			bool visitKeyValues(const IKey* key, const ValueVisitor& visitor) override;
+			void readKeyValues(const IKey* key, ValueBatch& batch) override;
+
+		private:
+			IValueManager& valueManager;
+			RegistryTrace& trace;
+		};
+
+		class HiveManager : public IHiveManager
+		{
+		public:
+			HiveManager(IHiveManager& inHiveManager, RegistryTrace& inTrace);
+
+			IHivePtr createHive(const std::filesystem::path& hiveFileName) override;
+			IHivePtr loadHive(const std::filesystem::path& hiveFileName) override;
+			void saveHive(const IHive& hive, const std::filesystem::path& hiveFileName) override;
+			void commitHive(const IHive& hive) override;
+
+		private:
+			IHiveManager& hiveManager;
+			RegistryTrace& trace;
+		};
+
+		/**
+		 * The keys opened through the registry must be released before it is destroyed.
+		 */
+		class RegistryManager : public IRegistryManager
+		{
+		public:
+			RegistryManager(IRegistryManager& inRegistry);
+
+			virtual IKeyManager& getKeyManager() override;
+			virtual const IKeyManager& getKeyManager() const override;
+
+			virtual IValueManager& getValueManager() override;
+			virtual const IValueManager& getValueManager() const override;
+
+			virtual IHiveManager& getHiveManager() override;
+			virtual const IHiveManager& getHiveManager() const override;
+
+			const RegistryTrace& getTrace() const;
+
+		private:
+			RegistryTrace trace;
+			KeyManager keyManager;
+			ValueManager valueManager;
+			HiveManager hiveManager;
+		};
+
+		/**
+		 * Writes the operations of a trace with their latency percentiles, and the slowest keys.
+		 */
+		void writeTrace(std::ostream& stream, const RegistryTrace& trace, const std::string_view& registryName);
+	}
+}
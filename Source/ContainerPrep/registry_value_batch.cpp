@@ -0,0 +1,94 @@
+#include "registry_value_batch.h"
+
+#include <cstring>
+
+using namespace Registry;
+
+static size_t alignName(size_t offset)
+{
+	return (offset + alignof(wchar_t) - 1) & ~(alignof(wchar_t) - 1);
+}
+
+ValueBatch::ValueBatch()
+	: bufferSize(0)
+	, pendingNameOffset(0)
+{
+}
+
+void ValueBatch::clear()
+{
+	bufferSize = 0;
+	entries.clear();
+}
+
+size_t ValueBatch::size() const
+{
+	return entries.size();
+}
+
+bool ValueBatch::empty() const
+{
+	return entries.empty();
+}
+
+ValueView ValueBatch::operator[](size_t index) const
+{
+	const Entry& entry = entries[index];
+	return ValueView(
+		reinterpret_cast<const wchar_t*>(buffer.data() + entry.nameOffset),
+		*entry.type,
+		std::span<const unsigned char>(buffer.data() + entry.dataOffset, entry.dataSize)
+	);
+}
+
+size_t ValueBatch::find(const std::wstring_view& valueName) const
+{
+	for (size_t i = 0; i < entries.size(); ++i)
+	{
+		if (!compareNames(reinterpret_cast<const wchar_t*>(buffer.data() + entries[i].nameOffset), valueName)) {
+			return i;
+		}
+	}
+
+	return entries.size();
+}
+
+void ValueBatch::add(const std::wstring_view& valueName, const IDataType& type, const std::span<const unsigned char>& data)
+{
+	const ValueBuffer valueBuffer = beginValue(valueName.size(), data.size());
+	std::memcpy(valueBuffer.name.data(), valueName.data(), valueName.size() * sizeof(wchar_t));
+	if (!data.empty()) {
+		std::memcpy(valueBuffer.data.data(), data.data(), data.size());
+	}
+
+	commitValue(valueName.size(), type, data.size());
+}
+
+ValueBatch::ValueBuffer ValueBatch::beginValue(size_t maxNameLength, size_t maxDataSize)
+{
+	// data first, the name is moved next to the data once its length is known
+	pendingNameOffset = alignName(bufferSize + maxDataSize);
+
+	const size_t requiredSize = pendingNameOffset + (maxNameLength + 1) * sizeof(wchar_t);
+	if (buffer.size() < requiredSize) {
+		buffer.resize(requiredSize > buffer.size() * 2 ? requiredSize : buffer.size() * 2);
+	}
+
+	return {
+		std::span<wchar_t>(reinterpret_cast<wchar_t*>(buffer.data() + pendingNameOffset), maxNameLength + 1),
+		std::span<unsigned char>(buffer.data() + bufferSize, maxDataSize)
+	};
+}
+
+void ValueBatch::commitValue(size_t nameLength, const IDataType& type, size_t dataSize)
+{
+	const size_t nameOffset = alignName(bufferSize + dataSize);
+	if (nameOffset != pendingNameOffset) {
+		std::memmove(buffer.data() + nameOffset, buffer.data() + pendingNameOffset, nameLength * sizeof(wchar_t));
+	}
+
+	reinterpret_cast<wchar_t*>(buffer.data() + nameOffset)[nameLength] = L'\0';
+
+	entries.push_back({ nameOffset, bufferSize, dataSize, &type });
+	bufferSize = nameOffset + (nameLength + 1) * sizeof(wchar_t);
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "registry_data.h"
+
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace Registry
+{
+	/**
+	 * Values of a key read at once. Names and data are stored one after another in a single buffer
+	 * that keeps its capacity when the batch is cleared, so that a batch can be reused for many keys.
+	 */
+	class ValueBatch
+	{
+	public:
+		/**
+		 * Space of a value being read in place.
+		 */
+		struct ValueBuffer
+		{
+			std::span<wchar_t> name;
+			std::span<unsigned char> data;
+		};
+
+	public:
+		ValueBatch();
+
+		void clear();
+		size_t size() const;
+		bool empty() const;
+
+		/**
+		 * Returns a value of the batch, valid until the batch is cleared or a value is added.
+		 */
+		ValueView operator[](size_t index) const;
+
+		/**
+		 * Returns the index of a value, or size() if there is no value with this name.
+		 */
+		size_t find(const std::wstring_view& valueName) const;
+
+		/**
+		 * Copies a value to the batch.
+		 */
+		void add(const std::wstring_view& valueName, const IDataType& type, const std::span<const unsigned char>& data);
+
+		/**
+		 * Reserves space for a value up to the specified lengths, to be read directly in the batch.
+		 * The name buffer includes room for the terminating null character.
+		 * The buffers are valid until the value is committed.
+		 */
+		ValueBuffer beginValue(size_t maxNameLength, size_t maxDataSize);
+
+		/**
+		 * Adds the value read in the buffers returned by beginValue.
+		 */
+		void commitValue(size_t nameLength, const IDataType& type, size_t dataSize);
+
+	private:
+		struct Entry
+		{
+			size_t nameOffset;
+			size_t dataOffset;
+			size_t dataSize;
+			const IDataType* type;
+		};
+
+	private:
+		std::vector<unsigned char> buffer;
+		size_t bufferSize;
+		std::vector<Entry> entries;
+
+		/** Name of the value being read, placed after its data. */
+		size_t pendingNameOffset;
+	};
+}
@@ -11,20 +11,6 @@
 
 using namespace Registry;
 
-const Platform::Windows::DataType Platform::Windows::StringDataType(L"REG_SZ", REG_SZ);
-const Platform::Windows::DataType Platform::Windows::ExpandableStringDataType(L"REG_EXPAND_SZ", REG_EXPAND_SZ);
-const Platform::Windows::DataType Platform::Windows::MultiStringDataType(L"REG_MULTI_SZ", REG_MULTI_SZ);
-const Platform::Windows::DataType Platform::Windows::BinaryDataType(L"REG_BINARY", REG_BINARY);
-const Platform::Windows::DataType Platform::Windows::DWordDataType(L"REG_DWORD", REG_DWORD);
-const Platform::Windows::DataType Platform::Windows::QWordDataType(L"REG_QWORD", REG_QWORD);
-
-const IDataType& Platform::Host::StringDataType = Platform::Windows::StringDataType;
-const IDataType& Platform::Host::ExpandableStringDataType = Platform::Windows::ExpandableStringDataType;
-const IDataType& Platform::Host::MultiStringDataType = Platform::Windows::MultiStringDataType;
-const IDataType& Platform::Host::BinaryDataType = Platform::Windows::BinaryDataType;
-const IDataType& Platform::Host::DWordDataType = Platform::Windows::DWordDataType;
-const IDataType& Platform::Host::QWordDataType = Platform::Windows::QWordDataType;
-
 static Platform::Windows::PredefinedKey PKClassesRoot(HKEY_CLASSES_ROOT, L"HKEY_CLASSES_ROOT");
 static Platform::Windows::PredefinedKey PKCurrentUser(HKEY_CURRENT_USER, L"HKEY_CURRENT_USER");
 static Platform::Windows::PredefinedKey PKLocalMachine(HKEY_LOCAL_MACHINE, L"HKEY_LOCAL_MACHINE");
@@ -39,25 +25,9 @@ const IKeyPtr Platform::Windows::PredefinedKeys::LocalMachine(&PKLocalMachine, N
 const IKeyPtr Platform::Windows::PredefinedKeys::Users(&PKUsers, NoDeleter);
 const IKeyPtr Platform::Windows::PredefinedKeys::CurrentConfig(&PKCurrentConfig, NoDeleter);
 
-static const Platform::Windows::DataType& getType(uint32_t dwType)
+static const IDataType& getType(uint32_t dwType)
 {
-	switch (dwType)
-	{
-	case REG_SZ:
-		return Platform::Windows::StringDataType;
-	case REG_EXPAND_SZ:
-		return Platform::Windows::ExpandableStringDataType;
-	case REG_MULTI_SZ:
-		return Platform::Windows::MultiStringDataType;
-	case REG_BINARY:
-		return Platform::Windows::BinaryDataType;
-	case REG_DWORD:
-		return Platform::Windows::DWordDataType;
-	case REG_QWORD:
-		return Platform::Windows::QWordDataType;
-	default:
-		return Platform::Windows::BinaryDataType;
-	}
+	return *IDataType::findDataType(dwType);
 }
 
 IKeyPtr Platform::Windows::PredefinedKeys::findByName(const wchar_t* name)
@@ -248,12 +218,11 @@ Platform::Windows::Value::Value(const wchar_t* valueName, const IDataType& type)
 
 }
 
-Platform::Windows::Value::Value(const wchar_t* valueName, const IDataType& type, std::vector<unsigned char>&& data)
+Platform::Windows::Value::Value(const wchar_t* valueName, const IDataType& type, size_t dataSize)
 	: name(valueName)
 	, dataType(type)
-	, rawData(std::move(data))
 {
-
+	rawData.reset(dataSize);
 }
 
 const wchar_t* Platform::Windows::Value::getValueName() const
@@ -268,12 +237,17 @@ const IDataType& Platform::Windows::Value::getType() const
 
 std::span<const unsigned char> Platform::Windows::Value::getRawData() const
 {
-	return rawData;
+	return rawData.get();
 }
 
 void Platform::Windows::Value::setRawData(const std::span<const unsigned char>& data)
 {
-	rawData.assign(data.begin(), data.end());
+	rawData.assign(data);
+}
+
+std::span<unsigned char> Platform::Windows::Value::getBuffer()
+{
+	return rawData.getBuffer();
 }
 
 REGSAM getPermission(Permission permissions)
@@ -343,6 +317,11 @@ IKeyPtr Platform::Windows::KeyManager::getOrCreateKey(const wchar_t* keyName, Pe
 	return std::make_shared<Windows::Key>(keyHandle, keyName);
 }
 
+IKeyPtr Platform::Windows::KeyManager::getPredefinedKey(const wchar_t* rootName)
+{
+	return PredefinedKeys::findByName(rootName);
+}
+
 IValuePtr Platform::Windows::ValueManager::getValue(const IKey* key, const wchar_t* valueName)
 {
 	if (!key) {
@@ -368,15 +347,16 @@ IValuePtr Platform::Windows::ValueManager::getValue(const IKey* key, const wchar
 	{
 		if (cbData)
 		{
-			std::vector<unsigned char> data;
-			data.resize(cbData);
+			// read in the value itself, small data doesn't need another allocation
+			const std::shared_ptr<Windows::Value> value = std::make_shared<Windows::Value>(valueName, getType(dwType), cbData);
+			const std::span<unsigned char> buffer = value->getBuffer();
 
 			Status = RegQueryValueEx(
 				static_cast<HKEY>(winKey->getKeyHandle()),
 				valueName,
 				NULL,
 				&dwType,
-				data.data(),
+				buffer.data(),
 				&cbData
 			);
 
@@ -384,7 +364,7 @@ IValuePtr Platform::Windows::ValueManager::getValue(const IKey* key, const wchar
 				throw std::system_error(std::error_code(Status, std::system_category()), "couldn't open registry key");
 			}
 
-			result = std::make_shared<Windows::Value>(valueName, getType(dwType), std::move(data));
+			result = value;
 		}
 		else {
 			result = std::make_shared<Windows::Value>(valueName, getType(dwType));
@@ -404,21 +384,18 @@ IValuePtr Platform::Windows::ValueManager::newValue(const wchar_t* valueName, co
 
 void Platform::Windows::ValueManager::setValue(const IKey* key, const IValue& value)
 {
+	// values from any platform can be set, the type identifiers are the same
 	const Windows::BaseKey* winKey = static_cast<const Windows::Key*>(key);
-	const Platform::Windows::Value& winVal = *static_cast<const Platform::Windows::Value*>(&value);
-	const Platform::Windows::DataType* winType = dynamic_cast<const Platform::Windows::DataType*>(&winVal.getType());
-	if (!winType) {
-		throw std::invalid_argument("invalid type");
-	}
+	const uint32_t dwType = value.getType().getRawType();
 
-	const std::span<const unsigned char> rawData = winVal.getRawData();
+	const std::span<const unsigned char> rawData = value.getRawData();
 	if (!rawData.empty())
 	{
 		RegSetValueExW(
 			static_cast<HKEY>(winKey->getKeyHandle()),
 			value.getValueName(),
 			NULL,
-			winType->getInternalType(),
+			dwType,
 			rawData.data(),
 			static_cast<DWORD>(rawData.size())
 		);
@@ -429,20 +406,69 @@ void Platform::Windows::ValueManager::setValue(const IKey* key, const IValue& va
 			static_cast<HKEY>(winKey->getKeyHandle()),
 			value.getValueName(),
 			NULL,
-			winType->getInternalType(),
+			dwType,
 			NULL,
 			0
 		);
 	}
 }
 
+void Platform::Windows::KeyManager::copyTree(const IKey* sourceKey, const IKey* targetKey, const ICopyFilter* filter, size_t maxDepth)
+{
+	if (!filter && maxDepth == SIZE_MAX)
+	{
+		const Windows::BaseKey* winSourceKey = static_cast<const Windows::Key*>(sourceKey);
+		const Windows::BaseKey* winTargetKey = static_cast<const Windows::Key*>(targetKey);
+
+		// the whole tree is copied by the configuration manager in a single call
+		const LSTATUS Status = RegCopyTree(static_cast<HKEY>(winSourceKey->getKeyHandle()), NULL, static_cast<HKEY>(winTargetKey->getKeyHandle()));
+		if (Status == ERROR_SUCCESS) {
+			return;
+		}
+	}
+
+	// keys that can't be copied as a whole, such as keys opened without enough access, are copied one by one
+	ValueManager valueManager;
+	Helpers::copyTree(*this, valueManager, *this, valueManager, sourceKey, targetKey, filter, maxDepth);
+}
+
+KeyInfo Platform::Windows::KeyManager::queryKeyInfo(const IKey* key)
+{
+	const Windows::BaseKey* winKey = static_cast<const Windows::Key*>(key);
+
+	DWORD cSubKeys = 0;
+	DWORD cValues = 0;
+	FILETIME ftLastWriteTime{};
+	const LSTATUS Status = RegQueryInfoKey(static_cast<HKEY>(winKey->getKeyHandle()), NULL, NULL, NULL, &cSubKeys, NULL, NULL, &cValues, NULL, NULL, NULL, &ftLastWriteTime);
+	if (Status != ERROR_SUCCESS) {
+		throw std::system_error(std::error_code(Status, std::system_category()), "couldn't query registry key");
+	}
+
+	KeyInfo info;
+	info.subKeyCount = cSubKeys;
+	info.valueCount = cValues;
+	info.lastWriteTime = (static_cast<uint64_t>(ftLastWriteTime.dwHighDateTime) << 32) | ftLastWriteTime.dwLowDateTime;
+	return info;
+}
+
+void Platform::Windows::KeyManager::deleteKey(const IKey* parentKey, const wchar_t* subKeyName)
+{
+	const Windows::BaseKey* winKey = static_cast<const Windows::Key*>(parentKey);
+
+	// deletes the subkeys first, then the key itself
+	const LSTATUS Status = RegDeleteTree(static_cast<HKEY>(winKey->getKeyHandle()), subKeyName);
+	if (Status != ERROR_SUCCESS) {
+		throw std::system_error(std::error_code(Status, std::system_category()), "couldn't delete registry key");
+	}
+}
+
 bool Platform::Windows::KeyManager::visitKeys(const IKey* key, const KeyVisitor& visitor, size_t maxDepth)
 {
 	const Windows::BaseKey* winKey = static_cast<const Windows::Key*>(key);
 
-	// use a single buffer for enumerating all keys
+	// use a single buffer for enumerating all keys, key names are up to 255 characters
 	std::wstring keyNameBuf;
-	keyNameBuf.resize(255);
+	keyNameBuf.resize(256);
 
 	return visitKeysInternal(winKey, visitor, keyNameBuf, maxDepth);
 }
@@ -497,78 +523,77 @@ bool Platform::Windows::KeyManager::visitKeysInternal(const BaseKey* winKey, con
 }
 
 bool Platform::Windows::ValueManager::visitKeyValues(const IKey* key, const ValueVisitor& visitor)
+{
+	ValueBatch batch;
+	readKeyValues(key, batch);
+
+	for (size_t i = 0; i < batch.size(); ++i)
+	{
+		if (!std::invoke(visitor, batch[i])) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static void queryValueSizes(HKEY hKey, DWORD& cchMaxValueName, DWORD& cbMaxValueData)
+{
+	const LSTATUS Status = RegQueryInfoKey(hKey, NULL, NULL, NULL, NULL, NULL, NULL, NULL, &cchMaxValueName, &cbMaxValueData, NULL, NULL);
+	if (Status != ERROR_SUCCESS) {
+		throw std::system_error(std::error_code(Status, std::system_category()), "couldn't query registry key");
+	}
+}
+
+void Platform::Windows::ValueManager::readKeyValues(const IKey* key, ValueBatch& batch)
 {
 	const Windows::BaseKey* winKey = static_cast<const Windows::Key*>(key);
 	HKEY hKey = static_cast<HKEY>(winKey->getKeyHandle());
 
-	std::wstring valueNameBuf;
-	valueNameBuf.resize(16384);
+	batch.clear();
+
+	// buffers are sized once for the largest name and data of the key
+	DWORD cchMaxValueName = 0;
+	DWORD cbMaxValueData = 0;
+	queryValueSizes(hKey, cchMaxValueName, cbMaxValueData);
 
 	LSTATUS Status;
 	DWORD dwIndex = 0;
-	DWORD dwType = 0;
-	DWORD cbData = 0;
-	DWORD cchName = 32767;
-	while ((Status = RegEnumValue(
-		hKey,
-		dwIndex,
-		valueNameBuf.data(),
-		&cchName,
-		NULL,
-		&dwType,
-		NULL,
-		&cbData
-	)) != ERROR_NO_MORE_ITEMS)
+	for (;;)
 	{
-		if (cbData)
-		{
-			std::vector<unsigned char> dataBuf;
-			dataBuf.resize(cbData);
-
-			cchName = 32767;
-			Status = RegEnumValue(
-				hKey,
-				dwIndex,
-				valueNameBuf.data(),
-				&cchName,
-				NULL,
-				&dwType,
-				(LPBYTE)dataBuf.data(),
-				&cbData
-			);
+		const ValueBatch::ValueBuffer valueBuffer = batch.beginValue(cchMaxValueName, cbMaxValueData);
+
+		DWORD dwType = 0;
+		DWORD cchName = static_cast<DWORD>(valueBuffer.name.size());
+		DWORD cbData = static_cast<DWORD>(valueBuffer.data.size());
+		Status = RegEnumValue(
+			hKey,
+			dwIndex,
+			valueBuffer.name.data(),
+			&cchName,
+			NULL,
+			&dwType,
+			valueBuffer.data.data(),
+			&cbData
+		);
 
-			const Platform::Windows::Value value(valueNameBuf.data(), getType(dwType), std::move(dataBuf));
-			if (!std::invoke(visitor, value)) {
-				return false;
-			}
+		if (Status == ERROR_NO_MORE_ITEMS) {
+			break;
 		}
-		else
+
+		if (Status == ERROR_MORE_DATA)
 		{
-			// empty value
-			const Platform::Windows::Value value(valueNameBuf.data(), getType(dwType));
-			if (!std::invoke(visitor, value)) {
-				return false;
-			}
+			// a value was set since the key was queried, read it again with larger buffers
+			queryValueSizes(hKey, cchMaxValueName, cbMaxValueData);
+			continue;
+		}
+
+		if (Status == ERROR_SUCCESS) {
+			batch.commitValue(cchName, getType(dwType), cbData);
 		}
 
-		cchName = 32767;
-		cbData = 0;
 		dwIndex++;
 	}
-
-	return true;
-}
-
-Platform::Windows::DataType::DataType(const wchar_t* name, uint32_t internalType)
-	:  IDataType(name)
-	, type(internalType)
-{
-
-}
-
-uint32_t Platform::Windows::DataType::getInternalType() const
-{
-	return type;
 }
 
 IKeyManager& Platform::Windows::RegistryManager::getKeyManager()
@@ -646,7 +671,8 @@ IHivePtr Platform::Windows::HiveManager::loadHive(const std::filesystem::path& h
 		throw std::system_error(std::error_code(Status, std::system_category()), "couldn't load key");
 	}
 
-	const IKeyPtr key = std::make_shared<Platform::Windows::Key>(static_cast<HKEY>(hSubKey), nullptr);
+	// like created hives, the loaded key has no name
+	const IKeyPtr key = std::make_shared<Platform::Windows::Key>(static_cast<HKEY>(hSubKey), L"");
 
 	return std::make_shared<Platform::Windows::Hive>(key, hiveFileName.stem().c_str());
 }
@@ -678,3 +704,17 @@ void Platform::Windows::HiveManager::saveHive(const IHive& hive, const std::file
 	Status = RegDeleteTree(hCurrentUser, winKey->getKeyName());
 	Status = RegCloseKey(hCurrentUser);
 }
+
+void Platform::Windows::HiveManager::commitHive(const IHive& hive)
+{
+	const Platform::Windows::Key* winKey = static_cast<const Platform::Windows::Key*>(hive.getRootKey().get());
+	if (!winKey) {
+		throw std::invalid_argument("invalid hive key");
+	}
+
+	// the application hive is written as it changes, make sure it is on disk
+	const LSTATUS Status = RegFlushKey(static_cast<HKEY>(winKey->getKeyHandle()));
+	if (Status != ERROR_SUCCESS) {
+		throw std::system_error(std::error_code(Status, std::system_category()), "could not flush the hive");
+	}
+}
\ No newline at end of file
@@ -15,7 +15,11 @@ namespace Registry
 			public:
 				IKeyPtr getKey(const wchar_t* keyName, Permission permissions, const IKey* parentKey) override;
 				IKeyPtr getOrCreateKey(const wchar_t* keyName, Permission permissions, const IKey* parentKey) override;
-				bool visitKeys(const IKey* key, const KeyVisitor& visitor, size_t maxDepth = ~0) override;
+				IKeyPtr getPredefinedKey(const wchar_t* rootName) override;
+				bool visitKeys(const IKey* key, const KeyVisitor& visitor, size_t maxDepth = SIZE_MAX) override;
+				void copyTree(const IKey* sourceKey, const IKey* targetKey, const ICopyFilter* filter = nullptr, size_t maxDepth = SIZE_MAX) override;
+				KeyInfo queryKeyInfo(const IKey* key) override;
+				void deleteKey(const IKey* parentKey, const wchar_t* subKeyName) override;
 
 			private:
 				bool visitKeysInternal(const BaseKey* winKey, const KeyVisitor& visitor, std::wstring& nameBuffer, size_t currentDepth);
@@ -28,6 +32,7 @@ namespace Registry
 				IValuePtr newValue(const wchar_t* valueName, const IDataType& dataType) override;
 				void setValue(const IKey* key, const IValue& value) override;
 				bool visitKeyValues(const IKey* key, const ValueVisitor& visitor) override;
+				void readKeyValues(const IKey* key, ValueBatch& batch) override;
 			};
 
 			class HiveManager : public IHiveManager
@@ -36,6 +41,7 @@ namespace Registry
 				IHivePtr createHive(const std::filesystem::path& hiveFileName) override;
 				IHivePtr loadHive(const std::filesystem::path& hiveFileName) override;
 				void saveHive(const IHive& hive, const std::filesystem::path& hiveFileName) override;
+				void commitHive(const IHive& hive) override;
 			};
 
 			class RegistryManager : public IRegistryManager
@@ -56,17 +62,6 @@ namespace Registry
 				HiveManager hiveManager;
 			};
 
-			class DataType : public IDataType
-			{
-			public:
-				DataType(const wchar_t* name, uint32_t internalType);
-
-				uint32_t getInternalType() const;
-
-			private:
-				uint32_t type;
-			};
-
 			class Hive : public IHive
 			{
 			public:
@@ -142,7 +137,7 @@ namespace Registry
 			{
 			public:
 				Value(const wchar_t* valueName, const IDataType& type);
-				Value(const wchar_t* valueName, const IDataType& type, std::vector<unsigned char>&& data);
+				Value(const wchar_t* valueName, const IDataType& type, size_t dataSize);
 
 				Value(const Value&) = delete;
 				Value& operator=(const Value&) = delete;
@@ -155,19 +150,17 @@ namespace Registry
 				std::span<const unsigned char> getRawData() const override;
 				void setRawData(const std::span<const unsigned char>& data) override;
 
+				/**
+				 * Returns the data to be read in place.
+				 */
+				std::span<unsigned char> getBuffer();
+
 			private:
 				std::wstring name;
 				const IDataType& dataType;
-				std::vector<unsigned char> rawData;
+				ValueData rawData;
 			};
 
-			extern const DataType StringDataType;
-			extern const DataType ExpandableStringDataType;
-			extern const DataType MultiStringDataType;
-			extern const DataType BinaryDataType;
-			extern const DataType DWordDataType;
-			extern const DataType QWordDataType;
-
 			namespace PredefinedKeys
 			{
 				extern const IKeyPtr ClassesRoot;
@@ -183,13 +176,6 @@ namespace Registry
 		namespace Host
 		{
 			using RegistryManager = Windows::RegistryManager;
-
-			extern const IDataType& StringDataType;
-			extern const IDataType& ExpandableStringDataType;
-			extern const IDataType& MultiStringDataType;
-			extern const IDataType& BinaryDataType;
-			extern const IDataType& DWordDataType;
-			extern const IDataType& QWordDataType;
 		}
 	}
 }
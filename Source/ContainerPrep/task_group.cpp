@@ -0,0 +1,92 @@
+#include "task_group.h"
+
+const char* TaskCancelled::what() const noexcept
+{
+	return "cancelled after another task failed";
+}
+
+CancellationToken::CancellationToken()
+	: cancelled(false)
+{
+}
+
+bool CancellationToken::isCancelled() const
+{
+	return cancelled.load(std::memory_order_relaxed);
+}
+
+void CancellationToken::check() const
+{
+	if (isCancelled()) {
+		throw TaskCancelled();
+	}
+}
+
+void CancellationToken::cancel()
+{
+	cancelled.store(true, std::memory_order_relaxed);
+}
+
+TaskGroup::TaskGroup(ThreadPool& inPool)
+	: pool(inPool)
+{
+}
+
+TaskGroup::~TaskGroup()
+{
+	token.cancel();
+
+	for (const std::future<void>& task : tasks)
+	{
+		if (task.valid()) {
+			pool.wait(task, true);
+		}
+	}
+}
+
+void TaskGroup::run(const std::string& name, std::function<void(const CancellationToken& token)>&& func)
+{
+	tasks.push_back(pool.submitLongTask([this, name, func = std::move(func)]()
+		{
+			try
+			{
+				token.check();
+				func(token);
+			}
+			catch (...)
+			{
+				{
+					std::lock_guard<std::mutex> lock(errorsMutex);
+					errors.push_back({ name, std::current_exception() });
+				}
+
+				// the first failure stops the other tasks, their cancellation comes after it
+				token.cancel();
+			}
+		}));
+}
+
+void TaskGroup::wait()
+{
+	for (std::future<void>& task : tasks)
+	{
+		pool.wait(task, true);
+		task.get();
+	}
+
+	tasks.clear();
+
+	if (!errors.empty()) {
+		std::rethrow_exception(errors.front().error);
+	}
+}
+
+const std::vector<TaskGroup::TaskError>& TaskGroup::getErrors() const
+{
+	return errors;
+}
+
+const CancellationToken& TaskGroup::getToken() const
+{
+	return token;
+}
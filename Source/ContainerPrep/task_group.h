@@ -0,0 +1,90 @@
+#pragma once
+
+#include "thread_pool.h"
+
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * Thrown by a task that stops because its group was cancelled.
+ */
+class TaskCancelled : public std::exception
+{
+public:
+	const char* what() const noexcept override;
+};
+
+/**
+ * Cancellation state of a task group, polled by its tasks between units of work.
+ */
+class CancellationToken
+{
+public:
+	CancellationToken();
+
+	bool isCancelled() const;
+
+	/**
+	 * Throws TaskCancelled if the group was cancelled.
+	 */
+	void check() const;
+
+	void cancel();
+
+private:
+	std::atomic<bool> cancelled;
+};
+
+/**
+ * Runs named tasks on a thread pool and joins them. The tasks are long tasks of the pool,
+ * they are not run by the threads waiting for short tasks.
+ *
+ * The first task to fail cancels the others, which stop at their next check.
+ * Once every task has returned, each failure is reported with the name of its task.
+ */
+class TaskGroup
+{
+public:
+	struct TaskError
+	{
+		std::string taskName;
+		std::exception_ptr error;
+	};
+
+public:
+	TaskGroup(ThreadPool& inPool);
+
+	/**
+	 * Cancels and waits for the tasks that are still running, their errors are dropped.
+	 */
+	~TaskGroup();
+
+	TaskGroup(const TaskGroup&) = delete;
+	TaskGroup& operator=(const TaskGroup&) = delete;
+
+	void run(const std::string& name, std::function<void(const CancellationToken& token)>&& func);
+
+	/**
+	 * Waits for every task while helping the pool, then throws the first failure if any.
+	 */
+	void wait();
+
+	/**
+	 * Failures in order of occurrence, including the tasks stopped by the cancellation.
+	 */
+	const std::vector<TaskError>& getErrors() const;
+
+	const CancellationToken& getToken() const;
+
+private:
+	ThreadPool& pool;
+	CancellationToken token;
+	std::vector<std::future<void>> tasks;
+	std::vector<TaskError> errors;
+	std::mutex errorsMutex;
+};
@@ -0,0 +1,144 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+
+ThreadPool::ThreadPool(size_t numThreads)
+	: stopping(false)
+{
+	if (!numThreads)
+	{
+		numThreads = std::thread::hardware_concurrency();
+		if (!numThreads) numThreads = 1;
+	}
+
+	workers.reserve(numThreads);
+	for (size_t i = 0; i < numThreads; ++i) {
+		workers.emplace_back(&ThreadPool::workerLoop, this);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(tasksMutex);
+		stopping = true;
+	}
+
+	tasksCondition.notify_all();
+
+	for (std::thread& worker : workers) {
+		worker.join();
+	}
+}
+
+size_t ThreadPool::getNumThreads() const
+{
+	return workers.size();
+}
+
+bool ThreadPool::runPendingTask(bool bLongTasks)
+{
+	std::function<void()> task;
+
+	{
+		std::lock_guard<std::mutex> lock(tasksMutex);
+		if (!tasks.empty())
+		{
+			task = std::move(tasks.front());
+			tasks.pop_front();
+		}
+		else if (bLongTasks && !longTasks.empty())
+		{
+			task = std::move(longTasks.front());
+			longTasks.pop_front();
+		}
+		else {
+			return false;
+		}
+	}
+
+	task();
+	return true;
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t index)>& func)
+{
+	if (!count) {
+		return;
+	}
+
+	std::atomic<size_t> nextIndex = 0;
+	std::exception_ptr firstError;
+	std::mutex errorMutex;
+
+	const auto runner = [&]()
+	{
+		for (size_t index = nextIndex++; index < count; index = nextIndex++)
+		{
+			try
+			{
+				func(index);
+			}
+			catch (...)
+			{
+				std::lock_guard<std::mutex> lock(errorMutex);
+				if (!firstError) firstError = std::current_exception();
+			}
+		}
+	};
+
+	// the calling thread takes part too, so no more helpers than remaining items are needed
+	const size_t numHelpers = std::min(workers.size(), count - 1);
+
+	std::vector<std::future<void>> helpers;
+	helpers.reserve(numHelpers);
+	for (size_t i = 0; i < numHelpers; ++i) {
+		helpers.push_back(submit(runner));
+	}
+
+	runner();
+
+	for (const std::future<void>& helper : helpers) {
+		wait(helper);
+	}
+
+	if (firstError) {
+		std::rethrow_exception(firstError);
+	}
+}
+
+void ThreadPool::enqueue(std::function<void()>&& task, bool bLongTask)
+{
+	{
+		std::lock_guard<std::mutex> lock(tasksMutex);
+		(bLongTask ? longTasks : tasks).push_back(std::move(task));
+	}
+
+	tasksCondition.notify_one();
+}
+
+void ThreadPool::workerLoop()
+{
+	for (;;)
+	{
+		std::function<void()> task;
+
+		{
+			std::unique_lock<std::mutex> lock(tasksMutex);
+			tasksCondition.wait(lock, [this]() { return stopping || !tasks.empty() || !longTasks.empty(); });
+
+			// long tasks are started first, the short tasks they queue are run by them and by the idle workers
+			std::deque<std::function<void()>>& queue = !longTasks.empty() ? longTasks : tasks;
+			if (queue.empty()) {
+				// stopping and nothing left to run
+				return;
+			}
+
+			task = std::move(queue.front());
+			queue.pop_front();
+		}
+
+		task();
+	}
+}
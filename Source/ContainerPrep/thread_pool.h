@@ -0,0 +1,95 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool
+{
+public:
+	/**
+	 * Creates a pool with the specified number of workers, or one per hardware thread if 0.
+	 */
+	ThreadPool(size_t numThreads = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	size_t getNumThreads() const;
+
+	/**
+	 * Queues a task and returns a future to its result.
+	 */
+	template<typename Func>
+	auto submit(Func&& func) -> std::future<decltype(func())>
+	{
+		using result_t = decltype(func());
+
+		auto task = std::make_shared<std::packaged_task<result_t()>>(std::forward<Func>(func));
+		std::future<result_t> result = task->get_future();
+		enqueue([task]() { (*task)(); }, false);
+
+		return result;
+	}
+
+	/**
+	 * Queues a task that runs for long and waits on other tasks, such as the build of a hive.
+	 * Long tasks are started by the workers before the other tasks, and are only run by a waiting thread
+	 * that asks for them, so that a task waiting for a short task doesn't run a long one on its stack.
+	 */
+	template<typename Func>
+	auto submitLongTask(Func&& func) -> std::future<decltype(func())>
+	{
+		using result_t = decltype(func());
+
+		auto task = std::make_shared<std::packaged_task<result_t()>>(std::forward<Func>(func));
+		std::future<result_t> result = task->get_future();
+		enqueue([task]() { (*task)(); }, true);
+
+		return result;
+	}
+
+	/**
+	 * Runs one queued task on the calling thread, or one long task if specified and no other task is queued.
+	 * Returns false if there was none to run.
+	 */
+	bool runPendingTask(bool bLongTasks = false);
+
+	/**
+	 * Waits for the future while helping with queued tasks, so that tasks running inside the pool can wait on other tasks.
+	 * Long tasks are only run while waiting if specified, by the threads that join them.
+	 */
+	template<typename T>
+	void wait(const std::future<T>& future, bool bLongTasks = false)
+	{
+		while (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+		{
+			if (!runPendingTask(bLongTasks)) {
+				future.wait_for(std::chrono::milliseconds(1));
+			}
+		}
+	}
+
+	/**
+	 * Calls func(index) for every index in [0, count) using the pool and the calling thread.
+	 */
+	void parallelFor(size_t count, const std::function<void(size_t index)>& func);
+
+private:
+	void enqueue(std::function<void()>&& task, bool bLongTask);
+	void workerLoop();
+
+private:
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> tasks;
+	std::deque<std::function<void()>> longTasks;
+	std::mutex tasksMutex;
+	std::condition_variable tasksCondition;
+	bool stopping;
+};
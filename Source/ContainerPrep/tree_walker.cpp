@@ -0,0 +1,106 @@
+#include "tree_walker.h"
+
+#include <iterator>
+#include <mutex>
+#include <string_view>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+using namespace Files;
+
+/**
+ * Lists the entries of a directory. Subdirectories to walk go to directories,
+ * and everything else, including reparse points to directories, goes to entries.
+ */
+static void enumerateDirectory(const std::filesystem::path& path, std::vector<TreeEntry>& entries, std::vector<std::filesystem::path>& directories)
+{
+#ifdef _WIN32
+	WIN32_FIND_DATAW findData;
+	HANDLE hFind = FindFirstFileExW((path / L"*").c_str(), FindExInfoBasic, &findData, FindExSearchNameMatch, NULL, FIND_FIRST_EX_LARGE_FETCH);
+	if (hFind == INVALID_HANDLE_VALUE) {
+		return;
+	}
+
+	do
+	{
+		const std::wstring_view name = findData.cFileName;
+		if (name == L"." || name == L"..") {
+			continue;
+		}
+
+		const bool isDirectory = (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+		if (isDirectory && !(findData.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT)) {
+			directories.push_back(path / name);
+		}
+		else {
+			entries.push_back({ path / name, isDirectory });
+		}
+	} while (FindNextFileW(hFind, &findData));
+
+	FindClose(hFind);
+#else
+	DIR* dir = opendir(path.c_str());
+	if (!dir) {
+		return;
+	}
+
+	while (const dirent* dirEntry = readdir(dir))
+	{
+		const std::string_view name = dirEntry->d_name;
+		if (name == "." || name == "..") {
+			continue;
+		}
+
+		bool isDirectory = dirEntry->d_type == DT_DIR;
+		if (dirEntry->d_type == DT_UNKNOWN)
+		{
+			struct stat status;
+			isDirectory = !lstat((path / name).c_str(), &status) && S_ISDIR(status.st_mode);
+		}
+
+		if (isDirectory) {
+			directories.push_back(path / name);
+		}
+		else {
+			entries.push_back({ path / name, false });
+		}
+	}
+
+	closedir(dir);
+#endif
+}
+
+void Files::walkTree(ThreadPool& pool, const std::filesystem::path& root, std::vector<TreeEntry>& entries, std::vector<std::vector<std::filesystem::path>>& levels)
+{
+	std::mutex resultsMutex;
+
+	std::vector<std::filesystem::path> level;
+	std::error_code ec;
+	if (std::filesystem::is_directory(std::filesystem::symlink_status(root, ec))) {
+		level.push_back(root);
+	}
+
+	while (!level.empty())
+	{
+		std::vector<std::filesystem::path> nextLevel;
+
+		pool.parallelFor(level.size(), [&](size_t index)
+			{
+				std::vector<TreeEntry> dirEntries;
+				std::vector<std::filesystem::path> subDirectories;
+				enumerateDirectory(level[index], dirEntries, subDirectories);
+
+				std::lock_guard<std::mutex> lock(resultsMutex);
+				std::move(dirEntries.begin(), dirEntries.end(), std::back_inserter(entries));
+				std::move(subDirectories.begin(), subDirectories.end(), std::back_inserter(nextLevel));
+			});
+
+		levels.push_back(std::move(level));
+		level = std::move(nextLevel);
+	}
+}
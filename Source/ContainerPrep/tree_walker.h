@@ -0,0 +1,24 @@
+#pragma once
+
+#include "thread_pool.h"
+
+#include <filesystem>
+#include <vector>
+
+namespace Files
+{
+	struct TreeEntry
+	{
+		std::filesystem::path path;
+
+		/** Set for reparse points to directories, which are not walked. */
+		bool directory;
+	};
+
+	/**
+	 * Lists the tree below the directory, enumerating the directories of a level in parallel.
+	 * Walked directories are added to levels, one vector per depth starting with the root,
+	 * and everything else to entries.
+	 */
+	void walkTree(ThreadPool& pool, const std::filesystem::path& root, std::vector<TreeEntry>& entries, std::vector<std::vector<std::filesystem::path>>& levels);
+}
@@ -0,0 +1,132 @@
+#include "file_operations.h"
+#include "link_batch.h"
+#include "test_directory.h"
+
+#include <catch2/catch.hpp>
+
+#include <string>
+#include <vector>
+
+using namespace Files;
+
+namespace
+{
+	constexpr size_t FileCount = 20;
+
+	std::filesystem::path getFileName(const std::filesystem::path& directory, size_t index)
+	{
+		return directory / ("file" + std::to_string(index) + ".dll");
+	}
+
+	/**
+	 * Runs the operations of a container preparation, in batches larger than the queue of the backend.
+	 */
+	void checkFileOperations(IFileOperations& fileOperations)
+	{
+		Tests::TestDirectory directory;
+		const std::filesystem::path host = directory.getPath() / "Host";
+		const std::filesystem::path container = directory.getPath() / "Container";
+
+		std::vector<FileOperation> operations;
+		for (size_t i = 0; i < FileCount; ++i) {
+			directory.writeFile(getFileName("Host", i), std::string(i, 'x'));
+		}
+
+		operations.push_back({ FileOperationType::CreateDirectory, container });
+		fileOperations.execute(operations);
+		CHECK_FALSE(operations[0].result);
+		CHECK(std::filesystem::is_directory(container));
+
+		operations.clear();
+		for (size_t i = 0; i < FileCount; ++i) {
+			operations.push_back({ FileOperationType::CreateHardLink, getFileName(container, i), getFileName(host, i) });
+		}
+
+		operations.push_back({ FileOperationType::CreateDirectoryLink, container / "HostLink", host });
+		operations.push_back({ FileOperationType::CreateDirectory, container });
+		operations.push_back({ FileOperationType::CreateHardLink, container / "missing.dll", host / "missing.dll" });
+		fileOperations.execute(operations);
+
+		for (size_t i = 0; i < FileCount; ++i)
+		{
+			CHECK_FALSE(operations[i].result);
+			CHECK(std::filesystem::equivalent(getFileName(container, i), getFileName(host, i)));
+		}
+
+		CHECK_FALSE(operations[FileCount].result);
+		CHECK(std::filesystem::is_symlink(container / "HostLink"));
+		CHECK(std::filesystem::read_symlink(container / "HostLink") == host);
+
+		CHECK(operations[FileCount + 1].result == std::errc::file_exists);
+		CHECK(operations[FileCount + 2].result == std::errc::no_such_file_or_directory);
+
+		// linked again by a resumed run
+		operations.clear();
+		operations.push_back({ FileOperationType::CreateHardLink, getFileName(container, 0), getFileName(host, 0) });
+		operations.push_back({ FileOperationType::CreateDirectoryLink, container / "HostLink", host });
+		fileOperations.execute(operations);
+		CHECK(operations[0].result == std::errc::file_exists);
+		CHECK(operations[1].result == std::errc::file_exists);
+
+		operations.clear();
+		for (size_t i = 0; i < FileCount; ++i) {
+			operations.push_back({ FileOperationType::Stat, getFileName(host, i) });
+		}
+
+		operations.push_back({ FileOperationType::Stat, host / "missing.dll" });
+		fileOperations.execute(operations);
+
+		for (size_t i = 0; i < FileCount; ++i)
+		{
+			CHECK_FALSE(operations[i].result);
+			CHECK(operations[i].linkCount == 2);
+			CHECK(operations[i].size == i);
+		}
+
+		CHECK(operations[FileCount].result == std::errc::no_such_file_or_directory);
+	}
+}
+
+TEST_CASE("The thread pool backend runs the file operations", "[files]")
+{
+	ThreadPool pool(4);
+	ThreadPoolFileOperations fileOperations(pool);
+	checkFileOperations(fileOperations);
+}
+
+#ifdef __linux__
+TEST_CASE("The io_uring backend runs the file operations", "[files]")
+{
+	// a queue smaller than the batches, so operations are submitted as others complete
+	const IFileOperationsPtr fileOperations = createUringFileOperations(4);
+	if (!fileOperations)
+	{
+		WARN("io_uring file operations aren't supported by this kernel");
+		return;
+	}
+
+	checkFileOperations(*fileOperations);
+}
+#endif
+
+TEST_CASE("A dry run falls back from directory links as the run did", "[files]")
+{
+	Tests::TestDirectory directory;
+	const std::filesystem::path host = directory.writeFile("Host/Fonts/arial.ttf", "font").parent_path();
+	const std::filesystem::path container = directory.getPath() / "Container";
+
+	// a run linked a directory, and a run without the privilege linked the files of another
+	std::filesystem::create_directories(container / "Linked");
+	std::filesystem::create_directory_symlink(host, container / "Linked/Fonts");
+	std::filesystem::create_directories(container / "Walked/Fonts");
+	std::filesystem::create_hard_link(host / "arial.ttf", container / "Walked/Fonts/arial.ttf");
+
+	LinkBatch linkBatch(std::make_shared<DryRunFileOperations>(), container);
+	CHECK_FALSE(linkBatch.linkDirectory(host, container / "Linked/Fonts"));
+	CHECK(linkBatch.linkDirectory(host, container / "Walked/Fonts") == std::errc::file_exists);
+
+	// nothing is created for a new container
+	CHECK_FALSE(linkBatch.linkDirectory(host, container / "New/Fonts"));
+	CHECK_FALSE(std::filesystem::exists(container / "New"));
+	CHECK(linkBatch.getFailedCount() == 0);
+}
@@ -0,0 +1,133 @@
+#include "import_closure.h"
+#include "test_directory.h"
+#include "test_pe_builder.h"
+#include "thread_pool.h"
+
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+
+using namespace Files;
+
+namespace
+{
+	/**
+	 * A Windows directory with 64-bit and 32-bit system modules, and an application with its own modules.
+	 */
+	class ClosureFixture
+	{
+	public:
+		ClosureFixture()
+			: pool(2)
+		{
+			Tests::PeImageSpec apiSetSchemaSpec;
+			apiSetSchemaSpec.sections.emplace_back(".apiset", Tests::buildApiSetSchema({ { "api-ms-win-core-file-l1-2-0", "kernelbase.dll", {} } }));
+
+			writeImage("Windows/System32/apisetschema.dll", apiSetSchemaSpec);
+			writeImage("Windows/System32/ntdll.dll", {});
+			writeImage("Windows/System32/kernelbase.dll", { false, { "ntdll.dll" } });
+			writeImage("Windows/System32/kernel32.dll", { false, { "kernelbase.dll", "ntdll.dll" } });
+			writeImage("Windows/System32/version.dll", { false, { "kernel32.dll" } });
+			writeImage("Windows/SysWOW64/ntdll.dll", { true });
+			writeImage("Windows/SysWOW64/kernel32.dll", { true, { "ntdll.dll" } });
+			writeImage("Windows/explorer.exe", { false, { "kernel32.dll" } });
+		}
+
+		std::filesystem::path writeImage(const std::filesystem::path& relativePath, const Tests::PeImageSpec& spec)
+		{
+			return directory.writeFile(relativePath, Tests::buildPeImage(spec));
+		}
+
+		std::filesystem::path getPath(const std::filesystem::path& relativePath) const
+		{
+			return directory.getPath() / relativePath;
+		}
+
+		ImportClosure createClosure()
+		{
+			const std::filesystem::path windowsDir = directory.getPath() / "Windows";
+			return ImportClosure(pool, { windowsDir / "System32", windowsDir }, { windowsDir / "SysWOW64", windowsDir });
+		}
+
+		static bool contains(const std::vector<std::filesystem::path>& closure, const std::filesystem::path& path)
+		{
+			return std::find(closure.begin(), closure.end(), path) != closure.end();
+		}
+
+	protected:
+		Tests::TestDirectory directory;
+		ThreadPool pool;
+	};
+}
+
+TEST_CASE_METHOD(ClosureFixture, "ImportClosure follows imports, delay imports and API sets", "[closure]")
+{
+	Tests::PeImageSpec appSpec;
+	appSpec.imports = { "KERNEL32.dll", "api-ms-win-core-file-l1-2-0.dll", "helper.dll" };
+	appSpec.delayImports = { "missing.dll" };
+	const std::filesystem::path app = writeImage("App/app.exe", appSpec);
+	writeImage("App/helper.dll", { false, { "version.dll" } });
+
+	ImportClosure importClosure = createClosure();
+	const std::vector<std::filesystem::path> closure = importClosure.compute({ app });
+
+	CHECK(closure.front() == app);
+	CHECK(contains(closure, getPath("App/helper.dll")));
+	CHECK(contains(closure, getPath("Windows/System32/kernel32.dll")));
+	CHECK(contains(closure, getPath("Windows/System32/kernelbase.dll")));
+	CHECK(contains(closure, getPath("Windows/System32/ntdll.dll")));
+	CHECK(contains(closure, getPath("Windows/System32/version.dll")));
+	CHECK(closure.size() == 6);
+
+	CHECK(importClosure.getUnresolvedModules() == std::vector<std::string>{ "missing.dll" });
+}
+
+TEST_CASE_METHOD(ClosureFixture, "ImportClosure searches the directory of the root binary first", "[closure]")
+{
+	const std::filesystem::path app = writeImage("App/app.exe", { false, { "version.dll" } });
+	const std::filesystem::path appVersion = writeImage("App/version.dll", { false, { "ntdll.dll" } });
+
+	const std::vector<std::filesystem::path> closure = createClosure().compute({ app });
+
+	CHECK(contains(closure, appVersion));
+	CHECK_FALSE(contains(closure, getPath("Windows/System32/version.dll")));
+	CHECK(contains(closure, getPath("Windows/System32/ntdll.dll")));
+}
+
+TEST_CASE_METHOD(ClosureFixture, "ImportClosure searches the WOW64 directories for 32-bit binaries", "[closure]")
+{
+	const std::filesystem::path app32 = writeImage("App32/app.exe", { true, { "kernel32.dll" } });
+	const std::filesystem::path app64 = writeImage("App64/app.exe", { false, { "kernel32.dll" } });
+
+	const std::vector<std::filesystem::path> closure = createClosure().compute({ app32, app64 });
+
+	CHECK(contains(closure, getPath("Windows/SysWOW64/kernel32.dll")));
+	CHECK(contains(closure, getPath("Windows/SysWOW64/ntdll.dll")));
+	CHECK(contains(closure, getPath("Windows/System32/kernel32.dll")));
+	CHECK(contains(closure, getPath("Windows/System32/ntdll.dll")));
+}
+
+TEST_CASE_METHOD(ClosureFixture, "ImportClosure takes the binaries of a root directory", "[closure]")
+{
+	writeImage("Tools/a.exe", { false, { "ntdll.dll" } });
+	writeImage("Tools/b.dll", { false, { "kernel32.dll" } });
+	directory.writeFile("Tools/readme.txt", "not a binary");
+
+	const std::vector<std::filesystem::path> closure = createClosure().compute({ getPath("Tools") });
+
+	CHECK(contains(closure, getPath("Tools/a.exe")));
+	CHECK(contains(closure, getPath("Tools/b.dll")));
+	CHECK_FALSE(contains(closure, getPath("Tools/readme.txt")));
+	CHECK(contains(closure, getPath("Windows/System32/kernelbase.dll")));
+}
+
+TEST_CASE_METHOD(ClosureFixture, "ImportClosure keeps roots that are not PE images", "[closure]")
+{
+	const std::filesystem::path notImage = directory.writeFile("App/broken.dll", "MZ");
+
+	ImportClosure importClosure = createClosure();
+	const std::vector<std::filesystem::path> closure = importClosure.compute({ notImage });
+
+	CHECK(closure == std::vector<std::filesystem::path>{ notImage });
+	CHECK(importClosure.getUnresolvedModules().empty());
+}
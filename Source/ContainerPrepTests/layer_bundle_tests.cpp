@@ -0,0 +1,324 @@
+#include "layer_bundle.h"
+#include "test_directory.h"
+
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <sstream>
+#include <system_error>
+
+using namespace Files;
+
+namespace
+{
+	/**
+	 * A prepared container whose links point to host files, and a second container imported from its bundle.
+	 */
+	class BundleFixture
+	{
+	public:
+		BundleFixture()
+			: pool(2)
+		{
+			addLink("Host/Windows/System32/same.dll", "/Windows/System32/same.dll", "content kept on the host");
+			addLink("Host/Windows/System32/changed.dll", "/Windows/System32/changed.dll", "content of the prepared host");
+			addLink("Host/Windows/System32/copy.dll", "/Windows/System32/copy.dll", "content of the prepared host");
+
+			// a host file linked twice, and a target linked again by a resumed run
+			links.push_back({ links[0].source, std::filesystem::path("/Windows/SysWOW64/same.dll").make_preferred() });
+			links.push_back({ directory.getPath() / "Host/Windows/System32/copy.dll", links[0].target });
+
+			directory.writeFile("Prepared/Hives/SOFTWARE_BASE", "regf of the software hive");
+			directory.writeFile("Prepared/Hives/SOFTWARE_BASE.LOG1", "log of the software hive");
+			directory.writeFile("Prepared/Hives/SOFTWARE_BASE.fingerprints", "fingerprints of the software hive");
+		}
+
+		void addLink(const std::filesystem::path& hostFile, const std::filesystem::path& target, std::string_view content)
+		{
+			links.push_back({ directory.writeFile(hostFile, content), std::filesystem::path(target).make_preferred() });
+		}
+
+		BundleReport exportBundle(std::ostream& stream)
+		{
+			return Files::exportBundle(pool, stream, links, directory.getPath() / "Prepared/Hives");
+		}
+
+		BundleReport importBundle(std::istream& stream, std::ostream& manifestStream, IFileOperationsPtr fileOperations = nullptr)
+		{
+			if (!fileOperations) {
+				fileOperations = std::make_shared<ThreadPoolFileOperations>(pool);
+			}
+
+			LinkManifestWriter manifest(manifestStream);
+			const BundleReport report = Files::importBundle(pool, stream, getImportedPath(), directory.getPath().root_path(), fileOperations, manifest);
+			manifest.flush();
+			return report;
+		}
+
+		std::filesystem::path getImportedPath() const
+		{
+			return directory.getPath() / "Imported";
+		}
+
+		std::filesystem::path getImportedFile(const std::filesystem::path& target) const
+		{
+			return getLinkPath(getImportedPath() / "Files", target);
+		}
+
+	protected:
+		Tests::TestDirectory directory;
+		ThreadPool pool;
+		std::vector<LinkEntry> links;
+	};
+
+	std::vector<unsigned char> toBytes(std::string_view str)
+	{
+		return std::vector<unsigned char>(str.begin(), str.end());
+	}
+
+	/**
+	 * Creates the directories, and fails the links as a file system without hard links does.
+	 */
+	class NoHardLinkFileOperations : public IFileOperations
+	{
+	public:
+		NoHardLinkFileOperations(ThreadPool& pool)
+			: fileOperations(pool)
+		{
+		}
+
+		void execute(std::span<FileOperation> operations) override
+		{
+			fileOperations.execute(operations);
+
+			for (FileOperation& operation : operations)
+			{
+				if (operation.type == FileOperationType::CreateHardLink) {
+					operation.result = std::make_error_code(std::errc::operation_not_supported);
+				}
+			}
+		}
+
+	private:
+		ThreadPoolFileOperations fileOperations;
+	};
+
+	/**
+	 * Writes a bundle by hand, as a crafted one could be.
+	 */
+	class BundleBuilder
+	{
+	public:
+		BundleBuilder()
+		{
+			data.append("WCLB");
+			appendInteger<uint32_t>(1);
+		}
+
+		template<typename T>
+		void appendInteger(T value)
+		{
+			for (size_t i = 0; i < sizeof(T); ++i) {
+				data.push_back(static_cast<char>(value >> (i * 8)));
+			}
+		}
+
+		void appendString(std::string_view value)
+		{
+			appendInteger<uint16_t>(static_cast<uint16_t>(value.size()));
+			data.append(value);
+		}
+
+		/**
+		 * Appends a link to a host file, with its size and hash so that it is linked on import.
+		 */
+		void appendLink(std::string_view target, const std::filesystem::path& hostFile, std::string_view source)
+		{
+			const ContentHash hash = hashFile(hostFile);
+
+			appendString(target);
+			appendString(source);
+			appendInteger<uint64_t>(std::filesystem::file_size(hostFile));
+			data.append(reinterpret_cast<const char*>(hash.data()), hash.size());
+		}
+
+		std::string data;
+	};
+}
+
+TEST_CASE_METHOD(BundleFixture, "A layer bundle links matching host files and writes the others", "[bundle]")
+{
+	std::stringstream bundle;
+	const BundleReport exportReport = exportBundle(bundle);
+
+	CHECK(exportReport.links == 4);
+	CHECK(exportReport.hives == 1);
+	CHECK(exportReport.writtenFiles == 2);
+
+	// the host that imports the bundle has another version of a file
+	directory.writeFile("Host/Windows/System32/changed.dll", "content of the importing host");
+	directory.writeFile("Host/Windows/System32/copy.dll", "content of the importing host");
+
+	std::stringstream manifestStream;
+	const BundleReport importReport = importBundle(bundle, manifestStream);
+
+	CHECK(importReport.links == 4);
+	CHECK(importReport.linkedFiles == 2);
+	CHECK(importReport.writtenFiles == 2);
+	CHECK(importReport.hives == 1);
+
+	// linked to the host file
+	const std::filesystem::path sameFile = getImportedFile(links[0].target);
+	CHECK(std::filesystem::equivalent(sameFile, links[0].source));
+	CHECK(std::filesystem::equivalent(getImportedFile(links[3].target), links[0].source));
+
+	// written from the bundle, once for both targets
+	const std::filesystem::path changedFile = getImportedFile(links[1].target);
+	const std::filesystem::path copyFile = getImportedFile(links[2].target);
+	CHECK(Tests::readFile(changedFile) == toBytes("content of the prepared host"));
+	CHECK_FALSE(std::filesystem::equivalent(changedFile, links[1].source));
+	CHECK(std::filesystem::equivalent(changedFile, copyFile));
+
+	CHECK(Tests::readFile(getImportedPath() / "Hives/SOFTWARE_BASE") == toBytes("regf of the software hive"));
+	CHECK_FALSE(std::filesystem::exists(getImportedPath() / "Hives/SOFTWARE_BASE.LOG1"));
+	CHECK_FALSE(std::filesystem::exists(getImportedPath() / "Hives/SOFTWARE_BASE.fingerprints"));
+
+	const LinkManifest manifest(manifestStream);
+	std::vector<std::filesystem::path> targets;
+	for (const LinkEntry& entry : manifest.getEntries()) {
+		targets.push_back(entry.target);
+	}
+
+	std::sort(targets.begin(), targets.end());
+	std::vector<std::filesystem::path> expectedTargets = { links[0].target, links[1].target, links[2].target, links[3].target };
+	std::sort(expectedTargets.begin(), expectedTargets.end());
+	CHECK(targets == expectedTargets);
+}
+
+TEST_CASE_METHOD(BundleFixture, "A layer bundle imports into an empty host", "[bundle]")
+{
+	std::stringstream bundle;
+	exportBundle(bundle);
+
+	std::filesystem::remove_all(directory.getPath() / "Host");
+
+	std::stringstream manifestStream;
+	const BundleReport importReport = importBundle(bundle, manifestStream);
+
+	CHECK(importReport.linkedFiles == 0);
+	CHECK(importReport.writtenFiles == 4);
+	CHECK(Tests::readFile(getImportedFile(links[0].target)) == toBytes("content kept on the host"));
+	CHECK(Tests::readFile(getImportedFile(links[3].target)) == toBytes("content kept on the host"));
+	CHECK(Tests::readFile(getImportedFile(links[2].target)) == toBytes("content of the prepared host"));
+}
+
+TEST_CASE_METHOD(BundleFixture, "A damaged layer bundle is rejected", "[bundle]")
+{
+	std::stringstream bundle;
+	exportBundle(bundle);
+	std::string data = bundle.str();
+
+	SECTION("not a bundle")
+	{
+		data[0] = 'X';
+	}
+
+	SECTION("truncated")
+	{
+		data.resize(data.size() - 10);
+	}
+
+	SECTION("corrupted content")
+	{
+		// the last content is written from the bundle, the host file was removed
+		std::filesystem::remove_all(directory.getPath() / "Host");
+		data.back() ^= 1;
+	}
+
+	std::stringstream damagedBundle(data);
+	std::stringstream manifestStream;
+	CHECK_THROWS_AS(importBundle(damagedBundle, manifestStream), std::system_error);
+}
+
+TEST_CASE_METHOD(BundleFixture, "A layer bundle streams contents larger than a chunk", "[bundle]")
+{
+	std::string content(3 * 1024 * 1024 + 123, '\0');
+	for (size_t i = 0; i < content.size(); ++i) {
+		content[i] = static_cast<char>(i * 13 + i / 4096);
+	}
+
+	links.clear();
+	addLink("Host/Windows/System32/big.dll", "/Windows/System32/big.dll", content);
+
+	std::stringstream bundle;
+	exportBundle(bundle);
+	std::filesystem::remove_all(directory.getPath() / "Host");
+
+	std::stringstream manifestStream;
+	const BundleReport importReport = importBundle(bundle, manifestStream);
+
+	CHECK(importReport.writtenFiles == 1);
+	CHECK(importReport.writtenBytes == content.size());
+	CHECK(Tests::readFile(getImportedFile(links[0].target)) == toBytes(content));
+}
+
+TEST_CASE_METHOD(BundleFixture, "A layer bundle fails when the host files can't be linked", "[bundle]")
+{
+	std::stringstream bundle;
+	exportBundle(bundle);
+
+	std::stringstream manifestStream;
+	CHECK_THROWS_AS(importBundle(bundle, manifestStream, std::make_shared<NoHardLinkFileOperations>(pool)), std::system_error);
+
+	// nothing is recorded as linked
+	CHECK(manifestStream.str().empty());
+}
+
+TEST_CASE_METHOD(BundleFixture, "A layer bundle with paths outside the container is rejected", "[bundle]")
+{
+	const std::filesystem::path hostFile = links[0].source;
+	const std::string source = toUtf8(toFileGroupPath(hostFile));
+
+	BundleBuilder builder;
+
+	SECTION("target in a parent directory")
+	{
+		builder.appendInteger<uint32_t>(1);
+		builder.appendLink("/Windows/../../outside.dll", hostFile, source);
+	}
+
+	SECTION("relative target in a parent directory")
+	{
+		builder.appendInteger<uint32_t>(1);
+		builder.appendLink("../outside.dll", hostFile, source);
+	}
+
+	SECTION("source in a parent directory")
+	{
+		const std::string parentSource = toUtf8(toFileGroupPath(hostFile.parent_path() / ".." / hostFile.parent_path().filename() / hostFile.filename()));
+
+		builder.appendInteger<uint32_t>(1);
+		builder.appendLink("/Windows/System32/same.dll", hostFile, parentSource);
+	}
+
+	SECTION("hive in a parent directory")
+	{
+		builder.appendInteger<uint32_t>(0);
+		builder.appendInteger<uint32_t>(1);
+		builder.appendString("../outside.dll");
+		builder.appendInteger<uint64_t>(4);
+		builder.data.append("regf");
+	}
+
+	// the links are all read before anything is created
+	builder.appendInteger<uint32_t>(0);
+	builder.appendInteger<uint32_t>(0);
+
+	std::stringstream bundle(builder.data);
+	std::stringstream manifestStream;
+	CHECK_THROWS_AS(importBundle(bundle, manifestStream), std::system_error);
+
+	CHECK_FALSE(std::filesystem::exists(getImportedPath() / "outside.dll"));
+	CHECK(std::filesystem::is_empty(getImportedPath() / "Files"));
+	CHECK(manifestStream.str().empty());
+}
@@ -0,0 +1,118 @@
+#include "pe_image.h"
+#include "test_pe_builder.h"
+
+#include <catch2/catch.hpp>
+
+#include <stdexcept>
+
+using namespace Files;
+
+TEST_CASE("Pe::Image reads the import tables of a 64-bit image", "[pe]")
+{
+	Tests::PeImageSpec spec;
+	spec.imports = { "KERNEL32.dll", "ntdll.dll" };
+	spec.delayImports = { "Version.DLL" };
+
+	const std::vector<unsigned char> data = Tests::buildPeImage(spec);
+	const Pe::Image image(data);
+
+	CHECK(image.getImports() == std::vector<std::string>{ "kernel32.dll", "ntdll.dll" });
+	CHECK(image.getDelayImports() == std::vector<std::string>{ "version.dll" });
+	CHECK_FALSE(image.is32Bit());
+}
+
+TEST_CASE("Pe::Image reads 32-bit images and delay imports by virtual address", "[pe]")
+{
+	Tests::PeImageSpec spec;
+	spec.b32Bit = true;
+	spec.imports = { "user32.dll" };
+	spec.delayImports = { "comctl32.dll", "shell32.dll" };
+	spec.bVirtualAddressDelayImports = true;
+
+	const std::vector<unsigned char> data = Tests::buildPeImage(spec);
+	const Pe::Image image(data);
+
+	CHECK(image.is32Bit());
+	CHECK(image.getImports() == std::vector<std::string>{ "user32.dll" });
+	CHECK(image.getDelayImports() == std::vector<std::string>{ "comctl32.dll", "shell32.dll" });
+}
+
+TEST_CASE("Pe::Image finds sections by name", "[pe]")
+{
+	Tests::PeImageSpec spec;
+	spec.sections.emplace_back(".apiset", std::vector<unsigned char>{ 1, 2, 3, 4, 5 });
+
+	const std::vector<unsigned char> data = Tests::buildPeImage(spec);
+	const Pe::Image image(data);
+
+	const std::span<const unsigned char> section = image.findSection(".apiset");
+	CHECK(std::vector<unsigned char>(section.begin(), section.end()) == std::vector<unsigned char>{ 1, 2, 3, 4, 5 });
+	CHECK(image.findSection(".rsrc").empty());
+	CHECK(image.getImports().empty());
+}
+
+TEST_CASE("Pe::Image rejects data that is not a PE image", "[pe]")
+{
+	std::vector<unsigned char> data = Tests::buildPeImage(Tests::PeImageSpec{ false, { "kernel32.dll" } });
+
+	SECTION("missing DOS signature")
+	{
+		data[0] = 'Z';
+		CHECK_THROWS_AS(Pe::Image(data), std::runtime_error);
+	}
+
+	SECTION("truncated headers")
+	{
+		data.resize(0x60);
+		CHECK_THROWS_AS(Pe::Image(data), std::runtime_error);
+	}
+
+	SECTION("empty file")
+	{
+		CHECK_THROWS_AS(Pe::Image(std::span<const unsigned char>()), std::runtime_error);
+	}
+}
+
+TEST_CASE("Pe::Image ignores import names outside of the image", "[pe]")
+{
+	Tests::PeImageSpec spec;
+	spec.imports = { "kernel32.dll" };
+	std::vector<unsigned char> data = Tests::buildPeImage(spec);
+
+	// the section data stops before the descriptors
+	data.resize(0x200);
+	const Pe::Image image(data);
+	CHECK(image.getImports().empty());
+}
+
+TEST_CASE("Pe::ApiSetSchema resolves contracts to their host module", "[pe][apiset]")
+{
+	const std::vector<unsigned char> schemaData = Tests::buildApiSetSchema({
+		{ "api-ms-win-core-file-l1-2-0", "kernelbase.dll", {} },
+		{ "api-ms-win-core-com-l1-1-1", "combase.dll", { { "ole32.dll", "ole32impl.dll" } } },
+		{ "ext-ms-win-gdi-draw-l1-1-0", "", {} },
+	});
+	const Pe::ApiSetSchema schema(schemaData);
+
+	CHECK(Pe::ApiSetSchema::isApiSetName("API-MS-Win-Core-File-L1-2-0.dll"));
+	CHECK(Pe::ApiSetSchema::isApiSetName("ext-ms-win-gdi-draw-l1-1-0.dll"));
+	CHECK_FALSE(Pe::ApiSetSchema::isApiSetName("kernel32.dll"));
+
+	// any revision of a contract resolves the same way
+	CHECK(schema.resolve("api-ms-win-core-file-l1-2-0.dll") == "kernelbase.dll");
+	CHECK(schema.resolve("API-MS-WIN-CORE-FILE-L1-2-4.DLL") == "kernelbase.dll");
+
+	CHECK(schema.resolve("api-ms-win-core-com-l1-1-1.dll") == "combase.dll");
+	CHECK(schema.resolve("api-ms-win-core-com-l1-1-1.dll", "OLE32.dll") == "ole32impl.dll");
+	CHECK(schema.resolve("api-ms-win-core-com-l1-1-1.dll", "shell32.dll") == "combase.dll");
+
+	// contracts without host, or unknown
+	CHECK(schema.resolve("ext-ms-win-gdi-draw-l1-1-0.dll").empty());
+	CHECK(schema.resolve("api-ms-win-unknown-l1-1-0.dll").empty());
+}
+
+TEST_CASE("Pe::ApiSetSchema rejects other schema versions", "[pe][apiset]")
+{
+	const std::vector<unsigned char> schemaData = Tests::buildApiSetSchema({ { "api-ms-win-core-file-l1-2-0", "kernelbase.dll", {} } }, 4);
+	CHECK_THROWS_AS(Pe::ApiSetSchema(schemaData), std::runtime_error);
+}
@@ -0,0 +1,99 @@
+#include "prep_journal.h"
+#include "test_directory.h"
+
+#include <catch2/catch.hpp>
+
+#include <string>
+
+namespace
+{
+	std::string readJournal(const std::filesystem::path& journalFile)
+	{
+		const std::vector<unsigned char> data = Tests::readFile(journalFile);
+		return std::string(data.begin(), data.end());
+	}
+}
+
+TEST_CASE("A resumed journal appends to the records of the interrupted run", "[journal]")
+{
+	Tests::TestDirectory directory;
+	const std::filesystem::path journalFile = directory.getPath() / "prep.journal";
+
+	{
+		PrepJournal journal(journalFile, true);
+		CHECK_FALSE(journal.isResuming());
+
+		journal.append("hive", "SYSTEM_BASE");
+		journal.append("hive", "SOFTWARE_BASE");
+		journal.commit();
+	}
+
+	const std::string committed = readJournal(journalFile);
+	CHECK(committed == "hive\tSYSTEM_BASE\nhive\tSOFTWARE_BASE\n");
+
+	{
+		PrepJournal journal(journalFile, true);
+		REQUIRE(journal.isResuming());
+		CHECK(journal.contains("hive", "SYSTEM_BASE"));
+		CHECK(journal.contains("hive", "SOFTWARE_BASE"));
+		CHECK_FALSE(journal.contains("hive", "DEFAULT_BASE"));
+
+		// opening doesn't rewrite the records
+		CHECK(readJournal(journalFile) == committed);
+
+		journal.append("hive", "DEFAULT_BASE");
+		journal.commit();
+	}
+
+	CHECK(readJournal(journalFile) == committed + "hive\tDEFAULT_BASE\n");
+}
+
+TEST_CASE("A resumed journal drops a record cut by the interruption", "[journal]")
+{
+	Tests::TestDirectory directory;
+	const std::filesystem::path journalFile = directory.getPath() / "prep.journal";
+	directory.writeFile("prep.journal", "hive\tSYSTEM_BASE\nhive\tSOFTW");
+
+	{
+		PrepJournal journal(journalFile, true);
+		REQUIRE(journal.isResuming());
+		CHECK(journal.contains("hive", "SYSTEM_BASE"));
+		CHECK_FALSE(journal.contains("hive", "SOFTW"));
+		CHECK(readJournal(journalFile) == "hive\tSYSTEM_BASE\n");
+
+		journal.append("hive", "SOFTWARE_BASE");
+		journal.commit();
+	}
+
+	CHECK(readJournal(journalFile) == "hive\tSYSTEM_BASE\nhive\tSOFTWARE_BASE\n");
+}
+
+TEST_CASE("A journal starts over after a complete run or without resuming", "[journal]")
+{
+	Tests::TestDirectory directory;
+	const std::filesystem::path journalFile = directory.getPath() / "prep.journal";
+
+	SECTION("complete run")
+	{
+		{
+			PrepJournal journal(journalFile, false);
+			journal.append("hive", "SYSTEM_BASE");
+			journal.complete();
+		}
+
+		PrepJournal journal(journalFile, true);
+		CHECK_FALSE(journal.isResuming());
+		CHECK_FALSE(journal.contains("hive", "SYSTEM_BASE"));
+	}
+
+	SECTION("not resuming")
+	{
+		directory.writeFile("prep.journal", "hive\tSYSTEM_BASE\n");
+
+		PrepJournal journal(journalFile, false);
+		CHECK_FALSE(journal.isResuming());
+		CHECK_FALSE(journal.contains("hive", "SYSTEM_BASE"));
+	}
+
+	CHECK(readJournal(journalFile).empty());
+}
@@ -0,0 +1,203 @@
+#include "registry_fingerprint.h"
+#include "registry_memory_platform.h"
+#include "test_directory.h"
+#include "test_registry.h"
+
+#include <catch2/catch.hpp>
+
+#include <string>
+#include <vector>
+
+using namespace Registry;
+using namespace Tests;
+
+namespace
+{
+	/**
+	 * Fingerprints everything but the keys named "Skip".
+	 */
+	class SkipFilter : public ICopyFilter
+	{
+	public:
+		bool includeKey(const std::wstring_view& keyPath) const override
+		{
+			return !keyPath.ends_with(L"Skip");
+		}
+
+		bool includeValue(const std::wstring_view& keyPath, const std::wstring_view& valueName) const override
+		{
+			return true;
+		}
+	};
+
+	std::vector<RuleFingerprint> getRules(const std::vector<std::wstring>& targetPaths)
+	{
+		std::vector<RuleFingerprint> rules;
+		for (size_t i = 0; i < targetPaths.size(); ++i) {
+			rules.push_back({ targetPaths[i], i + 1 });
+		}
+
+		return rules;
+	}
+}
+
+TEST_CASE("A key fingerprint changes with its subkeys and value counts", "[registry][fingerprint]")
+{
+	Tests::TestDirectory directory;
+	Platform::Memory::RegistryManager memory;
+	IKeyManager& keyManager = memory.getKeyManager();
+
+	const IHivePtr hive = memory.getHiveManager().createHive(directory.getPath() / "SOFTWARE");
+	const IKeyPtr root = hive->getRootKey();
+	fillHive(memory, root);
+
+	const IKeyPtr software = keyManager.getKey(L"Software", Permission::Read, root.get());
+	const uint64_t fingerprint = fingerprintTree(keyManager, software.get());
+	CHECK(fingerprintTree(keyManager, software.get()) == fingerprint);
+
+	SECTION("value added")
+	{
+		const IKeyPtr app = keyManager.getKey(L"Vendor\\App", Permission::Write, software.get());
+		setValue(memory, app, L"Added", Types::DWord, toData(1));
+		CHECK(fingerprintTree(keyManager, software.get()) != fingerprint);
+	}
+
+	SECTION("key added")
+	{
+		keyManager.getOrCreateKey(L"Vendor\\Other", Permission::Write, software.get());
+		CHECK(fingerprintTree(keyManager, software.get()) != fingerprint);
+	}
+
+	SECTION("key outside the filter")
+	{
+		// the skipped key is still counted in its parent
+		const SkipFilter filter;
+		const IKeyPtr skip = keyManager.getOrCreateKey(L"Vendor\\Skip", Permission::Write, software.get());
+		const uint64_t filteredFingerprint = fingerprintTree(keyManager, software.get(), &filter);
+		const uint64_t skipFingerprint = fingerprintTree(keyManager, software.get());
+
+		setValue(memory, skip, L"Added", Types::DWord, toData(1));
+		keyManager.getOrCreateKey(L"Added", Permission::Write, skip.get());
+		CHECK(fingerprintTree(keyManager, software.get(), &filter) == filteredFingerprint);
+		CHECK(fingerprintTree(keyManager, software.get()) != skipFingerprint);
+	}
+}
+
+TEST_CASE("A key fingerprint only reads the levels of subkeys asked", "[registry][fingerprint]")
+{
+	Tests::TestDirectory directory;
+	Platform::Memory::RegistryManager memory;
+	IKeyManager& keyManager = memory.getKeyManager();
+
+	const IHivePtr hive = memory.getHiveManager().createHive(directory.getPath() / "SOFTWARE");
+	const IKeyPtr root = hive->getRootKey();
+	fillHive(memory, root);
+
+	// Deep\Deep\Deep is three levels below the root
+	const uint64_t fingerprint = fingerprintTree(keyManager, root.get(), nullptr, HostKeyFingerprintLevels);
+	const IKeyPtr deepKey = keyManager.getKey(L"Deep\\Deep\\Deep", Permission::Write, root.get());
+
+	SECTION("change at the last level")
+	{
+		setValue(memory, deepKey, L"Added", Types::DWord, toData(1));
+		CHECK(fingerprintTree(keyManager, root.get(), nullptr, HostKeyFingerprintLevels) != fingerprint);
+	}
+
+	SECTION("change below the last level")
+	{
+		const IKeyPtr deeperKey = keyManager.getKey(L"Deep", Permission::Write, deepKey.get());
+		setValue(memory, deeperKey, L"Added", Types::DWord, toData(1));
+		keyManager.getOrCreateKey(L"Added", Permission::Write, deeperKey.get());
+
+		CHECK(fingerprintTree(keyManager, root.get(), nullptr, HostKeyFingerprintLevels) == fingerprint);
+		CHECK(fingerprintTree(keyManager, root.get()) != fingerprintTree(keyManager, root.get(), nullptr, HostKeyFingerprintLevels));
+	}
+}
+
+TEST_CASE("Only the changed rules and the rules writing the same keys are applied again", "[registry][fingerprint]")
+{
+	const std::vector<RuleFingerprint> previousRules = getRules({ L"Software\\Vendor", L"Software\\Vendor\\App", L"Software\\Other", L"System" });
+	std::vector<RuleFingerprint> rules = previousRules;
+
+	std::vector<bool> changedRules;
+	std::vector<bool> appliedRules;
+
+	SECTION("nothing changed")
+	{
+		REQUIRE(selectChangedRules(previousRules, rules, changedRules, appliedRules));
+		CHECK(changedRules == std::vector<bool>(rules.size(), false));
+		CHECK(appliedRules == std::vector<bool>(rules.size(), false));
+	}
+
+	SECTION("subkey changed")
+	{
+		rules[1].fingerprint = 42;
+
+		REQUIRE(selectChangedRules(previousRules, rules, changedRules, appliedRules));
+		CHECK(changedRules == std::vector<bool>{ false, true, false, false });
+
+		// Software\Vendor writes App too, the other keys are kept
+		CHECK(appliedRules == std::vector<bool>{ true, true, false, false });
+	}
+
+	SECTION("path compared in any case")
+	{
+		rules[3].targetPath = L"SYSTEM";
+		rules[3].fingerprint = 42;
+
+		REQUIRE(selectChangedRules(previousRules, rules, changedRules, appliedRules));
+		CHECK(changedRules == std::vector<bool>{ false, false, false, true });
+		CHECK(appliedRules == std::vector<bool>{ false, false, false, true });
+	}
+
+	SECTION("rule of the root key")
+	{
+		// the root key writes all the others
+		const std::vector<RuleFingerprint> previousRootRules = getRules({ L"", L"Software\\Vendor", L"System" });
+		std::vector<RuleFingerprint> rootRules = previousRootRules;
+		rootRules[2].fingerprint = 42;
+
+		REQUIRE(selectChangedRules(previousRootRules, rootRules, changedRules, appliedRules));
+		CHECK(changedRules == std::vector<bool>{ false, false, true });
+		CHECK(appliedRules == std::vector<bool>{ true, true, true });
+
+		// and can't be deleted
+		rootRules[0].fingerprint = 42;
+		CHECK_FALSE(selectChangedRules(previousRootRules, rootRules, changedRules, appliedRules));
+	}
+
+	SECTION("rule added")
+	{
+		rules.push_back({ L"Added", 42 });
+		CHECK_FALSE(selectChangedRules(previousRules, rules, changedRules, appliedRules));
+	}
+
+	SECTION("rules moved")
+	{
+		std::swap(rules[2], rules[3]);
+		CHECK_FALSE(selectChangedRules(previousRules, rules, changedRules, appliedRules));
+	}
+}
+
+TEST_CASE("Rule fingerprints are saved next to the hive", "[registry][fingerprint]")
+{
+	Tests::TestDirectory directory;
+	const std::filesystem::path hiveFile = directory.getPath() / "SOFTWARE_BASE";
+
+	CHECK(loadFingerprints(hiveFile).empty());
+
+	const std::vector<RuleFingerprint> rules = { { L"", 0xCBF29CE484222325ull }, { L"Software\\Vendor\\App", 1 } };
+	saveFingerprints(hiveFile, rules);
+
+	const std::vector<RuleFingerprint> loadedRules = loadFingerprints(hiveFile);
+	REQUIRE(loadedRules.size() == rules.size());
+	for (size_t i = 0; i < rules.size(); ++i)
+	{
+		CHECK(loadedRules[i].targetPath == rules[i].targetPath);
+		CHECK(loadedRules[i].fingerprint == rules[i].fingerprint);
+	}
+
+	// a damaged file is ignored, the hive is rebuilt
+	directory.writeFile("SOFTWARE_BASE.fingerprints", "not a fingerprint\n");
+	CHECK(loadFingerprints(hiveFile).empty());
+}
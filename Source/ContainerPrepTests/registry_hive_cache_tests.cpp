@@ -0,0 +1,91 @@
+#include "registry_hive_cache.h"
+#include "test_directory.h"
+
+#include <catch2/catch.hpp>
+
+#include <string>
+
+using namespace Registry;
+
+namespace
+{
+	std::vector<unsigned char> toBytes(std::string_view str)
+	{
+		return std::vector<unsigned char>(str.begin(), str.end());
+	}
+
+	size_t countFiles(const std::filesystem::path& directory)
+	{
+		size_t count = 0;
+		for (const auto& entry : std::filesystem::recursive_directory_iterator(directory))
+		{
+			if (entry.is_regular_file()) {
+				++count;
+			}
+		}
+
+		return count;
+	}
+}
+
+TEST_CASE("A stored hive is restored with the time saved", "[hivecache]")
+{
+	Tests::TestDirectory directory;
+	const std::filesystem::path hiveFile = directory.writeFile("Hives/SOFTWARE_BASE", "regf of the software hive");
+	const std::filesystem::path restoredFile = directory.getPath() / "Restored/SOFTWARE_BASE";
+	std::filesystem::create_directories(restoredFile.parent_path());
+
+	HiveCache cache(directory.getPath() / "Cache", L"22631.4037", L"DepthFirst");
+	CHECK_FALSE(cache.restore(L"SOFTWARE", 0x1234, restoredFile));
+
+	cache.store(L"SOFTWARE", 0x1234, hiveFile, std::chrono::seconds(60));
+
+	// the entry and its time, without the partial files
+	CHECK(countFiles(directory.getPath() / "Cache") == 2);
+
+	REQUIRE(cache.restore(L"SOFTWARE", 0x1234, restoredFile));
+	CHECK(Tests::readFile(restoredFile) == toBytes("regf of the software hive"));
+	CHECK_FALSE(cache.restore(L"SOFTWARE", 0x1235, restoredFile));
+	CHECK_FALSE(cache.restore(L"SYSTEM", 0x1234, restoredFile));
+
+	const HiveCacheReport report = cache.getReport();
+	CHECK(report.hits == 1);
+	CHECK(report.misses == 3);
+	CHECK(report.savedTime > std::chrono::seconds(50));
+}
+
+TEST_CASE("A hive is only restored for the same host build and hive format", "[hivecache]")
+{
+	Tests::TestDirectory directory;
+	const std::filesystem::path hiveFile = directory.writeFile("Hives/SOFTWARE_BASE", "regf of the software hive");
+	const std::filesystem::path restoredFile = directory.getPath() / "Hives/SOFTWARE_RESTORED";
+
+	{
+		HiveCache cache(directory.getPath() / "Cache", L"22631.4037", L"DepthFirst");
+		cache.store(L"SOFTWARE", 1, hiveFile, std::chrono::seconds(1));
+	}
+
+	HiveCache otherFormat(directory.getPath() / "Cache", L"22631.4037", L"BreadthFirst");
+	CHECK_FALSE(otherFormat.restore(L"SOFTWARE", 1, restoredFile));
+
+	// storing a hive for another build removes the hives of the previous one
+	HiveCache otherBuild(directory.getPath() / "Cache", L"22631.4169", L"DepthFirst");
+	otherBuild.store(L"SYSTEM", 2, hiveFile, std::chrono::seconds(1));
+
+	CHECK_FALSE(std::filesystem::exists(directory.getPath() / "Cache/22631.4037"));
+	CHECK(otherBuild.restore(L"SYSTEM", 2, restoredFile));
+	CHECK_FALSE(otherBuild.restore(L"SOFTWARE", 1, restoredFile));
+}
+
+TEST_CASE("A hive that can't be stored leaves no entry in the cache", "[hivecache]")
+{
+	Tests::TestDirectory directory;
+	const std::filesystem::path restoredFile = directory.getPath() / "SOFTWARE_BASE";
+
+	HiveCache cache(directory.getPath() / "Cache", L"22631.4037", L"DepthFirst");
+	cache.store(L"SOFTWARE", 1, directory.getPath() / "Missing/SOFTWARE_BASE", std::chrono::seconds(1));
+
+	// no time is written for a hive that isn't there
+	CHECK(countFiles(directory.getPath() / "Cache") == 0);
+	CHECK_FALSE(cache.restore(L"SOFTWARE", 1, restoredFile));
+}
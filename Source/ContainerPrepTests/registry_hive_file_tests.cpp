@@ -0,0 +1,181 @@
+#include "registry_hive_compaction.h"
+#include "registry_hive_file_platform.h"
+#include "registry_memory_platform.h"
+#include "test_directory.h"
+#include "test_registry.h"
+
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+using namespace Registry;
+using namespace Tests;
+
+namespace
+{
+	/**
+	 * Returns the offset of the first key cell with the name, relative to the first bin as cell offsets are.
+	 */
+	uint32_t findKeyCell(const std::vector<unsigned char>& image, const std::string& name)
+	{
+		const size_t binsSize = Regf::readUInt32(image.data() + Regf::BaseBlock::BinsSize);
+		const unsigned char* bins = image.data() + Regf::BaseBlockSize;
+
+		for (uint32_t binOffset = 0; binOffset < binsSize; binOffset += Regf::readUInt32(bins + binOffset + Regf::Bin::Size))
+		{
+			const uint32_t binSize = Regf::readUInt32(bins + binOffset + Regf::Bin::Size);
+			for (uint32_t cellOffset = binOffset + Regf::BinHeaderSize; cellOffset < binOffset + binSize;)
+			{
+				const int32_t cellSize = static_cast<int32_t>(Regf::readUInt32(bins + cellOffset));
+				const unsigned char* data = bins + cellOffset + sizeof(uint32_t);
+
+				if (cellSize < 0 && data[0] == 'n' && data[1] == 'k' && std::string(reinterpret_cast<const char*>(data + Regf::Key::Name), Regf::readUInt16(data + Regf::Key::NameLength)) == name) {
+					return cellOffset;
+				}
+
+				cellOffset += cellSize < 0 ? -cellSize : cellSize;
+			}
+		}
+
+		FAIL("no key cell named " << name);
+		return Regf::NullOffset;
+	}
+
+	void writeImage(const std::filesystem::path& path, const std::vector<unsigned char>& image)
+	{
+		std::ofstream stream(path, std::ios::out | std::ios::binary | std::ios::trunc);
+		stream.write(reinterpret_cast<const char*>(image.data()), image.size());
+	}
+
+	std::errc getError(const std::function<void()>& func)
+	{
+		try {
+			func();
+		}
+		catch (const std::system_error& e) {
+			return static_cast<std::errc>(e.code().value());
+		}
+
+		return std::errc();
+	}
+}
+
+TEST_CASE("The hive file registry reads the keys and values of a written hive", "[registry][hivefile]")
+{
+	const Regf::KeyOrder order = GENERATE(Regf::KeyOrder::DepthFirst, Regf::KeyOrder::BreadthFirst);
+
+	Tests::TestDirectory directory;
+	Regf::HiveLayout layout;
+	layout.order = order;
+
+	Platform::Memory::RegistryManager memory(Platform::Memory::HiveFormat::Regf, layout);
+	const IHivePtr hive = memory.getHiveManager().createHive(directory.getPath() / "SOFTWARE");
+	fillHive(memory, hive->getRootKey());
+	memory.getHiveManager().commitHive(*hive);
+
+	Platform::HiveFile::RegistryManager hiveFiles(directory.getPath());
+	IKeyManager& keyManager = hiveFiles.getKeyManager();
+
+	const IKeyPtr hklm = keyManager.getPredefinedKey(L"HKLM");
+	const IKeyPtr software = keyManager.getKey(L"SOFTWARE", Permission::Read, hklm.get());
+	REQUIRE(software);
+
+	// names are case-insensitive
+	const IKeyPtr app = keyManager.getKey(L"software\\VENDOR\\app", Permission::Read, software.get());
+	CHECK(getData(hiveFiles, app, L"Version", Types::DWord) == toData(7));
+	CHECK(getData(hiveFiles, app, L"Small", Types::Binary) == std::vector<unsigned char>{ 1, 2, 3 });
+	CHECK(getData(hiveFiles, app, L"Empty", Types::Binary).empty());
+	CHECK(getData(hiveFiles, app, L"PATHS", Types::MultiString) == toData(u"C:\\One\0C:\\Two\0"));
+	CHECK(getData(hiveFiles, app, L"Big", Types::Binary) == getBigData());
+
+	const IKeyPtr classes = keyManager.getKey(L"Classes\\.txt", Permission::Read, software.get());
+	CHECK(getData(hiveFiles, classes, L"", Types::String) == toData(u"txtfile"));
+
+	const IKeyPtr many = keyManager.getKey(L"Many", Permission::Read, software.get());
+	const KeyInfo manyInfo = keyManager.queryKeyInfo(many.get());
+	CHECK(manyInfo.subKeyCount == ManySubKeyCount);
+	CHECK(manyInfo.valueCount == 0);
+
+	std::vector<std::wstring> subKeyNames;
+	keyManager.visitKeys(many.get(), [&subKeyNames](const IKey* parentKey, const wchar_t* subKeyName)
+		{
+			subKeyNames.push_back(subKeyName);
+			return true;
+		}, 0);
+
+	REQUIRE(subKeyNames.size() == ManySubKeyCount);
+	CHECK(std::is_sorted(subKeyNames.begin(), subKeyNames.end(), [](const std::wstring& left, const std::wstring& right) { return compareNames(left, right) < 0; }));
+
+	const IKeyPtr key1234 = keyManager.getKey(L"Key1234", Permission::Read, many.get());
+	CHECK(getData(hiveFiles, key1234, L"Index", Types::DWord) == toData(1234));
+
+	std::wstring deepPath = L"Deep";
+	for (size_t i = 1; i < DeepKeyCount; ++i) {
+		deepPath += L"\\Deep";
+	}
+
+	const IKeyPtr deepKey = keyManager.getKey(deepPath.c_str(), Permission::Read, software.get());
+	CHECK(getData(hiveFiles, deepKey, L"Depth", Types::DWord) == toData(DeepKeyCount));
+
+	CHECK_THROWS_AS(keyManager.getKey(L"Software\\Missing", Permission::Read, software.get()), std::system_error);
+	CHECK_THROWS_AS(hiveFiles.getValueManager().getValue(app.get(), L"Missing"), std::system_error);
+}
+
+TEST_CASE("A hive file with changes in its logs is not read", "[registry][hivefile]")
+{
+	Tests::TestDirectory directory;
+	const std::filesystem::path hiveFile = directory.getPath() / "SOFTWARE";
+
+	Platform::Memory::RegistryManager memory;
+	const IHivePtr hive = memory.getHiveManager().createHive(hiveFile);
+	fillHive(memory, hive->getRootKey());
+	memory.getHiveManager().commitHive(*hive);
+
+	// as Windows leaves a hive between a write and the flush of its log
+	std::vector<unsigned char> image = readFile(hiveFile);
+	Regf::writeUInt32(image.data() + Regf::BaseBlock::PrimarySequence, 2);
+	Regf::writeUInt32(image.data() + Regf::BaseBlock::Checksum, Regf::computeChecksum(std::span<const unsigned char>(image.data(), Regf::BaseBlockSize)));
+	writeImage(hiveFile, image);
+
+	Platform::HiveFile::RegistryManager hiveFiles(directory.getPath());
+	const IKeyPtr hklm = hiveFiles.getKeyManager().getPredefinedKey(L"HKLM");
+	CHECK(getError([&] { hiveFiles.getKeyManager().getKey(L"SOFTWARE", Permission::Read, hklm.get()); }) == std::errc::device_or_resource_busy);
+	CHECK(getError([&] { memory.getHiveManager().loadHive(hiveFile); }) == std::errc::device_or_resource_busy);
+	CHECK(getError([&] { compactHive(hiveFile, Regf::HiveLayout()); }) == std::errc::device_or_resource_busy);
+}
+
+TEST_CASE("A hive file whose keys loop is rejected", "[registry][hivefile]")
+{
+	Tests::TestDirectory directory;
+	const std::filesystem::path hiveFile = directory.getPath() / "SOFTWARE";
+
+	Platform::Memory::RegistryManager memory;
+	const IHivePtr hive = memory.getHiveManager().createHive(hiveFile);
+	memory.getKeyManager().getOrCreateKey(L"Parent\\Child", Permission::Write, hive->getRootKey().get());
+	memory.getHiveManager().commitHive(*hive);
+
+	// the child lists itself as its subkey, through the list of its parent
+	std::vector<unsigned char> image = readFile(hiveFile);
+	unsigned char* parentCell = image.data() + Regf::BaseBlockSize + findKeyCell(image, "Parent") + sizeof(uint32_t);
+	unsigned char* childCell = image.data() + Regf::BaseBlockSize + findKeyCell(image, "Child") + sizeof(uint32_t);
+	Regf::writeUInt32(childCell + Regf::Key::SubKeyCount, 1);
+	Regf::writeUInt32(childCell + Regf::Key::SubKeyList, Regf::readUInt32(parentCell + Regf::Key::SubKeyList));
+	writeImage(hiveFile, image);
+
+	Platform::HiveFile::RegistryManager hiveFiles(directory.getPath());
+	IKeyManager& keyManager = hiveFiles.getKeyManager();
+	const IKeyPtr hklm = keyManager.getPredefinedKey(L"HKLM");
+	const IKeyPtr software = keyManager.getKey(L"SOFTWARE", Permission::Read, hklm.get());
+
+	// each key can still be opened
+	CHECK(keyManager.getKey(L"Parent\\Child\\Child", Permission::Read, software.get()));
+
+	CHECK(getError([&] { keyManager.visitKeys(software.get(), [](const IKey* parentKey, const wchar_t* subKeyName) { return true; }); }) == std::errc::bad_message);
+	CHECK(getError([&] { memory.getHiveManager().loadHive(hiveFile); }) == std::errc::bad_message);
+	CHECK(getError([&] { readHive(hiveFile); }) == std::errc::bad_message);
+	CHECK(getError([&] { compactHive(hiveFile, Regf::HiveLayout()); }) == std::errc::bad_message);
+}
@@ -0,0 +1,88 @@
+#include "registry_host_key_filter.h"
+
+#include <catch2/catch.hpp>
+
+#include <stdexcept>
+
+using namespace Registry;
+
+TEST_CASE("A host key filter copies the included keys and the keys leading to them", "[registry][filter]")
+{
+	Config::HostKeyFilter filter;
+	filter.addInclude(L"Software\\Vendor*\\App");
+	filter.addInclude(L"System");
+
+	CHECK(filter.includeKey(L"Software"));
+	CHECK(filter.includeKey(L"software\\VendorA"));
+	CHECK(filter.includeKey(L"Software\\VendorA\\App"));
+	CHECK(filter.includeKey(L"Software\\VendorA\\App\\Settings"));
+	CHECK(filter.includeKey(L"SYSTEM\\Setup"));
+	CHECK_FALSE(filter.includeKey(L"Software\\Other"));
+	CHECK_FALSE(filter.includeKey(L"Software\\VendorA\\Tool"));
+	CHECK_FALSE(filter.includeKey(L"Hardware"));
+
+	// the leading keys are copied without their values
+	CHECK_FALSE(filter.includeValue(L"Software\\VendorA", L"Version"));
+	CHECK(filter.includeValue(L"Software\\VendorA\\App", L"Version"));
+	CHECK(filter.includeValue(L"Software\\VendorA\\App\\Settings", L"Version"));
+}
+
+TEST_CASE("A host key filter skips the keys excluded below an included key", "[registry][filter]")
+{
+	Config::HostKeyFilter filter;
+	filter.addInclude(L"Software\\Vendor");
+	filter.addExclude(L"Software\\Vendor\\Secret?");
+
+	CHECK(filter.includeKey(L"Software\\Vendor\\App"));
+	CHECK(filter.includeKey(L"Software\\Vendor\\Secret"));
+	CHECK_FALSE(filter.includeKey(L"Software\\Vendor\\Secret1"));
+	CHECK_FALSE(filter.includeKey(L"Software\\Vendor\\SECRET2\\Keys"));
+	CHECK_FALSE(filter.includeValue(L"Software\\Vendor\\Secret1", L"Key"));
+	CHECK(filter.includeValue(L"Software\\Vendor\\App", L"Key"));
+}
+
+TEST_CASE("A host key filter selects values by name", "[registry][filter]")
+{
+	Config::HostKeyFilter filter;
+	filter.addIncludeValue(L"Install*");
+	filter.addExcludeValue(L"*Temp");
+
+	CHECK(filter.includeKey(L"Any\\Key"));
+	CHECK(filter.includeValue(L"Any\\Key", L"InstallDir"));
+	CHECK(filter.includeValue(L"", L"installdate"));
+	CHECK_FALSE(filter.includeValue(L"Any\\Key", L"InstallTemp"));
+	CHECK_FALSE(filter.includeValue(L"Any\\Key", L"Version"));
+}
+
+TEST_CASE("A host key filter copies the levels of subkeys asked", "[registry][filter]")
+{
+	Config::HostKeyFilter filter;
+	filter.setMaxLevels(Config::HostKeyFilter::parseMaxLevels("2"));
+
+	CHECK(filter.includeKey(L"Software"));
+	CHECK(filter.includeKey(L"Software\\Vendor"));
+	CHECK_FALSE(filter.includeKey(L"Software\\Vendor\\App"));
+
+	filter.setMaxLevels(Config::HostKeyFilter::parseMaxLevels("0"));
+	CHECK_FALSE(filter.includeKey(L"Software"));
+	CHECK(filter.includeValue(L"", L"Version"));
+}
+
+TEST_CASE("A host key filter rejects settings that would select everything", "[registry][filter]")
+{
+	Config::HostKeyFilter filter;
+
+	CHECK_THROWS_AS(filter.addInclude(L""), std::runtime_error);
+	CHECK_THROWS_AS(filter.addInclude(L"\\\\"), std::runtime_error);
+	CHECK_THROWS_AS(filter.addExclude(L""), std::runtime_error);
+	CHECK_THROWS_AS(filter.addIncludeValue(L""), std::runtime_error);
+	CHECK_THROWS_AS(filter.addExcludeValue(L""), std::runtime_error);
+
+	CHECK_THROWS_AS(Config::HostKeyFilter::parseMaxLevels(""), std::runtime_error);
+	CHECK_THROWS_AS(Config::HostKeyFilter::parseMaxLevels("-1"), std::runtime_error);
+	CHECK_THROWS_AS(Config::HostKeyFilter::parseMaxLevels("2 levels"), std::runtime_error);
+	CHECK_THROWS_AS(Config::HostKeyFilter::parseMaxLevels("99999999999999999999999"), std::runtime_error);
+
+	// nothing was added
+	CHECK(filter.includeKey(L"Software\\Vendor"));
+}
@@ -0,0 +1,146 @@
+#include "registry_memory_platform.h"
+#include "test_directory.h"
+#include "test_registry.h"
+
+#include <catch2/catch.hpp>
+
+#include <string>
+#include <system_error>
+#include <vector>
+
+using namespace Registry;
+using namespace Tests;
+
+namespace
+{
+	/**
+	 * Copies everything but the keys and values named "Skip".
+	 */
+	class SkipFilter : public ICopyFilter
+	{
+	public:
+		bool includeKey(const std::wstring_view& keyPath) const override
+		{
+			return !keyPath.ends_with(L"Skip");
+		}
+
+		bool includeValue(const std::wstring_view& keyPath, const std::wstring_view& valueName) const override
+		{
+			return valueName != L"Skip";
+		}
+	};
+
+	std::vector<std::wstring> getSubKeyNames(IKeyManager& keyManager, const IKeyPtr& key, size_t maxDepth)
+	{
+		std::vector<std::wstring> names;
+		keyManager.visitKeys(key.get(), [&names](const IKey* parentKey, const wchar_t* subKeyName)
+			{
+				names.push_back(subKeyName);
+				return true;
+			}, maxDepth);
+
+		return names;
+	}
+}
+
+TEST_CASE("The memory registry finds keys and values by their name in any case", "[registry][memory]")
+{
+	Tests::TestDirectory directory;
+	Platform::Memory::RegistryManager memory;
+	IKeyManager& keyManager = memory.getKeyManager();
+
+	const IHivePtr hive = memory.getHiveManager().createHive(directory.getPath() / "SOFTWARE");
+	const IKeyPtr root = hive->getRootKey();
+
+	const IKeyPtr app = keyManager.getOrCreateKey(L"Software\\Vendor\\App", Permission::Write, root.get());
+	setValue(memory, app, L"Version", Types::DWord, toData(7));
+	setValue(memory, app, L"", Types::String, toData(u"default"));
+
+	// created again, the key and its values are kept
+	const IKeyPtr sameApp = keyManager.getOrCreateKey(L"SOFTWARE\\vendor\\APP", Permission::Write, root.get());
+	CHECK(std::wstring(sameApp->getKeyName()) == L"App");
+	CHECK(getData(memory, sameApp, L"VERSION", Types::DWord) == toData(7));
+	CHECK(getData(memory, sameApp, L"", Types::String) == toData(u"default"));
+
+	setValue(memory, sameApp, L"version", Types::Binary, { 1, 2 });
+	CHECK(getData(memory, app, L"Version", Types::Binary) == std::vector<unsigned char>{ 1, 2 });
+
+	const KeyInfo appInfo = keyManager.queryKeyInfo(app.get());
+	CHECK(appInfo.subKeyCount == 0);
+	CHECK(appInfo.valueCount == 2);
+
+	CHECK_THROWS_AS(keyManager.getKey(L"Software\\Missing", Permission::Read, root.get()), std::system_error);
+	CHECK_THROWS_AS(memory.getValueManager().getValue(app.get(), L"Missing"), std::system_error);
+}
+
+TEST_CASE("The memory registry visits subkeys in their creation order, down to a depth", "[registry][memory]")
+{
+	Tests::TestDirectory directory;
+	Platform::Memory::RegistryManager memory;
+	IKeyManager& keyManager = memory.getKeyManager();
+
+	const IHivePtr hive = memory.getHiveManager().createHive(directory.getPath() / "SOFTWARE");
+	const IKeyPtr root = hive->getRootKey();
+
+	keyManager.getOrCreateKey(L"B\\Child", Permission::Write, root.get());
+	keyManager.getOrCreateKey(L"A", Permission::Write, root.get());
+	keyManager.getOrCreateKey(L"C", Permission::Write, root.get());
+
+	CHECK(getSubKeyNames(keyManager, root, 0) == std::vector<std::wstring>{ L"B", L"A", L"C" });
+	CHECK(getSubKeyNames(keyManager, root, ~static_cast<size_t>(0)) == std::vector<std::wstring>{ L"B", L"Child", L"A", L"C" });
+
+	keyManager.deleteKey(root.get(), L"b");
+	CHECK(getSubKeyNames(keyManager, root, ~static_cast<size_t>(0)) == std::vector<std::wstring>{ L"A", L"C" });
+	CHECK_THROWS_AS(keyManager.getKey(L"B\\Child", Permission::Read, root.get()), std::system_error);
+	CHECK_THROWS_AS(keyManager.deleteKey(root.get(), L"B"), std::system_error);
+}
+
+TEST_CASE("The memory registry copies trees between hives with a filter", "[registry][memory]")
+{
+	Tests::TestDirectory directory;
+	Platform::Memory::RegistryManager memory;
+	IKeyManager& keyManager = memory.getKeyManager();
+
+	const IHivePtr source = memory.getHiveManager().createHive(directory.getPath() / "SOURCE");
+	const IKeyPtr sourceRoot = source->getRootKey();
+	const IHivePtr target = memory.getHiveManager().createHive(directory.getPath() / "TARGET");
+	const IKeyPtr targetRoot = target->getRootKey();
+
+	const IKeyPtr app = keyManager.getOrCreateKey(L"App", Permission::Write, sourceRoot.get());
+	setValue(memory, app, L"Kept", Types::DWord, toData(1));
+	setValue(memory, app, L"Skip", Types::DWord, toData(2));
+	setValue(memory, keyManager.getOrCreateKey(L"App\\Sub\\Deeper", Permission::Write, sourceRoot.get()), L"Kept", Types::DWord, toData(3));
+	keyManager.getOrCreateKey(L"App\\Skip", Permission::Write, sourceRoot.get());
+
+	SkipFilter filter;
+	keyManager.copyTree(sourceRoot.get(), targetRoot.get(), &filter);
+
+	const IKeyPtr copiedApp = keyManager.getKey(L"App", Permission::Read, targetRoot.get());
+	CHECK(getData(memory, copiedApp, L"Kept", Types::DWord) == toData(1));
+	CHECK_THROWS_AS(memory.getValueManager().getValue(copiedApp.get(), L"Skip"), std::system_error);
+	CHECK_THROWS_AS(keyManager.getKey(L"App\\Skip", Permission::Read, targetRoot.get()), std::system_error);
+
+	const IKeyPtr deeper = keyManager.getKey(L"App\\Sub\\Deeper", Permission::Read, targetRoot.get());
+	CHECK(getData(memory, deeper, L"Kept", Types::DWord) == toData(3));
+
+	// the source is left as it was
+	CHECK(keyManager.queryKeyInfo(app.get()).subKeyCount == 2);
+}
+
+TEST_CASE("The memory registry commits hives as registry editor exports", "[registry][memory]")
+{
+	Tests::TestDirectory directory;
+	Platform::Memory::RegistryManager memory(Platform::Memory::HiveFormat::RegText);
+
+	const IHivePtr hive = memory.getHiveManager().createHive(directory.getPath() / "SOFTWARE.reg");
+	fillHive(memory, hive->getRootKey());
+	memory.getHiveManager().commitHive(*hive);
+
+	const std::vector<unsigned char> text = readFile(directory.getPath() / "SOFTWARE.reg");
+	REQUIRE(text.size() > 2);
+	CHECK(text[0] == 0xFF);
+	CHECK(text[1] == 0xFE);
+
+	CHECK(getKeySections(*hive).size() == FilledKeyCount);
+	CHECK_THROWS_AS(memory.getHiveManager().loadHive(directory.getPath() / "SOFTWARE.reg"), std::system_error);
+}
@@ -0,0 +1,163 @@
+#include "registry_memory_platform.h"
+#include "registry_regf_writer.h"
+#include "test_directory.h"
+#include "test_registry.h"
+
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace Registry;
+using namespace Tests;
+
+namespace
+{
+	const Platform::Memory::KeyTree& getTree(const IHivePtr& hive)
+	{
+		return static_cast<const Platform::Memory::Hive&>(*hive).getTree();
+	}
+
+	/**
+	 * Checks that the bins cover the hive and that their cells cover each bin, and returns the names
+	 * of the keys in the order their cells are written.
+	 */
+	std::vector<std::string> checkBins(const std::vector<unsigned char>& image)
+	{
+		using namespace Regf;
+
+		std::vector<std::string> keyNames;
+		const size_t binsSize = readUInt32(image.data() + BaseBlock::BinsSize);
+		REQUIRE(image.size() == BaseBlockSize + binsSize);
+
+		size_t binOffset = 0;
+		while (binOffset < binsSize)
+		{
+			const unsigned char* bin = image.data() + BaseBlockSize + binOffset;
+			REQUIRE(std::string(reinterpret_cast<const char*>(bin), 4) == "hbin");
+			REQUIRE(readUInt32(bin + Bin::Offset) == binOffset);
+
+			const uint32_t binSize = readUInt32(bin + Bin::Size);
+			REQUIRE(binSize % BinAlignment == 0);
+			REQUIRE(binOffset + binSize <= binsSize);
+
+			for (uint32_t cellOffset = BinHeaderSize; cellOffset < binSize;)
+			{
+				const unsigned char* cell = bin + cellOffset;
+				const int32_t cellSize = static_cast<int32_t>(readUInt32(cell));
+				const uint32_t size = cellSize < 0 ? -cellSize : cellSize;
+				REQUIRE(size % CellAlignment == 0);
+				REQUIRE(size != 0);
+				REQUIRE(cellOffset + size <= binSize);
+
+				// allocated key cells, with names stored in Latin-1
+				const unsigned char* data = cell + sizeof(uint32_t);
+				if (cellSize < 0 && data[0] == 'n' && data[1] == 'k') {
+					keyNames.emplace_back(reinterpret_cast<const char*>(data + Key::Name), readUInt16(data + Key::NameLength));
+				}
+
+				cellOffset += size;
+			}
+
+			binOffset += binSize;
+		}
+
+		return keyNames;
+	}
+}
+
+TEST_CASE("The hive writer writes a consistent base block and bins", "[registry][regf]")
+{
+	Tests::TestDirectory directory;
+	Platform::Memory::RegistryManager memory;
+	const IHivePtr hive = memory.getHiveManager().createHive(directory.getPath() / "SOFTWARE");
+	fillHive(memory, hive->getRootKey());
+
+	Regf::HiveWriter writer(0x01D0000000000000);
+	const std::vector<unsigned char> image = writer.write(getTree(hive), L"SOFTWARE");
+
+	REQUIRE(image.size() % Regf::BinAlignment == 0);
+	CHECK(std::string(reinterpret_cast<const char*>(image.data()), 4) == "regf");
+	CHECK(Regf::readUInt32(image.data() + Regf::BaseBlock::PrimarySequence) == Regf::readUInt32(image.data() + Regf::BaseBlock::SecondarySequence));
+	CHECK(Regf::readUInt64(image.data() + Regf::BaseBlock::Timestamp) == 0x01D0000000000000);
+	CHECK(Regf::readUInt32(image.data() + Regf::BaseBlock::MajorVersion) == Regf::MajorVersion);
+	CHECK(Regf::readUInt32(image.data() + Regf::BaseBlock::MinorVersion) == Regf::MinorVersion);
+	CHECK(Regf::readUInt32(image.data() + Regf::BaseBlock::Checksum) == Regf::computeChecksum(std::span<const unsigned char>(image.data(), Regf::BaseBlockSize)));
+
+	const std::vector<std::string> keyNames = checkBins(image);
+	CHECK(keyNames.size() == FilledKeyCount);
+	CHECK(keyNames.front() == "SOFTWARE");
+
+	// the same tree and timestamp give the same file
+	Regf::HiveWriter otherWriter(0x01D0000000000000);
+	CHECK(otherWriter.write(getTree(hive), L"SOFTWARE") == image);
+}
+
+TEST_CASE("The hive writer writes keys in the order of the layout", "[registry][regf]")
+{
+	Tests::TestDirectory directory;
+	Platform::Memory::RegistryManager memory;
+	const IHivePtr hive = memory.getHiveManager().createHive(directory.getPath() / "SOFTWARE");
+	fillHive(memory, hive->getRootKey());
+
+	Regf::HiveLayout layout;
+
+	SECTION("Depth first")
+	{
+		layout.order = Regf::KeyOrder::DepthFirst;
+		const std::vector<std::string> keyNames = checkBins(Regf::HiveWriter(0, layout).write(getTree(hive), L"SOFTWARE"));
+		REQUIRE(keyNames.size() == FilledKeyCount);
+		CHECK(keyNames[1] == "Classes");
+		CHECK(keyNames[2] == ".txt");
+	}
+
+	SECTION("Breadth first")
+	{
+		layout.order = Regf::KeyOrder::BreadthFirst;
+		const std::vector<std::string> keyNames = checkBins(Regf::HiveWriter(0, layout).write(getTree(hive), L"SOFTWARE"));
+		REQUIRE(keyNames.size() == FilledKeyCount);
+
+		std::vector<std::string> firstLevel(keyNames.begin() + 1, keyNames.begin() + 5);
+		std::sort(firstLevel.begin(), firstLevel.end());
+		CHECK(firstLevel == std::vector<std::string>{ "Classes", "Deep", "Many", "Software" });
+	}
+
+	SECTION("Access order")
+	{
+		layout.order = Regf::KeyOrder::AccessOrder;
+		layout.accessedKeys = { L"SOFTWARE\\Many\\Key1234", L"SOFTWARE\\Software\\Vendor" };
+		const std::vector<std::string> keyNames = checkBins(Regf::HiveWriter(0, layout).write(getTree(hive), L"SOFTWARE"));
+		REQUIRE(keyNames.size() == FilledKeyCount);
+		CHECK(std::vector<std::string>(keyNames.begin(), keyNames.begin() + 5) == std::vector<std::string>{ "SOFTWARE", "Many", "Key1234", "Software", "Vendor" });
+	}
+}
+
+TEST_CASE("A hive file written by the memory registry loads back with the same keys and values", "[registry][regf]")
+{
+	const Regf::KeyOrder order = GENERATE(Regf::KeyOrder::DepthFirst, Regf::KeyOrder::BreadthFirst, Regf::KeyOrder::AccessOrder);
+
+	Tests::TestDirectory directory;
+	const std::filesystem::path hiveFile = directory.getPath() / "SOFTWARE";
+
+	Regf::HiveLayout layout;
+	layout.order = order;
+	layout.accessedKeys = { L"SOFTWARE\\Software\\Vendor\\App" };
+
+	Platform::Memory::RegistryManager memory(Platform::Memory::HiveFormat::Regf, layout);
+	const IHivePtr hive = memory.getHiveManager().createHive(hiveFile);
+	fillHive(memory, hive->getRootKey());
+	memory.getHiveManager().commitHive(*hive);
+
+	const IHivePtr loadedHive = memory.getHiveManager().loadHive(hiveFile);
+	const std::vector<std::string> keySections = getKeySections(*hive);
+	CHECK(keySections.size() == FilledKeyCount);
+	CHECK(getKeySections(*loadedHive) == keySections);
+
+	// written again from the loaded tree, nothing is lost
+	memory.getHiveManager().saveHive(*loadedHive, directory.getPath() / "SOFTWARE_COPY");
+	const IHivePtr copiedHive = memory.getHiveManager().loadHive(directory.getPath() / "SOFTWARE_COPY");
+	CHECK(getKeySections(*copiedHive) == keySections);
+}
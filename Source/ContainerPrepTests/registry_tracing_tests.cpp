@@ -0,0 +1,123 @@
+#include "registry_memory_platform.h"
+#include "registry_tracing.h"
+#include "test_directory.h"
+
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <sstream>
+#include <system_error>
+
+using namespace Registry;
+
+namespace
+{
+	const Tracing::OperationTrace* findOperation(const std::vector<Tracing::OperationTrace>& operations, Tracing::Operation operation)
+	{
+		const auto it = std::find_if(operations.begin(), operations.end(), [operation](const Tracing::OperationTrace& trace) { return trace.operation == operation; });
+		return it != operations.end() ? &*it : nullptr;
+	}
+}
+
+TEST_CASE("The tracing registry forwards to the memory backend and counts the operations", "[registry][tracing]")
+{
+	Tests::TestDirectory directory;
+	Platform::Memory::RegistryManager memory;
+	Tracing::RegistryManager traced(memory);
+
+	const std::vector<unsigned char> versionData = { 7, 0, 0, 0 };
+	{
+		const IHivePtr hive = traced.getHiveManager().createHive(directory.getPath() / "TRACED");
+		const IKeyPtr root = hive->getRootKey();
+
+		const IKeyPtr app = traced.getKeyManager().getOrCreateKey(L"Software\\App", Permission::Write, root.get());
+		traced.getValueManager().setValue(app.get(), ValueView(L"Version", Types::DWord, versionData));
+		traced.getValueManager().setValue(app.get(), ValueView(L"Name", Types::Binary, std::vector<unsigned char>(100)));
+		traced.getKeyManager().getOrCreateKey(L"Sub", Permission::Write, app.get());
+
+		// the writes went to the wrapped registry
+		const IKeyPtr memoryApp = memory.getKeyManager().getKey(L"Software\\App", Permission::Read, root.get());
+		const IValuePtr memoryValue = memory.getValueManager().getValue(memoryApp.get(), L"Version");
+		REQUIRE(memoryValue);
+		CHECK(std::equal(versionData.begin(), versionData.end(), memoryValue->getRawData().begin(), memoryValue->getRawData().end()));
+
+		const IKeyPtr openedApp = traced.getKeyManager().getKey(L"Software\\App", Permission::Read, root.get());
+		const IValuePtr value = traced.getValueManager().getValue(openedApp.get(), L"Version");
+		REQUIRE(value);
+		CHECK(value->getType().getRawType() == Types::DWord.getRawType());
+
+		size_t subKeyCount = 0;
+		traced.getKeyManager().visitKeys(openedApp.get(), [&subKeyCount](const IKey* parentKey, const wchar_t* subKeyName)
+			{
+				subKeyCount++;
+				return true;
+			}, 0);
+		CHECK(subKeyCount == 1);
+
+		ValueBatch batch;
+		traced.getValueManager().readKeyValues(openedApp.get(), batch);
+		CHECK(batch.size() == 2);
+
+		// errors of the wrapped registry go through, the operation is still counted
+		CHECK_THROWS_AS(traced.getKeyManager().getKey(L"Missing", Permission::Read, root.get()), std::system_error);
+
+		traced.getHiveManager().commitHive(*hive);
+	}
+
+	CHECK(std::filesystem::exists(directory.getPath() / "TRACED"));
+
+	const std::vector<Tracing::OperationTrace> operations = traced.getTrace().getOperations();
+
+	const Tracing::OperationTrace* getOrCreateKey = findOperation(operations, Tracing::Operation::GetOrCreateKey);
+	REQUIRE(getOrCreateKey);
+	CHECK(getOrCreateKey->count == 2);
+
+	const Tracing::OperationTrace* setValue = findOperation(operations, Tracing::Operation::SetValue);
+	REQUIRE(setValue);
+	CHECK(setValue->count == 2);
+	CHECK(setValue->bytes == 104);
+	CHECK(setValue->getPercentile(0.5) <= setValue->maxTime);
+
+	const Tracing::OperationTrace* getKey = findOperation(operations, Tracing::Operation::GetKey);
+	REQUIRE(getKey);
+	CHECK(getKey->count == 2);
+
+	const Tracing::OperationTrace* readKeyValues = findOperation(operations, Tracing::Operation::ReadKeyValues);
+	REQUIRE(readKeyValues);
+	CHECK(readKeyValues->bytes == 104);
+
+	CHECK(findOperation(operations, Tracing::Operation::CreateHive));
+	CHECK(findOperation(operations, Tracing::Operation::CommitHive));
+	CHECK_FALSE(findOperation(operations, Tracing::Operation::DeleteKey));
+
+	std::ostringstream report;
+	Tracing::writeTrace(report, traced.getTrace(), "memory");
+	CHECK(report.str().find("memory") != std::string::npos);
+}
+
+TEST_CASE("The tracing registry names the slowest keys by their path", "[registry][tracing]")
+{
+	Tests::TestDirectory directory;
+	Platform::Memory::RegistryManager memory;
+	Tracing::RegistryManager traced(memory);
+
+	{
+		const IHivePtr hive = traced.getHiveManager().createHive(directory.getPath() / "TRACED");
+		const IKeyPtr root = hive->getRootKey();
+
+		const IKeyPtr software = traced.getKeyManager().getOrCreateKey(L"Software", Permission::Write, root.get());
+		const IKeyPtr app = traced.getKeyManager().getOrCreateKey(L"Vendor\\App", Permission::Write, software.get());
+		traced.getValueManager().setValue(app.get(), ValueView(L"Version", Types::DWord, std::vector<unsigned char>(4)));
+	}
+
+	// fewer operations than the slowest keys kept, all of them are listed
+	const std::vector<Tracing::SlowKeyTrace> slowestKeys = traced.getTrace().getSlowestKeys();
+	CHECK(std::is_sorted(slowestKeys.begin(), slowestKeys.end(), [](const Tracing::SlowKeyTrace& left, const Tracing::SlowKeyTrace& right) { return left.time > right.time; }));
+
+	const auto setValue = std::find_if(slowestKeys.begin(), slowestKeys.end(), [](const Tracing::SlowKeyTrace& trace) { return trace.operation == Tracing::Operation::SetValue; });
+	REQUIRE(setValue != slowestKeys.end());
+	CHECK(setValue->keyPath == L"Software\\Vendor\\App");
+
+	const auto createKey = std::find_if(slowestKeys.begin(), slowestKeys.end(), [](const Tracing::SlowKeyTrace& trace) { return trace.keyPath == L"Software\\Vendor\\App" && trace.operation == Tracing::Operation::GetOrCreateKey; });
+	CHECK(createKey != slowestKeys.end());
+}
@@ -0,0 +1,60 @@
+#include "test_directory.h"
+
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <system_error>
+
+using namespace Tests;
+
+Tests::TestDirectory::TestDirectory()
+{
+	std::random_device random;
+	const std::filesystem::path tempDir = std::filesystem::temp_directory_path();
+
+	// another test run may use the same temporary directory
+	for (;;)
+	{
+		path = tempDir / ("containerprep-tests-" + std::to_string(random()));
+		if (std::filesystem::create_directory(path)) {
+			break;
+		}
+	}
+}
+
+Tests::TestDirectory::~TestDirectory()
+{
+	std::error_code ec;
+	std::filesystem::remove_all(path, ec);
+}
+
+const std::filesystem::path& Tests::TestDirectory::getPath() const
+{
+	return path;
+}
+
+std::filesystem::path Tests::TestDirectory::writeFile(const std::filesystem::path& relativePath, std::span<const unsigned char> content) const
+{
+	const std::filesystem::path filePath = path / relativePath;
+	std::filesystem::create_directories(filePath.parent_path());
+
+	std::ofstream stream(filePath, std::ios::out | std::ios::binary | std::ios::trunc);
+	stream.write(reinterpret_cast<const char*>(content.data()), content.size());
+	if (stream.fail()) {
+		throw std::system_error(std::make_error_code(std::errc::io_error), "could not write a test file");
+	}
+
+	return filePath;
+}
+
+std::filesystem::path Tests::TestDirectory::writeFile(const std::filesystem::path& relativePath, std::string_view content) const
+{
+	return writeFile(relativePath, std::span<const unsigned char>(reinterpret_cast<const unsigned char*>(content.data()), content.size()));
+}
+
+std::vector<unsigned char> Tests::readFile(const std::filesystem::path& path)
+{
+	std::ifstream stream(path, std::ios::in | std::ios::binary);
+	return std::vector<unsigned char>(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+}
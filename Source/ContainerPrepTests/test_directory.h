@@ -0,0 +1,35 @@
+#pragma once
+
+#include <filesystem>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace Tests
+{
+	/**
+	 * Directory created for a test in the temporary directory, deleted with its content at the end of the test.
+	 */
+	class TestDirectory
+	{
+	public:
+		TestDirectory();
+		~TestDirectory();
+
+		TestDirectory(const TestDirectory&) = delete;
+		TestDirectory& operator=(const TestDirectory&) = delete;
+
+		const std::filesystem::path& getPath() const;
+
+		/**
+		 * Writes a file below the directory, with its parent directories. Returns its absolute path.
+		 */
+		std::filesystem::path writeFile(const std::filesystem::path& relativePath, std::span<const unsigned char> content) const;
+		std::filesystem::path writeFile(const std::filesystem::path& relativePath, std::string_view content) const;
+
+	private:
+		std::filesystem::path path;
+	};
+
+	std::vector<unsigned char> readFile(const std::filesystem::path& path);
+}
@@ -0,0 +1,217 @@
+#include "test_pe_builder.h"
+
+#include <algorithm>
+
+using namespace Tests;
+
+constexpr uint32_t FileAlignment = 0x200;
+constexpr uint32_t SectionAlignment = 0x1000;
+constexpr uint32_t NtHeaderOffset = 0x40;
+constexpr size_t ImportDescriptorSize = 20;
+constexpr size_t DelayImportDescriptorSize = 32;
+constexpr size_t SectionHeaderSize = 40;
+constexpr uint32_t DirectoryCount = 16;
+
+static uint32_t alignUp(size_t value, uint32_t alignment)
+{
+	return static_cast<uint32_t>((value + alignment - 1) / alignment * alignment);
+}
+
+template<typename T>
+static void writeAt(std::vector<unsigned char>& data, size_t offset, T value)
+{
+	if (data.size() < offset + sizeof(T)) {
+		data.resize(offset + sizeof(T));
+	}
+
+	for (size_t i = 0; i < sizeof(T); ++i) {
+		data[offset + i] = static_cast<unsigned char>(static_cast<uint64_t>(value) >> (i * 8));
+	}
+}
+
+static void writeString(std::vector<unsigned char>& data, size_t offset, const std::string& str)
+{
+	if (data.size() < offset + str.size() + 1) {
+		data.resize(offset + str.size() + 1);
+	}
+
+	std::copy(str.begin(), str.end(), data.begin() + offset);
+	data[offset + str.size()] = 0;
+}
+
+std::vector<unsigned char> Tests::buildPeImage(const PeImageSpec& spec)
+{
+	const uint64_t imageBase = spec.b32Bit ? 0x400000 : 0x140000000;
+
+	// import descriptors, delay import descriptors, then the module names
+	std::vector<unsigned char> importSection;
+	const uint32_t importRva = SectionAlignment;
+	const size_t delayDescriptorsOffset = (spec.imports.size() + 1) * ImportDescriptorSize;
+	size_t namesOffset = delayDescriptorsOffset + (spec.delayImports.size() + 1) * DelayImportDescriptorSize;
+	importSection.resize(namesOffset);
+
+	for (size_t i = 0; i < spec.imports.size(); ++i)
+	{
+		const uint32_t nameRva = importRva + static_cast<uint32_t>(namesOffset);
+		writeAt<uint32_t>(importSection, i * ImportDescriptorSize + 12, nameRva);
+		writeAt<uint32_t>(importSection, i * ImportDescriptorSize + 16, nameRva);
+
+		writeString(importSection, namesOffset, spec.imports[i]);
+		namesOffset = importSection.size();
+	}
+
+	for (size_t i = 0; i < spec.delayImports.size(); ++i)
+	{
+		const uint32_t nameRva = importRva + static_cast<uint32_t>(namesOffset);
+		const size_t descriptorOffset = delayDescriptorsOffset + i * DelayImportDescriptorSize;
+		if (spec.bVirtualAddressDelayImports) {
+			writeAt<uint32_t>(importSection, descriptorOffset + 4, static_cast<uint32_t>(imageBase + nameRva));
+		}
+		else
+		{
+			writeAt<uint32_t>(importSection, descriptorOffset, 1);
+			writeAt<uint32_t>(importSection, descriptorOffset + 4, nameRva);
+		}
+
+		writeString(importSection, namesOffset, spec.delayImports[i]);
+		namesOffset = importSection.size();
+	}
+
+	std::vector<std::pair<std::string, const std::vector<unsigned char>*>> sections;
+	sections.emplace_back(".idata", &importSection);
+	for (const auto& [name, data] : spec.sections) {
+		sections.emplace_back(name, &data);
+	}
+
+	// NT signature, COFF file header, optional header with its data directories, section table
+	const size_t fileHeaderOffset = NtHeaderOffset + 4;
+	const size_t optionalHeaderOffset = fileHeaderOffset + 20;
+	const size_t directoriesOffset = optionalHeaderOffset + (spec.b32Bit ? 96 : 112);
+	const size_t optionalHeaderSize = directoriesOffset + DirectoryCount * 8 - optionalHeaderOffset;
+	const size_t sectionsOffset = optionalHeaderOffset + optionalHeaderSize;
+
+	std::vector<unsigned char> image(alignUp(sectionsOffset + sections.size() * SectionHeaderSize, FileAlignment));
+	writeAt<uint16_t>(image, 0, 0x5A4D);
+	writeAt<uint32_t>(image, 0x3C, NtHeaderOffset);
+	writeAt<uint32_t>(image, NtHeaderOffset, 0x00004550);
+
+	writeAt<uint16_t>(image, fileHeaderOffset, spec.b32Bit ? 0x14C : 0x8664);
+	writeAt<uint16_t>(image, fileHeaderOffset + 2, static_cast<uint16_t>(sections.size()));
+	writeAt<uint16_t>(image, fileHeaderOffset + 16, static_cast<uint16_t>(optionalHeaderSize));
+
+	if (spec.b32Bit)
+	{
+		writeAt<uint16_t>(image, optionalHeaderOffset, 0x10B);
+		writeAt<uint32_t>(image, optionalHeaderOffset + 28, static_cast<uint32_t>(imageBase));
+		writeAt<uint32_t>(image, optionalHeaderOffset + 92, DirectoryCount);
+	}
+	else
+	{
+		writeAt<uint16_t>(image, optionalHeaderOffset, 0x20B);
+		writeAt<uint64_t>(image, optionalHeaderOffset + 24, imageBase);
+		writeAt<uint32_t>(image, optionalHeaderOffset + 108, DirectoryCount);
+	}
+
+	if (!spec.imports.empty())
+	{
+		writeAt<uint32_t>(image, directoriesOffset + 1 * 8, importRva);
+		writeAt<uint32_t>(image, directoriesOffset + 1 * 8 + 4, static_cast<uint32_t>(delayDescriptorsOffset));
+	}
+
+	if (!spec.delayImports.empty())
+	{
+		writeAt<uint32_t>(image, directoriesOffset + 13 * 8, importRva + static_cast<uint32_t>(delayDescriptorsOffset));
+		writeAt<uint32_t>(image, directoriesOffset + 13 * 8 + 4, static_cast<uint32_t>(spec.delayImports.size() * DelayImportDescriptorSize));
+	}
+
+	uint32_t rva = importRva;
+	for (size_t i = 0; i < sections.size(); ++i)
+	{
+		const std::string& name = sections[i].first;
+		const std::vector<unsigned char>& data = *sections[i].second;
+		const size_t headerOffset = sectionsOffset + i * SectionHeaderSize;
+		const uint32_t rawOffset = static_cast<uint32_t>(image.size());
+
+		std::copy(name.begin(), name.begin() + std::min<size_t>(name.size(), 8), image.begin() + headerOffset);
+		writeAt<uint32_t>(image, headerOffset + 8, static_cast<uint32_t>(data.size()));
+		writeAt<uint32_t>(image, headerOffset + 12, rva);
+		writeAt<uint32_t>(image, headerOffset + 16, alignUp(data.size(), FileAlignment));
+		writeAt<uint32_t>(image, headerOffset + 20, rawOffset);
+
+		image.insert(image.end(), data.begin(), data.end());
+		image.resize(alignUp(image.size(), FileAlignment));
+		rva += alignUp(std::max<size_t>(data.size(), 1), SectionAlignment);
+	}
+
+	return image;
+}
+
+std::vector<unsigned char> Tests::buildApiSetSchema(const std::vector<ApiSetSpec>& apiSets, uint32_t version)
+{
+	constexpr size_t HeaderSize = 28;
+	constexpr size_t NamespaceEntrySize = 24;
+	constexpr size_t ValueEntrySize = 20;
+
+	size_t valueCount = 0;
+	for (const ApiSetSpec& apiSet : apiSets) {
+		valueCount += 1 + apiSet.importerHosts.size();
+	}
+
+	std::vector<unsigned char> schema(HeaderSize + apiSets.size() * NamespaceEntrySize + valueCount * ValueEntrySize);
+
+	// names are UTF-16, appended after the entries
+	const auto addName = [&schema](const std::string& name)
+		{
+			const uint32_t offset = static_cast<uint32_t>(schema.size());
+			for (const char ch : name) {
+				writeAt<uint16_t>(schema, schema.size(), static_cast<uint16_t>(ch));
+			}
+
+			return std::make_pair(offset, static_cast<uint32_t>(name.size() * 2));
+		};
+
+	const auto writeValue = [&](size_t valuePos, const std::string& importer, const std::string& host)
+		{
+			if (!importer.empty())
+			{
+				const auto [importerOffset, importerLength] = addName(importer);
+				writeAt<uint32_t>(schema, valuePos + 4, importerOffset);
+				writeAt<uint32_t>(schema, valuePos + 8, importerLength);
+			}
+
+			const auto [hostOffset, hostLength] = addName(host);
+			writeAt<uint32_t>(schema, valuePos + 12, hostOffset);
+			writeAt<uint32_t>(schema, valuePos + 16, hostLength);
+		};
+
+	writeAt<uint32_t>(schema, 0, version);
+	writeAt<uint32_t>(schema, 12, static_cast<uint32_t>(apiSets.size()));
+	writeAt<uint32_t>(schema, 16, static_cast<uint32_t>(HeaderSize));
+
+	size_t valuePos = HeaderSize + apiSets.size() * NamespaceEntrySize;
+	for (size_t i = 0; i < apiSets.size(); ++i)
+	{
+		const ApiSetSpec& apiSet = apiSets[i];
+		const size_t entryPos = HeaderSize + i * NamespaceEntrySize;
+
+		// the hashed part of the name stops before the revision number
+		const auto [nameOffset, nameLength] = addName(apiSet.name);
+		writeAt<uint32_t>(schema, entryPos + 4, nameOffset);
+		writeAt<uint32_t>(schema, entryPos + 8, nameLength);
+		writeAt<uint32_t>(schema, entryPos + 12, static_cast<uint32_t>(apiSet.name.rfind('-') * 2));
+		writeAt<uint32_t>(schema, entryPos + 16, static_cast<uint32_t>(valuePos));
+		writeAt<uint32_t>(schema, entryPos + 20, static_cast<uint32_t>(1 + apiSet.importerHosts.size()));
+
+		writeValue(valuePos, {}, apiSet.defaultHost);
+		valuePos += ValueEntrySize;
+
+		for (const auto& [importer, host] : apiSet.importerHosts)
+		{
+			writeValue(valuePos, importer, host);
+			valuePos += ValueEntrySize;
+		}
+	}
+
+	writeAt<uint32_t>(schema, 4, static_cast<uint32_t>(schema.size()));
+	return schema;
+}
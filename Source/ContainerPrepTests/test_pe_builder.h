@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Tests
+{
+	/**
+	 * Content of a PE image built for a test, with only the headers and tables the parser reads.
+	 */
+	struct PeImageSpec
+	{
+		bool b32Bit = false;
+		std::vector<std::string> imports;
+		std::vector<std::string> delayImports;
+
+		/** Delay imports name their modules by virtual address, as in images older than Visual C++ 7. */
+		bool bVirtualAddressDelayImports = false;
+
+		/** Sections added after the import section, by name, with their data. */
+		std::vector<std::pair<std::string, std::vector<unsigned char>>> sections;
+	};
+
+	std::vector<unsigned char> buildPeImage(const PeImageSpec& spec);
+
+	/**
+	 * API set contract, with its host module and the hosts that depend on the importing module.
+	 */
+	struct ApiSetSpec
+	{
+		/** Contract name with its revision number, without extension (api-ms-win-core-file-l1-1-0). */
+		std::string name;
+		std::string defaultHost;
+		std::vector<std::pair<std::string, std::string>> importerHosts;
+	};
+
+	/**
+	 * Builds the .apiset section data of apisetschema.dll, schema version 6.
+	 */
+	std::vector<unsigned char> buildApiSetSchema(const std::vector<ApiSetSpec>& apiSets, uint32_t version = 6);
+}
@@ -0,0 +1,107 @@
+#include "test_registry.h"
+#include "registry_memory_platform.h"
+
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <sstream>
+
+using namespace Registry;
+
+std::vector<unsigned char> Tests::toData(uint32_t value)
+{
+	return { static_cast<unsigned char>(value), static_cast<unsigned char>(value >> 8), static_cast<unsigned char>(value >> 16), static_cast<unsigned char>(value >> 24) };
+}
+
+std::vector<unsigned char> Tests::toData(const std::u16string_view& str)
+{
+	std::vector<unsigned char> data;
+	for (const char16_t ch : str)
+	{
+		data.push_back(static_cast<unsigned char>(ch));
+		data.push_back(static_cast<unsigned char>(ch >> 8));
+	}
+
+	data.insert(data.end(), { 0, 0 });
+	return data;
+}
+
+std::vector<unsigned char> Tests::getBigData()
+{
+	std::vector<unsigned char> data(40000);
+	for (size_t i = 0; i < data.size(); ++i) {
+		data[i] = static_cast<unsigned char>(i * 7);
+	}
+
+	return data;
+}
+
+void Tests::setValue(IRegistryManager& registry, const IKeyPtr& key, const wchar_t* name, const IDataType& type, const std::vector<unsigned char>& data)
+{
+	registry.getValueManager().setValue(key.get(), ValueView(name, type, data));
+}
+
+std::vector<unsigned char> Tests::getData(IRegistryManager& registry, const IKeyPtr& key, const wchar_t* valueName, const IDataType& expectedType)
+{
+	const IValuePtr value = registry.getValueManager().getValue(key.get(), valueName);
+	REQUIRE(value);
+	CHECK(value->getType().getRawType() == expectedType.getRawType());
+
+	const std::span<const unsigned char> data = value->getRawData();
+	return std::vector<unsigned char>(data.begin(), data.end());
+}
+
+void Tests::fillHive(IRegistryManager& registry, const IKeyPtr& root)
+{
+	IKeyManager& keyManager = registry.getKeyManager();
+
+	setValue(registry, keyManager.getOrCreateKey(L"Classes\\.txt", Permission::Write, root.get()), L"", Types::String, toData(u"txtfile"));
+
+	const IKeyPtr app = keyManager.getOrCreateKey(L"Software\\Vendor\\App", Permission::Write, root.get());
+	setValue(registry, app, L"Version", Types::DWord, toData(7));
+	setValue(registry, app, L"Small", Types::Binary, { 1, 2, 3 });
+	setValue(registry, app, L"Empty", Types::Binary, {});
+	setValue(registry, app, L"Paths", Types::MultiString, toData(u"C:\\One\0C:\\Two\0"));
+	setValue(registry, app, L"Big", Types::Binary, getBigData());
+
+	const IKeyPtr many = keyManager.getOrCreateKey(L"Many", Permission::Write, root.get());
+	for (uint32_t i = 0; i < ManySubKeyCount; ++i)
+	{
+		const IKeyPtr subKey = keyManager.getOrCreateKey((L"Key" + std::to_wstring(i)).c_str(), Permission::Write, many.get());
+		setValue(registry, subKey, L"Index", Types::DWord, toData(i));
+	}
+
+	IKeyPtr deepKey = root;
+	for (size_t i = 0; i < DeepKeyCount; ++i) {
+		deepKey = keyManager.getOrCreateKey(L"Deep", Permission::Write, deepKey.get());
+	}
+
+	setValue(registry, deepKey, L"Depth", Types::DWord, toData(DeepKeyCount));
+}
+
+std::vector<std::string> Tests::getKeySections(const IHive& hive)
+{
+	std::ostringstream stream;
+	Platform::Memory::writeRegText(stream, static_cast<const Platform::Memory::Hive&>(hive).getTree(), L"HKEY_LOCAL_MACHINE\\SOFTWARE");
+
+	// UTF-16 text, sections are separated by an empty line and the first one is the header
+	const std::string text = stream.str();
+	const std::string separator("\r\0\n\0\r\0\n\0", 8);
+
+	std::vector<std::string> sections;
+	for (size_t start = text.find(separator); start != std::string::npos;)
+	{
+		start += separator.size();
+		const size_t end = text.find(separator, start);
+
+		std::string section = text.substr(start, end == std::string::npos ? std::string::npos : end - start);
+		if (!section.empty()) {
+			sections.push_back(std::move(section));
+		}
+
+		start = end;
+	}
+
+	std::sort(sections.begin(), sections.end());
+	return sections;
+}
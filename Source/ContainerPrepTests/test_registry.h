@@ -0,0 +1,47 @@
+#pragma once
+
+#include "registry.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Tests
+{
+	std::vector<unsigned char> toData(uint32_t value);
+
+	/**
+	 * UTF-16 string data with its terminator, as REG_SZ values are stored.
+	 */
+	std::vector<unsigned char> toData(const std::u16string_view& str);
+
+	/**
+	 * Data larger than a cell, stored in segments by hive files.
+	 */
+	std::vector<unsigned char> getBigData();
+
+	void setValue(Registry::IRegistryManager& registry, const Registry::IKeyPtr& key, const wchar_t* name, const Registry::IDataType& type, const std::vector<unsigned char>& data);
+
+	/**
+	 * Returns the data of a value and checks its type.
+	 */
+	std::vector<unsigned char> getData(Registry::IRegistryManager& registry, const Registry::IKeyPtr& key, const wchar_t* valueName, const Registry::IDataType& expectedType);
+
+	/** Keys created by fillHive, with the root key. */
+	constexpr size_t FilledKeyCount = 1571;
+	constexpr size_t ManySubKeyCount = 1500;
+	constexpr size_t DeepKeyCount = 64;
+
+	/**
+	 * Creates keys and values of each kind hive files lay out differently: values of each size,
+	 * the default value, a key with enough subkeys for an index of several leaves and a deep chain of keys.
+	 */
+	void fillHive(Registry::IRegistryManager& registry, const Registry::IKeyPtr& root);
+
+	/**
+	 * Returns the key sections of a memory hive as .reg text, sorted as the memory tree keeps subkeys
+	 * in the order they were created while hive files keep them in name order.
+	 */
+	std::vector<std::string> getKeySections(const Registry::IHive& hive);
+}
@@ -0,0 +1,97 @@
+#include "allocation_counter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <Psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+using namespace RegBench;
+
+/** Room before each block for its size, keeping the alignment of malloc. */
+static constexpr size_t HeaderSize = 16;
+
+static std::atomic<uint64_t> allocationCount(0);
+static std::atomic<uint64_t> allocatedBytes(0);
+static std::atomic<uint64_t> liveBytes(0);
+static std::atomic<uint64_t> peakBytes(0);
+
+// the array and nothrow forms call these two
+void* operator new(size_t size)
+{
+	unsigned char* block = static_cast<unsigned char*>(std::malloc(size + HeaderSize));
+	if (!block) {
+		throw std::bad_alloc();
+	}
+
+	*reinterpret_cast<size_t*>(block) = size;
+
+	allocationCount.fetch_add(1, std::memory_order_relaxed);
+	allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+
+	const uint64_t live = liveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+	uint64_t peak = peakBytes.load(std::memory_order_relaxed);
+	while (live > peak && !peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+	}
+
+	return block + HeaderSize;
+}
+
+void operator delete(void* ptr) noexcept
+{
+	if (!ptr) {
+		return;
+	}
+
+	unsigned char* block = static_cast<unsigned char*>(ptr) - HeaderSize;
+	liveBytes.fetch_sub(*reinterpret_cast<size_t*>(block), std::memory_order_relaxed);
+
+	std::free(block);
+}
+
+void operator delete(void* ptr, size_t size) noexcept
+{
+	operator delete(ptr);
+}
+
+void AllocationCounter::reset()
+{
+	allocationCount.store(0, std::memory_order_relaxed);
+	allocatedBytes.store(0, std::memory_order_relaxed);
+	peakBytes.store(liveBytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+AllocationStats AllocationCounter::get()
+{
+	AllocationStats stats;
+	stats.allocations = allocationCount.load(std::memory_order_relaxed);
+	stats.allocatedBytes = allocatedBytes.load(std::memory_order_relaxed);
+	stats.peakBytes = peakBytes.load(std::memory_order_relaxed);
+
+	return stats;
+}
+
+uint64_t RegBench::getProcessPeakMemory()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+		return 0;
+	}
+
+	return counters.PeakWorkingSetSize;
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage)) {
+		return 0;
+	}
+
+	// kilobytes on Linux
+	return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+
+namespace RegBench
+{
+	struct AllocationStats
+	{
+		uint64_t allocations = 0;
+		uint64_t allocatedBytes = 0;
+
+		/** Most memory allocated at once since the counters were reset. */
+		uint64_t peakBytes = 0;
+	};
+
+	/**
+	 * Counts the allocations made through operator new, which the benchmark replaces.
+	 */
+	namespace AllocationCounter
+	{
+		void reset();
+		AllocationStats get();
+	}
+
+	/**
+	 * Returns the peak memory of the process as reported by the system, 0 if it isn't known.
+	 */
+	uint64_t getProcessPeakMemory();
+}
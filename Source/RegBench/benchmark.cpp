@@ -0,0 +1,296 @@
+#include "benchmark.h"
+
+#include "registry_configuration.h"
+#include "registry_configuration_visitor.h"
+#include "registry_hive_file_platform.h"
+#include "registry_memory_platform.h"
+#ifdef _WIN32
+#include "registry_windows_platform.h"
+#endif
+
+#include <algorithm>
+#include <iomanip>
+#include <stdexcept>
+#include <system_error>
+
+using namespace RegBench;
+using namespace Registry;
+
+RegBench::Benchmark::Benchmark(const BenchmarkOptions& inOptions, ThreadPool& inPool)
+	: options(inOptions)
+	, pool(inPool)
+{
+}
+
+std::vector<std::string> RegBench::Benchmark::getBackendNames()
+{
+#ifdef _WIN32
+	return { "memory", "regf", "windows" };
+#else
+	return { "memory", "regf" };
+#endif
+}
+
+void RegBench::Benchmark::run(const std::string& backend, const TreeProfile& profile)
+{
+	if (backend == "memory") {
+		runMemory(profile);
+	}
+	else if (backend == "regf") {
+		runRegf(profile);
+	}
+	else if (backend == "windows") {
+		runWindows(profile);
+	}
+	else {
+		throw std::invalid_argument("unknown registry backend " + backend);
+	}
+}
+
+const std::vector<BenchmarkResult>& RegBench::Benchmark::getResults() const
+{
+	return results;
+}
+
+void RegBench::Benchmark::runMemory(const TreeProfile& profile)
+{
+	Platform::Memory::RegistryManager registry;
+	const IHivePtr hive = registry.getHiveManager().createHive(options.workDir / L"MEMORY");
+	const IKeyPtr rootKey = hive->getRootKey();
+
+	TreeStats stats;
+	measure("memory", profile, "generate", stats, 1, [&]()
+		{
+			stats = generateTree(registry, rootKey.get(), profile, options.seed);
+		});
+
+	runReads("memory", profile, registry, rootKey, stats);
+}
+
+void RegBench::Benchmark::runRegf(const TreeProfile& profile)
+{
+	TreeStats stats;
+
+	{
+		// the hive file is written from memory, as the offline hives are
+		Platform::Memory::RegistryManager memoryRegistry;
+		const IHivePtr hive = memoryRegistry.getHiveManager().createHive(options.workDir / L"REGF");
+		stats = generateTree(memoryRegistry, hive->getRootKey().get(), profile, options.seed);
+
+		measure("regf", profile, "write", stats, options.repeat, [&]()
+			{
+				memoryRegistry.getHiveManager().commitHive(*hive);
+			});
+	}
+
+	Platform::HiveFile::RegistryManager registry(options.workDir);
+	const IKeyPtr rootKey = registry.getKeyManager().getKey(L"REGF", Permission::Read, registry.getKeyManager().getPredefinedKey(L"HKLM").get());
+	if (!rootKey) {
+		throw std::system_error(std::make_error_code(std::errc::no_such_file_or_directory), "couldn't open the written hive");
+	}
+
+	runReads("regf", profile, registry, rootKey, stats);
+}
+
+void RegBench::Benchmark::runWindows(const TreeProfile& profile)
+{
+#ifdef _WIN32
+	// an application hive, the tree doesn't touch the registry of the machine
+	Platform::Windows::RegistryManager registry;
+	const IHivePtr hive = registry.getHiveManager().createHive(options.workDir / L"WINDOWS.dat");
+	const IKeyPtr rootKey = hive->getRootKey();
+
+	TreeStats stats;
+	measure("windows", profile, "generate", stats, 1, [&]()
+		{
+			stats = generateTree(registry, rootKey.get(), profile, options.seed);
+		});
+
+	measure("windows", profile, "commit", stats, 1, [&]()
+		{
+			registry.getHiveManager().commitHive(*hive);
+		});
+
+	runReads("windows", profile, registry, rootKey, stats);
+#else
+	throw std::invalid_argument("the windows registry backend requires Windows");
+#endif
+}
+
+/**
+ * Reads the values of a tree key by key, as the snapshots of host keys do.
+ */
+static size_t walkKeyValues(IRegistryManager& registry, const IKey* key)
+{
+	size_t valueCount = 0;
+	registry.getValueManager().visitKeyValues(key, [&](const IValue&)
+		{
+			valueCount++;
+			return true;
+		});
+
+	std::vector<std::wstring> subKeyNames;
+	registry.getKeyManager().visitKeys(key, [&](const IKey*, const wchar_t* subKeyName)
+		{
+			subKeyNames.emplace_back(subKeyName);
+			return true;
+		}, 0);
+
+	for (const std::wstring& subKeyName : subKeyNames)
+	{
+		const IKeyPtr subKey = registry.getKeyManager().getKey(subKeyName.c_str(), Permission::Read, key);
+		valueCount += walkKeyValues(registry, subKey.get());
+	}
+
+	return valueCount;
+}
+
+void RegBench::Benchmark::runReads(const std::string& backend, const TreeProfile& profile, IRegistryManager& registry, const IKeyPtr& rootKey, const TreeStats& stats)
+{
+	measure(backend, profile, "visitKeys", stats, options.repeat, [&]()
+		{
+			size_t keyCount = 0;
+			registry.getKeyManager().visitKeys(rootKey.get(), [&](const IKey*, const wchar_t*)
+				{
+					keyCount++;
+					return true;
+				});
+
+			if (keyCount != stats.keys) {
+				throw std::runtime_error("visited " + std::to_string(keyCount) + " keys out of " + std::to_string(stats.keys));
+			}
+		});
+
+	measure(backend, profile, "visitKeyValues", stats, options.repeat, [&]()
+		{
+			const size_t valueCount = walkKeyValues(registry, rootKey.get());
+			if (valueCount != stats.values) {
+				throw std::runtime_error("visited " + std::to_string(valueCount) + " values out of " + std::to_string(stats.values));
+			}
+		});
+
+	measure(backend, profile, "copyKeysValues", stats, options.repeat, [&]()
+		{
+			// the copy is released within the run
+			Platform::Memory::RegistryManager targetRegistry;
+			const IHivePtr targetHive = targetRegistry.getHiveManager().createHive(options.workDir / L"COPY");
+			Helpers::copyKeysValues(registry, targetRegistry, rootKey.get(), targetHive->getRootKey().get());
+		});
+
+	// a host key for each key below the root, as the hive configurations list them
+	std::vector<std::wstring> hostKeyNames;
+	registry.getKeyManager().visitKeys(rootKey.get(), [&](const IKey*, const wchar_t* subKeyName)
+		{
+			hostKeyNames.emplace_back(subKeyName);
+			return true;
+		}, 0);
+
+	measure(backend, profile, "pipeline", stats, options.repeat, [&]()
+		{
+			Platform::Memory::RegistryManager targetRegistry;
+			KeyConfigVisitor visitor(registry, targetRegistry, options.workDir / L"PIPELINE", rootKey, true, nullptr, &pool);
+
+			for (const std::wstring& hostKeyName : hostKeyNames) {
+				visitor.prepare(Config::HostKey(hostKeyName, hostKeyName));
+			}
+
+			for (const std::wstring& hostKeyName : hostKeyNames) {
+				visitor.visit(Config::HostKey(hostKeyName, hostKeyName));
+			}
+
+			visitor.finish();
+		});
+}
+
+void RegBench::Benchmark::measure(const std::string& backend, const TreeProfile& profile, const std::string& benchmark, const TreeStats& stats, size_t runs, const std::function<void()>& func)
+{
+	BenchmarkResult result;
+	result.backend = backend;
+	result.profile = profile.name;
+	result.benchmark = benchmark;
+
+	for (size_t run = 0; run < std::max<size_t>(runs, 1); ++run)
+	{
+		AllocationCounter::reset();
+
+		const auto startTime = std::chrono::steady_clock::now();
+		func();
+		const std::chrono::nanoseconds time = std::chrono::steady_clock::now() - startTime;
+
+		if (!run || time < result.time)
+		{
+			result.time = time;
+			result.allocations = AllocationCounter::get();
+		}
+	}
+
+	// the tree may be generated by the run
+	result.keys = stats.keys;
+	result.values = stats.values;
+
+	results.push_back(std::move(result));
+}
+
+static double toMilliseconds(std::chrono::nanoseconds time)
+{
+	return std::chrono::duration<double, std::milli>(time).count();
+}
+
+static double getRate(size_t count, std::chrono::nanoseconds time)
+{
+	return time.count() ? count / std::chrono::duration<double>(time).count() : 0;
+}
+
+static double toMegabytes(uint64_t bytes)
+{
+	return bytes / (1024.0 * 1024.0);
+}
+
+void RegBench::writeResults(std::ostream& stream, const std::vector<BenchmarkResult>& results)
+{
+	stream << std::left << std::setw(10) << "backend"
+		<< std::setw(10) << "profile"
+		<< std::setw(16) << "benchmark" << std::right
+		<< std::setw(10) << "ms"
+		<< std::setw(12) << "keys/s"
+		<< std::setw(12) << "values/s"
+		<< std::setw(12) << "allocs"
+		<< std::setw(12) << "alloc MB"
+		<< std::setw(10) << "peak MB" << std::endl;
+
+	const std::ios_base::fmtflags flags = stream.flags();
+	stream << std::fixed << std::setprecision(1);
+
+	for (const BenchmarkResult& result : results)
+	{
+		stream << std::left << std::setw(10) << result.backend
+			<< std::setw(10) << result.profile
+			<< std::setw(16) << result.benchmark << std::right
+			<< std::setw(10) << toMilliseconds(result.time)
+			<< std::setw(12) << std::setprecision(0) << getRate(result.keys, result.time)
+			<< std::setw(12) << getRate(result.values, result.time)
+			<< std::setw(12) << result.allocations.allocations << std::setprecision(1)
+			<< std::setw(12) << toMegabytes(result.allocations.allocatedBytes)
+			<< std::setw(10) << toMegabytes(result.allocations.peakBytes) << std::endl;
+	}
+
+	stream.flags(flags);
+}
+
+void RegBench::writeResultsTsv(std::ostream& stream, const std::vector<BenchmarkResult>& results)
+{
+	stream << "backend\tprofile\tbenchmark\tns\tkeys\tvalues\tallocations\tallocated_bytes\tpeak_bytes\n";
+
+	for (const BenchmarkResult& result : results)
+	{
+		stream << result.backend << '\t'
+			<< result.profile << '\t'
+			<< result.benchmark << '\t'
+			<< result.time.count() << '\t'
+			<< result.keys << '\t'
+			<< result.values << '\t'
+			<< result.allocations.allocations << '\t'
+			<< result.allocations.allocatedBytes << '\t'
+			<< result.allocations.peakBytes << '\n';
+	}
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "allocation_counter.h"
+#include "synthetic_tree.h"
+#include "thread_pool.h"
+
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace RegBench
+{
+	struct BenchmarkOptions
+	{
+		/** Directory of the hive files written by the benchmarks. */
+		std::filesystem::path workDir;
+
+		/** Runs of each read benchmark, the fastest is kept. */
+		size_t repeat = 1;
+
+		uint64_t seed = 1;
+	};
+
+	struct BenchmarkResult
+	{
+		std::string backend;
+		std::string profile;
+		std::string benchmark;
+		std::chrono::nanoseconds time{};
+		size_t keys = 0;
+		size_t values = 0;
+		AllocationStats allocations;
+	};
+
+	/**
+	 * Runs the benchmarks of a tree profile against the registry backends (memory, regf, windows).
+	 */
+	class Benchmark
+	{
+	public:
+		Benchmark(const BenchmarkOptions& inOptions, ThreadPool& inPool);
+
+		/**
+		 * Names of the backends available on this platform.
+		 */
+		static std::vector<std::string> getBackendNames();
+
+		void run(const std::string& backend, const TreeProfile& profile);
+
+		const std::vector<BenchmarkResult>& getResults() const;
+
+	private:
+		void runMemory(const TreeProfile& profile);
+		void runRegf(const TreeProfile& profile);
+		void runWindows(const TreeProfile& profile);
+
+		/**
+		 * Walks, copies and builds a hive from a generated tree.
+		 */
+		void runReads(const std::string& backend, const TreeProfile& profile, Registry::IRegistryManager& registry, const Registry::IKeyPtr& rootKey, const TreeStats& stats);
+
+		/**
+		 * Times a benchmark, keeping the fastest of the runs.
+		 */
+		void measure(const std::string& backend, const TreeProfile& profile, const std::string& benchmark, const TreeStats& stats, size_t runs, const std::function<void()>& func);
+
+	private:
+		BenchmarkOptions options;
+		ThreadPool& pool;
+		std::vector<BenchmarkResult> results;
+	};
+
+	/**
+	 * Writes the results as a table with the rates and allocations of each benchmark.
+	 */
+	void writeResults(std::ostream& stream, const std::vector<BenchmarkResult>& results);
+
+	/**
+	 * Writes the results as tab-separated lines, preceded by a header.
+	 */
+	void writeResultsTsv(std::ostream& stream, const std::vector<BenchmarkResult>& results);
+}
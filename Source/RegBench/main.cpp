@@ -0,0 +1,148 @@
+#include "allocation_counter.h"
+#include "benchmark.h"
+#include "synthetic_tree.h"
+#include "thread_pool.h"
+
+#include <tclap/CmdLine.h>
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+/**
+ * Splits a comma-separated list, "all" standing for every name.
+ */
+static std::vector<std::string> splitNames(const std::string& list, const std::vector<std::string>& allNames)
+{
+	if (list == "all") {
+		return allNames;
+	}
+
+	std::vector<std::string> names;
+	std::stringstream stream(list);
+	std::string name;
+	while (std::getline(stream, name, ',')) {
+		if (!name.empty()) {
+			names.push_back(name);
+		}
+	}
+
+	return names;
+}
+
+int main(int argc, const char* argv[])
+{
+	std::vector<RegBench::TreeProfile> profiles;
+	std::vector<std::string> backends;
+	RegBench::BenchmarkOptions options;
+	size_t threadCount = 0;
+	std::filesystem::path tsvFile;
+
+	TCLAP::CmdLine cmd("Registry benchmark on synthetic trees", ' ');
+	cmd.setExceptionHandling(false);
+
+	try
+	{
+		TCLAP::ValueArg<std::string> profileArg("p", "profile", "Tree profiles (wide, deep, services), separated by commas, or all", false, "all", "string");
+		TCLAP::ValueArg<size_t> depthArg("", "depth", "Levels of subkeys below the root, instead of those of the profile", false, 0, "count");
+		TCLAP::ValueArg<size_t> fanOutArg("", "fan-out", "Subkeys of each key, or services, instead of those of the profile", false, 0, "count");
+		TCLAP::ValueArg<size_t> valuesArg("", "values", "Values of each key, instead of those of the profile", false, 0, "count");
+		TCLAP::ValueArg<uint64_t> seedArg("", "seed", "Seed of the generated trees", false, 1, "number");
+		TCLAP::ValueArg<size_t> repeatArg("r", "repeat", "Runs of each benchmark, the fastest is kept", false, 3, "count");
+		TCLAP::ValueArg<std::string> backendsArg("b", "backends", "Registry backends (memory, regf, windows), separated by commas, or all", false, "all", "string");
+		TCLAP::ValueArg<std::string> workDirArg("w", "work-dir", "Directory of the hive files written by the benchmarks", false, "", "string");
+		TCLAP::ValueArg<size_t> threadsArg("t", "threads", "Threads reading the host keys of the pipeline", false, 0, "count");
+		TCLAP::ValueArg<std::string> tsvArg("", "tsv", "Also writes the results to a file, as tab-separated lines", false, "", "string");
+
+		cmd.add(profileArg);
+		cmd.add(depthArg);
+		cmd.add(fanOutArg);
+		cmd.add(valuesArg);
+		cmd.add(seedArg);
+		cmd.add(repeatArg);
+		cmd.add(backendsArg);
+		cmd.add(workDirArg);
+		cmd.add(threadsArg);
+		cmd.add(tsvArg);
+
+		cmd.parse(argc, argv);
+
+		for (const std::string& profileName : splitNames(profileArg.getValue(), RegBench::getProfileNames()))
+		{
+			RegBench::TreeProfile profile = RegBench::getProfile(profileName);
+			if (depthArg.isSet()) {
+				profile.depth = depthArg.getValue();
+			}
+			if (fanOutArg.isSet()) {
+				profile.fanOut = fanOutArg.getValue();
+			}
+			if (valuesArg.isSet()) {
+				profile.valuesPerKey = valuesArg.getValue();
+			}
+
+			profiles.push_back(std::move(profile));
+		}
+
+		backends = splitNames(backendsArg.getValue(), RegBench::Benchmark::getBackendNames());
+
+		if (workDirArg.isSet()) {
+			options.workDir = workDirArg.getValue();
+		}
+		else {
+			options.workDir = std::filesystem::temp_directory_path() / L"regbench";
+		}
+
+		options.seed = seedArg.getValue();
+		options.repeat = repeatArg.getValue();
+		threadCount = threadsArg.getValue();
+		if (tsvArg.isSet()) {
+			tsvFile = tsvArg.getValue();
+		}
+	}
+	catch (const TCLAP::ArgException& e)
+	{
+		std::cerr << "error: " << e.error() << " for arg " << e.argId() << std::endl;
+		return 1;
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "error: " << e.what() << std::endl;
+		return 2;
+	}
+	catch (...)
+	{
+		return 3;
+	}
+
+	std::filesystem::create_directories(options.workDir);
+
+	ThreadPool pool(threadCount);
+	RegBench::Benchmark benchmark(options, pool);
+
+	try
+	{
+		for (const RegBench::TreeProfile& profile : profiles)
+		{
+			for (const std::string& backend : backends) {
+				benchmark.run(backend, profile);
+			}
+		}
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "error: " << e.what() << std::endl;
+		return 4;
+	}
+
+	RegBench::writeResults(std::cout, benchmark.getResults());
+	std::cout << "process peak: " << RegBench::getProcessPeakMemory() / (1024 * 1024) << " MB" << std::endl;
+
+	if (!tsvFile.empty())
+	{
+		std::ofstream tsvStream(tsvFile, std::ios::out | std::ios::binary);
+		RegBench::writeResultsTsv(tsvStream, benchmark.getResults());
+	}
+
+	return 0;
+}
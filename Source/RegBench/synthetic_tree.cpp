@@ -0,0 +1,291 @@
+#include "synthetic_tree.h"
+
+#include <random>
+#include <stdexcept>
+
+using namespace RegBench;
+using namespace Registry;
+
+RegBench::TreeProfile RegBench::getProfile(const std::string& name)
+{
+	TreeProfile profile;
+	profile.name = name;
+
+	if (name == "wide")
+	{
+		// shallow keys with many siblings and small values, as in SOFTWARE\Classes
+		profile.depth = 2;
+		profile.fanOut = 300;
+		profile.valuesPerKey = 4;
+		profile.valueSizes = { { 60, 4, 4 }, { 30, 16, 128 }, { 10, 256, 2048 } };
+	}
+	else if (name == "deep")
+	{
+		profile.depth = 8;
+		profile.fanOut = 4;
+		profile.valuesPerKey = 2;
+		profile.valueSizes = { { 50, 4, 4 }, { 10, 8, 8 }, { 40, 16, 256 } };
+	}
+	else if (name == "services")
+	{
+		profile.fanOut = 600;
+		profile.bServices = true;
+	}
+	else {
+		throw std::invalid_argument("unknown tree profile " + name);
+	}
+
+	return profile;
+}
+
+std::vector<std::string> RegBench::getProfileNames()
+{
+	return { "wide", "deep", "services" };
+}
+
+/**
+ * Writes the values and subkeys of a tree, keeping the counts.
+ */
+class TreeWriter
+{
+public:
+	TreeWriter(IRegistryManager& inRegistry, uint64_t seed)
+		: registry(inRegistry)
+		, random(seed)
+	{
+	}
+
+	IKeyPtr createKey(const IKey* parentKey, const std::wstring& keyName)
+	{
+		stats.keys++;
+		return registry.getKeyManager().getOrCreateKey(keyName.c_str(), Permission::Write, parentKey);
+	}
+
+	void setValue(const IKey* key, const std::wstring& valueName, const IDataType& type, const std::span<const unsigned char>& data)
+	{
+		registry.getValueManager().setValue(key, ValueView(valueName.c_str(), type, data));
+
+		stats.values++;
+		stats.dataBytes += data.size();
+	}
+
+	void setDWord(const IKey* key, const std::wstring& valueName, uint32_t value)
+	{
+		setValue(key, valueName, Types::DWord, std::span<const unsigned char>((const unsigned char*)&value, sizeof(value)));
+	}
+
+	void setQWord(const IKey* key, const std::wstring& valueName, uint64_t value)
+	{
+		setValue(key, valueName, Types::QWord, std::span<const unsigned char>((const unsigned char*)&value, sizeof(value)));
+	}
+
+	void setString(const IKey* key, const std::wstring& valueName, const IDataType& type, const std::u16string& value)
+	{
+		// strings are stored as UTF-16 with their terminating null character
+		setValue(key, valueName, type, std::span<const unsigned char>((const unsigned char*)value.c_str(), (value.length() + 1) * sizeof(char16_t)));
+	}
+
+	void setBinary(const IKey* key, const std::wstring& valueName, size_t size)
+	{
+		std::vector<unsigned char> data(size);
+		for (unsigned char& byte : data) {
+			byte = static_cast<unsigned char>(random());
+		}
+
+		setValue(key, valueName, Types::Binary, data);
+	}
+
+	/**
+	 * Sets a value of a given data size, its type following the size.
+	 */
+	void setSizedValue(const IKey* key, const std::wstring& valueName, size_t size)
+	{
+		if (size == 4) {
+			setDWord(key, valueName, static_cast<uint32_t>(random()));
+		}
+		else if (size == 8) {
+			setQWord(key, valueName, random());
+		}
+		else if (random() & 1) {
+			setString(key, valueName, Types::String, makeText(size / sizeof(char16_t) > 1 ? size / sizeof(char16_t) - 1 : 0));
+		}
+		else {
+			setBinary(key, valueName, size);
+		}
+	}
+
+	std::u16string makeText(size_t length)
+	{
+		std::u16string text(length, u'a');
+		for (char16_t& ch : text) {
+			ch = static_cast<char16_t>(u'a' + random() % 26);
+		}
+
+		return text;
+	}
+
+	size_t pick(size_t minValue, size_t maxValue)
+	{
+		return minValue + static_cast<size_t>(random() % (maxValue - minValue + 1));
+	}
+
+	bool chance(unsigned percent)
+	{
+		return random() % 100 < percent;
+	}
+
+	const TreeStats& getStats() const
+	{
+		return stats;
+	}
+
+private:
+	IRegistryManager& registry;
+	std::mt19937_64 random;
+	TreeStats stats;
+};
+
+static std::wstring toWide(const std::u16string& text)
+{
+	return std::wstring(text.begin(), text.end());
+}
+
+static std::u16string toText(const std::wstring& text)
+{
+	return std::u16string(text.begin(), text.end());
+}
+
+static void generateKeys(TreeWriter& writer, const IKey* key, const TreeProfile& profile, size_t depth)
+{
+	unsigned totalWeight = 0;
+	for (const ValueSizeRange& range : profile.valueSizes) {
+		totalWeight += range.weight;
+	}
+
+	for (size_t i = 0; i < profile.valuesPerKey && totalWeight; ++i)
+	{
+		size_t weight = writer.pick(0, totalWeight - 1);
+		for (const ValueSizeRange& range : profile.valueSizes)
+		{
+			if (weight < range.weight)
+			{
+				writer.setSizedValue(key, L"Value" + std::to_wstring(i), writer.pick(range.minSize, range.maxSize));
+				break;
+			}
+
+			weight -= range.weight;
+		}
+	}
+
+	if (depth == profile.depth) {
+		return;
+	}
+
+	for (size_t i = 0; i < profile.fanOut; ++i)
+	{
+		const IKeyPtr subKey = writer.createKey(key, L"Key" + std::to_wstring(i));
+		generateKeys(writer, subKey.get(), profile, depth + 1);
+	}
+}
+
+/**
+ * Writes a service key with the values and subkeys usually found in SYSTEM\CurrentControlSet\Services.
+ */
+static void generateService(TreeWriter& writer, const IKey* servicesKey, size_t index)
+{
+	const std::wstring serviceName = toWide(writer.makeText(writer.pick(3, 12))) + std::to_wstring(index);
+	const IKeyPtr serviceKey = writer.createKey(servicesKey, serviceName);
+	const IKey* key = serviceKey.get();
+
+	const bool bDriver = writer.chance(60);
+	writer.setDWord(key, L"Type", bDriver ? 1 : 0x10);
+	writer.setDWord(key, L"Start", static_cast<uint32_t>(writer.pick(0, 4)));
+	writer.setDWord(key, L"ErrorControl", static_cast<uint32_t>(writer.pick(0, 1)));
+
+	if (bDriver) {
+		writer.setString(key, L"ImagePath", Types::ExpandableString, u"\\SystemRoot\\System32\\drivers\\" + toText(serviceName) + u".sys");
+	}
+	else {
+		writer.setString(key, L"ImagePath", Types::ExpandableString, u"%SystemRoot%\\System32\\svchost.exe -k " + writer.makeText(writer.pick(6, 20)) + u" -p");
+	}
+
+	writer.setString(key, L"DisplayName", Types::String, u"@%SystemRoot%\\system32\\" + writer.makeText(writer.pick(5, 15)) + u".dll,-" + toText(std::to_wstring(writer.pick(100, 9999))));
+	writer.setString(key, L"Description", Types::String, writer.makeText(writer.pick(40, 200)));
+
+	if (!bDriver) {
+		writer.setString(key, L"ObjectName", Types::String, u"LocalSystem");
+	}
+
+	if (writer.chance(40)) {
+		writer.setString(key, L"Group", Types::String, writer.makeText(writer.pick(4, 20)));
+	}
+
+	if (writer.chance(30))
+	{
+		// strings separated by null characters, the list ends with an empty string
+		std::u16string dependencies;
+		for (size_t i = writer.pick(1, 4); i > 0; --i)
+		{
+			dependencies += writer.makeText(writer.pick(3, 12));
+			dependencies += u'\0';
+		}
+
+		writer.setString(key, L"DependOnService", Types::MultiString, dependencies);
+	}
+
+	if (writer.chance(30)) {
+		writer.setBinary(key, L"FailureActions", writer.pick(20, 44));
+	}
+
+	if (writer.chance(70))
+	{
+		const IKeyPtr parametersKey = writer.createKey(key, L"Parameters");
+		for (size_t i = writer.pick(1, 6); i > 0; --i) {
+			writer.setSizedValue(parametersKey.get(), toWide(writer.makeText(writer.pick(4, 16))) + std::to_wstring(i), writer.chance(60) ? 4 : writer.pick(16, 260));
+		}
+	}
+
+	if (writer.chance(40))
+	{
+		const IKeyPtr securityKey = writer.createKey(key, L"Security");
+		writer.setBinary(securityKey.get(), L"Security", writer.pick(100, 300));
+	}
+
+	if (bDriver && writer.chance(30))
+	{
+		const IKeyPtr enumKey = writer.createKey(key, L"Enum");
+		writer.setString(enumKey.get(), L"0", Types::String, u"ROOT\\LEGACY_" + writer.makeText(writer.pick(4, 12)) + u"\\0000");
+		writer.setDWord(enumKey.get(), L"Count", 1);
+		writer.setDWord(enumKey.get(), L"NextInstance", 1);
+	}
+
+	if (bDriver && writer.chance(10))
+	{
+		const IKeyPtr instancesKey = writer.createKey(key, L"Instances");
+		writer.setString(instancesKey.get(), L"DefaultInstance", Types::String, writer.makeText(writer.pick(8, 24)));
+
+		for (size_t i = writer.pick(1, 3); i > 0; --i)
+		{
+			const IKeyPtr instanceKey = writer.createKey(instancesKey.get(), toWide(writer.makeText(writer.pick(8, 24))) + std::to_wstring(i));
+			writer.setString(instanceKey.get(), L"Altitude", Types::String, toText(std::to_wstring(writer.pick(20000, 429999))));
+			writer.setDWord(instanceKey.get(), L"Flags", 0);
+		}
+	}
+}
+
+TreeStats RegBench::generateTree(IRegistryManager& registry, const IKey* rootKey, const TreeProfile& profile, uint64_t seed)
+{
+	TreeWriter writer(registry, seed);
+
+	if (profile.bServices)
+	{
+		for (size_t i = 0; i < profile.fanOut; ++i) {
+			generateService(writer, rootKey, i);
+		}
+	}
+	else {
+		generateKeys(writer, rootKey, profile, 0);
+	}
+
+	return writer.getStats();
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "registry.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace RegBench
+{
+	/**
+	 * Share of the values whose data size is picked in a range.
+	 * Values of 4 and 8 bytes are written as DWORD and QWORD, others as strings or binary data.
+	 */
+	struct ValueSizeRange
+	{
+		unsigned weight;
+		size_t minSize;
+		size_t maxSize;
+	};
+
+	/**
+	 * Shape of a generated registry tree.
+	 */
+	struct TreeProfile
+	{
+		std::string name;
+
+		/** Levels of subkeys below the root. */
+		size_t depth = 0;
+
+		/** Subkeys of each key above the last level. */
+		size_t fanOut = 0;
+
+		size_t valuesPerKey = 0;
+		std::vector<ValueSizeRange> valueSizes;
+
+		/** Keys laid out as the services of SYSTEM\CurrentControlSet, the other settings are ignored. */
+		bool bServices = false;
+	};
+
+	struct TreeStats
+	{
+		size_t keys = 0;
+		size_t values = 0;
+		size_t dataBytes = 0;
+	};
+
+	/**
+	 * Returns the built-in profile of that name (wide, deep, services), or throws std::invalid_argument.
+	 */
+	TreeProfile getProfile(const std::string& name);
+
+	std::vector<std::string> getProfileNames();
+
+	/**
+	 * Writes a tree below a key. The same profile and seed always write the same keys and values.
+	 */
+	TreeStats generateTree(Registry::IRegistryManager& registry, const Registry::IKey* rootKey, const TreeProfile& profile, uint64_t seed);
+}
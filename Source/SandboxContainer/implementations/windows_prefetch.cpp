@@ -0,0 +1,140 @@
+#include "windows_prefetch.h"
+
+#include <Windows.h>
+
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+
+using namespace Container;
+
+struct PrefetchFile
+{
+	HANDLE hFile;
+	uintmax_t size;
+};
+
+/**
+ * Reads the whole file, the data is discarded.
+ */
+static uintmax_t readFile(HANDLE hFile, uint8_t* buffer, uint32_t chunkSize)
+{
+	uintmax_t totalRead = 0;
+
+	for (;;)
+	{
+		DWORD bytesRead = 0;
+		if (!ReadFile(hFile, buffer, chunkSize, &bytesRead, NULL) || !bytesRead) {
+			break;
+		}
+
+		totalRead += bytesRead;
+	}
+
+	return totalRead;
+}
+
+std::vector<std::filesystem::path> Storage::readPrefetchList(const std::filesystem::path& listFile)
+{
+	std::vector<std::filesystem::path> files;
+
+	std::ifstream stream(listFile, std::ios::in | std::ios::binary);
+	std::string line;
+	while (std::getline(stream, line))
+	{
+		if (!line.empty() && line.back() == '\r') {
+			line.pop_back();
+		}
+
+		if (!line.empty()) {
+			files.emplace_back(std::u8string(reinterpret_cast<const char8_t*>(line.data()), line.size()));
+		}
+	}
+
+	return files;
+}
+
+Storage::PrefetchResult Storage::prefetchFiles(const std::vector<std::filesystem::path>& files, const PrefetchOptions& options)
+{
+	const auto startTime = std::chrono::steady_clock::now();
+
+	PrefetchResult result{};
+
+	// open the files in list order and keep those that fit in the budget,
+	// so that the first accessed files are always read
+	std::vector<PrefetchFile> prefetchFiles;
+	prefetchFiles.reserve(files.size());
+
+	uintmax_t budget = options.byteBudget;
+	for (const std::filesystem::path& file : files)
+	{
+		HANDLE hFile = CreateFileW(
+			file.c_str(),
+			GENERIC_READ,
+			FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+			NULL,
+			OPEN_EXISTING,
+			FILE_FLAG_SEQUENTIAL_SCAN,
+			NULL
+		);
+
+		if (hFile == INVALID_HANDLE_VALUE)
+		{
+			++result.skippedCount;
+			continue;
+		}
+
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(hFile, &fileSize) || static_cast<uintmax_t>(fileSize.QuadPart) > budget)
+		{
+			CloseHandle(hFile);
+			++result.skippedCount;
+			continue;
+		}
+
+		budget -= fileSize.QuadPart;
+		prefetchFiles.push_back({ hFile, static_cast<uintmax_t>(fileSize.QuadPart) });
+	}
+
+	uint32_t threadCount = options.threadCount ? options.threadCount : std::thread::hardware_concurrency();
+	if (threadCount > prefetchFiles.size()) {
+		threadCount = static_cast<uint32_t>(prefetchFiles.size());
+	}
+
+	const uint32_t chunkSize = options.chunkSize ? options.chunkSize : 1024 * 1024;
+
+	std::atomic<size_t> nextFile = 0;
+	std::atomic<uintmax_t> byteCount = 0;
+
+	std::vector<std::thread> threads;
+	threads.reserve(threadCount);
+
+	for (uint32_t i = 0; i < threadCount; ++i)
+	{
+		threads.emplace_back([&]
+			{
+				std::unique_ptr<uint8_t[]> buffer(new uint8_t[chunkSize]);
+
+				// workers take the files in list order
+				for (size_t index = nextFile++; index < prefetchFiles.size(); index = nextFile++) {
+					byteCount += readFile(prefetchFiles[index].hFile, buffer.get(), chunkSize);
+				}
+			});
+	}
+
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+
+	for (const PrefetchFile& file : prefetchFiles) {
+		CloseHandle(file.hFile);
+	}
+
+	result.fileCount = prefetchFiles.size();
+	result.byteCount = byteCount;
+	result.duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime);
+
+	return result;
+}
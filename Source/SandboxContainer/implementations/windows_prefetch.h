@@ -0,0 +1,42 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+namespace Container
+{
+	namespace Storage
+	{
+		struct PrefetchOptions
+		{
+			/** Maximum number of bytes to read, files past the budget are skipped. */
+			uintmax_t byteBudget;
+
+			/** Number of files read at the same time, 0 for one per processor. */
+			uint32_t threadCount;
+
+			/** Size of each sequential read in bytes, 0 for 1 MB. */
+			uint32_t chunkSize;
+		};
+
+		struct PrefetchResult
+		{
+			size_t fileCount;
+			size_t skippedCount;
+			uintmax_t byteCount;
+			std::chrono::milliseconds duration;
+		};
+
+		/**
+		 * Reads the prefetch list written by conprep, one UTF-8 host path per line.
+		 */
+		std::vector<std::filesystem::path> readPrefetchList(const std::filesystem::path& listFile);
+
+		/**
+		 * Warms the host page cache for the files, in list order, with large sequential reads.
+		 */
+		PrefetchResult prefetchFiles(const std::vector<std::filesystem::path>& files, const PrefetchOptions& options);
+	}
+}
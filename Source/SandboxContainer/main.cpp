@@ -1,12 +1,14 @@
 #include "implementations/windows_storage.h"
 #include "implementations/windows_container_runtime.h"
 #include "implementations/windows_container_process.h"
+#include "implementations/windows_prefetch.h"
 
 #include <tclap/CmdLine.h>
 
 #include <iostream>
 #include <fstream>
 #include <filesystem>
+#include <chrono>
 
 #include <conio.h>
 
@@ -23,7 +25,7 @@ Container::Storage::IStoragePtr createLayer()
 	return storageManager.create(storageOptions);
 }
 
-void createContainer(const Container::Storage::IStoragePtr& storage, const std::wstring& containerName, const std::filesystem::path& containerPath)
+void createContainer(const Container::Storage::IStoragePtr& storage, const std::wstring& containerName, const std::filesystem::path& containerPath, const Container::Storage::PrefetchOptions* prefetchOptions)
 {
 	Container::Runtime::WindowsContainerManager containerManager;
 
@@ -54,6 +56,18 @@ void createContainer(const Container::Storage::IStoragePtr& storage, const std::
 
 	container = containerManager.create(containerName.c_str(), containerOptions);
 
+	const auto startTime = std::chrono::steady_clock::now();
+
+	if (prefetchOptions)
+	{
+		// Warm the host page cache with the files read while booting
+		const std::vector<std::filesystem::path> prefetchFiles = Container::Storage::readPrefetchList(containerPath / L"prefetch.lst");
+		const Container::Storage::PrefetchResult prefetchResult = Container::Storage::prefetchFiles(prefetchFiles, *prefetchOptions);
+
+		std::cerr << "prefetch: " << prefetchResult.fileCount << " files, " << prefetchResult.byteCount / (1024 * 1024) << " MB in "
+			<< prefetchResult.duration.count() << " ms (" << prefetchResult.skippedCount << " skipped)" << std::endl;
+	}
+
 	// Start the container!
 	container->start();
 
@@ -69,6 +83,9 @@ void createContainer(const Container::Storage::IStoragePtr& storage, const std::
 
 	Container::Runtime::IProcessPtr process = processManager.createProcess(container, processCreateOptions);
 
+	const auto firstProcessTime = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime);
+	std::cerr << "time to first process: " << firstProcessTime.count() << " ms" << (prefetchOptions ? "" : " (no prefetch)") << std::endl;
+
 	std::thread inThread([process]
 		{
 			std::ostream* inStream = process->getInputStream();
@@ -127,6 +144,8 @@ int main(int argc, const char* argv[])
 {
 	std::filesystem::path containerPath;
 	std::wstring containerHostName;
+	Container::Storage::PrefetchOptions prefetchOptions{ 256 * 1024 * 1024, 0, 0 };
+	bool bPrefetch = true;
 
 	TCLAP::CmdLine cmd("Container preparation tool", ' ');
 	cmd.setExceptionHandling(false);
@@ -136,10 +155,14 @@ int main(int argc, const char* argv[])
 		TCLAP::ValueArg<std::string> containerDrivePathArg("p", "condir", "The container directory on the system drive", false, "", "string");
 		TCLAP::ValueArg<std::string> containerNameArg("c", "name", "Container name", true, "", "string");
 		TCLAP::ValueArg<std::string> containerHostNameArg("n", "hostname", "Container host name", false, "", "string");
+		TCLAP::SwitchArg noPrefetchArg("", "no-prefetch", "Don't read the container prefetch list before starting", false);
+		TCLAP::ValueArg<uint32_t> prefetchBudgetArg("", "prefetch-budget", "Maximum size of the prefetched files, in MB", false, 256, "MB");
 
 		cmd.add(containerDrivePathArg);
 		cmd.add(containerNameArg);
 		cmd.add(containerHostNameArg);
+		cmd.add(noPrefetchArg);
+		cmd.add(prefetchBudgetArg);
 
 		cmd.parse(argc, argv);
 
@@ -167,6 +190,9 @@ int main(int argc, const char* argv[])
 			const std::string val = containerNameArg.getValue();
 			containerHostName = std::wstring(val.begin(), val.end());
 		}
+
+		bPrefetch = !noPrefetchArg.getValue();
+		prefetchOptions.byteBudget = static_cast<uintmax_t>(prefetchBudgetArg.getValue()) * 1024 * 1024;
 	}
 	catch (const TCLAP::ArgException& e)
 	{
@@ -184,5 +210,5 @@ int main(int argc, const char* argv[])
 	}
 
 	Container::Storage::IStoragePtr storage = createLayer();
-	createContainer(storage, containerHostName, containerPath);
+	createContainer(storage, containerHostName, containerPath, bPrefetch ? &prefetchOptions : nullptr);
 }